@@ -2,7 +2,13 @@ REM Do 8080 -> Z80 -> X86 and 8080 -> X86 conversions
 Release\convert-8080-to-z80-or-x86.exe -generate_x86 -relax stages\sargon-8080-and-x86.asm stages\sargon-x86.asm stages\sargon-asm-interface.h temp-report.txt
 Release\convert-8080-to-z80-or-x86.exe -generate_z80 stages\sargon-8080-and-x86.asm stages\sargon-z80-and-x86.asm temp-interface.h temp-report.txt
 Release\convert-8080-to-z80-or-x86.exe -generate_z80_only stages\sargon-8080-and-x86.asm stages\sargon-z80.asm temp-interface.h temp-report.txt
-Release\convert-z80-to-x86.exe -relax stages\sargon-z80-and-x86.asm temp-sargon-x86.asm temp-sargon-asm-interface.h temp-report.txt
+Release\convert-z80-to-x86.exe -relax -map=stages\sargon-x86-map.txt stages\sargon-z80-and-x86.asm temp-sargon-x86.asm temp-sargon-asm-interface.h temp-report.txt
+REM Optional optimised X86 code (see report for each optimisation), copy to src\sargon-x86.asm to use
+Release\convert-z80-to-x86.exe -relax -widen -idioms -peephole -map=stages\sargon-x86-optimised-map.txt stages\sargon-z80-and-x86.asm stages\sargon-x86-optimised.asm temp-interface.h stages\sargon-x86-optimised-report.txt
+REM Optional profiling X86 code, copy both files to src\sargon-x86.asm and src\sargon-asm-interface.h to use
+Release\convert-z80-to-x86.exe -relax -profile stages\sargon-z80-and-x86.asm stages\sargon-x86-profile.asm stages\sargon-asm-interface-profile.h stages\sargon-x86-profile-report.txt
+REM Portable C++ version of the same code, for the sargon-tests-cpp project (copy to src\sargon-cpp.cpp)
+Release\convert-z80-to-x86.exe -relax -cpp stages\sargon-z80-and-x86.asm stages\sargon-cpp.cpp temp-interface.h temp-report.txt
 Release\convert-z80-to-x86.exe -z80_only stages\sargon-z80-and-x86.asm temp-sargon-z80.asm temp-interface.h temp-report.txt
 
 REM Assemble the Z80 code with ZMAC cross assembler to stages\sargon-z80.lst
@@ -13,5 +19,6 @@ fc stages\sargon-x86.asm temp-sargon-x86.asm
 fc stages\sargon-asm-interface.h temp-sargon-asm-interface.h
 fc stages\sargon-x86.asm src\sargon-x86.asm
 fc stages\sargon-asm-interface.h src\sargon-asm-interface.h
+fc stages\sargon-cpp.cpp src\sargon-cpp.cpp
 fc stages\sargon-z80.asm temp-sargon-z80.asm
 del temp-*.*
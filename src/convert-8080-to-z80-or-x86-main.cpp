@@ -464,7 +464,10 @@ void convert( bool relax_switch, std::string fin, std::string fout, std::string
     util::putline( h_out, "extern \"C\" {" );
     util::putline( h_out, "" );
     util::putline( h_out, "    // First byte of Sargon data"  );
-    util::putline( h_out, "    extern unsigned char sargon_base_address;" );
+    util::putline( h_out, "    extern unsigned char sargon_base_address[];" );
+    util::putline( h_out, "" );
+    util::putline( h_out, "    // Non zero selects native C++ POINTS(), see sargon-points.cpp" );
+    util::putline( h_out, "    extern unsigned char sargon_native_points;" );
     util::putline( h_out, "" );
     util::putline( h_out, "    // Calls to sargon() can set and read back registers" );
     util::putline( h_out, "    struct z80_registers" );
@@ -487,6 +490,10 @@ void convert( bool relax_switch, std::string fin, std::string fout, std::string
     util::putline( h_out, "                   uint32_t ebx, uint32_t edx, uint32_t ecx, uint32_t eax," );
     util::putline( h_out, "                   uint32_t eflags );" );
     util::putline( h_out, "" );
+    util::putline( h_out, "    // Portable form of callback(), for the C++ build of Sargon. The x86 build's" );
+    util::putline( h_out, "    //  callback() calls it too, see sargon-interface.cpp" );
+    util::putline( h_out, "    void sargon_callback( const char *msg, z80_registers &registers );" );
+    util::putline( h_out, "" );
     util::putline( h_out, "    // Data offsets for peeking and poking" );
     bool api_constants_detected = false;
     std::set<std::string> labels;
@@ -40,6 +40,42 @@ std::string detabify( const std::string &s, bool push_comment_to_right=false );
 enum original_t { original_keep, original_comment_out, original_discard };
 static original_t original_switch = original_discard;
 
+// Optionally widen 16 bit register loads to 32 bits, but only where it can be
+//  shown that the result is identical (the top 16 bits of ebx, ecx, edx, esi
+//  and edi are always zero). Widened (and rejected) candidates are listed in
+//  the report file
+static bool widen_switch = false;
+static std::map<std::string,long> widen_known_values;   // data labels
+static std::map<std::string,std::string> widen_equates; // equates, evaluated on demand
+static std::vector<std::string> widen_report;
+static int widen_count, widen_rejected_count, widen_wraparound_count;
+
+// Evaluate a simple expression (number, known symbol, or symbol+/-number)
+static bool widen_evaluate( const std::string &expr, long &value );
+
+// Optionally replace recognised Z80 routines and instructions with native x86
+static bool idioms_switch = false;
+
+// Optionally apply peephole optimisations to the x86 output
+static bool peephole_switch = false;
+
+// Check each peephole rewrite is applied when, and only when, its conditions are met
+static bool peephole_test();
+
+// Optionally inline small routines at their call sites
+static bool inline_switch = false;
+static int inline_threshold = 24;       // maximum routine size, Z80 instructions
+
+// Optionally write a map from x86 output lines to Z80 source lines
+static bool map_switch = false;
+static std::string map_fout;
+
+// Optionally count calls and cycles for each called routine
+static bool profile_switch = false;
+
+// Optionally write portable C++ instead of x86 code
+static bool cpp_switch = false;
+
 int main( int argc, const char *argv[] )
 {
     bool relax=false;
@@ -73,6 +109,61 @@ int main( int argc, const char *argv[] )
     "   of proof passes to programmer) but improves performance. For Sargon, manual\n"
     "   checking suggests it's okay to use this flag.\n"
     "\n"
+    " -widen\n"
+    "   Widen 16 bit register loads to 32 bits where the result is provably the\n"
+    "   same, eg MOV ebx,imm instead of MOV bx,imm, MOVZX esi,word ptr [mem]\n"
+    "   instead of MOV si,word ptr [mem]. Relies on the top 16 bits of ebx, ecx,\n"
+    "   edx, esi and edi always being zero. Avoids operand size prefixes and\n"
+    "   partial register writes. Each candidate instruction, widened or not, is\n"
+    "   listed with its justification in the report file.\n"
+    "\n"
+    " -idioms\n"
+    "   Recognise Sargon's DIVIDE and MLTPLY routines and the CPIR instruction and\n"
+    "   replace them with native x86 equivalents (DIV, MUL, REPNE SCASB). Each\n"
+    "   native version is guarded so it is only used where the results are exactly\n"
+    "   the same, otherwise the literal translation runs. DIVIDE and MLTPLY are\n"
+    "   only replaced with -relax (the native versions set the flags the -relax\n"
+    "   DJNZ translation leaves). Recognised idioms are listed in the report file.\n"
+    "\n"
+    " -peephole\n"
+    "   Apply a catalogue of safe rewrites to the translated x86 code, removing\n"
+    "   redundant reloads and stores, jumps to the next instruction, unneeded\n"
+    "   SAHF/LAHF instructions and retargeting jumps to jumps. Code passed\n"
+    "   through from .IF_X86 blocks is never changed. Each rewrite, and a hit\n"
+    "   count for each pattern, is listed in the report file.\n"
+    "\n"
+    " -peephole_test\n"
+    "   Run the peephole rewrites over small instruction sequences, checking each\n"
+    "   rewrite is applied where it is safe and not where a flag, register or\n"
+    "   label condition rules it out. No files are needed, exit code is 0 if all\n"
+    "   cases pass.\n"
+    "\n"
+    " -inline or -inline=N\n"
+    "   Expand calls to small routines (default N=24 Z80 instructions or fewer) in\n"
+    "   place, eg PATH, LIMIT and ADJPTR in Sargon. Only routines with a single\n"
+    "   entry point, no stack manipulation and no calls to other routines qualify.\n"
+    "   Local labels in each expansion are renamed to be unique. Candidate routines,\n"
+    "   call sites and the code size impact are listed in the report file.\n"
+    "\n"
+    " -map or -map=map.txt\n"
+    "   Write a map file relating each line of x86 code to the Z80 source line,\n"
+    "   routine and label it came from, eg \"POINTS: PT20 line 1811\". Use it to\n"
+    "   interpret profiler results attributed to x86 source lines or offsets.\n"
+    "   Default filename is generated from the main output filename.\n"
+    "\n"
+ " -profile\n"
+    "   Bracket each call to a Sargon routine with rdtsc based counters that\n"
+    "   accumulate calls, total cycles and self cycles for each routine. The\n"
+    "   counters are defined in sargon-profile.cpp, which is compiled in when the\n"
+    "   generated asm-interface.h defines SARGON_PROFILE.\n"
+    "\n"
+    " -cpp\n"
+    "   Write portable C++ instead of x86 assembly language to the main output\n"
+    "   file (eg sargon-cpp.cpp), one function per routine, Z80 registers and\n"
+    "   flags as variables, and the same 64K data layout (and asm-interface.h) as\n"
+    "   the x86 code. Flags are only calculated where they might be used. The x86\n"
+    "   optimisation switches are ignored.\n"
+    "\n"
     " -z80_only\n"
     "   Don't convert to X86, instead strip .IF_X86 code and .IF_X86, .IF_Z80, .ELSE\n"
     "   and .ENDIF directives to generate a pure Z80 assembly language source file\n"
@@ -96,6 +187,32 @@ int main( int argc, const char *argv[] )
         {
             if( arg == "-relax" )
                 relax = true;
+            else if( arg == "-widen" )
+                widen_switch = true;
+            else if( arg == "-idioms" )
+                idioms_switch = true;
+            else if( arg == "-peephole" )
+                peephole_switch = true;
+            else if( arg == "-peephole_test" )
+                return peephole_test() ? 0 : -1;
+            else if( arg == "-inline" )
+                inline_switch = true;
+            else if( arg.substr(0,8)=="-inline=" && atoi(arg.c_str()+8)>0 )
+            {
+                inline_switch = true;
+                inline_threshold = atoi(arg.c_str()+8);
+            }
+            else if( arg == "-profile" )
+                profile_switch = true;
+            else if( arg == "-cpp" )
+                cpp_switch = true;
+            else if( arg == "-map" )
+                map_switch = true;
+            else if( arg.substr(0,5) == "-map=" && arg.length()>5 )
+            {
+                map_switch = true;
+                map_fout = arg.substr(5);
+            }
             else if( arg == "-z80_only" )
                 z80_only = true;
             else if( arg == "-original_keep" )
@@ -130,6 +247,17 @@ int main( int argc, const char *argv[] )
     std::string fout( argv[argi+1] );
     std::string asm_interface_fout = argc>=4 ? argv[argi+2] : fout + "-asm-interface.h";
     std::string report_fout = argc>=5 ? argv[argi+3] : fout + "-report.txt";
+    if( cpp_switch )
+    {
+        widen_switch    = false;
+        idioms_switch   = false;
+        peephole_switch = false;
+        inline_switch   = false;
+        map_switch      = false;
+        profile_switch  = false;
+    }
+    if( map_switch && map_fout == "" )
+        map_fout = fout + "-map.txt";
     convert(relax,z80_only,fin,fout,report_fout,asm_interface_fout);
     return 0;
 }
@@ -325,68 +453,2185 @@ static void parse( const std::string &line, statement &stmt )
                 }
                 else
                 {
-                    parm += c;
+                    parm += c;
+                }
+                break;
+            }
+            case between_parms_before_comma:
+            {
+                if( c == ';' )
+                {
+                    state = in_comment;
+                }
+                else if( c == ',' )
+                {
+                    state = between_parms_after_comma;
+                }
+                break;
+            }
+            case between_parms_after_comma:
+            {
+                if( c == ',' )
+                    state = err;
+                else if( c != ' ' )
+                {
+                    parm = c;
+                    if( c == '\'' )
+                        state = in_quoted_parm;
+                    else if( c == '\"' )
+                        state = in_double_quoted_parm;
+                    else
+                        state = in_parm;
+                }
+                break;
+            }
+        }
+    }
+    const char *identifier_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
+    if( util::toupper(stmt.label).find_first_not_of(identifier_chars) != std::string::npos )
+        stmt.typ = illegal;
+    if( util::toupper(stmt.instruction).find_first_not_of(identifier_chars) != std::string::npos )
+        stmt.typ = illegal;
+    if( state == init )
+        stmt.typ = empty;
+    else if( state==before_instruction && stmt.label=="" )
+        stmt.typ = empty;
+    else if( state == err || state==between_parms_after_comma || state==in_quoted_parm || state==in_double_quoted_parm )
+        stmt.typ = illegal;
+    else if( state == in_parm )
+    {
+        util::rtrim(parm);
+        stmt.parameters.push_back(parm);
+    }
+    stmt.instruction = util::toupper(stmt.instruction);
+    if( stmt.instruction == "EQU" )
+    {
+        if( stmt.label == "" || stmt.label_has_colon_terminator || stmt.parameters.size()!=1 )
+            stmt.typ = illegal;
+        else
+        {
+            stmt.typ = equate;
+            stmt.equate = stmt.label;
+            stmt.label = "";
+        }
+    }
+}
+
+// Idiom recognition. Recognised Z80 routines and instructions are replaced
+//  with native x86 equivalents. Each native version is guarded so that it
+//  is only used where it produces exactly the same results as the literal
+//  translation, which is retained as a fallback
+static int idiom_counter=1;
+static std::map<std::string,int> idiom_hits;
+static std::vector<std::string> idiom_report;
+
+// Normalised form of a statement's instruction, eg "SUB A,E"
+static std::string idiom_normalise( const statement &stmt )
+{
+    std::string s = util::toupper(stmt.instruction);
+    bool first = true;
+    for( const std::string &parm: stmt.parameters )
+    {
+        s += first ? " " : ",";
+        first = false;
+        s += util::toupper(parm);
+    }
+    return s;
+}
+
+// Do the source lines starting at idx match a sequence of instructions ?
+static bool idiom_match( const std::vector<std::string> &lines, size_t idx, const std::vector<std::string> &pattern )
+{
+    for( const std::string &instruction: pattern )
+    {
+        if( idx >= lines.size() )
+            return false;
+        std::string line = lines[idx++];
+        util::rtrim(line);
+        util::replace_all(line,"\t"," ");
+        statement stmt;
+        parse( line, stmt );
+        if( stmt.typ!=normal || idiom_normalise(stmt)!=instruction )
+            return false;
+    }
+    return true;
+}
+
+// Sargon's DIVIDE, an 8 iteration shift and subtract loop dividing A:D by E,
+//  quotient in D, remainder in A. The loop tests the sign of the partial
+//  remainder, so it only agrees with a true division when the remainder can't
+//  reach 80H, exhaustive checking shows it's exact for E <= 128 and A < E
+static const std::vector<std::string> idiom_divide =
+{
+    "PUSH BC", "LD B,8", "SLA D", "RLA", "SUB A,E", "JP M,REL027", "INC D",
+    "JR REL024", "ADD A,E", "DJNZ DD04", "POP BC", "RET"
+};
+
+// Sargon's MLTPLY, an 8 iteration shift and add loop multiplying D by E,
+//  product in A:D. The loop uses an 8 bit accumulator with an arithmetic
+//  right shift, exhaustive checking shows it's exact for E <= 64
+static const std::vector<std::string> idiom_multiply =
+{
+    "PUSH BC", "SUB A,A", "LD B,8", "BIT 0,D", "JR Z,REL025", "ADD A,E",
+    "SRA A", "RR D", "DJNZ ML04", "POP BC", "RET"
+};
+
+// Try to recognise an idiom at source line idx, if successful out is the x86
+//  code to emit in place of the statement's literal translation. DIVIDE and
+//  MLTPLY need -relax, their native versions set the flags the -relax DJNZ
+//  leaves. The strict DJNZ restores the flags of the last loop iteration,
+//  which depend on the data, so no fixed flag setting can match them
+static bool idiom_recognise( const std::vector<std::string> &lines, size_t idx, const statement &stmt, bool relax, std::string &out )
+{
+    std::string name;
+    std::string fallback = util::sprintf( "idiom%d", idiom_counter );
+    std::string literal;
+    std::set<std::string> labels;
+    if( relax && util::toupper(stmt.label)=="DIVIDE" && idiom_match(lines,idx,idiom_divide) )
+    {
+        // Native DIV, A:D / E -> quotient in al -> D, remainder in ah -> A. The
+        //  -relax loop always exits with B decremented to zero, so CMP al,al
+        //  leaves Z, S and P as the loop does (CY is not defined)
+        name = "DIVIDE";
+        translate_x86( lines[idx], stmt.instruction, stmt.parameters, labels, literal );
+        out = util::sprintf(
+            "CMP\tdl,128\n"
+            "\tJA\t%s\n"
+            "\tCMP\tal,dl\n"
+            "\tJAE\t%s\n"
+            "\tMOV\tah,al\n"
+            "\tMOV\tal,dh\n"
+            "\tDIV\tdl\n"
+            "\tMOV\tdh,al\n"
+            "\tMOV\tal,ah\n"
+            "\tCMP\tal,al\n"
+            "\tRET\n"
+            "%s:\t%s",
+            fallback.c_str(), fallback.c_str(), fallback.c_str(), literal.c_str() );
+        idiom_report.push_back( "DIVIDE routine -> native DIV if E <= 128 and A < E, else original loop" );
+    }
+    else if( relax && util::toupper(stmt.label)=="MLTPLY" && idiom_match(lines,idx,idiom_multiply) )
+    {
+        // Native MUL, D * E -> ax -> A:D, flags as for DIVIDE
+        name = "MLTPLY";
+        translate_x86( lines[idx], stmt.instruction, stmt.parameters, labels, literal );
+        out = util::sprintf(
+            "CMP\tdl,64\n"
+            "\tJA\t%s\n"
+            "\tMOV\tal,dh\n"
+            "\tMUL\tdl\n"
+            "\tMOV\tdh,al\n"
+            "\tMOV\tal,ah\n"
+            "\tCMP\tal,al\n"
+            "\tRET\n"
+            "%s:\t%s",
+            fallback.c_str(), fallback.c_str(), literal.c_str() );
+        idiom_report.push_back( "MLTPLY routine -> native MUL if E <= 64, else original loop" );
+    }
+    else if( util::toupper(stmt.instruction)=="CPIR" && stmt.parameters.size()==0 )
+    {
+        // REPNE SCASB, then set Z and P the same way the Z80_CPIR macro does;
+        //  Z=1 P=1 found, counter not expired; Z=1 P=0 found in last position;
+        //  Z=0 P=0 not found. BC=0 means search 64K, leave that to the macro
+        name = "CPIR";
+        std::string flags = util::sprintf( "idiom%d", idiom_counter+1 );
+        std::string end   = util::sprintf( "idiom%d", idiom_counter+2 );
+        idiom_counter += 2;
+        out = util::sprintf(
+            "JECXZ\t%s\n"
+            "\tPUSH\tedi\n"
+            "\tLEA\tedi,[ebp+ebx]\n"
+            "\tREPNE\tSCASB\n"
+            "\tMOV\tah,02h\n"
+            "\tJNZ\t%s\n"
+            "\tMOV\tah,42h\n"
+            "\tJECXZ\t%s\n"
+            "\tMOV\tah,46h\n"
+            "%s:\tSUB\tedi,ebp\n"
+            "\tMOV\tebx,edi\n"
+            "\tPOP\tedi\n"
+            "\tSAHF\n"
+            "\tJMP\t%s\n"
+            "%s:\tZ80_CPIR\n"
+            "%s:",
+            fallback.c_str(), flags.c_str(), flags.c_str(), flags.c_str(),
+            end.c_str(), fallback.c_str(), end.c_str() );
+        std::string where = stmt.label=="" ? "" : util::sprintf( " at %s", stmt.label.c_str() );
+        idiom_report.push_back( "CPIR" + where + " -> REPNE SCASB if BC != 0, else Z80_CPIR macro" );
+    }
+    if( name == "" )
+        return false;
+    idiom_counter++;
+    idiom_hits[name]++;
+    return true;
+}
+
+// Peephole optimisation. The x86 output is collected line by line, then
+//  optionally a catalogue of safe rewrites is applied over a window of
+//  translated instructions before the output is written
+struct asm_line
+{
+    std::string text;
+    bool translated;    // generated from Z80 code, rather than passed through
+    bool removed;       // by the peephole optimiser
+    int source_line;    // Z80 source line it came from, 0 if none
+    int inline_site;    // if inlined, Z80 source line of the CALL, else 0
+};
+
+// Z80 source line(s) currently being converted, for the -map file
+static int map_source_line;
+static int map_inline_site;
+
+static void peephole_emit( std::vector<asm_line> &out, const std::string &text, bool translated )
+{
+    size_t start = 0;
+    for(;;)
+    {
+        size_t offset = text.find('\n',start);
+        asm_line line;
+        line.text = text.substr(start,offset==std::string::npos ? std::string::npos : offset-start);
+        line.translated = translated;
+        line.removed = false;
+        line.source_line = map_source_line;
+        line.inline_site = map_inline_site;
+        out.push_back(line);
+        if( offset == std::string::npos )
+            break;
+        start = offset+1;
+    }
+}
+
+// A parsed output line
+struct peephole_instruction
+{
+    std::string label;
+    std::string mnemonic;       // upper case, empty if none
+    std::vector<std::string> operands;
+    std::string comment;
+    bool barrier;               // passed through code or data, can't reason about it
+};
+
+static void peephole_parse( const asm_line &line, peephole_instruction &pi )
+{
+    pi.label = "";
+    pi.mnemonic = "";
+    pi.operands.clear();
+    pi.comment = "";
+    pi.barrier = false;
+    std::string s = line.text;
+    size_t offset = s.find(';');
+    if( offset != std::string::npos )
+    {
+        pi.comment = s.substr(offset+1);
+        s = s.substr(0,offset);
+    }
+    util::rtrim(s);
+    if( s == "" )
+        return;     // empty or comment only lines are transparent
+    if( !line.translated )
+    {
+        pi.barrier = true;
+        return;
+    }
+    if( !isspace(s[0]) )
+    {
+        offset = s.find_first_of(" \t");
+        std::string label = s.substr(0,offset);
+        if( label[label.length()-1] != ':' )
+        {
+            pi.barrier = true;     // data or equate
+            return;
+        }
+        pi.label = label.substr(0,label.length()-1);
+        s = offset==std::string::npos ? "" : s.substr(offset);
+    }
+    util::ltrim(s);
+    if( s == "" )
+        return;
+    offset = s.find_first_of(" \t");
+    pi.mnemonic = util::toupper( s.substr(0,offset) );
+    s = offset==std::string::npos ? "" : s.substr(offset);
+    util::ltrim(s);
+    while( s != "" )
+    {
+        offset = s.find(',');
+        std::string operand = s.substr(0,offset);
+        util::rtrim(operand);
+        pi.operands.push_back(operand);
+        if( offset == std::string::npos )
+            break;
+        s = s.substr(offset+1);
+        util::ltrim(s);
+    }
+}
+
+static std::string peephole_format( const peephole_instruction &pi )
+{
+    std::string s = pi.label=="" ? "\t" : pi.label+":\t";
+    s += pi.mnemonic;
+    bool first = true;
+    for( const std::string &operand: pi.operands )
+    {
+        s += first ? "\t" : ",";
+        first = false;
+        s += operand;
+    }
+    if( pi.comment != "" )
+    {
+        s += "\t;";
+        s += pi.comment;
+    }
+    return detabify(s,true);
+}
+
+// Flags, as a bitmask
+const int F_S=1, F_Z=2, F_A=4, F_P=8, F_C=16, F_O=32, F_ALL=63;
+
+// Flags written by an instruction, -1 if not a known instruction
+static int peephole_flags_written( const std::string &mnemonic )
+{
+    static const std::map<std::string,int> table =
+    {
+        {"ADD",F_ALL}, {"ADC",F_ALL}, {"SUB",F_ALL}, {"SBB",F_ALL}, {"CMP",F_ALL},
+        {"AND",F_ALL}, {"OR",F_ALL},  {"XOR",F_ALL}, {"TEST",F_ALL}, {"NEG",F_ALL},
+        {"SHL",F_ALL}, {"SAL",F_ALL}, {"SHR",F_ALL}, {"SAR",F_ALL},
+        {"MUL",F_ALL}, {"DIV",F_ALL},
+        {"INC",F_S|F_Z|F_A|F_P|F_O}, {"DEC",F_S|F_Z|F_A|F_P|F_O},
+        {"RCL",F_C|F_O}, {"RCR",F_C|F_O}, {"ROL",F_C|F_O}, {"ROR",F_C|F_O},
+        {"SAHF",F_S|F_Z|F_A|F_P|F_C},
+        {"MOV",0}, {"MOVZX",0}, {"LEA",0}, {"PUSH",0}, {"POP",0}, {"XCHG",0},
+        {"NOT",0}, {"LAHF",0}
+    };
+    auto it = table.find(mnemonic);
+    return it==table.end() ? -1 : it->second;
+}
+
+// Flags read by a (known) instruction
+static int peephole_flags_read( const std::string &mnemonic )
+{
+    if( mnemonic=="ADC" || mnemonic=="SBB" || mnemonic=="RCL" || mnemonic=="RCR" )
+        return F_C;
+    if( mnemonic == "LAHF" )
+        return F_S|F_Z|F_A|F_P|F_C;
+    return 0;
+}
+
+// Register family (a,b,c,d,si,di) of an operand, or "" if not a register
+static std::string peephole_register( const std::string &operand )
+{
+    std::string s = util::tolower(operand);
+    if( s.length()==3 && s[0]=='e' )
+        s = s.substr(1);
+    if( s=="al" || s=="ah" || s=="ax" ) return "a";
+    if( s=="bl" || s=="bh" || s=="bx" ) return "b";
+    if( s=="cl" || s=="ch" || s=="cx" ) return "c";
+    if( s=="dl" || s=="dh" || s=="dx" ) return "d";
+    if( s=="si" ) return "si";
+    if( s=="di" ) return "di";
+    return "";
+}
+
+// Does a (known) instruction write a register family or memory ?
+static bool peephole_writes( const peephole_instruction &pi, const std::string &reg, bool &memory )
+{
+    const std::string &m = pi.mnemonic;
+    memory = false;
+    if( m=="CMP" || m=="TEST" || m=="PUSH" )
+        return false;
+    if( m=="LAHF" || m=="MUL" || m=="DIV" )
+        return reg=="a" || ((m=="MUL" || m=="DIV") && reg=="d");
+    bool writes = false;
+    for( size_t i=0; i<pi.operands.size() && (i==0 || m=="XCHG"); i++ )
+    {
+        const std::string &operand = pi.operands[i];
+        if( operand.find('[') != std::string::npos )
+            memory = true;
+        else if( peephole_register(operand) == reg )
+            writes = true;
+    }
+    return writes;
+}
+
+// Does a memory operand's address use a register family ?
+static bool peephole_address_uses( const std::string &mem, const std::string &family )
+{
+    std::string name = family.length()==1 ? "e"+family+"x" : "e"+family;
+    return util::tolower(mem).find(name) != std::string::npos;
+}
+
+static std::map<std::string,int> peephole_hits;
+static std::vector<std::string> peephole_report;
+
+static void peephole_log( const char *pattern, const std::vector<asm_line> &lines, size_t idx )
+{
+    peephole_hits[pattern]++;
+    std::string s = lines[idx].text;
+    util::replace_all(s,"\t"," ");
+    util::rtrim(s);
+    peephole_report.push_back( util::sprintf( "%-20s line %5u: %s", pattern, idx+1, s.c_str() ) );
+}
+
+// Remove an instruction, keeping its label and comment
+static void peephole_remove( std::vector<asm_line> &lines, std::vector<peephole_instruction> &pis, size_t idx )
+{
+    peephole_instruction &pi = pis[idx];
+    pi.mnemonic = "";
+    pi.operands.clear();
+    if( pi.label != "" )
+        lines[idx].text = detabify( pi.label + ":" + (pi.comment==""?"":"\t;"+pi.comment), true );
+    else if( pi.comment != "" )
+        lines[idx].text = detabify( "\t;" + pi.comment, true );
+    else
+        lines[idx].removed = true;
+}
+
+// Next line with an instruction, label or barrier
+static size_t peephole_next( const std::vector<peephole_instruction> &pis, size_t idx )
+{
+    while( idx<pis.size() && pis[idx].mnemonic=="" && pis[idx].label=="" && !pis[idx].barrier )
+        idx++;
+    return idx;
+}
+
+// One pass over the output, applying each rewrite in the catalogue
+static void peephole_pass( std::vector<asm_line> &lines, std::vector<peephole_instruction> &pis, std::map<std::string,size_t> &labels )
+{
+    for( size_t i=0; i<lines.size(); i++ )
+    {
+        peephole_instruction &pi = pis[i];
+        const std::string &m = pi.mnemonic;
+
+        // Jumps; to the next instruction (remove), or to another jump (retarget)
+        if( m.length()>=2 && m[0]=='J' && m!="JECXZ" && m!="JCXZ" && pi.operands.size()==1 )
+        {
+            auto it = labels.find(pi.operands[0]);
+            if( it == labels.end() )
+                continue;
+            size_t target = it->second;
+            size_t next = i+1;
+            while( next<lines.size() && pis[next].mnemonic=="" && !pis[next].barrier && next!=target )
+                next++;
+            if( next == target )
+            {
+                peephole_log( "jump_to_next", lines, i );
+                peephole_remove( lines, pis, i );
+                continue;
+            }
+            std::string destination = pi.operands[0];
+            for( int hops=0; hops<8; hops++ )
+            {
+                size_t t = labels[destination];
+                while( t<lines.size() && pis[t].mnemonic=="" && !pis[t].barrier )
+                    t++;
+                if( t>=lines.size() || pis[t].barrier || pis[t].mnemonic!="JMP" || pis[t].operands.size()!=1
+                                    || labels.find(pis[t].operands[0])==labels.end() || pis[t].operands[0]==destination )
+                    break;
+                destination = pis[t].operands[0];
+            }
+            if( destination != pi.operands[0] )
+            {
+                peephole_log( "jump_chain", lines, i );
+                pi.operands[0] = destination;
+                lines[i].text = peephole_format(pi);
+            }
+        }
+
+        // MOV mem,reg then MOV reg,mem (or MOV reg,mem then MOV mem,reg), remove the second
+        //  if neither the register nor memory can have changed in between. Not if the
+        //  register is part of the address, eg "MOV bl,byte ptr [ebp+ebx]" (LD L,(HL))
+        //  changes the address, so a following "MOV byte ptr [ebp+ebx],bl" is needed
+        else if( m=="MOV" && pi.operands.size()==2 )
+        {
+            bool store = pi.operands[0].find('[') != std::string::npos;
+            const std::string &mem = store ? pi.operands[0] : pi.operands[1];
+            const std::string &reg = store ? pi.operands[1] : pi.operands[0];
+            std::string family = peephole_register(reg);
+            if( family=="" || mem.find('[')==std::string::npos || peephole_address_uses(mem,family) )
+                continue;
+            for( size_t j=peephole_next(pis,i+1); j<lines.size(); j=peephole_next(pis,j+1) )
+            {
+                const peephole_instruction &pj = pis[j];
+                if( pj.barrier || pj.label!="" || peephole_flags_written(pj.mnemonic)<0 )
+                    break;
+                if( pj.mnemonic=="MOV" && pj.operands.size()==2 &&
+                    pj.operands[0]==(store?reg:mem) && pj.operands[1]==(store?mem:reg) )
+                {
+                    peephole_log( store ? "store_reload" : "load_store", lines, j );
+                    peephole_remove( lines, pis, j );
+                    break;
+                }
+                bool memory;
+                bool writes = peephole_writes( pj, family, memory );
+                if( writes || memory )
+                    break;
+                bool address_changed = false;
+                for( const char *r: {"a","b","c","d","si","di"} )
+                {
+                    if( peephole_address_uses(mem,r) && peephole_writes(pj,r,memory) )
+                        address_changed = true;
+                }
+                if( address_changed )
+                    break;
+            }
+        }
+
+        // SAHF then LAHF, as in the strict (not -relax) translation of consecutive
+        //  16 bit operations, "LAHF; op; SAHF; LAHF; ..; SAHF". Remove the inner
+        //  pair if the flags written by op are overwritten before they could be
+        //  observed (ah is unchanged, so the final SAHF restores the same flags)
+        else if( m == "SAHF" )
+        {
+            size_t j = peephole_next(pis,i+1);
+            if( j<lines.size() && pis[j].mnemonic=="LAHF" && pis[j].label=="" && pi.label=="" && i>=2 )
+            {
+                // Find op and the LAHF before it
+                size_t op = i-1, k;
+                while( op>0 && pis[op].mnemonic=="" && pis[op].label=="" && !pis[op].barrier )
+                    op--;
+                k = op-1;
+                while( k>0 && pis[k].mnemonic=="" && pis[k].label=="" && !pis[k].barrier )
+                    k--;
+                if( pis[op].label!="" || pis[op].barrier || pis[k].mnemonic!="LAHF" )
+                    continue;
+                int stale = peephole_flags_written(pis[op].mnemonic);
+                bool memory;
+                if( stale<0 || peephole_flags_read(pis[op].mnemonic)!=0 || peephole_writes(pis[op],"a",memory) )
+                    continue;
+                bool ok = false;
+                for( size_t n=peephole_next(pis,j+1); n<lines.size() && stale!=0; n=peephole_next(pis,n+1) )
+                {
+                    const peephole_instruction &pn = pis[n];
+                    if( pn.barrier || pn.label!="" )
+                        break;
+                    if( pn.mnemonic == "SAHF" )
+                    {
+                        ok = true;
+                        break;
+                    }
+                    int written = peephole_flags_written(pn.mnemonic);
+                    if( written<0 || (peephole_flags_read(pn.mnemonic)&stale) || peephole_writes(pn,"a",memory) )
+                        break;
+                    stale &= ~written;
+                }
+                if( ok || stale==0 )
+                {
+                    peephole_log( "sahf_lahf", lines, i );
+                    peephole_remove( lines, pis, i );
+                    peephole_remove( lines, pis, j );
+                }
+            }
+
+            // SAHF with all the restored flags overwritten before they are read
+            else
+            {
+                int live = F_S|F_Z|F_A|F_P|F_C;
+                for( size_t n=peephole_next(pis,i+1); n<lines.size() && live!=0; n=peephole_next(pis,n+1) )
+                {
+                    const peephole_instruction &pn = pis[n];
+                    int written = peephole_flags_written(pn.mnemonic);
+                    if( pn.barrier || pn.label!="" || written<0 || (peephole_flags_read(pn.mnemonic)&live) )
+                        break;
+                    live &= ~written;
+                }
+                if( live == 0 )
+                {
+                    peephole_log( "sahf_dead", lines, i );
+                    peephole_remove( lines, pis, i );
+                }
+            }
+        }
+    }
+}
+
+static void peephole( std::vector<asm_line> &lines )
+{
+    std::vector<peephole_instruction> pis(lines.size());
+    std::map<std::string,size_t> labels;
+    for( size_t i=0; i<lines.size(); i++ )
+    {
+        peephole_parse( lines[i], pis[i] );
+        if( pis[i].label != "" )
+            labels[pis[i].label] = i;
+    }
+
+    // Repeat until nothing changes, one rewrite can expose another
+    size_t hits;
+    do
+    {
+        hits = peephole_report.size();
+        peephole_pass( lines, pis, labels );
+    } while( peephole_report.size() != hits );
+}
+
+// Peephole test cases. Lines starting with '!' are passed through (not translated)
+//  code. Expected is the code remaining after the peephole pass, one instruction
+//  per '; ' separated item
+struct peephole_test_case
+{
+    const char *name;
+    std::vector<std::string> code;
+    const char *pattern;
+    int hits;
+    const char *expected;
+};
+
+static bool peephole_test()
+{
+    static const std::vector<peephole_test_case> cases =
+    {
+        // sahf_dead; every flag SAHF restores must be overwritten before it could be read
+        { "sahf_dead overwritten", { "\tSAHF", "\tAND\tal,al", "\tRET" },
+            "sahf_dead", 1, "AND al,al; RET" },
+        { "sahf_dead read by ADC", { "\tSAHF", "\tADC\tal,0", "\tAND\tal,al" },
+            "sahf_dead", 0, "SAHF; ADC al,0; AND al,al" },
+        { "sahf_dead carry read by JC", { "\tSAHF", "\tINC\tal", "\tJC\tL1", "\tAND\tal,al", "L1:\tRET" },
+            "sahf_dead", 0, "SAHF; INC al; JC L1; AND al,al; RET" },
+        { "sahf_dead carry not written", { "\tSAHF", "\tINC\tal", "\tDEC\tbl" },
+            "sahf_dead", 0, "SAHF; INC al; DEC bl" },
+        { "sahf_dead label", { "\tSAHF", "L1:\tAND\tal,al" },
+            "sahf_dead", 0, "SAHF; AND al,al" },
+        { "sahf_dead passed through", { "\tSAHF", "!\tAND\tal,al" },
+            "sahf_dead", 0, "SAHF" },
+        { "sahf_dead call", { "\tSAHF", "\tCALL\tL1", "\tAND\tal,al" },
+            "sahf_dead", 0, "SAHF; CALL L1; AND al,al" },
+
+        // sahf_lahf; LAHF op SAHF LAHF .. SAHF, op must leave ah alone and not
+        //  read flags, its flags must be overwritten or restored before being read
+        { "sahf_lahf overwritten", { "\tLAHF", "\tINC\tbx", "\tSAHF", "\tLAHF", "\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 1, "LAHF; INC bx; INC cx; SAHF" },
+        { "sahf_lahf restored", { "\tLAHF", "\tADD\tbx,cx", "\tSAHF", "\tLAHF", "\tMOV\tdl,1", "\tSAHF" },
+            "sahf_lahf", 1, "LAHF; ADD bx,cx; MOV dl,1; SAHF" },
+        { "sahf_lahf read by ADC", { "\tLAHF", "\tADD\tbx,cx", "\tSAHF", "\tLAHF", "\tADC\tdl,0", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; ADD bx,cx; SAHF; LAHF; ADC dl,0; SAHF" },
+        { "sahf_lahf read by JC", { "\tLAHF", "\tADD\tbx,cx", "\tSAHF", "\tLAHF", "\tJC\tL1", "\tSAHF", "L1:\tRET" },
+            "sahf_lahf", 0, "LAHF; ADD bx,cx; SAHF; LAHF; JC L1; SAHF; RET" },
+        { "sahf_lahf op writes ah", { "\tLAHF", "\tADD\tax,bx", "\tSAHF", "\tLAHF", "\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; ADD ax,bx; SAHF; LAHF; INC cx; SAHF" },
+        { "sahf_lahf op reads flags", { "\tLAHF", "\tADC\tbx,0", "\tSAHF", "\tLAHF", "\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; ADC bx,0; SAHF; LAHF; INC cx; SAHF" },
+        { "sahf_lahf later writes ah", { "\tLAHF", "\tINC\tbx", "\tSAHF", "\tLAHF", "\tMOV\tal,1", "\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; INC bx; SAHF; LAHF; MOV al,1; INC cx; SAHF" },
+        { "sahf_lahf label", { "\tLAHF", "\tINC\tbx", "\tSAHF", "\tLAHF", "L1:\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; INC bx; SAHF; LAHF; INC cx; SAHF" },
+        { "sahf_lahf label on SAHF", { "\tLAHF", "\tINC\tbx", "L1:\tSAHF", "\tLAHF", "\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; INC bx; SAHF; LAHF; INC cx; SAHF" },
+        { "sahf_lahf passed through", { "\tLAHF", "\tINC\tbx", "\tSAHF", "\tLAHF", "!\tINC\tcx", "\tSAHF" },
+            "sahf_lahf", 0, "LAHF; INC bx; SAHF; LAHF; SAHF" },
+
+        // jump_chain; only ever retarget to the target of an unconditional JMP
+        { "jump_chain JMP", { "\tJNZ\tL1", "\tRET", "L1:\tJMP\tL2", "\tRET", "L2:\tRET" },
+            "jump_chain", 1, "JNZ L2; RET; JMP L2; RET; RET" },
+        { "jump_chain two hops", { "\tJNZ\tL1", "\tRET", "L1:\tJMP\tL2", "\tRET", "L2:", "\tJMP\tL3", "\tRET", "L3:\tRET" },
+            "jump_chain", 2, "JNZ L3; RET; JMP L3; RET; JMP L3; RET; RET" },
+        { "jump_chain conditional", { "\tJNZ\tL1", "\tRET", "L1:\tJZ\tL2", "\tRET", "L2:\tRET" },
+            "jump_chain", 0, "JNZ L1; RET; JZ L2; RET; RET" },
+        { "jump_chain passed through", { "\tJNZ\tL1", "\tRET", "L1:", "!\tJMP\tL2", "\tRET", "L2:\tRET" },
+            "jump_chain", 0, "JNZ L1; RET; RET; RET" },
+        { "jump_chain unknown label", { "\tJNZ\tL1", "\tRET", "L1:\tJMP\tEXTERNAL" },
+            "jump_chain", 0, "JNZ L1; RET; JMP EXTERNAL" },
+        { "jump_chain loop", { "\tJNZ\tL1", "\tRET", "L1:\tJMP\tL1" },
+            "jump_chain", 0, "JNZ L1; RET; JMP L1" },
+
+        // jump_to_next; only if nothing but labels and comments lie in between
+        { "jump_to_next", { "\tJNZ\tL1", "L1:\tRET" },
+            "jump_to_next", 1, "RET" },
+        { "jump_to_next via label", { "\tJMP\tL2", "L1:", "L2:\tRET" },
+            "jump_to_next", 1, "RET" },
+        { "jump_to_next skips code", { "\tJZ\tL1", "\tINC\tal", "L1:\tRET" },
+            "jump_to_next", 0, "JZ L1; INC al; RET" },
+        { "jump_to_next passed through", { "\tJZ\tL1", "!\tINC\tal", "L1:\tRET" },
+            "jump_to_next", 0, "JZ L1; RET" },
+
+        // store_reload and load_store; the register, the memory and the address
+        //  must all be unchanged between the pair
+        { "store_reload", { "\tMOV\tbyte ptr [ebp+ebx],al", "\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 1, "MOV byte ptr [ebp+ebx],al" },
+        { "store_reload other register", { "\tMOV\tbyte ptr [ebp+ebx],al", "\tINC\tcl", "\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 1, "MOV byte ptr [ebp+ebx],al; INC cl" },
+        { "store_reload register changed", { "\tMOV\tbyte ptr [ebp+ebx],al", "\tINC\tal", "\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 0, "MOV byte ptr [ebp+ebx],al; INC al; MOV al,byte ptr [ebp+ebx]" },
+        { "store_reload memory changed", { "\tMOV\tbyte ptr [ebp+ebx],al", "\tMOV\tbyte ptr [ebp+edx],cl", "\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 0, "MOV byte ptr [ebp+ebx],al; MOV byte ptr [ebp+edx],cl; MOV al,byte ptr [ebp+ebx]" },
+        { "store_reload address changed", { "\tMOV\tbyte ptr [ebp+ebx],al", "\tINC\tbx", "\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 0, "MOV byte ptr [ebp+ebx],al; INC bx; MOV al,byte ptr [ebp+ebx]" },
+        { "store_reload address register", { "\tMOV\tbyte ptr [ebp+ebx],bl", "\tMOV\tbl,byte ptr [ebp+ebx]" },
+            "store_reload", 0, "MOV byte ptr [ebp+ebx],bl; MOV bl,byte ptr [ebp+ebx]" },
+        { "store_reload label", { "\tMOV\tbyte ptr [ebp+ebx],al", "L1:\tMOV\tal,byte ptr [ebp+ebx]" },
+            "store_reload", 0, "MOV byte ptr [ebp+ebx],al; MOV al,byte ptr [ebp+ebx]" },
+        { "load_store", { "\tMOV\tal,byte ptr [ebp+ebx]", "\tMOV\tbyte ptr [ebp+ebx],al" },
+            "load_store", 1, "MOV al,byte ptr [ebp+ebx]" },
+        { "load_store register changed", { "\tMOV\tal,byte ptr [ebp+ebx]", "\tDEC\tal", "\tMOV\tbyte ptr [ebp+ebx],al" },
+            "load_store", 0, "MOV al,byte ptr [ebp+ebx]; DEC al; MOV byte ptr [ebp+ebx],al" },
+        { "load_store address register", { "\tMOV\tbl,byte ptr [ebp+ebx]", "\tMOV\tbyte ptr [ebp+ebx],bl" },
+            "load_store", 0, "MOV bl,byte ptr [ebp+ebx]; MOV byte ptr [ebp+ebx],bl" },
+        { "load_store address register, wide", { "\tMOV\tdi,word ptr [ebp+edi]", "\tMOV\tword ptr [ebp+edi],di" },
+            "load_store", 0, "MOV di,word ptr [ebp+edi]; MOV word ptr [ebp+edi],di" },
+        { "load_store call", { "\tMOV\tal,byte ptr [ebp+ebx]", "\tCALL\tL1", "\tMOV\tbyte ptr [ebp+ebx],al" },
+            "load_store", 0, "MOV al,byte ptr [ebp+ebx]; CALL L1; MOV byte ptr [ebp+ebx],al" }
+    };
+    int passed = 0;
+    for( const peephole_test_case &tc: cases )
+    {
+        std::vector<asm_line> lines;
+        map_source_line = 0;
+        map_inline_site = 0;
+        for( const std::string &s: tc.code )
+            peephole_emit( lines, s[0]=='!' ? s.substr(1) : s, s[0]!='!' );
+        peephole_hits.clear();
+        peephole_report.clear();
+        peephole( lines );
+
+        // The remaining translated instructions
+        std::string remaining;
+        for( const asm_line &line: lines )
+        {
+            peephole_instruction pi;
+            peephole_parse( line, pi );
+            if( line.removed || pi.mnemonic=="" )
+                continue;
+            if( remaining != "" )
+                remaining += "; ";
+            remaining += pi.mnemonic;
+            for( size_t i=0; i<pi.operands.size(); i++ )
+                remaining += (i==0 ? " " : ",") + pi.operands[i];
+        }
+        int hits = peephole_hits[tc.pattern];
+        bool ok = (hits==tc.hits && peephole_report.size()==static_cast<size_t>(hits) && remaining==tc.expected);
+        if( ok )
+            passed++;
+        printf( "%s %-30s %s %d hits\n", ok?"PASS":"FAIL", tc.name, tc.pattern, hits );
+        if( !ok )
+        {
+            printf( "  expected: %s (%d hits)\n", tc.expected, tc.hits );
+            printf( "  got:      %s (%u rewrites)\n", remaining.c_str(), static_cast<unsigned>(peephole_report.size()) );
+        }
+    }
+    peephole_hits.clear();
+    peephole_report.clear();
+    printf( "%d of %u peephole tests pass\n", passed, static_cast<unsigned>(cases.size()) );
+    return passed == static_cast<int>(cases.size());
+}
+
+// Inlining. Small routines are expanded at their call sites (CALL rtn, the
+//  original routine remains for any other callers). A routine qualifies if
+//  it's below a size threshold, has a single entry (no internal label is
+//  referenced from outside), doesn't use the stack or call anything (so no
+//  stack tricks like popping the return address) and can't fall off the end
+static int inline_counter=1;
+static int inline_lines_added;          // so call sites can be reported as original line numbers
+struct inline_routine
+{
+    size_t idx;                         // index of first line
+    std::vector<std::string> body;      // source lines
+    std::set<std::string> labels;       // internal labels
+    int nbr_instructions;
+    bool final_ret;                     // final RET is dropped from each expansion
+    std::string rejected;               // reason not inlined, or empty if ok
+    std::vector<std::string> call_sites;
+};
+static std::map<std::string,inline_routine> inline_routines;
+
+// Find routines and decide whether each can be inlined
+static void inline_scan( const std::vector<std::string> &lines )
+{
+    enum { mode_normal, mode_other } mode = mode_normal;
+    bool data_mode = true;
+    std::set<std::string> called;
+    for( size_t i=0; i<lines.size(); i++ )
+    {
+        std::string line = lines[i];
+        util::rtrim(line);
+        util::replace_all(line,"\t"," ");
+        statement stmt;
+        parse( line, stmt );
+        if( stmt.label == "" )
+        {
+            if( stmt.instruction==".IF_X86" || stmt.instruction==".IF_Z80" )
+                mode = mode_other;
+            else if( stmt.instruction == ".ENDIF" )
+                mode = mode_normal;
+            else if( stmt.instruction == ".DATA" )
+                data_mode = true;
+            else if( stmt.instruction == ".CODE" )
+                data_mode = false;
+        }
+        if( stmt.typ!=normal || mode!=mode_normal || data_mode )
+            continue;
+        if( stmt.instruction=="CALL" && stmt.parameters.size()==1 )
+            called.insert(stmt.parameters[0]);
+        if( stmt.label=="" || inline_routines.find(stmt.label)!=inline_routines.end() )
+            continue;
+
+        // Routine extends up to the next empty, comment or directive line
+        inline_routine r;
+        r.idx = i;
+        r.nbr_instructions = 0;
+        std::string last;
+        for( size_t j=i; j<lines.size(); j++ )
+        {
+            std::string line2 = lines[j];
+            util::rtrim(line2);
+            util::replace_all(line2,"\t"," ");
+            statement stmt2;
+            parse( line2, stmt2 );
+            if( stmt2.typ != normal || stmt2.instruction[0]=='.' )
+                break;
+            r.body.push_back(lines[j]);
+            if( stmt2.label != "" && j>i )
+                r.labels.insert(stmt2.label);
+            if( stmt2.instruction == "" )
+                continue;
+            r.nbr_instructions++;
+            last = idiom_normalise(stmt2);
+            bool uses_sp = false;
+            for( const std::string &parm: stmt2.parameters )
+            {
+                std::string u = util::toupper(parm);
+                if( u=="SP" || u=="(SP)" )
+                    uses_sp = true;
+            }
+            if( r.rejected == "" )
+            {
+                if( stmt2.instruction=="PUSH" || stmt2.instruction=="POP" || uses_sp )
+                    r.rejected = "uses the stack";
+                else if( stmt2.instruction=="CALL" || stmt2.instruction=="CALLBACK" || stmt2.instruction=="RST" )
+                    r.rejected = "calls another routine";
+            }
+        }
+        r.final_ret = (last=="RET");
+
+        // Branches must stay within the routine, a tail jump elsewhere would
+        //  eventually RET without a return address on the stack
+        for( size_t j=0; j<r.body.size() && r.rejected==""; j++ )
+        {
+            std::string line2 = r.body[j];
+            util::rtrim(line2);
+            util::replace_all(line2,"\t"," ");
+            statement stmt2;
+            parse( line2, stmt2 );
+            if( stmt2.instruction!="JP" && stmt2.instruction!="JR" && stmt2.instruction!="DJNZ" )
+                continue;
+            std::string target = stmt2.parameters.size()>0 ? stmt2.parameters[stmt2.parameters.size()-1] : "";
+            if( r.labels.find(target) == r.labels.end() )
+                r.rejected = "jumps outside the routine (" + target + ")";
+        }
+        if( r.rejected=="" && r.nbr_instructions > inline_threshold )
+            r.rejected = util::sprintf( "too big (%d instructions)", r.nbr_instructions );
+        if( r.rejected=="" && last!="RET" && last.substr(0,3)!="JP " && last.substr(0,3)!="JR " )
+            r.rejected = "could fall off the end";
+        if( r.rejected=="" && (last.substr(0,3)=="JP " || last.substr(0,3)=="JR ") && last.find(',')!=std::string::npos )
+            r.rejected = "could fall off the end";
+        inline_routines[stmt.label] = r;
+    }
+
+    // Single entry check, no internal label is referenced from outside the routine
+    for( std::pair<const std::string,inline_routine> &p: inline_routines )
+    {
+        inline_routine &r = p.second;
+        if( r.rejected != "" || r.labels.size()==0 )
+            continue;
+        for( size_t i=0; i<lines.size() && r.rejected==""; i++ )
+        {
+            if( r.idx<=i && i<r.idx+r.body.size() )
+                continue;
+            std::string line = lines[i];
+            util::rtrim(line);
+            util::replace_all(line,"\t"," ");
+            statement stmt;
+            parse( line, stmt );
+            for( const std::string &parm: stmt.parameters )
+            {
+                if( r.labels.find(parm) != r.labels.end() )
+                    r.rejected = "internal label " + parm + " referenced from outside";
+            }
+        }
+    }
+
+    // Only routines that are called are of interest
+    for( auto it=inline_routines.begin(); it!=inline_routines.end(); )
+    {
+        if( called.find(it->first) == called.end() )
+            it = inline_routines.erase(it);
+        else
+            ++it;
+    }
+}
+
+// If stmt calls an inlinable routine, generate the expansion
+static bool inline_expand( const statement &stmt, size_t idx, std::vector<std::string> &expansion, std::vector<int> &origins )
+{
+    if( stmt.instruction!="CALL" || stmt.parameters.size()!=1 )
+        return false;
+    auto it = inline_routines.find(stmt.parameters[0]);
+    if( it==inline_routines.end() || it->second.rejected!="" )
+        return false;
+    inline_routine &r = it->second;
+    std::string end = util::sprintf( "inline%d", inline_counter++ );
+    std::string site = util::sprintf( "line %d", (int)idx+1-inline_lines_added );
+    if( stmt.label != "" )
+        site += " (" + stmt.label + ")";
+    r.call_sites.push_back(site);
+    expansion.clear();
+    origins.clear();
+    for( size_t i=0; i<r.body.size(); i++ )
+    {
+        std::string line = r.body[i];
+        util::rtrim(line);
+        util::replace_all(line,"\t"," ");
+        statement b;
+        parse( line, b );
+        std::string label = b.label;
+        if( i == 0 )
+            label = stmt.label;     // the call site's label, if any
+        else if( label != "" )
+            label = end + "_" + label;
+        std::string instruction = b.instruction;
+        std::vector<std::string> parameters = b.parameters;
+        for( std::string &parm: parameters )
+        {
+            if( r.labels.find(parm) != r.labels.end() )
+                parm = end + "_" + parm;
+        }
+        if( instruction == "RET" )
+        {
+            // RET -> JP end, RET cc -> JP cc,end, the final RET just falls through
+            if( i+1==r.body.size() && parameters.size()==0 )
+                instruction = "";
+            else
+            {
+                instruction = "JP";
+                parameters.push_back(end);
+            }
+        }
+        std::string out = label=="" ? "" : label + ":";
+        if( instruction != "" )
+        {
+            out += "\t" + instruction;
+            bool first = true;
+            for( const std::string &parm: parameters )
+            {
+                out += first ? "\t" : ",";
+                first = false;
+                out += parm;
+            }
+        }
+        std::string comment = i==0 && stmt.comment!="" ? stmt.comment : b.comment;
+        if( comment != "" )
+            out += "\t;" + comment;
+        if( out != "" )
+        {
+            expansion.push_back(out);
+            origins.push_back( (int)(r.idx+i+1) );
+        }
+    }
+    expansion.push_back( end + ":" );
+    origins.push_back( (int)(r.idx+r.body.size()) );
+    inline_lines_added += (int)expansion.size() - 1;
+    return true;
+}
+
+// Profiling map. Profilers attribute time to x86 source lines (MASM /Zi line
+//  numbers) or offsets within the sargon PROC, the map relates each x86 line
+//  back to the original routine, label and line in the Z80 source.
+static std::vector<std::string> map_routines;   // indexed by Z80 line number-1
+static std::vector<std::string> map_labels;
+
+// Find the routine and nearest label for each Z80 source line. A label is taken
+//  to be a routine if it's called, or if it starts a new block of code (follows
+//  a comment or empty line) and isn't the target of a jump
+static void map_scan( const std::vector<std::string> &lines )
+{
+    std::vector<statement> stmts;
+    std::set<std::string> called, jumped_to;
+    for( const std::string &s: lines )
+    {
+        std::string line = s;
+        util::rtrim(line);
+        util::replace_all(line,"\t"," ");
+        statement stmt;
+        parse( line, stmt );
+        if( stmt.typ==normal && stmt.parameters.size()>0 )
+        {
+            const std::string &target = stmt.parameters[stmt.parameters.size()-1];
+            if( stmt.instruction=="CALL" )
+                called.insert(target);
+            else if( stmt.instruction=="JP" || stmt.instruction=="JR" || stmt.instruction=="DJNZ" )
+                jumped_to.insert(target);
+        }
+        stmts.push_back(stmt);
+    }
+    std::set<std::string> directives = { "IF", "ELSE", "ENDIF", "PUBLIC", "EXTERN", "MACRO", "ENDM",
+                                         "SEGMENT", "ENDS", "ENDP", "ORG", "END", ".DATA", ".CODE",
+                                         ".IF_X86", ".IF_Z80", ".ELSE", ".ENDIF" };
+    bool data_mode = true;
+    bool macro_mode = false;
+    bool block_start = true;
+    std::string routine, label;
+    for( const statement &stmt: stmts )
+    {
+        std::string instruction = util::toupper(stmt.instruction);
+        if( stmt.label=="" && stmt.instruction==".DATA" )
+            data_mode = true;
+        else if( stmt.label=="" && stmt.instruction==".CODE" )
+            data_mode = false;
+        else if( instruction == "MACRO" )
+            macro_mode = true;
+        bool directive = stmt.typ==equate ||
+                         directives.find(instruction) != directives.end() ||
+                         directives.find(util::toupper(stmt.label)) != directives.end();
+        if( stmt.typ==normal && !data_mode && !macro_mode && !directive &&
+            stmt.label!="" && (stmt.label_has_colon_terminator || instruction=="PROC") )
+        {
+            label = stmt.label;
+            if( called.find(label)!=called.end() || (block_start && jumped_to.find(label)==jumped_to.end()) )
+                routine = label;
+        }
+        bool code = !data_mode && !macro_mode && !directive;
+        map_routines.push_back( code ? routine : "" );
+        map_labels.push_back( code ? label : "" );
+        if( instruction == "ENDM" )
+            macro_mode = false;
+        block_start = (stmt.typ!=normal || directive);
+    }
+}
+
+// Describe a Z80 source line, eg "POINTS: PT20 line 1811"
+static std::string map_location( int source_line )
+{
+    std::string s;
+    size_t idx = source_line-1;
+    if( idx<map_routines.size() && map_routines[idx]!="" )
+    {
+        s = map_routines[idx];
+        if( map_labels[idx] != map_routines[idx] )
+            s += ": " + map_labels[idx];
+        s += " ";
+    }
+    s += util::sprintf( "line %d", source_line );
+    return s;
+}
+
+// Write the map, one line for each line of x86 code
+static void map_write( const std::vector<asm_line> &asm_lines )
+{
+    std::ofstream map_out(map_fout);
+    if( !map_out )
+    {
+        printf( "Error; Cannot open file %s for writing\n", map_fout.c_str() );
+        return;
+    }
+    util::putline( map_out, "; x86 line, Z80 line, location (x86 lines with code only)" );
+    int x86_line = 0;
+    for( const asm_line &line: asm_lines )
+    {
+        if( line.removed )
+            continue;
+        x86_line++;
+        std::string text = line.text;
+        util::ltrim(text);
+        if( line.source_line==0 || text=="" || text[0]==';' )
+            continue;
+        size_t idx = line.source_line-1;
+        if( idx>=map_routines.size() || map_routines[idx]=="" )
+            continue;   // data, or code before the first routine
+        std::string s = util::sprintf( "%6d %6d  %s", x86_line, line.source_line, map_location(line.source_line).c_str() );
+        if( line.inline_site )
+            s += ", inlined at " + map_location(line.inline_site);
+        util::putline( map_out, s );
+    }
+}
+
+// Profiling. Each CALL of a Sargon routine is bracketed by PROFILE_ENTER and
+//  PROFILE_LEAVE macros. These maintain a stack of rdtsc start times and
+//  accumulated callee cycles, so both total (inclusive) and self (exclusive)
+//  cycles can be attributed. Bracketing the call sites rather than the routines
+//  means conditional returns and tail jumps need no special treatment. The
+//  macros preserve all registers and flags. The counters themselves are C++
+//  variables, see sargon-profile.cpp. A call too deep for the stack isn't
+//  timed, it's counted in sargon_profile_overflows instead.
+static const int profile_stack_size = 256;  // Sargon's call nesting is shallow, no recursion
+static std::map<std::string,int> profile_routines;
+static std::vector<std::string> profile_names;
+static std::vector<int> profile_call_sites;
+
+static void profile_emit_macros( std::vector<asm_line> &asm_lines )
+{
+    const char *macros[] =
+    {
+        "",
+        ";",
+        "; Per routine profiling, generated by convert-z80-to-x86 -profile",
+        "; Frame 0 is a dummy parent for the outermost call (with esp 0FFFFFFFFH),",
+        "; so PROFILE_LEAVE can always add elapsed cycles to the parent frame.",
+        "; Each frame records esp at the call site. A routine that discards its",
+        "; return address (BOOK aborts the return to FNDMOV) leaves frames that",
+        "; are no longer live, both macros discard such frames before use. A call",
+        "; with no room on the stack gets no frame, it's counted as an overflow",
+        "; and PROFILE_LEAVE (finding no frame with the call site's esp) drops it.",
+        ";",
+        "PROFILE_STACK_SIZE EQU %d",
+        "EXTERN  _sargon_profile_depth: DWORD",
+        "EXTERN  _sargon_profile_esp: DWORD",
+        "EXTERN  _sargon_profile_start: QWORD",
+        "EXTERN  _sargon_profile_children: QWORD",
+        "EXTERN  _sargon_profile_calls: DWORD",
+        "EXTERN  _sargon_profile_total: QWORD",
+        "EXTERN  _sargon_profile_self: QWORD",
+        "EXTERN  _sargon_profile_overflows: DWORD",
+        "PROFILE_ENTER MACRO n",
+        "LOCAL   discard,live,room,done",
+        "         pushfd",
+        "         push   eax",
+        "         push   ecx",
+        "         push   edx",
+        "         lea    eax,[esp+16]                                     ;esp at call site",
+        "         mov    ecx,_sargon_profile_depth",
+        "discard: cmp    dword ptr _sargon_profile_esp[ecx*4-4],eax",
+        "         ja     live",
+        "         dec    ecx",
+        "         jmp    discard",
+        "live:    cmp    ecx,PROFILE_STACK_SIZE",
+        "         jb     room",
+        "         mov    _sargon_profile_depth,ecx",
+        "         inc    _sargon_profile_overflows",
+        "         jmp    done",
+        "room:    inc    dword ptr _sargon_profile_calls[n*4]",
+        "         mov    dword ptr _sargon_profile_esp[ecx*4],eax",
+        "         lea    eax,[ecx+1]",
+        "         mov    _sargon_profile_depth,eax",
+        "         xor    eax,eax",
+        "         mov    dword ptr _sargon_profile_children[ecx*8],eax",
+        "         mov    dword ptr _sargon_profile_children[ecx*8+4],eax",
+        "         rdtsc",
+        "         mov    dword ptr _sargon_profile_start[ecx*8],eax",
+        "         mov    dword ptr _sargon_profile_start[ecx*8+4],edx",
+        "done:    pop    edx",
+        "         pop    ecx",
+        "         pop    eax",
+        "         popfd",
+        "         ENDM",
+        "PROFILE_LEAVE MACRO n",
+        "LOCAL   discard,dropped",
+        "         pushfd",
+        "         push   eax",
+        "         push   ecx",
+        "         push   edx",
+        "         lea    eax,[esp+16]                                     ;esp at call site",
+        "         mov    ecx,_sargon_profile_depth",
+        "discard: dec    ecx",
+        "         cmp    dword ptr _sargon_profile_esp[ecx*4],eax",
+        "         jb     discard",
+        "         jne    dropped                                          ;no frame, ENTER overflowed",
+        "         mov    _sargon_profile_depth,ecx",
+        "         rdtsc",
+        "         sub    eax,dword ptr _sargon_profile_start[ecx*8]       ;edx:eax = elapsed",
+        "         sbb    edx,dword ptr _sargon_profile_start[ecx*8+4]",
+        "         add    dword ptr _sargon_profile_total[n*8],eax",
+        "         adc    dword ptr _sargon_profile_total[n*8+4],edx",
+        "         add    dword ptr _sargon_profile_children[ecx*8-8],eax  ;parent's callees",
+        "         adc    dword ptr _sargon_profile_children[ecx*8-4],edx",
+        "         sub    eax,dword ptr _sargon_profile_children[ecx*8]    ;less own callees",
+        "         sbb    edx,dword ptr _sargon_profile_children[ecx*8+4]",
+        "         add    dword ptr _sargon_profile_self[n*8],eax",
+        "         adc    dword ptr _sargon_profile_self[n*8+4],edx",
+        "dropped: pop    edx",
+        "         pop    ecx",
+        "         pop    eax",
+        "         popfd",
+        "         ENDM",
+        ""
+    };
+    for( const char *line: macros )
+    {
+        std::string s(line);
+        util::replace_all( s, "%d", util::sprintf("%d",profile_stack_size) );
+        peephole_emit( asm_lines, s, false );
+    }
+}
+
+// Bracket any CALLs in translated code
+static void profile_wrap( std::string &out )
+{
+    std::string ret;
+    size_t start = 0;
+    for(;;)
+    {
+        size_t offset = out.find('\n',start);
+        std::string line = out.substr(start,offset==std::string::npos ? std::string::npos : offset-start);
+        size_t idx = line.find("CALL\t");
+        if( idx!=std::string::npos && line.find_first_not_of('\t')==idx )
+        {
+            std::string routine = line.substr(idx+5);
+            auto it = profile_routines.find(routine);
+            int n;
+            if( it != profile_routines.end() )
+                n = it->second;
+            else
+            {
+                n = (int)profile_names.size();
+                profile_routines[routine] = n;
+                profile_names.push_back(routine);
+                profile_call_sites.push_back(0);
+            }
+            profile_call_sites[n]++;
+            std::string indent = line.substr(0,idx);
+            line = util::sprintf( "%sPROFILE_ENTER\t%d\n\t%s\n\tPROFILE_LEAVE\t%d",
+                        indent.c_str(), n, line.substr(idx).c_str(), n );
+        }
+        ret += line;
+        if( offset == std::string::npos )
+            break;
+        ret += '\n';
+        start = offset+1;
+    }
+    out = ret;
+}
+
+// C++ output. Instead of x86 assembly language, write portable C++ with one
+//  function per routine (the labels that are CALLed, plus the api entry
+//  points and the x86 build's stub routines). The Z80 registers and flags are
+//  file scope variables, because Sargon passes arguments and results in
+//  registers, and the 64K of Z80 data is the sargon_base_address array. A
+//  CALL pushes a word on an emulated stack and calls the routine's function,
+//  RET pops a word and notes where it was found. If a routine discarded its
+//  return address (BOOK aborts the return to FNDMOV, PNCK returns directly
+//  to ATTACK) the caller's word wasn't the one popped, so the caller returns
+//  too until the right frame is reached. Flags are three independent groups,
+//  a result byte that gives S and Z, the carry and P/V, and each group is
+//  only calculated if it might be read before it's overwritten (a backward
+//  liveness analysis over each routine, flags are assumed to be read by
+//  calls, returns and callbacks)
+const int CPP_SZ=1, CPP_C=2, CPP_PV=4, CPP_ALL=7;
+
+struct cpp_statement
+{
+    int line_nbr;
+    bool x86;               // hand written x86 code, only a few forms are understood
+    statement stmt;
+};
+static std::vector<cpp_statement> cpp_code;
+static std::vector<cpp_statement> cpp_x86_pending;     // discarded if there's a Z80 alternative
+static bool cpp_z80_alternative;                        // in the .ELSE part of .IF_X86
+static std::vector<std::string> cpp_equates;
+static std::vector<std::string> cpp_data;
+static std::vector<std::pair<std::string,std::string>> cpp_api;    // number, routine
+static std::vector<std::string> cpp_report;
+static int cpp_flags_total, cpp_flags_eliminated;
+
+static void cpp_error( const cpp_statement &cs, const std::string &msg )
+{
+    std::string s = util::sprintf( "Error, line %d: %s", cs.line_nbr, msg.c_str() );
+    printf( "%s\n", s.c_str() );
+    cpp_report.push_back( s );
+}
+
+// Convert an assembler expression to C++, eg "BOARDA+10H" -> "BOARDA+0x10"
+static std::string cpp_expression( const std::string &expr, unsigned int location=0 )
+{
+    std::string out;
+    size_t i = 0;
+    while( i < expr.length() )
+    {
+        char c = expr[i];
+        if( isalnum(c) || c=='_' )
+        {
+            size_t start = i;
+            while( i<expr.length() && (isalnum(expr[i]) || expr[i]=='_') )
+                i++;
+            std::string token = expr.substr(start,i-start);
+            if( isdigit(token[0]) )
+            {
+                char last = toupper(token[token.length()-1]);
+                if( last == 'H' )
+                    token = "0x" + token.substr(0,token.length()-1);
+                else
+                {
+                    size_t nz = token.find_first_not_of('0');   // avoid octal
+                    token = (nz==std::string::npos ? "0" : token.substr(nz));
+                }
+            }
+            else if( token[0] == '_' )
+                token = token.substr(1);    // x86 C symbol
+            out += token;
+        }
+        else if( c == '$' )
+        {
+            out += util::sprintf( "0x%04x", location );
+            i++;
+        }
+        else
+        {
+            out += c;
+            i++;
+        }
+    }
+    return out;
+}
+
+// Equates and data initialisation
+static void cpp_equate( const statement &stmt, unsigned int location )
+{
+    cpp_equates.push_back( util::sprintf( "const int %s = %s;", stmt.equate.c_str(),
+                            cpp_expression(stmt.parameters[0],location).c_str() ) );
+}
+
+static void cpp_data_directive( const statement &stmt, unsigned int location )
+{
+    std::string values;
+    for( const std::string &parm: stmt.parameters )
+        values += (values=="" ? "" : ",") + cpp_expression(parm,location);
+    cpp_data.push_back( util::sprintf( "    %s( 0x%04x, { %s } );",
+                        stmt.instruction=="DB" ? "db" : "dw", location, values.c_str() ) );
+}
+
+static bool cpp_is_reg8( const std::string &parm )
+{
+    std::string p = util::tolower(parm);
+    return p.length()==1 && std::string("abcdehl").find(p)!=std::string::npos;
+}
+
+static bool cpp_is_pair( const std::string &parm )
+{
+    std::string p = util::tolower(parm);
+    return p=="bc" || p=="de" || p=="hl" || p=="ix" || p=="iy";
+}
+
+// Read and write a register pair
+static std::string cpp_pair( const std::string &parm )
+{
+    std::string p = util::tolower(parm);
+    if( p=="ix" || p=="iy" )
+        return p;
+    return util::toupper(p) + "()";
+}
+
+static std::string cpp_set_pair( const std::string &parm, const std::string &value )
+{
+    std::string p = util::tolower(parm);
+    if( p=="ix" || p=="iy" )
+        return p + " = " + value + ";";
+    return "set_" + util::toupper(p) + "( " + value + " );";
+}
+
+// An 8 bit operand as a C++ lvalue or rvalue, false if not an 8 bit operand
+static bool cpp_operand8( const std::string &parm, std::string &out, bool &immediate )
+{
+    std::string p = util::tolower(parm);
+    immediate = false;
+    if( cpp_is_reg8(p) )
+        out = p;
+    else if( p == "(hl)" )
+        out = "mem[HL()]";
+    else if( p == "(bc)" || p == "(de)" )
+        out = "mem[" + util::toupper(p.substr(1,2)) + "()]";
+    else if( p.length()>4 && (p.substr(0,3)=="(ix" || p.substr(0,3)=="(iy") && p[p.length()-1]==')' )
+    {
+        std::string d = parm.substr(3,parm.length()-4);     // "+MLVAL" or "-1"
+        out = "mem[(uint16_t)(" + p.substr(1,2) + cpp_expression(d) + ")]";
+    }
+    else if( p.length()>2 && p[0]=='(' && p[p.length()-1]==')' )
+        out = "mem[" + cpp_expression(parm.substr(1,parm.length()-2)) + "]";
+    else if( p=="r" || p=="i" || p=="af" || p=="af'" || p=="sp" || cpp_is_pair(p) )
+        return false;
+    else
+    {
+        out = "(uint8_t)(" + cpp_expression(parm) + ")";
+        immediate = true;
+    }
+    return true;
+}
+
+static bool cpp_memory16( const std::string &parm, std::string &addr )
+{
+    if( parm.length()>2 && parm[0]=='(' && parm[parm.length()-1]==')' && !cpp_is_pair(parm.substr(1,parm.length()-2)) )
+    {
+        addr = cpp_expression(parm.substr(1,parm.length()-2));
+        return true;
+    }
+    return false;
+}
+
+// Conditions, and the flags they read
+static bool cpp_condition( const std::string &parm, std::string &out, int &reads )
+{
+    std::string p = util::toupper(parm);
+    reads = CPP_SZ;
+    if( p == "NZ" )      out = "fsz != 0";
+    else if( p == "Z" )  out = "fsz == 0";
+    else if( p == "P" )  out = "(fsz&0x80) == 0";
+    else if( p == "M" )  out = "(fsz&0x80) != 0";
+    else if( p == "NC" ) { out = "!fc";  reads = CPP_C; }
+    else if( p == "C" )  { out = "fc";   reads = CPP_C; }
+    else if( p == "PO" ) { out = "!fpv"; reads = CPP_PV; }
+    else if( p == "PE" ) { out = "fpv";  reads = CPP_PV; }
+    else
+        return false;
+    return true;
+}
+
+struct cpp_node
+{
+    cpp_statement cs;
+    std::string label;
+    std::string instruction;            // upper case
+    std::vector<std::string> parameters;
+    std::string condition;              // C++ expression, for conditional jumps, calls and returns
+    std::string target;                 // jump or call target
+    bool local_target;                  // jump target is in this routine
+    bool falls_through;
+    int reads;
+    int writes;
+    int live;                           // flags live after this node
+};
+
+struct cpp_routine
+{
+    std::string name;
+    int line_nbr;
+    bool stub;
+    std::vector<cpp_node> nodes;
+};
+
+// Classify a node, find the flags it reads and writes
+static void cpp_classify( cpp_node &n )
+{
+    const std::string &ins = n.instruction;
+    std::vector<std::string> &parms = n.parameters;
+    n.reads = 0;
+    n.writes = 0;
+    n.falls_through = true;
+    n.local_target = false;
+    int cond_reads = 0;
+    if( ins == "CALLBACK" )
+    {
+        n.reads  = CPP_ALL;
+        n.writes = CPP_ALL;
+        return;
+    }
+    if( n.cs.x86 )
+    {
+        std::string x = util::toupper(ins);
+        if( x=="JMP" || x=="JZ" || x=="JNZ" )
+        {
+            n.target = parms.size()==1 ? parms[0] : "";
+            if( x == "JMP" )
+                n.falls_through = false;
+            else
+            {
+                n.condition = (x=="JZ" ? "fsz == 0" : "fsz != 0");
+                n.reads = CPP_SZ;
+            }
+        }
+        else if( x=="CMP" )
+            n.writes = CPP_SZ|CPP_C;
+        else if( x=="RET" )
+        {
+            n.reads = CPP_ALL;
+            n.falls_through = false;
+        }
+        return;
+    }
+    if( ins=="JP" || ins=="JR" || ins=="DJNZ" || ins=="CALL" || ins=="RET" )
+    {
+        if( ins=="DJNZ" || (parms.size()==1 && ins!="RET") )
+            n.target = parms.size()>0 ? parms[parms.size()-1] : "";
+        else if( parms.size() == 2 )
+        {
+            n.target = parms[1];
+            cpp_condition( parms[0], n.condition, cond_reads );
+        }
+        else if( ins=="RET" && parms.size()==1 )
+            cpp_condition( parms[0], n.condition, cond_reads );
+        if( ins == "DJNZ" )
+            n.condition = "--b != 0";
+        n.reads = cond_reads;
+        if( ins=="CALL" || ins=="RET" )
+            n.reads = CPP_ALL;          // callee or caller may read any flag
+        if( ins=="CALL" )
+            n.writes = 0;               // conservatively, flags may pass through
+        if( n.condition=="" && ins!="CALL" )
+            n.falls_through = false;
+        return;
+    }
+    std::string p0 = parms.size()>0 ? util::tolower(parms[0]) : "";
+    std::string p1 = parms.size()>1 ? util::tolower(parms[1]) : "";
+    if( ins=="ADD" && cpp_is_pair(p0) )
+        n.writes = CPP_C;
+    else if( ins=="ADD" || ins=="SUB" || ins=="CP" || ins=="NEG" )
+        n.writes = CPP_ALL;
+    else if( ins=="AND" || ins=="XOR" || ins=="OR" )
+        n.writes = CPP_ALL;
+    else if( ins=="SBC" || ins=="ADC" )
+    {
+        n.reads  = CPP_C;
+        n.writes = CPP_ALL;
+    }
+    else if( (ins=="INC" || ins=="DEC") && !cpp_is_pair(p0) )
+        n.writes = CPP_SZ|CPP_PV;
+    else if( ins=="BIT" )
+        n.writes = CPP_SZ|CPP_PV;
+    else if( ins=="RLA" || ins=="RRA" )
+    {
+        n.reads  = CPP_C;
+        n.writes = CPP_C;
+    }
+    else if( ins=="RLCA" || ins=="RRCA" )
+        n.writes = CPP_C;
+    else if( ins=="RL" || ins=="RR" )
+    {
+        n.reads  = CPP_C;
+        n.writes = CPP_ALL;
+    }
+    else if( ins=="RLC" || ins=="RRC" || ins=="SLA" || ins=="SRA" || ins=="SRL" )
+        n.writes = CPP_ALL;
+    else if( ins=="RLD" || ins=="RRD" || ins=="CPIR" )
+        n.writes = CPP_SZ|CPP_PV;
+    else if( ins=="LD" && p1=="r" )
+        n.writes = CPP_SZ|CPP_PV;
+    else if( (ins=="PUSH" && p0=="af") )
+        n.reads = CPP_ALL;
+    else if( (ins=="POP" && p0=="af") )
+        n.writes = CPP_ALL;
+    else if( ins=="EX" && p0=="af" )
+    {
+        n.reads  = CPP_ALL;
+        n.writes = CPP_ALL;
+    }
+    else if( ins=="SCF" || ins=="CCF" )
+    {
+        n.reads  = (ins=="CCF" ? CPP_C : 0);
+        n.writes = CPP_C;
+    }
+}
+
+// Backward liveness analysis of the flags over a routine. Flags are assumed
+//  live wherever control leaves the routine
+static void cpp_liveness( cpp_routine &r, const std::map<std::string,size_t> &labels )
+{
+    size_t nbr = r.nodes.size();
+    for( cpp_node &n: r.nodes )
+        n.live = 0;
+    bool changed = true;
+    while( changed )
+    {
+        changed = false;
+        for( size_t i=nbr; i-->0; )
+        {
+            cpp_node &n = r.nodes[i];
+            int live = 0;
+            if( n.falls_through )
+            {
+                if( i+1 < nbr )
+                {
+                    const cpp_node &next = r.nodes[i+1];
+                    live |= (next.live & ~next.writes) | next.reads;
                 }
-                break;
+                else
+                    live = CPP_ALL;     // falls into the next routine
             }
-            case between_parms_before_comma:
+            if( n.target != "" && n.instruction != "CALL" )
             {
-                if( c == ';' )
-                {
-                    state = in_comment;
-                }
-                else if( c == ',' )
+                auto it = labels.find(n.target);
+                if( n.local_target && it != labels.end() )
                 {
-                    state = between_parms_after_comma;
+                    const cpp_node &t = r.nodes[it->second];
+                    live |= (t.live & ~t.writes) | t.reads;
                 }
-                break;
+                else
+                    live = CPP_ALL;
             }
-            case between_parms_after_comma:
+            if( live != n.live )
             {
-                if( c == ',' )
-                    state = err;
-                else if( c != ' ' )
-                {
-                    parm = c;
-                    if( c == '\'' )
-                        state = in_quoted_parm;
-                    else if( c == '\"' )
-                        state = in_double_quoted_parm;
-                    else
-                        state = in_parm;
-                }
-                break;
+                n.live = live;
+                changed = true;
             }
         }
     }
-    const char *identifier_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
-    if( util::toupper(stmt.label).find_first_not_of(identifier_chars) != std::string::npos )
-        stmt.typ = illegal;
-    if( util::toupper(stmt.instruction).find_first_not_of(identifier_chars) != std::string::npos )
-        stmt.typ = illegal;
-    if( state == init )
-        stmt.typ = empty;
-    else if( state==before_instruction && stmt.label=="" )
-        stmt.typ = empty;
-    else if( state == err || state==between_parms_after_comma || state==in_quoted_parm || state==in_double_quoted_parm )
-        stmt.typ = illegal;
-    else if( state == in_parm )
+}
+
+// Generate C++ for one node
+static std::string cpp_generate( const cpp_node &n, const std::set<std::string> &routines, const std::set<std::string> &macros )
+{
+    const std::string &ins = n.instruction;
+    const std::vector<std::string> &parms = n.parameters;
+    int live = n.live & n.writes;
+    bool sz = (live&CPP_SZ)!=0, cy = (live&CPP_C)!=0, pv = (live&CPP_PV)!=0;
+    std::string s;
+
+    // Control flow
+    if( n.cs.x86 && util::toupper(ins)=="CMP" && parms.size()==2 )
     {
-        util::rtrim(parm);
-        stmt.parameters.push_back(parm);
+        std::string lhs = cpp_expression(parms[0]), rhs = cpp_expression(parms[1]);
+        if( sz ) s = "fsz = (uint8_t)(" + lhs + " - " + rhs + ");";
+        if( cy ) s += (sz?" ":"") + std::string("fc = (uint8_t)") + lhs + " < (uint8_t)" + rhs + ";";
+        return s=="" ? ";" : s;
     }
-    stmt.instruction = util::toupper(stmt.instruction);
-    if( stmt.instruction == "EQU" )
+    std::string upper_ins = util::toupper(ins);
+    if( n.target != "" && upper_ins!="CALL" )
     {
-        if( stmt.label == "" || stmt.label_has_colon_terminator || stmt.parameters.size()!=1 )
-            stmt.typ = illegal;
+        std::string go;
+        if( n.local_target )
+            go = "goto " + n.target + ";";
+        else if( routines.count(n.target) )
+            go = "{ " + n.target + "(); return; }";    // tail call
         else
+            return "";
+        return n.condition=="" ? go : "if( " + n.condition + " ) " + go;
+    }
+    if( upper_ins == "CALL" )
+    {
+        std::string call = "CALL( " + n.target + " );";
+        return n.condition=="" ? call : "if( " + n.condition + " ) " + call;
+    }
+    if( upper_ins == "RET" )
+        return n.condition=="" ? "RET;" : "if( " + n.condition + " ) RET;";
+    if( ins == "CALLBACK" )
+    {
+        std::string msg;
+        for( const std::string &parm: parms )
+            msg += (msg=="" ? "" : ",") + parm;
+        return "do_callback( " + (msg=="" ? std::string("\"\"") : msg) + " );";
+    }
+
+    std::string p0 = parms.size()>0 ? util::tolower(parms[0]) : "";
+    std::string p1 = parms.size()>1 ? util::tolower(parms[1]) : "";
+    std::string dst, src;
+    bool imm;
+
+    // Loads
+    if( ins == "LD" && parms.size()==2 )
+    {
+        std::string addr;
+        if( p1 == "r" )
         {
-            stmt.typ = equate;
-            stmt.equate = stmt.label;
-            stmt.label = "";
+            s = "a = ldar();";
+            if( sz ) s += " fsz = a;";
+            if( pv ) s += " fpv = false;";
+            return s;
+        }
+        if( cpp_is_pair(p0) && cpp_memory16(parms[1],addr) )
+            return cpp_set_pair( p0, "rd16(" + addr + ")" );
+        if( cpp_is_pair(p0) && !cpp_is_pair(p1) )
+            return cpp_set_pair( p0, "(uint16_t)(" + cpp_expression(parms[1]) + ")" );
+        if( cpp_is_pair(p1) && cpp_memory16(parms[0],addr) )
+            return "wr16( " + addr + ", " + cpp_pair(p1) + " );";
+        if( cpp_operand8(parms[0],dst,imm) && !imm && cpp_operand8(parms[1],src,imm) )
+            return dst + " = " + src + ";";
+        return "";
+    }
+
+    // 8 bit arithmetic and logic, "CP a,(hl)" or "CP (hl)"
+    if( ins=="ADD" && cpp_is_pair(p0) && cpp_is_pair(p1) )
+    {
+        s = "{ unsigned int r = " + cpp_pair(p0) + " + " + cpp_pair(p1) + ";";
+        if( cy ) s += " fc = r > 0xffff;";
+        return s + " " + cpp_set_pair( p0, "(uint16_t)r" ) + " }";
+    }
+    if( ins=="SBC" && p0=="hl" && cpp_is_pair(p1) )
+    {
+        s = "{ unsigned int x = HL(), v = " + cpp_pair(p1) + " + (fc?1:0); unsigned int r = x - v;";
+        if( cy ) s += " fc = x < v;";
+        if( pv ) s += " fpv = ((x^v)&(x^r)&0x8000) != 0;";
+        if( sz ) s += " fsz = (r&0xffff)==0 ? 0 : (((r>>8)&0x80)|1);";
+        return s + " set_HL( (uint16_t)r ); }";
+    }
+    if( ins=="ADD" || ins=="SUB" || ins=="CP" || ins=="AND" || ins=="XOR" || ins=="OR" )
+    {
+        std::string operand = parms.size()==2 ? parms[1] : (parms.size()==1 ? parms[0] : "");
+        if( parms.size()==2 && p0!="a" )
+            return "";
+        if( !cpp_operand8(operand,src,imm) )
+            return "";
+        if( ins=="AND" || ins=="XOR" || ins=="OR" )
+        {
+            std::string op = (ins=="AND" ? "&" : (ins=="XOR" ? "^" : "|"));
+            if( ins=="XOR" && util::tolower(operand)=="a" )
+                s = "a = 0;";
+            else if( (ins=="AND" || ins=="OR") && util::tolower(operand)=="a" )
+                s = "";
+            else
+                s = "a " + op + "= " + src + ";";
+            if( sz ) s += " fsz = a;";
+            if( cy ) s += " fc = false;";
+            if( pv ) s += " fpv = parity(a);";
+            if( s[0] == ' ' )
+                s = s.substr(1);
+            return s;
+        }
+        if( ins == "ADD" )
+        {
+            s = "{ unsigned int v = " + src + "; unsigned int r = a + v;";
+            if( cy ) s += " fc = r > 0xff;";
+            if( pv ) s += " fpv = ((a^~v)&(a^r)&0x80) != 0;";
+            s += " a = (uint8_t)r;";
+            if( sz ) s += " fsz = a;";
+            return s + " }";
+        }
+        s = "{ unsigned int v = " + src + ";";
+        if( ins=="SUB" || sz || pv ) s += " unsigned int r = a - v;";
+        if( cy ) s += " fc = a < v;";
+        if( pv ) s += " fpv = ((a^v)&(a^r)&0x80) != 0;";
+        if( ins == "SUB" )
+        {
+            s += " a = (uint8_t)r;";
+            if( sz ) s += " fsz = a;";
+        }
+        else if( sz )
+            s += " fsz = (uint8_t)r;";
+        return s + " }";
+    }
+    if( ins == "NEG" )
+    {
+        s = "{ unsigned int v = a;";
+        if( cy ) s += " fc = v != 0;";
+        if( pv ) s += " fpv = v == 0x80;";
+        s += " a = (uint8_t)(0-v);";
+        if( sz ) s += " fsz = a;";
+        return s + " }";
+    }
+    if( (ins=="INC" || ins=="DEC") && parms.size()==1 )
+    {
+        bool inc = (ins=="INC");
+        if( cpp_is_pair(p0) )
+        {
+            if( p0=="ix" || p0=="iy" )
+                return p0 + (inc ? "++;" : "--;");
+            return cpp_set_pair( p0, std::string("(uint16_t)(") + cpp_pair(p0) + (inc?"+1)":"-1)") );
+        }
+        if( !cpp_operand8(parms[0],dst,imm) || imm )
+            return "";
+        if( !sz && !pv )
+            return dst + (inc ? "++;" : "--;");
+        s = "{ uint8_t r = " + std::string(inc?"++":"--") + dst + ";";
+        if( sz ) s += " fsz = r;";
+        if( pv ) s += inc ? " fpv = r == 0x80;" : " fpv = r == 0x7f;";
+        return s + " }";
+    }
+
+    // Bit operations
+    if( (ins=="BIT" || ins=="SET" || ins=="RES") && parms.size()==2 )
+    {
+        if( !cpp_operand8(parms[1],dst,imm) || imm )
+            return "";
+        std::string mask = "(1<<" + cpp_expression(parms[0]) + ")";
+        if( ins == "SET" )
+            return dst + " |= " + mask + ";";
+        if( ins == "RES" )
+            return dst + " &= ~" + mask + ";";
+        if( sz && pv )
+            return "fsz = " + dst + " & " + mask + "; fpv = fsz == 0;";
+        if( sz )
+            return "fsz = " + dst + " & " + mask + ";";
+        if( pv )
+            return "fpv = (" + dst + " & " + mask + ") == 0;";
+        return "";
+    }
+
+    // Rotates and shifts
+    if( ins == "RLA" )
+        return cy ? "{ uint8_t c0 = fc; fc = (a&0x80) != 0; a = (uint8_t)((a<<1)|c0); }"
+                  : "a = (uint8_t)((a<<1)|fc);";
+    if( (ins=="RR" || ins=="SLA" || ins=="SRA" || ins=="SRL") && parms.size()==1 )
+    {
+        if( !cpp_operand8(parms[0],dst,imm) || imm )
+            return "";
+        s = "{ uint8_t v = " + dst + ";";
+        if( ins == "RR" )
+            s += " " + dst + " = (uint8_t)((v>>1)|(fc?0x80:0));";
+        else if( ins == "SLA" )
+            s += " " + dst + " = (uint8_t)(v<<1);";
+        else if( ins == "SRA" )
+            s += " " + dst + " = (uint8_t)((v>>1)|(v&0x80));";
+        else
+            s += " " + dst + " = (uint8_t)(v>>1);";
+        if( cy ) s += ins=="SLA" ? " fc = (v&0x80) != 0;" : " fc = (v&1) != 0;";
+        if( sz ) s += " fsz = " + dst + ";";
+        if( pv ) s += " fpv = parity(" + dst + ");";
+        return s + " }";
+    }
+    if( ins=="RLD" || ins=="RRD" )
+    {
+        if( ins == "RLD" )      // a=kx (hl)=yz -> a=ky (hl)=zx
+            s = "{ uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((m<<4)|(a&0x0f)); a = (uint8_t)((a&0xf0)|(m>>4));";
+        else                    // a=kx (hl)=yz -> a=kz (hl)=xy
+            s = "{ uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((a<<4)|(m>>4)); a = (uint8_t)((a&0xf0)|(m&0x0f));";
+        if( sz ) s += " fsz = a;";
+        if( pv ) s += " fpv = parity(a);";
+        return s + " }";
+    }
+    if( ins == "CPIR" )
+    {
+        s = "{ uint16_t x = HL(), n = BC(); uint8_t v; do { v = mem[x++]; n--; } while( n!=0 && v!=a ); set_HL(x); set_BC(n);";
+        if( sz ) s += " fsz = (uint8_t)(a-v);";
+        if( pv ) s += " fpv = n != 0;";
+        return s + " }";
+    }
+
+    // Exchanges and the stack
+    if( ins=="EX" && p0=="de" && p1=="hl" )
+        return "{ uint8_t t = d; d = h; h = t; t = e; e = l; l = t; }";
+    if( ins=="EX" && p0=="af" )
+        return "ex_af();";
+    if( ins == "EXX" )
+        return "exx();";
+    if( ins=="PUSH" && parms.size()==1 )
+    {
+        if( p0 == "af" )
+            return "push( (uint16_t)((a<<8)|get_F()) );";
+        if( cpp_is_pair(p0) )
+            return "push( " + cpp_pair(p0) + " );";
+        return "";
+    }
+    if( ins=="POP" && parms.size()==1 )
+    {
+        if( p0 == "af" )
+            return "{ uint16_t w = pop(); a = (uint8_t)(w>>8); set_F( (uint8_t)w ); }";
+        if( cpp_is_pair(p0) )
+            return cpp_set_pair( p0, "pop()" );
+        return "";
+    }
+
+    // Macros without a C++ equivalent, eg display macros stubbed out in the
+    //  x86 build
+    if( macros.count(util::toupper(ins)) )
+        return ";";
+    return "";
+}
+
+// Split the code into routines
+static void cpp_routines( std::vector<cpp_routine> &routines, std::set<std::string> &names )
+{
+    // Routines are the labels that are CALLed, api entry points and stubs
+    for( const cpp_statement &cs: cpp_code )
+    {
+        if( !cs.x86 && cs.stmt.instruction=="CALL" && cs.stmt.parameters.size()>0 )
+            names.insert( cs.stmt.parameters[cs.stmt.parameters.size()-1] );
+        if( cs.x86 && cs.stmt.label!="" && util::toupper(cs.stmt.instruction)=="RET" )
+            names.insert( cs.stmt.label );
+    }
+    for( const std::pair<std::string,std::string> &api: cpp_api )
+        names.insert( api.second );
+    const std::set<std::string> x86_directives = { "PROC", "ENDP", "SEGMENT", "ENDS", "END", "PUBLIC", "EXTERN", "MACRO", "ENDM", "LOCAL", "IF", "ELSE", "ENDIF" };
+    bool in_routine = false;
+    for( const cpp_statement &cs: cpp_code )
+    {
+        const statement &stmt = cs.stmt;
+        std::string x86_ins = util::toupper(stmt.instruction);
+        if( cs.x86 && stmt.label!="" && x86_ins=="RET" )
+        {
+            cpp_routine r;
+            r.name = stmt.label;
+            r.line_nbr = cs.line_nbr;
+            r.stub = true;
+            routines.push_back(r);
+            in_routine = false;     // subsequent x86 code is the x86 build's own
+            continue;
+        }
+        if( !cs.x86 && stmt.label!="" && names.count(stmt.label) )
+        {
+            cpp_routine r;
+            r.name = stmt.label;
+            r.line_nbr = cs.line_nbr;
+            r.stub = false;
+            routines.push_back(r);
+            in_routine = true;
+        }
+        if( !in_routine )
+        {
+            if( !cs.x86 )
+                cpp_error( cs, "Z80 code outside any routine" );
+            continue;
+        }
+        if( cs.x86 && (x86_directives.count(x86_ins) || x86_directives.count(util::toupper(stmt.label))) )
+            continue;
+        cpp_node n;
+        n.cs = cs;
+        n.label = stmt.label;
+        n.instruction = stmt.instruction;
+        n.parameters = stmt.parameters;
+        cpp_classify( n );
+        routines.back().nodes.push_back(n);
+    }
+}
+
+static const char *cpp_preamble[] =
+{
+    "",
+    "// Z80 registers and flags. fsz is a result byte that gives the S and Z flags",
+    "static uint8_t  a, b, c, d, e, h, l;",
+    "static uint16_t ix, iy;",
+    "static uint8_t  fsz;",
+    "static bool     fc, fpv;",
+    "static uint8_t  a_alt, f_alt, b_alt, c_alt, d_alt, e_alt, h_alt, l_alt;",
+    "",
+    "// Memory, the same 64K of data (and the same layout) as the x86 build",
+    "extern \"C\" {",
+    "    unsigned char sargon_base_address[65536];",
+    "    unsigned char sargon_native_points;",
+    "};",
+    "#define mem sargon_base_address",
+    "",
+    "// Stack, RET records where it found its return address in ret_sp",
+    "static uint16_t stack[256];",
+    "static unsigned int sp, ret_sp;",
+    "",
+    "static inline uint16_t BC() { return (uint16_t)((b<<8)|c); }",
+    "static inline uint16_t DE() { return (uint16_t)((d<<8)|e); }",
+    "static inline uint16_t HL() { return (uint16_t)((h<<8)|l); }",
+    "static inline void set_BC( uint16_t w ) { b = (uint8_t)(w>>8); c = (uint8_t)w; }",
+    "static inline void set_DE( uint16_t w ) { d = (uint8_t)(w>>8); e = (uint8_t)w; }",
+    "static inline void set_HL( uint16_t w ) { h = (uint8_t)(w>>8); l = (uint8_t)w; }",
+    "static inline uint16_t rd16( uint16_t addr ) { return (uint16_t)(mem[addr] | (mem[(uint16_t)(addr+1)]<<8)); }",
+    "static inline void wr16( uint16_t addr, uint16_t w ) { mem[addr] = (uint8_t)w; mem[(uint16_t)(addr+1)] = (uint8_t)(w>>8); }",
+    "static inline void push( uint16_t w ) { stack[--sp] = w; }",
+    "static inline uint16_t pop() { return stack[sp++]; }",
+    "",
+    "// Even parity sets P/V",
+    "static inline bool parity( uint8_t v )",
+    "{",
+    "    v ^= v>>4;",
+    "    v ^= v>>2;",
+    "    v ^= v>>1;",
+    "    return (v&1) == 0;",
+    "}",
+    "",
+    "// Flags in Z80 format (S Z - H - P/V N C), for PUSH AF, EX AF,AF' and callbacks",
+    "static inline uint8_t get_F()",
+    "{",
+    "    return (uint8_t)((fsz&0x80) | (fsz==0?0x40:0) | (fpv?0x04:0) | (fc?0x01:0));",
+    "}",
+    "",
+    "static inline void set_F( uint8_t f )",
+    "{",
+    "    fsz = (f&0x40) ? 0 : ((f&0x80) | 1);",
+    "    fpv = (f&0x04) != 0;",
+    "    fc  = (f&0x01) != 0;",
+    "}",
+    "",
+    "static inline void ex_af()",
+    "{",
+    "    uint8_t t = a;",
+    "    a = a_alt;",
+    "    a_alt = t;",
+    "    t = get_F();",
+    "    set_F( f_alt );",
+    "    f_alt = t;",
+    "}",
+    "",
+    "static inline void exx()",
+    "{",
+    "    uint8_t t;",
+    "    t = b; b = b_alt; b_alt = t;",
+    "    t = c; c = c_alt; c_alt = t;",
+    "    t = d; d = d_alt; d_alt = t;",
+    "    t = e; e = e_alt; e_alt = t;",
+    "    t = h; h = h_alt; h_alt = t;",
+    "    t = l; l = l_alt; l_alt = t;",
+    "}",
+    "",
+    "// LD A,R, the refresh register is a poor random number generator",
+    "static inline uint8_t ldar()",
+    "{",
+    "    static uint8_t r;",
+    "    r = (r+1) & 0x7f;",
+    "    return r;",
+    "}",
+    "",
+    "// A CALL runs the routine, then returns too if the routine didn't return",
+    "//  to us (it discarded its own return address)",
+    "#define CALL(routine)  do { push(0); unsigned int token = sp; routine(); if( ret_sp != token ) return; } while(0)",
+    "#define RET            do { ret_sp = sp++; return; } while(0)",
+    "",
+    "static void do_callback( const char *msg )",
+    "{",
+    "    z80_registers registers;",
+    "    registers.af = (uint16_t)((get_F()<<8) | a);",
+    "    registers.hl = HL();",
+    "    registers.bc = BC();",
+    "    registers.de = DE();",
+    "    registers.ix = ix;",
+    "    registers.iy = iy;",
+    "    sargon_callback( msg, registers );",
+    "    a = (uint8_t)registers.af;",
+    "    set_F( (uint8_t)(registers.af>>8) );",
+    "    set_HL( registers.hl );",
+    "    set_BC( registers.bc );",
+    "    set_DE( registers.de );",
+    "    ix = registers.ix;",
+    "    iy = registers.iy;",
+    "}",
+    "",
+    NULL
+};
+
+// Write the C++ output
+static void cpp_write( std::ofstream &out, const std::set<std::string> &macros )
+{
+    std::vector<cpp_routine> routines;
+    std::set<std::string> names;
+    cpp_routines( routines, names );
+    util::putline( out, "// Automatically generated file - Sargon translated to C++ by convert-z80-to-x86 -cpp" );
+    util::putline( out, "#include <stddef.h>" );
+    util::putline( out, "#include <stdint.h>" );
+    util::putline( out, "#include <initializer_list>" );
+    util::putline( out, "#include \"sargon-asm-interface.h\"" );
+    for( int i=0; cpp_preamble[i]; i++ )
+        util::putline( out, cpp_preamble[i] );
+    util::putline( out, "// Equates" );
+    for( const std::string &s: cpp_equates )
+        util::putline( out, s );
+    util::putline( out, "" );
+    util::putline( out, "// Initial data" );
+    util::putline( out, "static void db( uint16_t addr, std::initializer_list<int> values )" );
+    util::putline( out, "{" );
+    util::putline( out, "    for( int v: values )" );
+    util::putline( out, "        mem[addr++] = (uint8_t)v;" );
+    util::putline( out, "}" );
+    util::putline( out, "" );
+    util::putline( out, "static void dw( uint16_t addr, std::initializer_list<int> values )" );
+    util::putline( out, "{" );
+    util::putline( out, "    for( int v: values )" );
+    util::putline( out, "    {" );
+    util::putline( out, "        wr16( addr, (uint16_t)v );" );
+    util::putline( out, "        addr += 2;" );
+    util::putline( out, "    }" );
+    util::putline( out, "}" );
+    util::putline( out, "" );
+    util::putline( out, "static bool init_data()" );
+    util::putline( out, "{" );
+    for( const std::string &s: cpp_data )
+        util::putline( out, s );
+    util::putline( out, "    return true;" );
+    util::putline( out, "}" );
+    util::putline( out, "" );
+    util::putline( out, "// Initialise before main(), like the x86 build's initialised data" );
+    util::putline( out, "static bool data_initialised = init_data();" );
+    util::putline( out, "" );
+    util::putline( out, "// Routines" );
+    for( const cpp_routine &r: routines )
+        util::putline( out, "static void " + r.name + "();" );
+    for( size_t ri=0; ri<routines.size(); ri++ )
+    {
+        cpp_routine &r = routines[ri];
+        util::putline( out, "" );
+        util::putline( out, util::sprintf( "// %s, line %d", r.name.c_str(), r.line_nbr ) );
+        util::putline( out, "static void " + r.name + "()" );
+        util::putline( out, "{" );
+        if( r.stub )
+        {
+            util::putline( out, "    RET;                                        // stub in the x86 build too" );
+            util::putline( out, "}" );
+            continue;
+        }
+
+        // Local labels, and the labels that are jumped to
+        std::map<std::string,size_t> labels;
+        std::set<std::string> targets;
+        for( size_t i=0; i<r.nodes.size(); i++ )
+        {
+            if( r.nodes[i].label != "" )
+                labels[r.nodes[i].label] = i;
+        }
+        for( cpp_node &n: r.nodes )
+        {
+            if( n.target!="" && n.instruction!="CALL" )
+            {
+                n.local_target = (labels.count(n.target) > 0);
+                if( n.local_target )
+                    targets.insert(n.target);
+                else if( !names.count(n.target) )
+                    cpp_error( n.cs, "jump to " + n.target + ", not a label in this routine or a routine" );
+            }
+        }
+        cpp_liveness( r, labels );
+        bool falls_through = true;
+        for( const cpp_node &n: r.nodes )
+        {
+            if( n.label!="" && targets.count(n.label) )
+                util::putline( out, n.label + ":" );
+            if( n.instruction == "" )
+                continue;
+            for( int f=1; f<=CPP_PV; f<<=1 )
+            {
+                if( n.writes & f )
+                {
+                    cpp_flags_total++;
+                    if( !(n.live & f) )
+                        cpp_flags_eliminated++;
+                }
+            }
+            std::string code = cpp_generate( n, names, macros );
+            if( code == "" )
+            {
+                cpp_error( n.cs, "can't convert " + n.instruction + " to C++" );
+                code = "#error can't convert";
+            }
+            std::string original = n.instruction;
+            for( size_t i=0; i<n.parameters.size(); i++ )
+                original += (i==0 ? " " : ",") + n.parameters[i];
+            std::string line = "    " + code;
+            if( line.length() < 48 )
+                line += std::string( 48-line.length(), ' ' );
+            else
+                line += " ";
+            line += "// " + original;
+            util::putline( out, line );
+            falls_through = n.falls_through;
         }
+        if( falls_through )
+        {
+            if( ri+1<routines.size() && !routines[ri+1].stub )
+                util::putline( out, "    " + routines[ri+1].name + "();                                 // falls through" );
+            else
+                cpp_error( r.nodes.size()>0 ? r.nodes.back().cs : cpp_statement(), "code falls off the end of " + r.name );
+        }
+        util::putline( out, "}" );
     }
+
+    // The api
+    util::putline( out, "" );
+    util::putline( out, "// Call Sargon from C, with optional registers in and out" );
+    util::putline( out, "extern \"C\" void sargon( int api_command_code, z80_registers *registers )" );
+    util::putline( out, "{" );
+    util::putline( out, "    if( registers )" );
+    util::putline( out, "    {" );
+    util::putline( out, "        a = (uint8_t)registers->af;" );
+    util::putline( out, "        set_F( (uint8_t)(registers->af>>8) );" );
+    util::putline( out, "        set_HL( registers->hl );" );
+    util::putline( out, "        set_BC( registers->bc );" );
+    util::putline( out, "        set_DE( registers->de );" );
+    util::putline( out, "        ix = registers->ix;" );
+    util::putline( out, "        iy = registers->iy;" );
+    util::putline( out, "    }" );
+    util::putline( out, "    sp = sizeof(stack)/sizeof(stack[0]);  // a callback may have abandoned the last call with longjmp()" );
+    util::putline( out, "    push( 0 );" );
+    util::putline( out, "    switch( api_command_code )" );
+    util::putline( out, "    {" );
+    for( const std::pair<std::string,std::string> &api: cpp_api )
+        util::putline( out, util::sprintf( "        case %s: %s(); break;", api.first.c_str(), api.second.c_str() ) );
+    util::putline( out, "    }" );
+    util::putline( out, "    if( registers )" );
+    util::putline( out, "    {" );
+    util::putline( out, "        registers->af = (uint16_t)((get_F()<<8) | a);" );
+    util::putline( out, "        registers->hl = HL();" );
+    util::putline( out, "        registers->bc = BC();" );
+    util::putline( out, "        registers->de = DE();" );
+    util::putline( out, "        registers->ix = ix;" );
+    util::putline( out, "        registers->iy = iy;" );
+    util::putline( out, "    }" );
+    util::putline( out, "}" );
+
+    cpp_report.push_back( util::sprintf( "%d routines", (int)routines.size() ) );
+    cpp_report.push_back( util::sprintf( "%d of %d flag calculations eliminated (flags not live)",
+                                          cpp_flags_eliminated, cpp_flags_total ) );
+}
+
+// Each optimisation's report ends with its measured effect, from sargon-tests
+//  b -1 runs of a 32 bit build with only that switch (plus -relax), against
+//  the plain -relax build, the minimum of interleaved runs (see README.md)
+static void report_measured( std::ofstream &report_out, const char *what, const char *result )
+{
+    util::putline(report_out,util::sprintf("%s measured with sargon-tests b -1: %s", what, result) );
 }
 
 void convert( bool relax, bool z80_only, std::string fin, std::string fout, std::string report_fout, std::string asm_interface_fout )
@@ -421,7 +2666,10 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
     util::putline( h_out, "extern \"C\" {" );
     util::putline( h_out, "" );
     util::putline( h_out, "    // First byte of Sargon data"  );
-    util::putline( h_out, "    extern unsigned char sargon_base_address;" );
+    util::putline( h_out, "    extern unsigned char sargon_base_address[];" );
+    util::putline( h_out, "" );
+    util::putline( h_out, "    // Non zero selects native C++ POINTS(), see sargon-points.cpp" );
+    util::putline( h_out, "    extern unsigned char sargon_native_points;" );
     util::putline( h_out, "" );
     util::putline( h_out, "    // Calls to sargon() can set and read back registers" );
     util::putline( h_out, "    struct z80_registers" );
@@ -444,6 +2692,10 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
     util::putline( h_out, "                   uint32_t ebx, uint32_t edx, uint32_t ecx, uint32_t eax," );
     util::putline( h_out, "                   uint32_t eflags );" );
     util::putline( h_out, "" );
+    util::putline( h_out, "    // Portable form of callback(), for the C++ build of Sargon. The x86 build's" );
+    util::putline( h_out, "    //  callback() calls it too, see sargon-interface.cpp" );
+    util::putline( h_out, "    void sargon_callback( const char *msg, z80_registers &registers );" );
+    util::putline( h_out, "" );
     util::putline( h_out, "    // Data offsets for peeking and poking" );
     bool api_constants_detected = false;
     std::set<std::string> labels;
@@ -488,12 +2740,39 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
 
     */
 
-    unsigned int track_location = 0;
+    // Read the whole file, idiom recognition needs to look ahead
+    std::vector<std::string> lines;
     for(;;)
     {
         std::string line;
         if( !std::getline(in,line) )
             break;
+        lines.push_back(line);
+    }
+    size_t line_idx = 0;
+    std::vector<asm_line> asm_lines;
+    if( inline_switch && !z80_only )
+        inline_scan( lines );
+
+    // Track original line numbers as inlining changes lines
+    std::vector<int> line_numbers, inline_sites;
+    for( size_t i=0; i<lines.size(); i++ )
+    {
+        line_numbers.push_back( (int)i+1 );
+        inline_sites.push_back( 0 );
+    }
+    if( map_switch && !z80_only )
+        map_scan( lines );
+
+    unsigned int track_location = 0;
+    for(;;)
+    {
+        std::string line;
+        if( line_idx >= lines.size() )
+            break;
+        map_source_line = line_numbers[line_idx];
+        map_inline_site = inline_sites[line_idx];
+        line = lines[line_idx++];
         util::rtrim(line);
         std::string line_original = line;
         util::replace_all(line,"\t"," ");
@@ -501,6 +2780,22 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
         parse( line, stmt );
         bool done = false;
 
+        // Optionally replace a call to a small routine with the routine itself
+        std::vector<std::string> expansion;
+        std::vector<int> origins;
+        if( inline_switch && !z80_only && !data_mode && stmt.typ==normal &&
+            (mode==mode_normal || mode==mode_not_z80) && inline_expand( stmt, line_idx-1, expansion, origins ) )
+        {
+            line_idx--;
+            lines.erase( lines.begin() + line_idx );
+            lines.insert( lines.begin() + line_idx, expansion.begin(), expansion.end() );
+            line_numbers.erase( line_numbers.begin() + line_idx );
+            line_numbers.insert( line_numbers.begin() + line_idx, origins.begin(), origins.end() );
+            inline_sites.erase( inline_sites.begin() + line_idx );
+            inline_sites.insert( inline_sites.begin() + line_idx, expansion.size(), map_source_line );
+            continue;
+        }
+
         // Reduce to a few simple types of line
         std::string line_out="";
         done = false;
@@ -588,6 +2883,8 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
             {
                 data_mode = false;
                 handled = true;         
+                if( profile_switch && !z80_only )
+                    profile_emit_macros( asm_lines );
             }
             else if( stmt.instruction == ".IF_Z80" )
             {
@@ -604,7 +2901,11 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                 if( mode == mode_z80 )
                     mode = mode_not_z80;
                 else if( mode == mode_x86 )
+                {
                     mode = mode_z80;
+                    cpp_x86_pending.clear();     // C++ uses the Z80 alternative instead
+                    cpp_z80_alternative = true;
+                }
                 else
                     printf( "Error, unexpected .ELSE\n" );
                 handled = true;         
@@ -613,6 +2914,9 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
             {
                 mode = mode_normal;
                 handled = true;         
+                cpp_code.insert( cpp_code.end(), cpp_x86_pending.begin(), cpp_x86_pending.end() );
+                cpp_x86_pending.clear();
+                cpp_z80_alternative = false;
             }
         }
 
@@ -671,13 +2975,20 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                     util::putline( h_out, "    // API constants" );
                 }
                 util::putline( h_out, h_line_out );
+                cpp_api.push_back( std::pair<std::string,std::string>(nbr,name) );
             }
-            util::putline( asm_out, line_original );
+            else if( cpp_switch && !data_mode && stmt.typ==normal )
+                cpp_x86_pending.push_back( {map_source_line,true,stmt} );
+            peephole_emit( asm_lines, line_original, false );
             continue;
         }
 
         if( mode == mode_z80  )
+        {
+            if( cpp_switch && cpp_z80_alternative && !handled && !data_mode && stmt.typ==normal )
+                cpp_code.push_back( {map_source_line,false,stmt} );
             continue;
+        }
 
         // Generate assembly language output
         switch( stmt.typ )
@@ -685,17 +2996,17 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
             case empty:
                 line_original = "";
                 line_original = detabify(line_original);
-                util::putline( asm_out, line_original );
+                peephole_emit( asm_lines, line_original, false );
                 break;
             case comment_only:
                 line_original = ";" + stmt.comment;
                 line_original = detabify(line_original);
-                util::putline( asm_out, line_original );
+                peephole_emit( asm_lines, line_original, false );
                 break;
             case comment_only_indented:
                 line_original = "\t;" + stmt.comment;
                 line_original = detabify(line_original, true );
-                util::putline( asm_out, line_original );
+                peephole_emit( asm_lines, line_original, false );
                 break;
         }
         if( stmt.typ!=normal && stmt.typ!=equate )
@@ -708,12 +3019,12 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
         {
             case original_comment_out:
             {
-                util::putline( asm_out, detabify( ";" + line_original) );
+                peephole_emit( asm_lines, detabify( ";" + line_original), false );
                 break;
             }
             case original_keep:
             {
-                util::putline( asm_out, detabify(line_original) );
+                peephole_emit( asm_lines, detabify(line_original), false );
                 break;
             }
             default:
@@ -742,6 +3053,15 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                 {
                     printf( "Error: No EQU parameters, line=[%s]\n", line.c_str() );
                 }
+                else if( stmt.parameters.size() == 1 )
+                {
+                    std::string s = stmt.parameters[0];
+                    if( s[0] == '$' )
+                        s = util::sprintf( "%u", track_location ) + s.substr(1);
+                    widen_equates[stmt.equate] = s;
+                    if( cpp_switch )
+                        cpp_equate( stmt, track_location );
+                }
             }
             else if( stmt.label != "" && stmt.instruction=="" )
             {
@@ -750,9 +3070,14 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                     asm_line_out = util::sprintf( "%s\tEQU\t%s", stmt.label.c_str(), str_location.c_str() );
                     std::string c_include_line_out = util::sprintf( "    const int %s = 0x%04x;", stmt.label.c_str(), track_location  );
                     util::putline( h_out, c_include_line_out );
+                    widen_known_values[stmt.label] = track_location;
                 }
                 else
+                {
                     asm_line_out = stmt.label + ":";
+                    if( cpp_switch )
+                        cpp_code.push_back( {map_source_line,false,stmt} );
+                }
                 if( stmt.comment != "" )
                 {
                     asm_line_out += "\t;";
@@ -836,6 +3161,7 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                         {
                             std::string c_include_line_out = util::sprintf( "    const int %s = 0x%04x;", stmt.label.c_str(), track_location  );
                             util::putline( h_out, c_include_line_out );
+                            widen_known_values[stmt.label] = track_location;
                             asm_line_out = util::sprintf( "%s\tEQU\t%s", stmt.label.c_str(), str_location.c_str() );
                             if( stmt.comment != "" )
                             {
@@ -859,11 +3185,15 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                         else if( stmt.instruction == "DB" )
                         {
                             asm_line_out += util::sprintf( "\tDB\t%s", parameter_list.c_str() );
+                            if( cpp_switch )
+                                cpp_data_directive( stmt, track_location );
                             track_location += stmt.parameters.size();
                         }
                         else if( stmt.instruction == "DW" )
                         {
                             asm_line_out += util::sprintf( "\tDW\t%s", parameter_list.c_str() );
+                            if( cpp_switch )
+                                cpp_data_directive( stmt, track_location );
                             track_location += (2 * stmt.parameters.size());
                         }
                         if( !commented && stmt.comment != "" )
@@ -877,6 +3207,8 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                 // Handle macro expansion
                 else if( callback_macro || macros.find(util::toupper(stmt.instruction)) != macros.end() )
                 {
+                    if( cpp_switch && !data_mode )
+                        cpp_code.push_back( {map_source_line,false,stmt} );
                     if( stmt.label == "" )
                         asm_line_out = "\t";
                     else
@@ -899,7 +3231,14 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                 // Else do code translation
                 else
                 {
-                    generated = translate_x86( line_original, stmt.instruction, stmt.parameters, labels, out );
+                    if( cpp_switch && !data_mode )
+                        cpp_code.push_back( {map_source_line,false,stmt} );
+                    if( idioms_switch && idiom_recognise( lines, line_idx-1, stmt, relax, out ) )
+                        generated = true;
+                    else
+                        generated = translate_x86( line_original, stmt.instruction, stmt.parameters, labels, out );
+                    if( generated && profile_switch )
+                        profile_wrap( out );
                     show_original = !generated;
                 }
                 if( show_original )
@@ -941,12 +3280,41 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
                 }
             }
             asm_line_out = detabify(asm_line_out, true );
-            util::putline( asm_out, asm_line_out );
+            peephole_emit( asm_lines, asm_line_out, true );
         }
     }
+    if( profile_switch )
+    {
+        util::putline( h_out, "" );
+        util::putline( h_out, "    // Per routine profile counters, see sargon-profile.cpp" );
+        util::putline( h_out, "    #define SARGON_PROFILE" );
+        util::putline( h_out, util::sprintf("    const int sargon_profile_nbr = %d;", (int)profile_names.size()) );
+        util::putline( h_out, util::sprintf("    const int sargon_profile_stack_size = %d;", profile_stack_size) );
+        util::putline( h_out, "    static const char *sargon_profile_names[sargon_profile_nbr] =" );
+        util::putline( h_out, "    {" );
+        for( const std::string &name: profile_names )
+            util::putline( h_out, "        \"" + name + "\"," );
+        util::putline( h_out, "    };" );
+    }
     util::putline( h_out, "};" );
     util::putline( h_out, "#endif //SARGON_ASM_INTERFACE_H_INCLUDED" );
 
+    // Write the x86 output, after optional peephole optimisation, or the C++ output
+    if( cpp_switch )
+        cpp_write( asm_out, macros );
+    else
+    {
+        if( peephole_switch )
+            peephole( asm_lines );
+        for( const asm_line &line: asm_lines )
+        {
+            if( !line.removed )
+                util::putline( asm_out, line.text );
+        }
+    }
+    if( map_switch )
+        map_write( asm_lines );
+
     // Summary report
     util::putline(report_out,"\nLABELS\n");
     for( const std::string &s: labels )
@@ -968,6 +3336,77 @@ void convert( bool relax, bool z80_only, std::string fin, std::string fout, std:
         }
         util::putline(report_out,s);
     }
+    if( widen_switch )
+    {
+        util::putline(report_out,"\nWIDENED INSTRUCTIONS\n");
+        for( const std::string &s: widen_report )
+            util::putline(report_out,s);
+        util::putline(report_out,"");
+        util::putline(report_out,util::sprintf("%d instructions widened", widen_count) );
+        util::putline(report_out,util::sprintf("%d 16 bit loads not widened (value not provably in range 0-0FFFFH)", widen_rejected_count) );
+        util::putline(report_out,util::sprintf("%d 16 bit arithmetic instructions not widened (16 bit wraparound required)", widen_wraparound_count) );
+        report_measured( report_out, "Speedup from -widen", "6-8% at level 1, 1-4% at level 2, 6-10% at level 3" );
+    }
+    if( idioms_switch )
+    {
+        util::putline(report_out,"\nIDIOMS\n");
+        for( const std::string &s: idiom_report )
+            util::putline(report_out,s);
+        util::putline(report_out,"");
+        for( const auto &p: idiom_hits )
+            util::putline(report_out,util::sprintf("%s recognised %d times", p.first.c_str(), p.second) );
+        report_measured( report_out, "Speedup from -idioms", "none, all three levels within 1%" );
+    }
+    if( peephole_switch )
+    {
+        util::putline(report_out,"\nPEEPHOLE\n");
+        for( const std::string &s: peephole_report )
+            util::putline(report_out,s);
+        util::putline(report_out,"");
+        const char *patterns[] = { "store_reload", "load_store", "jump_to_next", "jump_chain", "sahf_lahf", "sahf_dead" };
+        for( const char *pattern: patterns )
+            util::putline(report_out,util::sprintf("%-20s %d hits", pattern, peephole_hits[pattern]) );
+    }
+    if( inline_switch )
+    {
+        util::putline(report_out,"\nINLINING\n");
+        int total_growth = 0;
+        for( const std::pair<const std::string,inline_routine> &p: inline_routines )
+        {
+            const inline_routine &r = p.second;
+            if( r.rejected != "" )
+            {
+                util::putline(report_out,util::sprintf("%s not inlined, %s", p.first.c_str(), r.rejected.c_str()) );
+                continue;
+            }
+            util::putline(report_out,util::sprintf("%s inlined, %d instructions, %d call sites", p.first.c_str(), r.nbr_instructions, (int)r.call_sites.size()) );
+            for( const std::string &site: r.call_sites )
+                util::putline(report_out," > " + site );
+
+            // Each call site replaces a CALL with the body, less any final RET
+            int growth = (int)r.call_sites.size() * (r.nbr_instructions - (r.final_ret?1:0) - 1);
+            total_growth += growth;
+            util::putline(report_out,util::sprintf(" > code size %+d Z80 instructions (routine retained)", growth) );
+        }
+        util::putline(report_out,"");
+        util::putline(report_out,util::sprintf("Total code size %+d Z80 instructions", total_growth) );
+        report_measured( report_out, "Speedup from -inline", "none, 0-2% slower at levels 1 and 2, 3-5% slower at level 3" );
+    }
+    if( profile_switch )
+    {
+        util::putline(report_out,"\nPROFILE\n");
+        for( size_t n=0; n<profile_names.size(); n++ )
+            util::putline(report_out,util::sprintf("%2u %-8s %d call sites", static_cast<unsigned>(n), profile_names[n].c_str(), profile_call_sites[n]) );
+        util::putline(report_out,"");
+        util::putline(report_out,util::sprintf("%d routines profiled", (int)profile_names.size()) );
+        report_measured( report_out, "Overhead of -profile", "3.9 to 4.4 times as long as the plain build" );
+    }
+    if( cpp_switch )
+    {
+        util::putline(report_out,"\nC++\n");
+        for( const std::string &s: cpp_report )
+            util::putline(report_out,s);
+    }
     util::putline(report_out,"\nINSTRUCTIONS\n");
     for( const std::pair<std::string,std::set<std::vector<std::string>> > &p: instructions )
     {
@@ -1322,6 +3761,157 @@ bool is_n_clr( const std::string &parm, std::string &out )
 }
 
 // Return true if translated    
+// Evaluate a term, a number (decimal or hex with 'H' suffix) or a known symbol
+static bool widen_evaluate_term( const std::string &term, long &value )
+{
+    std::string s = term;
+    util::ltrim(s);
+    util::rtrim(s);
+    size_t len = s.length();
+    if( len == 0 )
+        return false;
+    if( !isdigit(s[0]) )
+    {
+        auto it = widen_known_values.find(s);
+        if( it != widen_known_values.end() )
+        {
+            value = it->second;
+            return true;
+        }
+        auto it2 = widen_equates.find(s);
+        if( it2 == widen_equates.end() )
+            return false;
+        std::string expr = it2->second;
+        widen_equates.erase(it2);   // guard against recursive definitions
+        bool ok = widen_evaluate(expr,value);
+        widen_equates[s] = expr;
+        return ok;
+    }
+    int base = 10;
+    if( s[len-1]=='H' || s[len-1]=='h' )
+    {
+        base = 16;
+        len--;
+    }
+    value = 0;
+    for( size_t i=0; i<len; i++ )
+    {
+        char c = s[i];
+        int digit;
+        if( '0'<=c && c<='9' )
+            digit = c-'0';
+        else if( base==16 && 'a'<=c && c<='f' )
+            digit = 10+c-'a';
+        else if( base==16 && 'A'<=c && c<='F' )
+            digit = 10+c-'A';
+        else
+            return false;
+        value = value*base + digit;
+        if( value > 0xffffff )
+            return false;
+    }
+    return true;
+}
+
+// Evaluate a simple expression (number, known symbol, or symbol+/-number)
+static bool widen_evaluate( const std::string &expr, long &value )
+{
+    size_t offset = expr.find_first_of("+-",1);
+    if( offset == std::string::npos )
+    {
+        if( expr.length()>0 && expr[0]=='-' )
+        {
+            if( !widen_evaluate_term(expr.substr(1),value) )
+                return false;
+            value = 0-value;
+            return true;
+        }
+        return widen_evaluate_term(expr,value);
+    }
+    long lhs, rhs;
+    if( expr.find_first_of("+-",offset+1) != std::string::npos )
+        return false;
+    if( !widen_evaluate_term(expr.substr(0,offset),lhs) || !widen_evaluate_term(expr.substr(offset+1),rhs) )
+        return false;
+    value = expr[offset]=='+' ? lhs+rhs : lhs-rhs;
+    return true;
+}
+
+// Add a line to the widening report
+static void widen_log( const std::string &line, const std::string &x86_out, const std::string &reason )
+{
+    std::string z80 = line;
+    util::replace_all(z80,"\t"," ");
+    size_t offset = z80.find(';');
+    if( offset != std::string::npos )
+        z80 = z80.substr(0,offset);
+    util::ltrim(z80);
+    util::rtrim(z80);
+    std::string x86 = x86_out;
+    util::replace_all(x86,"\t"," ");
+    util::replace_all(x86,"\n","; ");
+    widen_report.push_back( util::sprintf( "%-28s -> %-40s ; %s", z80.c_str(), x86.c_str(), reason.c_str() ) );
+}
+
+// Replace a 16 bit register load (or exchange) with its 32 bit equivalent if
+//  the result is provably identical, and record the decision
+static void widen( const std::string &line, const std::string &instruction, AddressMode gt2,
+                   const std::string &out1, const std::string &out2, std::string &x86_out )
+{
+    std::string insn = util::toupper(instruction);
+    if( insn == "EX" )
+    {
+        if( x86_out != "XCHG\tbx,dx" )
+            return;
+        x86_out = "XCHG\tebx,edx";
+        widen_count++;
+        widen_log( line, x86_out, "both registers have top 16 bits zero" );
+        return;
+    }
+    if( insn != "LD" )
+        return;
+    if( gt2 == am_mem )
+    {
+        x86_out = util::sprintf( "MOVZX\te%s,%s", out1.c_str(), out2.c_str() );
+        widen_count++;
+        widen_log( line, x86_out, "zero extended load, top 16 bits remain zero" );
+    }
+    else if( gt2 == am_reg16 )
+    {
+        x86_out = util::sprintf( "MOV\te%s,e%s", out1.c_str(), out2.c_str() );
+        widen_count++;
+        widen_log( line, x86_out, "source register has top 16 bits zero" );
+    }
+    else if( gt2 == am_imm )
+    {
+        long value;
+        if( !widen_evaluate(out2,value) )
+        {
+            widen_rejected_count++;
+            widen_log( line, x86_out, "NOT WIDENED, value unknown at conversion time" );
+        }
+        else if( value<0 || value>0xffff )
+        {
+            widen_rejected_count++;
+            widen_log( line, x86_out, util::sprintf( "NOT WIDENED, value %ld would set top 16 bits", value ) );
+        }
+        else
+        {
+            x86_out = util::sprintf( "MOV\te%s,%s", out1.c_str(), out2.c_str() );
+            widen_count++;
+            widen_log( line, x86_out, util::sprintf( "value 0%04lxh, top 16 bits remain zero", value ) );
+        }
+    }
+}
+
+// 16 bit arithmetic is never widened, Sargon relies on wraparound (eg adding
+//  DE=-6 to IX to step back through the move list)
+static void widen_wraparound( const std::string &line, const std::string &x86_out )
+{
+    widen_wraparound_count++;
+    widen_log( line, x86_out, "NOT WIDENED, 16 bit wraparound required" );
+}
+
 bool translate_x86( const std::string &line, const std::string &instruction, const std::vector<std::string> &parameters, std::set<std::string> &labels, std::string &x86_out )
 {
     x86_out = "";
@@ -1473,7 +4063,11 @@ bool translate_x86( const std::string &line, const std::string &instruction, con
                     std::string parm = parameters[0];
                     std::string out;
                     if( is_reg16_mem16(parm,out) )
+                    {
                         x86_out = util::sprintf( format, out.c_str() );
+                        if( widen_switch )
+                            widen_wraparound( line, x86_out );
+                    }
                     else
                     {
                         printf( "Error: Illegal parameter %s, line=[%s]\n", parm.c_str(), line.c_str() );
@@ -1507,6 +4101,8 @@ bool translate_x86( const std::string &line, const std::string &instruction, con
                         x86_out = "Z80_LDAR";
                     else if( fixups == "XCHG\tDX,BX" )
                         x86_out = "XCHG\tbx,dx";
+                    if( widen_switch && gt1==am_reg16 )
+                        widen( line, instruction, gt2, out1, out2, x86_out );
                     break;
                 }
                 case dst_src_8_more:
@@ -1561,6 +4157,8 @@ bool translate_x86( const std::string &line, const std::string &instruction, con
                     if( gt2 == am_mem )
                         out2 = "word " + out2;
                     x86_out = util::sprintf( format, out1.c_str(), out2.c_str() );
+                    if( widen_switch )
+                        widen_wraparound( line, x86_out );
                     break;
                 }
                 case af_af_dash_more:
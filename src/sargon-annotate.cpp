@@ -0,0 +1,532 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-annotate.cpp
+ *       Annotate PGN games with Sargon's evaluations and alternative moves
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+/*
+
+    Every position in every game is analysed by a pool of worker processes
+    (see sargon-pool.h). Positions from all games in flight go into a single
+    queue and a worker takes the next position from the queue whenever it
+    becomes idle. Since a worker only ever has one position, a deep
+    position that takes 100 times longer than its neighbours ties up just
+    that one worker while the others carry on through the queue (there is
+    nothing to steal, so this is as good as a work stealing scheduler).
+
+    Results are cached by position hash (see sargon_book_hash()), so an
+    opening position that occurs in many games, or a position that recurs
+    within a game, is only analysed once. An entry is pinned while any game
+    in the read-ahead window uses it. After that it joins a least recently
+    used list, and the oldest unpinned entries are evicted once there are
+    more than -cache N of them, so memory doesn't grow with the size of
+    the PGN file.
+
+    Games are read a limited distance ahead of the output, and written in
+    input order as soon as all their positions have been analysed.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <chrono>
+#include "util.h"
+#include "thc.h"
+#include "sargon-book.h"
+#include "sargon-pool.h"
+
+// Analysis parameters
+static int plymax = 5;              // depth, or maximum depth if movetime given
+static int movetime = 0;            // milliseconds per position, 0 for fixed depth
+static int nbr_workers = 0;         // 0 means one per core
+static int window = 0;              // games read ahead of the output, 0 means 4 per worker
+static unsigned long cache_size = 100000;   // unpinned positions kept in the cache
+
+// A game, as read and then replayed
+struct Game
+{
+    std::vector<std::string> tags;
+    std::vector<thc::Move> moves;
+    std::vector<uint64_t> keys;     // position before each move, and final position
+    thc::ChessRules start;
+    std::string result;
+};
+
+// Analysis of a position, from the side to move's point of view
+struct Analysis
+{
+    bool done;
+    bool ok;
+    std::string bestmove;           // terse form
+    std::string pv;                 // SAN
+    int cp;
+    int mate;                       // 0 if not mate
+    int refs;                       // uses by games in the window, 0 if in the LRU list
+    std::list<uint64_t>::iterator lru_pos;
+    Analysis() : done(false), ok(false), cp(0), mate(0), refs(0) {}
+};
+
+static std::map<uint64_t,Analysis> cache;
+static std::list<uint64_t> lru;     // unpinned entries, most recently used first
+static unsigned long nbr_positions;
+static unsigned long nbr_analysed;
+
+static bool read_game( std::ifstream &in, Game &game );
+static void write_game( FILE *out, const Game &game );
+static void cache_release( const Game &game );
+
+int main( int argc, const char *argv[] )
+{
+    const char *usage=
+    "Annotate PGN games with Sargon's evaluation of each move, and Sargon's\n"
+    "preferred line wherever it disagrees with the move played.\n"
+    "\n"
+    "Usage:\n"
+    " sargon-annotate [switches] games.pgn [annotated.pgn]\n"
+    "\n"
+    "Switches:\n"
+    " -depth N    Analyse each position to N plies (default 5)\n"
+    " -time MS    Analyse each position for MS milliseconds (deepening up to\n"
+    "             -depth, or 20 plies if -depth isn't given)\n"
+    " -workers N  Use N worker processes (default one per core)\n"
+    " -window N   Read at most N games ahead of the output (default 4 per worker)\n"
+    " -cache N    Keep up to N analysed positions for reuse by later games\n"
+    "             (default 100000)\n"
+    "\n"
+    "Evaluations are [%eval] comments (pawns from White's point of view, or #N\n"
+    "for mate in N). Existing comments and variations are not kept.\n";
+    int argi = 1;
+    bool worker = false;
+    bool depth_given = false;
+    while( argi < argc )
+    {
+        std::string arg( argv[argi] );
+        if( arg[0] != '-' )
+            break;
+        if( arg=="-depth" && argi+1<argc )
+        {
+            plymax = atoi(argv[++argi]);
+            depth_given = true;
+        }
+        else if( arg=="-time" && argi+1<argc )
+            movetime = atoi(argv[++argi]);
+        else if( arg=="-workers" && argi+1<argc )
+            nbr_workers = atoi(argv[++argi]);
+        else if( arg=="-window" && argi+1<argc )
+            window = atoi(argv[++argi]);
+        else if( arg=="-cache" && argi+1<argc )
+            cache_size = strtoul(argv[++argi],NULL,10);
+        else if( arg=="-worker" )
+            worker = true;
+        else
+        {
+            printf( "Unknown switch %s\n", arg.c_str() );
+            printf( "%s\n", usage );
+            return -1;
+        }
+        argi++;
+    }
+    if( movetime>0 && !depth_given )
+        plymax = 20;
+    if( plymax < 1 )
+        plymax = 1;
+    else if( plymax > 20 )
+        plymax = 20;
+    if( worker )
+        return sargon_pool_worker( plymax, movetime );
+    if( argc-argi<1 || argc-argi>2 )
+    {
+        printf( "%s\n", usage );
+        return -1;
+    }
+    std::ifstream in( argv[argi] );
+    if( !in )
+    {
+        fprintf( stderr, "Cannot open %s\n", argv[argi] );
+        return -1;
+    }
+    FILE *out = stdout;
+    if( argc-argi == 2 )
+    {
+        out = fopen( argv[argi+1], "wb" );
+        if( !out )
+        {
+            fprintf( stderr, "Cannot open %s\n", argv[argi+1] );
+            return -1;
+        }
+    }
+    if( !sargon_pool_start(nbr_workers,plymax,movetime) )
+    {
+        fprintf( stderr, "Cannot start worker processes\n" );
+        if( out != stdout )
+            fclose(out);
+        return -1;
+    }
+    nbr_workers = sargon_pool_size();
+    if( window <= 0 )
+        window = 4*nbr_workers;
+
+    // Positions waiting for a worker, and positions being analysed
+    std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+    std::deque< std::pair<uint64_t,std::string> > queue;
+    std::map<unsigned long,uint64_t> jobs;
+    unsigned long next_job = 0;
+    std::vector<int> idle;
+    for( int i=0; i<nbr_workers; i++ )
+        idle.push_back(i);
+    std::deque<Game> games;
+    unsigned long nbr_games = 0;
+    bool eof = false;
+    bool ok = true;
+    while( ok )
+    {
+        // Read games until there's a position for every idle worker, or the
+        //  window is full
+        while( !eof && queue.size()<idle.size() && games.size()<static_cast<size_t>(window) )
+        {
+            Game game;
+            if( !read_game(in,game) )
+            {
+                eof = true;
+                break;
+            }
+            thc::ChessRules cr = game.start;
+            for( size_t i=0; i<game.keys.size(); i++ )
+            {
+                uint64_t key = game.keys[i];
+                nbr_positions++;
+                auto it = cache.find(key);
+                if( it == cache.end() )
+                {
+                    it = cache.insert( std::pair<uint64_t,Analysis>(key,Analysis()) ).first;
+                    queue.push_back( std::pair<uint64_t,std::string>(key,cr.ForsythPublish()) );
+                }
+                else if( it->second.refs == 0 )
+                    lru.erase( it->second.lru_pos );
+                it->second.refs++;
+                if( i < game.moves.size() )
+                    cr.PlayMove( game.moves[i] );
+            }
+            games.push_back( game );
+            nbr_games++;
+        }
+
+        // Give idle workers the next positions
+        while( idle.size()>0 && queue.size()>0 )
+        {
+            int i = idle.back();
+            idle.pop_back();
+            jobs[next_job] = queue.front().first;
+            sargon_pool_send( i, next_job++, queue.front().second );
+            queue.pop_front();
+            nbr_analysed++;
+        }
+
+        // Write completed games
+        while( games.size() > 0 )
+        {
+            bool complete = true;
+            for( uint64_t key: games.front().keys )
+            {
+                if( !cache[key].done )
+                {
+                    complete = false;
+                    break;
+                }
+            }
+            if( !complete )
+                break;
+            write_game( out, games.front() );
+            cache_release( games.front() );
+            games.pop_front();
+        }
+        if( jobs.size() == 0 )
+        {
+            if( eof && queue.size()==0 )
+                break;
+            continue;
+        }
+
+        // Wait for a result
+        int worker;
+        unsigned long idx;
+        std::string json;
+        if( !sargon_pool_result(worker,idx,json) )
+        {
+            fprintf( stderr, "Worker process %d stopped unexpectedly\n", worker );
+            ok = false;
+            break;
+        }
+        idle.push_back( worker );
+        Analysis &a = cache[ jobs[idx] ];
+        jobs.erase(idx);
+        a.done = true;
+        a.bestmove = sargon_pool_field(json,"bestmove");
+        a.ok = a.bestmove.length() > 0;
+        a.pv   = sargon_pool_field(json,"pv");
+        a.cp   = atoi( sargon_pool_field(json,"cp").c_str() );
+        a.mate = atoi( sargon_pool_field(json,"mate").c_str() );
+    }
+    sargon_pool_stop();
+    if( out != stdout )
+        fclose(out);
+    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - base);
+    fprintf( stderr, "%lu games, %lu positions (%lu analysed by %d workers, %lu found in cache) in %.3f seconds%s\n",
+                nbr_games, nbr_positions, nbr_analysed, nbr_workers, nbr_positions-nbr_analysed,
+                ms.count()/1000.0, ok ? "" : ", stopped early" );
+    return ok ? 0 : -1;
+}
+
+// Unpin a written game's positions, evicting the least recently used
+//  unpinned entries beyond the cache size. A pinned entry is never evicted,
+//  it's either being analysed or needed to write a game in the window
+static void cache_release( const Game &game )
+{
+    for( uint64_t key: game.keys )
+    {
+        Analysis &a = cache[key];
+        if( --a.refs == 0 )
+        {
+            lru.push_front( key );
+            a.lru_pos = lru.begin();
+        }
+    }
+    while( lru.size() > cache_size )
+    {
+        cache.erase( lru.back() );
+        lru.pop_back();
+    }
+}
+
+// A simple PGN reader, it handles tags, comments, variations, NAGs and
+//  move numbers and otherwise expects standard SAN moves
+static std::string lookahead;
+static bool read_game( std::ifstream &in, Game &game )
+{
+    std::string fen, movetext, line;
+    bool in_movetext = false;
+    bool have_line = lookahead.length() > 0;
+    if( have_line )
+        line = lookahead;
+    lookahead.clear();
+    while( have_line || std::getline(in,line) )
+    {
+        have_line = false;
+        util::rtrim(line);
+        if( line.length()>0 && line[0]=='[' )
+        {
+            if( in_movetext )
+            {
+                lookahead = line;
+                break;
+            }
+            game.tags.push_back(line);
+            if( util::prefix(line,"[FEN \"") )
+            {
+                size_t end = line.find('"',6);
+                if( end != std::string::npos )
+                    fen = line.substr(6,end-6);
+            }
+            else if( util::prefix(line,"[Result \"") )
+            {
+                size_t end = line.find('"',9);
+                if( end != std::string::npos )
+                    game.result = line.substr(9,end-9);
+            }
+        }
+        else if( line.length() > 0 )
+        {
+            in_movetext = true;
+            movetext += line;
+            movetext += '\n';
+        }
+    }
+    if( game.tags.size()==0 && !in_movetext )
+        return false;
+
+    // Strip comments and variations, leaving a clean list of tokens
+    std::string clean;
+    int depth=0;
+    bool in_brace=false, in_semicolon=false;
+    for( char c: movetext )
+    {
+        if( in_semicolon )
+        {
+            if( c == '\n' )
+                in_semicolon = false;
+        }
+        else if( in_brace )
+        {
+            if( c == '}' )
+                in_brace = false;
+        }
+        else if( c == '{' )
+            in_brace = true;
+        else if( c == ';' )
+            in_semicolon = true;
+        else if( c == '(' )
+            depth++;
+        else if( c == ')' )
+        {
+            if( depth > 0 )
+                depth--;
+        }
+        else if( depth == 0 )
+            clean += (c=='\n' ? ' ' : c);
+    }
+    std::vector<std::string> tokens;
+    util::split( clean, tokens );
+
+    // Play through the moves
+    if( fen != "" && !game.start.Forsyth(fen.c_str()) )
+        fprintf( stderr, "Bad FEN tag %s, game starts from the initial position\n", fen.c_str() );
+    thc::ChessRules cr = game.start;
+    for( std::string token: tokens )
+    {
+        if( token=="1-0" || token=="0-1" || token=="1/2-1/2" || token=="*" )
+        {
+            game.result = token;
+            break;
+        }
+        if( token[0] == '$' )
+            continue;
+
+        // Remove move number prefix, eg "12." or "12..."
+        size_t i=0;
+        while( i<token.length() && isdigit(token[i]) )
+            i++;
+        if( i>0 && i<token.length() && token[i]=='.' )
+        {
+            while( i<token.length() && token[i]=='.' )
+                i++;
+            token = token.substr(i);
+        }
+        else if( i>0 && i==token.length() )
+            continue;
+
+        // Remove annotation suffixes
+        while( token.length()>0 && (token.back()=='!' || token.back()=='?') )
+            token.pop_back();
+        if( token.length() == 0 )
+            continue;
+        thc::Move mv;
+        if( !mv.NaturalIn(&cr,token.c_str()) )
+        {
+            fprintf( stderr, "Illegal move %s, game is annotated up to this point\n", token.c_str() );
+            break;
+        }
+        game.keys.push_back( sargon_book_hash(cr) );
+        game.moves.push_back(mv);
+        cr.PlayMove(mv);
+    }
+    game.keys.push_back( sargon_book_hash(cr) );
+    if( game.result == "" )
+        game.result = "*";
+    return true;
+}
+
+// Sargon's evaluation of a position as an [%eval] comment (from White's
+//  point of view), or empty if there is no evaluation
+static std::string eval( const Analysis &a, bool white )
+{
+    if( !a.ok )
+        return "";
+    if( a.mate != 0 )
+        return util::sprintf( "[%%eval #%d]", white ? a.mate : 0-a.mate );
+    int cp = white ? a.cp : 0-a.cp;
+    return util::sprintf( "[%%eval %s%d.%02d]", cp<0?"-":"", abs(cp)/100, abs(cp)%100 );
+}
+
+// Movetext, wrapped to keep lines a reasonable length
+static void emit( std::string &line, std::string &movetext, const std::string &s )
+{
+    if( line.length()>0 && line.length()+1+s.length()>79 )
+    {
+        movetext += line + "\n";
+        line.clear();
+    }
+    if( line.length() > 0 )
+        line += " ";
+    line += s;
+}
+
+static void write_game( FILE *out, const Game &game )
+{
+    std::string annotator = util::sprintf( "[Annotator \"Sargon %s %d\"]", movetime>0?"max depth":"depth", plymax );
+    bool have_annotator = false;
+    for( const std::string &tag: game.tags )
+    {
+        if( util::prefix(tag,"[Annotator ") )
+        {
+            have_annotator = true;
+            fprintf( out, "%s\n", annotator.c_str() );
+        }
+        else
+            fprintf( out, "%s\n", tag.c_str() );
+    }
+    if( !have_annotator )
+        fprintf( out, "%s\n", annotator.c_str() );
+    fprintf( out, "\n" );
+    std::string movetext, line;
+    thc::ChessRules cr = game.start;
+    bool need_number = true;
+    for( size_t i=0; i<game.moves.size(); i++ )
+    {
+        thc::Move mv = game.moves[i];
+        const Analysis &before = cache[game.keys[i]];
+        const Analysis &after  = cache[game.keys[i+1]];
+        int move_nbr = cr.full_move_count;
+        bool white = cr.white;
+        std::string san = mv.NaturalOut(&cr);
+        if( white )
+            emit( line, movetext, util::sprintf("%d.",move_nbr) );
+        else if( need_number )
+            emit( line, movetext, util::sprintf("%d...",move_nbr) );
+        emit( line, movetext, san );
+        cr.PlayMove(mv);
+        need_number = false;
+        std::string e = eval( after, cr.white );
+        if( e.length() > 0 )
+            emit( line, movetext, "{" + e + "}" );
+
+        // Sargon's line, if it prefers another move
+        if( before.ok && before.bestmove!=mv.TerseOut() )
+        {
+            std::vector<std::string> pv;
+            util::split( before.pv, pv );
+            bool w = white;
+            int n = move_nbr;
+            for( size_t j=0; j<pv.size(); j++ )
+            {
+                std::string s = (j==0 ? "(" : "");
+                if( w )
+                    s += util::sprintf( "%d. ", n );
+                else if( j == 0 )
+                    s += util::sprintf( "%d... ", n );
+                s += pv[j];
+                emit( line, movetext, s );
+                if( !w )
+                    n++;
+                w = !w;
+            }
+            emit( line, movetext, "{" + eval(before,white) + "})" );
+            need_number = true;
+        }
+    }
+    emit( line, movetext, game.result );
+    movetext += line + "\n";
+    fprintf( out, "%s\n", movetext.c_str() );
+    fflush( out );
+}
@@ -0,0 +1,288 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-batch.cpp
+ *       Batch analysis of EPD/FEN files over a pool of worker processes
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+/*
+
+    Positions are analysed in parallel by a pool of worker processes (see
+    sargon-pool.h). The master streams the input file to the workers and writes the results
+    as JSON lines, in input order. A position is read from the input only
+    when a worker is free to analyse it, and only if fewer than -window
+    positions have been read but not yet written. So memory use is bounded
+    however big the input file is, and however long a slow position holds
+    up the output behind it.
+
+    Each result is flushed as it is written, so an interrupted run leaves
+    the results for the first N positions (perhaps followed by a partial
+    line). Restart with -resume and the partial line is discarded and the
+    analysis continues from position N.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+#include "util.h"
+#include "sargon-pool.h"
+
+// Analysis parameters
+static int plymax = 5;              // fixed depth
+static int nbr_workers = 0;         // 0 means one per core
+static int window = 0;              // 0 means 16 per worker
+
+static int master_main( const std::string &fin, const std::string &fout, bool resume, unsigned long skip );
+
+int main( int argc, const char *argv[] )
+{
+    const char *usage=
+    "Analyse the positions in an EPD or FEN file (one position per line) at a\n"
+    "fixed depth, using a pool of worker processes.\n"
+    "\n"
+    "Usage:\n"
+    " sargon-batch [switches] positions.epd [results.jsonl]\n"
+    "\n"
+    "Switches:\n"
+    " -depth N    Analyse to N plies (default 5)\n"
+    " -workers N  Use N worker processes (default one per core)\n"
+    " -window N   Read at most N positions ahead of the output (default 16 per worker)\n"
+    " -skip N     Skip the first N positions\n"
+    " -resume     Continue an interrupted run (give the same -skip, if any),\n"
+    "             appending to results.jsonl\n"
+    "\n"
+    "Results are written (to stdout if no output file is given) one JSON object\n"
+    "per line in input order. Each result has the position's index (from 0), id\n"
+    "(if the EPD has an id operation), fen, bestmove (terse and SAN forms), pv\n"
+    "(SAN), cp (centipawns from the side to move's point of view) or mate (in N\n"
+    "moves, negative if the side to move is mated), depth, nodes\n"
+    "(calls to POINTS()) and time (milliseconds).\n";
+    int argi = 1;
+    bool worker = false;
+    int movetime = 0;       // workers only, see sargon-pool.h
+    bool resume = false;
+    unsigned long skip = 0;
+    while( argi < argc )
+    {
+        std::string arg( argv[argi] );
+        if( arg[0] != '-' )
+            break;
+        if( arg=="-depth" && argi+1<argc )
+            plymax = atoi(argv[++argi]);
+        else if( arg=="-workers" && argi+1<argc )
+            nbr_workers = atoi(argv[++argi]);
+        else if( arg=="-window" && argi+1<argc )
+            window = atoi(argv[++argi]);
+        else if( arg=="-skip" && argi+1<argc )
+            skip = strtoul(argv[++argi],NULL,10);
+        else if( arg=="-resume" )
+            resume = true;
+        else if( arg=="-worker" )
+            worker = true;
+        else if( arg=="-time" && argi+1<argc )
+            movetime = atoi(argv[++argi]);
+        else
+        {
+            printf( "Unknown switch %s\n", arg.c_str() );
+            printf( "%s\n", usage );
+            return -1;
+        }
+        argi++;
+    }
+    if( plymax < 1 )
+        plymax = 1;
+    else if( plymax > 20 )
+        plymax = 20;
+    if( worker )
+        return sargon_pool_worker( plymax, movetime );
+    if( argc-argi<1 || argc-argi>2 || (resume && argc-argi<2) )
+    {
+        printf( "%s\n", usage );
+        return -1;
+    }
+    return master_main( argv[argi], argc-argi==2 ? argv[argi+1] : "", resume, skip );
+}
+
+static unsigned long elapsed_milliseconds( std::chrono::time_point<std::chrono::steady_clock> base )
+{
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
+    return static_cast<unsigned long>(ms.count());
+}
+
+// Find the number of complete results in the output of an interrupted run,
+//  and discard any partial line after them. The results start at the run's
+//  original -skip position, so the run resumes at skip + nbr_results
+static bool checkpoint( const std::string &fout, unsigned long &nbr_results )
+{
+    nbr_results = 0;
+    FILE *f = fopen( fout.c_str(), "rb" );
+    if( !f )
+        return true;    // nothing done yet
+    long complete_len = 0;
+    long len = 0;
+    int c;
+    while( (c=fgetc(f)) != EOF )
+    {
+        len++;
+        if( c == '\n' )
+        {
+            nbr_results++;
+            complete_len = len;
+        }
+    }
+    fclose(f);
+    if( complete_len == len )
+        return true;
+#ifdef _WIN32
+    int fd = _open( fout.c_str(), _O_RDWR|_O_BINARY );
+    bool ok = fd>=0 && _chsize(fd,complete_len)==0;
+    if( fd >= 0 )
+        _close(fd);
+#else
+    bool ok = truncate(fout.c_str(),complete_len) == 0;
+#endif
+    return ok;
+}
+
+static int master_main( const std::string &fin, const std::string &fout, bool resume, unsigned long skip )
+{
+    unsigned long first = skip;     // index of the first result in the output
+    unsigned long nbr_results = 0;
+    if( resume && !checkpoint(fout,nbr_results) )
+    {
+        fprintf( stderr, "Cannot resume from %s\n", fout.c_str() );
+        return -1;
+    }
+    skip = first + nbr_results;
+    FILE *in = fopen( fin.c_str(), "r" );
+    if( !in )
+    {
+        fprintf( stderr, "Cannot open %s\n", fin.c_str() );
+        return -1;
+    }
+    FILE *out = stdout;
+    if( fout.length() > 0 )
+    {
+        out = fopen( fout.c_str(), resume ? "ab" : "wb" );
+        if( !out )
+        {
+            fprintf( stderr, "Cannot open %s\n", fout.c_str() );
+            fclose(in);
+            return -1;
+        }
+    }
+
+    // Next position, skipping blank lines and comments
+    static char buf[8192];
+    unsigned long nbr_read = 0;
+    auto next_position = [&]( std::string &s ) -> bool
+    {
+        while( fgets(buf,sizeof(buf)-2,in) )
+        {
+            s = buf;
+            util::rtrim(s);
+            size_t offset = s.find_first_not_of(" \t");
+            if( offset==std::string::npos || s[offset]=='#' )
+                continue;
+            s = s.substr(offset);
+            if( nbr_read++ >= skip )
+                return true;
+        }
+        return false;
+    };
+
+    // Start the workers
+    if( !sargon_pool_start(nbr_workers,plymax,0) )
+    {
+        fprintf( stderr, "Cannot start worker processes\n" );
+        fclose(in);
+        if( out != stdout )
+            fclose(out);
+        return -1;
+    }
+    nbr_workers = sargon_pool_size();
+    if( window < nbr_workers )
+        window = window>0 ? nbr_workers : 16*nbr_workers;
+
+    // Each worker has at most one position at a time, the rest wait in idle
+    //  until the window allows the next position to be read
+    std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+    std::map<unsigned long,std::string> reorder;
+    std::vector<int> idle;
+    for( int i=0; i<nbr_workers; i++ )
+        idle.push_back(i);
+    unsigned long next_idx  = skip;   // next position to send
+    unsigned long next_out  = skip;   // next result to write
+    int busy = 0;
+    bool eof = false;
+    bool ok = true;
+    while( ok )
+    {
+        while( !eof && idle.size()>0 && next_idx-next_out < static_cast<unsigned long>(window) )
+        {
+            std::string s;
+            if( !next_position(s) )
+                eof = true;
+            else
+            {
+                int i = idle.back();
+                idle.pop_back();
+                sargon_pool_send( i, next_idx++, s );
+                busy++;
+            }
+        }
+        if( busy == 0 )
+            break;
+        int worker;
+        unsigned long idx;
+        std::string json;
+        if( !sargon_pool_result(worker,idx,json) )
+        {
+            fprintf( stderr, "Worker process %d stopped unexpectedly\n", worker );
+            ok = false;
+            break;
+        }
+        busy--;
+        idle.push_back( worker );
+        reorder[idx] = json;
+        while( reorder.size()>0 && reorder.begin()->first==next_out )
+        {
+            fprintf( out, "%s\n", reorder.begin()->second.c_str() );
+            fflush( out );
+            reorder.erase( reorder.begin() );
+            next_out++;
+        }
+    }
+
+    sargon_pool_stop();
+    fclose(in);
+    if( out != stdout )
+        fclose(out);
+    unsigned long ms = elapsed_milliseconds(base);
+    unsigned long nbr = next_out - skip;
+    fprintf( stderr, "%lu positions analysed by %d workers in %.3f seconds (%.2f positions/second)%s\n",
+                nbr, nbr_workers, ms/1000.0, ms ? nbr*1000.0/ms : 0.0,
+                ok ? "" : ", stopped early" );
+    if( !ok && out!=stdout )
+        fprintf( stderr, "%lu results in %s, restart with the same switches and -resume (or with -skip %lu and"
+                         " a new results file) to continue after them\n", next_out-first, fout.c_str(), next_out );
+    else if( !ok )
+        fprintf( stderr, "%lu results written, restart with -skip %lu to continue after them\n", next_out-first, next_out );
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,418 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-benchmark.cpp
+ *       Repeatable move calculation benchmark, with JSON results
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+/*
+
+    The timing tests time a single pass over the positions at each level,
+    which is fine for comparing Sargon with a TRS-80 but not for deciding
+    whether a change to the x86 code made Sargon 2% faster or slower. So
+    the benchmark;
+
+    - Runs each position (untimed) before timing starts, which also finds
+      how many runs of a fast position are needed for a sample long enough
+      to time accurately
+    - Takes a number of samples of each position, the positions taking
+      turns so any slow drift in the machine's speed affects them all alike
+    - Reports the median (not the mean, one interruption by another program
+      can ruin a mean), the median absolute deviation (MAD) as a measure of
+      the noise, and the 95th percentile, for each position and for each
+      level as a whole (the samples for a level are the sums of the
+      positions' samples)
+    - Can pin itself to one CPU, so it isn't moved between cores mid sample
+    - Optionally writes all the samples to a JSON file
+
+    Two JSON files can then be compared. Each level's (and each position's)
+    samples are compared with a Mann-Whitney U test, which makes no
+    assumptions about the distribution of the timings. Changes are only
+    reported as significant if they are unlikely to be noise (p < 0.01) and
+    at least 1%.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+#include "util.h"
+#include "thc.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-pv.h"
+#include "sargon-stats.h"
+#include "sargon-benchmark.h"
+
+// Fast positions are run repeatedly, so that each sample takes at least this long
+static const double MIN_SAMPLE_NS = 20e6;
+
+// Changes must be this unlikely to be noise, and at least this big, to be reported
+static const double SIGNIFICANCE   = 0.01;
+static const double MIN_CHANGE_PCT = 1.0;
+
+static double median( std::vector<double> v )
+{
+    size_t n = v.size();
+    if( n == 0 )
+        return 0;
+    std::sort( v.begin(), v.end() );
+    return n%2 ? v[n/2] : (v[n/2-1]+v[n/2])/2;
+}
+
+struct STATS
+{
+    double median;
+    double mad;     // median absolute deviation
+    double p95;     // 95th percentile (nearest rank)
+};
+
+static STATS calculate_stats( const std::vector<double> &samples )
+{
+    STATS stats;
+    stats.median = median(samples);
+    std::vector<double> deviations;
+    for( double x: samples )
+        deviations.push_back( fabs(x-stats.median) );
+    stats.mad = median(deviations);
+    std::vector<double> sorted = samples;
+    std::sort( sorted.begin(), sorted.end() );
+    size_t rank = static_cast<size_t>( ceil(0.95*sorted.size()) );
+    stats.p95 = rank>0 ? sorted[rank-1] : 0;
+    return stats;
+}
+
+static std::string format_ns( double ns )
+{
+    if( ns >= 1e9 )
+        return util::sprintf( "%.3f s", ns/1e9 );
+    else if( ns >= 1e6 )
+        return util::sprintf( "%.3f ms", ns/1e6 );
+    return util::sprintf( "%.1f us", ns/1e3 );
+}
+
+static bool pin_to_cpu( int cpu )
+{
+#ifdef _WIN32
+    return 0 != SetThreadAffinityMask( GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu );
+#else
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    return 0 == sched_setaffinity( 0, sizeof(set), &set );
+#endif
+}
+
+// Calculate a move, returns the move and the time taken
+static std::string run_position( const std::string &fen, int level, double &ns )
+{
+    thc::ChessRules cr;
+    cr.Forsyth( fen.c_str() );
+    PV pv;
+    std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+    sargon_run_engine( cr, level, pv, false );
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    ns = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(now - base).count() );
+    return sargon_export_move(BESTM);
+}
+
+static std::string json_samples( const std::vector<double> &samples )
+{
+    std::string s;
+    for( double x: samples )
+        s += util::sprintf( "%s%.0f", s.length()>0 ? "," : "", x );
+    return "[" + s + "]";
+}
+
+bool sargon_benchmark( const std::vector<std::string> &fens, const BENCHMARK_OPTIONS &options, bool quiet )
+{
+    int nbr_positions = static_cast<int>(fens.size());
+    int reps = options.reps>0 ? options.reps : 1;
+    printf( "* Benchmark, levels 1-%d, %d positions, %d warm up run%s and %d samples each\n",
+        options.max_level, nbr_positions, options.warmup, options.warmup==1?"":"s", reps );
+    if( options.cpu >= 0 )
+    {
+        if( pin_to_cpu(options.cpu) )
+            printf( "Pinned to CPU %d\n", options.cpu );
+        else
+            printf( "Could not pin to CPU %d, continuing anyway\n", options.cpu );
+    }
+    FILE *json = NULL;
+    if( options.json_file.length() > 0 )
+    {
+        json = fopen( options.json_file.c_str(), "wt" );
+        if( !json )
+        {
+            printf( "Cannot open %s\n", options.json_file.c_str() );
+            return false;
+        }
+        fprintf( json, "{\"benchmark\":\"sargon\",\"max_level\":%d,\"positions\":%d,\"warmup\":%d,\"reps\":%d,\"cpu\":%d,\n\"results\":[\n",
+            options.max_level, nbr_positions, options.warmup, reps, options.cpu );
+    }
+    std::string separator = "";
+    for( int level=1; level<=options.max_level; level++ )
+    {
+        printf( "Level %d: ", level );
+        fflush( stdout );
+
+        // Warm up, and find how many runs make a sample long enough to time accurately
+        std::vector<std::string> moves(nbr_positions);
+        std::vector<unsigned long> iterations(nbr_positions);
+        for( int i=0; i<nbr_positions; i++ )
+        {
+            double ns = 0;
+            for( int j=0; j==0 || j<options.warmup; j++ )
+                moves[i] = run_position( fens[i], level, ns );
+            iterations[i] = ns < MIN_SAMPLE_NS ? static_cast<unsigned long>( ceil(MIN_SAMPLE_NS/(ns>1?ns:1)) ) : 1;
+        }
+
+        // Timed samples, nanoseconds per run
+        std::vector< std::vector<double> > samples(nbr_positions);
+        std::vector<double> level_samples;
+        for( int r=0; r<reps; r++ )
+        {
+            double total = 0;
+            for( int i=0; i<nbr_positions; i++ )
+            {
+                double sum = 0;
+                for( unsigned long j=0; j<iterations[i]; j++ )
+                {
+                    double ns;
+                    run_position( fens[i], level, ns );
+                    sum += ns;
+                }
+                samples[i].push_back( sum/iterations[i] );
+                total += sum/iterations[i];
+            }
+            level_samples.push_back( total );
+            printf( "." );
+            fflush( stdout );
+        }
+        STATS stats = calculate_stats( level_samples );
+        printf( " median %s, MAD %s (%.1f%%), p95 %s\n",
+            format_ns(stats.median).c_str(), format_ns(stats.mad).c_str(),
+            stats.median>0 ? 100.0*stats.mad/stats.median : 0.0, format_ns(stats.p95).c_str() );
+        for( int i=0; i<nbr_positions; i++ )
+        {
+            STATS s = calculate_stats( samples[i] );
+            if( !quiet )
+                printf( "  Position %2d %-5s x%-6lu median %s, MAD %s (%.1f%%), p95 %s\n",
+                    i+1, moves[i].c_str(), iterations[i],
+                    format_ns(s.median).c_str(), format_ns(s.mad).c_str(),
+                    s.median>0 ? 100.0*s.mad/s.median : 0.0, format_ns(s.p95).c_str() );
+            if( json )
+            {
+                fprintf( json, "%s{\"level\":%d,\"position\":%d,\"fen\":\"%s\",\"move\":\"%s\",\"iterations\":%lu,"
+                               "\"median_ns\":%.0f,\"mad_ns\":%.0f,\"p95_ns\":%.0f,\"samples_ns\":%s}",
+                    separator.c_str(), level, i+1, fens[i].c_str(), moves[i].c_str(), iterations[i],
+                    s.median, s.mad, s.p95, json_samples(samples[i]).c_str() );
+                separator = ",\n";
+            }
+        }
+
+        // Search statistics, from one more (untimed) run of each position
+        if( options.stats )
+        {
+            sargon_stats_reset_totals();
+            sargon_stats_enable( true );
+            for( int i=0; i<nbr_positions; i++ )
+            {
+                double ns;
+                sargon_stats_new_search();
+                run_position( fens[i], level, ns );
+            }
+            sargon_stats_enable( false );
+            printf( "Level %d search statistics, all positions\n%s", level, sargon_stats_report(true).c_str() );
+        }
+        if( json )
+        {
+            fprintf( json, "%s{\"level\":%d,\"position\":0,\"median_ns\":%.0f,\"mad_ns\":%.0f,\"p95_ns\":%.0f,\"samples_ns\":%s}",
+                separator.c_str(), level, stats.median, stats.mad, stats.p95, json_samples(level_samples).c_str() );
+            separator = ",\n";
+        }
+    }
+    if( json )
+    {
+        fprintf( json, "\n]}\n" );
+        fclose( json );
+        printf( "Results written to %s\n", options.json_file.c_str() );
+    }
+    return true;
+}
+
+// A level's (position 0) or a position's results, read back from a JSON file
+struct RESULT
+{
+    std::string fen;
+    std::string move;
+    std::vector<double> samples;
+};
+
+// Get a field's value from one of our own JSON result lines
+static std::string json_field( const std::string &line, const std::string &name )
+{
+    std::string key = "\"" + name + "\":";
+    size_t offset = line.find(key);
+    if( offset == std::string::npos )
+        return "";
+    offset += key.length();
+    if( offset<line.length() && line[offset]=='"' )
+    {
+        size_t end = line.find( '"', offset+1 );
+        return end==std::string::npos ? "" : line.substr( offset+1, end-offset-1 );
+    }
+    size_t end = line.find_first_of( ",}", offset );
+    if( offset<line.length() && line[offset]=='[' )
+        end = line.find( ']', offset ) + 1;
+    return line.substr( offset, end==std::string::npos ? std::string::npos : end-offset );
+}
+
+static bool read_results( const std::string &file, std::map< std::pair<int,int>, RESULT > &results )
+{
+    FILE *f = fopen( file.c_str(), "rt" );
+    if( !f )
+    {
+        printf( "Cannot open %s\n", file.c_str() );
+        return false;
+    }
+    std::string line;
+    int c;
+    do
+    {
+        c = fgetc(f);
+        if( c!='\n' && c!=EOF )
+            line += static_cast<char>(c);
+        else
+        {
+            std::string level = json_field( line, "level" );
+            std::string position = json_field( line, "position" );
+            if( level.length()>0 && position.length()>0 )
+            {
+                RESULT &r = results[ std::make_pair(atoi(level.c_str()),atoi(position.c_str())) ];
+                r.fen  = json_field( line, "fen" );
+                r.move = json_field( line, "move" );
+                std::string s = json_field( line, "samples_ns" );   // eg "[123,456]"
+                util::replace_all( s, ",", " " );
+                std::vector<std::string> fields;
+                util::split( s.length()>2 ? s.substr(1,s.length()-2) : "", fields );
+                for( std::string &x: fields )
+                    r.samples.push_back( atof(x.c_str()) );
+            }
+            line.clear();
+        }
+    } while( c != EOF );
+    fclose(f);
+    if( results.size() == 0 )
+        printf( "No benchmark results in %s\n", file.c_str() );
+    return results.size() > 0;
+}
+
+// One sided Mann-Whitney U test, the probability of b's samples being at least
+//  this much bigger than a's if they came from the same distribution (normal
+//  approximation, with a correction for ties)
+static double p_bigger( const std::vector<double> &a, const std::vector<double> &b )
+{
+    double n1 = static_cast<double>(a.size());
+    double n2 = static_cast<double>(b.size());
+    if( n1==0 || n2==0 )
+        return 1;
+    std::vector< std::pair<double,bool> > all;
+    for( double x: a )
+        all.push_back( std::make_pair(x,false) );
+    for( double x: b )
+        all.push_back( std::make_pair(x,true) );
+    std::sort( all.begin(), all.end() );
+    double rank_sum_b = 0;
+    double ties = 0;
+    for( size_t i=0; i<all.size(); )
+    {
+        size_t j = i;
+        while( j<all.size() && all[j].first==all[i].first )
+            j++;
+        double rank = (i+1+j)/2.0;  // tied samples share the average rank
+        double t = static_cast<double>(j-i);
+        ties += t*t*t - t;
+        for( ; i<j; i++ )
+        {
+            if( all[i].second )
+                rank_sum_b += rank;
+        }
+    }
+    double n = n1+n2;
+    double u = rank_sum_b - n2*(n2+1)/2;
+    double variance = n1*n2/12 * ((n+1) - ties/(n*(n-1)));
+    if( variance <= 0 )
+        return 1;
+    double z = (u - n1*n2/2 - 0.5) / sqrt(variance);
+    return 0.5 * erfc( z/sqrt(2.0) );
+}
+
+bool sargon_benchmark_compare( const std::string &baseline_file, const std::string &json_file )
+{
+    std::map< std::pair<int,int>, RESULT > baseline, results;
+    if( !read_results(baseline_file,baseline) || !read_results(json_file,results) )
+        return false;
+    printf( "* Benchmark comparison, %s -> %s\n", baseline_file.c_str(), json_file.c_str() );
+    int nbr_slower = 0;
+    int nbr_faster = 0;
+    for( auto &it: baseline )
+    {
+        int level    = it.first.first;
+        int position = it.first.second;
+        auto found = results.find( it.first );
+        if( found == results.end() )
+            continue;
+        const RESULT &a = it.second;
+        const RESULT &b = found->second;
+        std::string what = position==0 ? util::sprintf("Level %d", level)
+                                       : util::sprintf("  Position %2d", position);
+        if( a.fen != b.fen )
+        {
+            printf( "%s: different positions, not compared\n", what.c_str() );
+            continue;
+        }
+        double median_a = median(a.samples);
+        double median_b = median(b.samples);
+        double change = median_a>0 ? 100.0*(median_b-median_a)/median_a : 0;
+        double p_slower = p_bigger( a.samples, b.samples );
+        double p_faster = p_bigger( b.samples, a.samples );
+        std::string verdict;
+        if( p_slower<SIGNIFICANCE && change>=MIN_CHANGE_PCT )
+        {
+            verdict = "SLOWER";
+            nbr_slower++;
+        }
+        else if( p_faster<SIGNIFICANCE && change<=-MIN_CHANGE_PCT )
+        {
+            verdict = "faster";
+            nbr_faster++;
+        }
+        bool moves_differ = (a.move != b.move);
+        if( position==0 || verdict.length()>0 || moves_differ )
+        {
+            printf( "%s: %s -> %s, %+.1f%% (p=%.4f) %s%s\n", what.c_str(),
+                format_ns(median_a).c_str(), format_ns(median_b).c_str(), change,
+                change>0 ? p_slower : p_faster,
+                verdict.length()>0 ? verdict.c_str() : "no significant change",
+                moves_differ ? util::sprintf(", move changed %s -> %s", a.move.c_str(), b.move.c_str()).c_str() : "" );
+        }
+    }
+    printf( "%d significantly slower, %d significantly faster (p < %.2f and at least %.0f%% change)\n",
+        nbr_slower, nbr_faster, SIGNIFICANCE, MIN_CHANGE_PCT );
+    return nbr_slower == 0;
+}
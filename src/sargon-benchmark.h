@@ -0,0 +1,39 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-benchmark.h
+ *       Repeatable move calculation benchmark, with JSON results
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_BENCHMARK_H_INCLUDED
+#define SARGON_BENCHMARK_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+// Benchmark settings
+struct BENCHMARK_OPTIONS
+{
+    int         max_level;  // levels (PLYMAX) 1 to max_level
+    int         warmup;     // untimed runs of each position before timing starts
+    int         reps;       // timed samples of each position at each level
+    int         cpu;        // pin the benchmark to this CPU, -1 = don't
+    std::string json_file;  // also write the results to this file, if not empty
+    bool        stats;      // also report search statistics for each level
+    BENCHMARK_OPTIONS() : max_level(5), warmup(1), reps(10), cpu(-1), stats(false) {}
+};
+
+// Time Sargon's move calculation on each position at each level. Reports the
+//  median, median absolute deviation and 95th percentile of the samples for
+//  each level (and for each position unless quiet)
+bool sargon_benchmark( const std::vector<std::string> &fens, const BENCHMARK_OPTIONS &options, bool quiet );
+
+// Compare two sets of JSON results, and report statistically significant
+//  changes. Returns false if anything got slower
+bool sargon_benchmark_compare( const std::string &baseline_file, const std::string &json_file );
+
+#endif // SARGON_BENCHMARK_H_INCLUDED
@@ -0,0 +1,271 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-book.cpp
+ *       External opening book, compact sorted binary format
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "thc.h"
+#include "sargon-book.h"
+
+// Zobrist hash codes; 12 piece types x 64 squares, 4 castling rights,
+//  8 en-passant files and side to move. The codes are generated by a fixed
+//  xorshift sequence, so the keys follow the Polyglot scheme but are not
+//  interchangeable with Polyglot's own random table. Books must be built
+//  with sargon-make-book.
+static uint64_t piece_codes[12][64];
+static uint64_t castling_codes[4];
+static uint64_t enpassant_codes[8];
+static uint64_t white_to_move_code;
+static bool codes_initialised;
+
+static uint64_t next_code()
+{
+    static uint64_t x = 0x2545f4914f6cdd1dULL;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+static void codes_init()
+{
+    for( int i=0; i<12; i++ )
+    {
+        for( int j=0; j<64; j++ )
+            piece_codes[i][j] = next_code();
+    }
+    for( int i=0; i<4; i++ )
+        castling_codes[i] = next_code();
+    for( int i=0; i<8; i++ )
+        enpassant_codes[i] = next_code();
+    white_to_move_code = next_code();
+    codes_initialised = true;
+}
+
+uint64_t sargon_book_hash( const thc::ChessPosition &cp )
+{
+    if( !codes_initialised )
+        codes_init();
+    static const char *pieces = "pPnNbBrRqQkK";
+    uint64_t hash = 0;
+    for( int sq=0; sq<64; sq++ )
+    {
+        char c = cp.squares[sq];
+        if( c == ' ' )
+            continue;
+        const char *p = strchr(pieces,c);
+        if( p )
+            hash ^= piece_codes[p-pieces][sq];
+    }
+    if( cp.wking_allowed() )
+        hash ^= castling_codes[0];
+    if( cp.wqueen_allowed() )
+        hash ^= castling_codes[1];
+    if( cp.bking_allowed() )
+        hash ^= castling_codes[2];
+    if( cp.bqueen_allowed() )
+        hash ^= castling_codes[3];
+    thc::Square ep = cp.groomed_enpassant_target();
+    if( ep != thc::SQUARE_INVALID )
+        hash ^= enpassant_codes[ep&7];
+    if( cp.white )
+        hash ^= white_to_move_code;
+    return hash;
+}
+
+uint16_t sargon_book_encode_move( const thc::Move &mv )
+{
+    // thc squares run a8=0 .. h1=63, book ranks run 0=rank 1 .. 7=rank 8
+    int src = mv.src;
+    int dst = mv.dst;
+    switch( mv.special )
+    {
+        case thc::SPECIAL_WK_CASTLING:  dst = thc::h1;  break;
+        case thc::SPECIAL_WQ_CASTLING:  dst = thc::a1;  break;
+        case thc::SPECIAL_BK_CASTLING:  dst = thc::h8;  break;
+        case thc::SPECIAL_BQ_CASTLING:  dst = thc::a8;  break;
+        default:                                        break;
+    }
+    int promotion = 0;
+    switch( mv.special )
+    {
+        case thc::SPECIAL_PROMOTION_KNIGHT: promotion = 1;  break;
+        case thc::SPECIAL_PROMOTION_BISHOP: promotion = 2;  break;
+        case thc::SPECIAL_PROMOTION_ROOK:   promotion = 3;  break;
+        case thc::SPECIAL_PROMOTION_QUEEN:  promotion = 4;  break;
+        default:                                            break;
+    }
+    int to_file   = dst&7;
+    int to_rank   = 7 - (dst>>3);
+    int from_file = src&7;
+    int from_rank = 7 - (src>>3);
+    return static_cast<uint16_t>( to_file | (to_rank<<3) | (from_file<<6) | (from_rank<<9) | (promotion<<12) );
+}
+
+void sargon_book_write_entry( unsigned char *buf, const BOOK_ENTRY &e )
+{
+    for( int i=0; i<8; i++ )
+        buf[i] = static_cast<unsigned char>( e.key >> (56-8*i) );
+    buf[8]  = static_cast<unsigned char>( e.move >> 8 );
+    buf[9]  = static_cast<unsigned char>( e.move );
+    buf[10] = static_cast<unsigned char>( e.weight >> 8 );
+    buf[11] = static_cast<unsigned char>( e.weight );
+    for( int i=0; i<4; i++ )
+        buf[12+i] = static_cast<unsigned char>( e.learn >> (24-8*i) );
+}
+
+static void read_entry( const unsigned char *buf, BOOK_ENTRY &e )
+{
+    e.key = 0;
+    for( int i=0; i<8; i++ )
+        e.key = (e.key<<8) | buf[i];
+    e.move   = static_cast<uint16_t>( (buf[8]<<8)  | buf[9] );
+    e.weight = static_cast<uint16_t>( (buf[10]<<8) | buf[11] );
+    e.learn  = (static_cast<uint32_t>(buf[12])<<24) | (buf[13]<<16) | (buf[14]<<8) | buf[15];
+}
+
+//
+//  Memory mapping, the book is read only and shared between instances
+//
+
+static const unsigned char *book_base;
+static size_t book_nbr_entries;
+#ifdef _WIN32
+static HANDLE book_file   = INVALID_HANDLE_VALUE;
+static HANDLE book_mapping;
+#else
+static size_t book_len;
+#endif
+
+bool sargon_book_open( const std::string &filename )
+{
+    sargon_book_close();
+    size_t len=0;
+#ifdef _WIN32
+    book_file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( book_file == INVALID_HANDLE_VALUE )
+        return false;
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx(book_file,&size) || size.QuadPart<BOOK_ENTRY_SIZE )
+    {
+        sargon_book_close();
+        return false;
+    }
+    len = static_cast<size_t>(size.QuadPart);
+    book_mapping = CreateFileMappingA( book_file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( book_mapping == NULL )
+    {
+        sargon_book_close();
+        return false;
+    }
+    book_base = static_cast<const unsigned char *>( MapViewOfFile( book_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+#else
+    int fd = open( filename.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+    struct stat st;
+    if( fstat(fd,&st)!=0 || st.st_size<BOOK_ENTRY_SIZE )
+    {
+        close(fd);
+        return false;
+    }
+    len = static_cast<size_t>(st.st_size);
+    void *p = mmap( NULL, len, PROT_READ, MAP_SHARED, fd, 0 );
+    close(fd);
+    if( p != MAP_FAILED )
+    {
+        book_base = static_cast<const unsigned char *>(p);
+        book_len  = len;
+    }
+#endif
+    if( book_base == NULL )
+    {
+        sargon_book_close();
+        return false;
+    }
+    book_nbr_entries = len / BOOK_ENTRY_SIZE;
+    return true;
+}
+
+void sargon_book_close()
+{
+#ifdef _WIN32
+    if( book_base )
+        UnmapViewOfFile( book_base );
+    if( book_mapping )
+        CloseHandle( book_mapping );
+    if( book_file != INVALID_HANDLE_VALUE )
+        CloseHandle( book_file );
+    book_mapping = NULL;
+    book_file = INVALID_HANDLE_VALUE;
+#else
+    if( book_base )
+        munmap( const_cast<unsigned char *>(book_base), book_len );
+    book_len = 0;
+#endif
+    book_base = NULL;
+    book_nbr_entries = 0;
+}
+
+bool sargon_book_is_open()
+{
+    return book_base != NULL;
+}
+
+bool sargon_book_probe( thc::ChessRules &cr, thc::Move &mv )
+{
+    if( !book_base )
+        return false;
+    uint64_t key = sargon_book_hash(cr);
+
+    // Binary search for the first entry with this key
+    size_t lo=0, hi=book_nbr_entries;
+    while( lo < hi )
+    {
+        size_t mid = lo + (hi-lo)/2;
+        BOOK_ENTRY e;
+        read_entry( book_base + mid*BOOK_ENTRY_SIZE, e );
+        if( e.key < key )
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+
+    // Entries for a key are sorted by descending weight, so take the first
+    //  that is legal in this position (guards against hash collisions)
+    std::vector<thc::Move> moves;
+    cr.GenLegalMoveList( moves );
+    for( size_t i=lo; i<book_nbr_entries; i++ )
+    {
+        BOOK_ENTRY e;
+        read_entry( book_base + i*BOOK_ENTRY_SIZE, e );
+        if( e.key != key )
+            break;
+        for( thc::Move m: moves )
+        {
+            if( sargon_book_encode_move(m) == e.move )
+            {
+                mv = m;
+                return true;
+            }
+        }
+    }
+    return false;
+}
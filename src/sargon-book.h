@@ -0,0 +1,56 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-book.h
+ *       External opening book, compact sorted binary format
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_BOOK_H_INCLUDED
+#define SARGON_BOOK_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "thc.h"
+
+// A book file is a sorted array of 16 byte entries, using the Polyglot
+//  layout (all fields big endian);
+//      uint64_t key;       position hash, see sargon_book_hash()
+//      uint16_t move;      to file (bits 0-2), to rank (3-5), from file (6-8),
+//                           from rank (9-11), promotion (12-14: 1=N,2=B,3=R,4=Q)
+//                           castling is encoded as king takes own rook
+//      uint16_t weight;    relative frequency of the move
+//      uint32_t learn;     unused, zero
+//  Entries are sorted by key, then by descending weight
+const int BOOK_ENTRY_SIZE = 16;
+
+struct BOOK_ENTRY
+{
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+    BOOK_ENTRY() : key(0), move(0), weight(0), learn(0) {}
+};
+
+// Position hash and move encoding, shared by the engine and the book builder
+uint64_t sargon_book_hash( const thc::ChessPosition &cp );
+uint16_t sargon_book_encode_move( const thc::Move &mv );
+
+// Serialise an entry (for the book builder)
+void sargon_book_write_entry( unsigned char *buf, const BOOK_ENTRY &e );
+
+// Open and memory map a book file, returns bool ok
+bool sargon_book_open( const std::string &filename );
+void sargon_book_close();
+bool sargon_book_is_open();
+
+// Look up a position, returns bool found. If found, mv is the book move
+//  with the highest weight (legality is checked against the position)
+bool sargon_book_probe( thc::ChessRules &cr, thc::Move &mv );
+
+#endif // SARGON_BOOK_H_INCLUDED
@@ -0,0 +1,2032 @@
+// Automatically generated file - Sargon translated to C++ by convert-z80-to-x86 -cpp
+#include <stddef.h>
+#include <stdint.h>
+#include <initializer_list>
+#include "sargon-asm-interface.h"
+
+// Z80 registers and flags. fsz is a result byte that gives the S and Z flags
+static uint8_t  a, b, c, d, e, h, l;
+static uint16_t ix, iy;
+static uint8_t  fsz;
+static bool     fc, fpv;
+static uint8_t  a_alt, f_alt, b_alt, c_alt, d_alt, e_alt, h_alt, l_alt;
+
+// Memory, the same 64K of data (and the same layout) as the x86 build
+extern "C" {
+    unsigned char sargon_base_address[65536];
+    unsigned char sargon_native_points;
+};
+#define mem sargon_base_address
+
+// Stack, RET records where it found its return address in ret_sp
+static uint16_t stack[256];
+static unsigned int sp, ret_sp;
+
+static inline uint16_t BC() { return (uint16_t)((b<<8)|c); }
+static inline uint16_t DE() { return (uint16_t)((d<<8)|e); }
+static inline uint16_t HL() { return (uint16_t)((h<<8)|l); }
+static inline void set_BC( uint16_t w ) { b = (uint8_t)(w>>8); c = (uint8_t)w; }
+static inline void set_DE( uint16_t w ) { d = (uint8_t)(w>>8); e = (uint8_t)w; }
+static inline void set_HL( uint16_t w ) { h = (uint8_t)(w>>8); l = (uint8_t)w; }
+static inline uint16_t rd16( uint16_t addr ) { return (uint16_t)(mem[addr] | (mem[(uint16_t)(addr+1)]<<8)); }
+static inline void wr16( uint16_t addr, uint16_t w ) { mem[addr] = (uint8_t)w; mem[(uint16_t)(addr+1)] = (uint8_t)(w>>8); }
+static inline void push( uint16_t w ) { stack[--sp] = w; }
+static inline uint16_t pop() { return stack[sp++]; }
+
+// Even parity sets P/V
+static inline bool parity( uint8_t v )
+{
+    v ^= v>>4;
+    v ^= v>>2;
+    v ^= v>>1;
+    return (v&1) == 0;
+}
+
+// Flags in Z80 format (S Z - H - P/V N C), for PUSH AF, EX AF,AF' and callbacks
+static inline uint8_t get_F()
+{
+    return (uint8_t)((fsz&0x80) | (fsz==0?0x40:0) | (fpv?0x04:0) | (fc?0x01:0));
+}
+
+static inline void set_F( uint8_t f )
+{
+    fsz = (f&0x40) ? 0 : ((f&0x80) | 1);
+    fpv = (f&0x04) != 0;
+    fc  = (f&0x01) != 0;
+}
+
+static inline void ex_af()
+{
+    uint8_t t = a;
+    a = a_alt;
+    a_alt = t;
+    t = get_F();
+    set_F( f_alt );
+    f_alt = t;
+}
+
+static inline void exx()
+{
+    uint8_t t;
+    t = b; b = b_alt; b_alt = t;
+    t = c; c = c_alt; c_alt = t;
+    t = d; d = d_alt; d_alt = t;
+    t = e; e = e_alt; e_alt = t;
+    t = h; h = h_alt; h_alt = t;
+    t = l; l = l_alt; l_alt = t;
+}
+
+// LD A,R, the refresh register is a poor random number generator
+static inline uint8_t ldar()
+{
+    static uint8_t r;
+    r = (r+1) & 0x7f;
+    return r;
+}
+
+// A CALL runs the routine, then returns too if the routine didn't return
+//  to us (it discarded its own return address)
+#define CALL(routine)  do { push(0); unsigned int token = sp; routine(); if( ret_sp != token ) return; } while(0)
+#define RET            do { ret_sp = sp++; return; } while(0)
+
+static void do_callback( const char *msg )
+{
+    z80_registers registers;
+    registers.af = (uint16_t)((get_F()<<8) | a);
+    registers.hl = HL();
+    registers.bc = BC();
+    registers.de = DE();
+    registers.ix = ix;
+    registers.iy = iy;
+    sargon_callback( msg, registers );
+    a = (uint8_t)registers.af;
+    set_F( (uint8_t)(registers.af>>8) );
+    set_HL( registers.hl );
+    set_BC( registers.bc );
+    set_DE( registers.de );
+    ix = registers.ix;
+    iy = registers.iy;
+}
+
+// Equates
+const int PAWN = 1;
+const int KNIGHT = 2;
+const int BISHOP = 3;
+const int ROOK = 4;
+const int QUEEN = 5;
+const int KING = 6;
+const int WHITE = 0;
+const int BLACK = 0x80;
+const int BPAWN = BLACK+PAWN;
+const int TBASE = 0x0100;
+const int DIRECT = 0x0100-TBASE;
+const int DPOINT = 0x0118-TBASE;
+const int DCOUNT = 0x011f-TBASE;
+const int PVALUE = 0x0126-TBASE-1;
+const int PIECES = 0x012c-TBASE;
+const int BOARD = 0x0134-TBASE;
+const int WACT = ATKLST;
+const int BACT = ATKLST+7;
+const int PLIST = 0x01ba-TBASE-1;
+const int PLISTD = PLIST+10;
+const int MLPTR = 0;
+const int MLFRP = 2;
+const int MLTOP = 3;
+const int MLFLG = 4;
+const int MLVAL = 5;
+
+// Initial data
+static void db( uint16_t addr, std::initializer_list<int> values )
+{
+    for( int v: values )
+        mem[addr++] = (uint8_t)v;
+}
+
+static void dw( uint16_t addr, std::initializer_list<int> values )
+{
+    for( int v: values )
+    {
+        wr16( addr, (uint16_t)v );
+        addr += 2;
+    }
+}
+
+static bool init_data()
+{
+    db( 0x0100, { +9,+11,-11,-9 } );
+    db( 0x0104, { +10,-10,+1,-1 } );
+    db( 0x0108, { -21,-12,+8,+19 } );
+    db( 0x010c, { +21,+12,-8,-19 } );
+    db( 0x0110, { +10,+10,+11,+9 } );
+    db( 0x0114, { -10,-10,-11,-9 } );
+    db( 0x0118, { 20,16,8,0,4,0,0 } );
+    db( 0x011f, { 4,4,8,4,4,8,8 } );
+    db( 0x0126, { 1,3,3,5,9,10 } );
+    db( 0x012c, { 4,2,3,5,6,3,2,4 } );
+    dw( 0x01ac, { 0,0,0,0,0,0,0 } );
+    dw( 0x01ba, { 0,0,0,0,0,0,0,0,0,0 } );
+    db( 0x01ce, { 24,95 } );
+    db( 0x01d0, { 14,94 } );
+    db( 0x01d2, { -1 } );
+    dw( 0x0200, { 0,0,0,0,0,0,0,0,0,0 } );
+    dw( 0x0214, { 0,0,0,0,0,0,0,0,0,0 } );
+    dw( 0x0228, { 0 } );
+    dw( 0x022a, { 0,0,0,0,0,0,0,0,0,0 } );
+    dw( 0x023e, { 0,0,0,0,0,0,0,0,0,0 } );
+    dw( 0x0300, { TBASE } );
+    dw( 0x0302, { TBASE } );
+    dw( 0x0304, { TBASE } );
+    dw( 0x0306, { TBASE } );
+    dw( 0x0308, { TBASE } );
+    dw( 0x030a, { TBASE } );
+    dw( 0x030c, { TBASE } );
+    dw( 0x030e, { TBASE } );
+    dw( 0x0310, { TBASE } );
+    dw( 0x0312, { TBASE } );
+    dw( 0x0314, { PLYIX } );
+    dw( 0x0316, { 0 } );
+    dw( 0x0318, { 0 } );
+    dw( 0x031a, { 0 } );
+    dw( 0x031c, { 0 } );
+    dw( 0x031e, { MLIST } );
+    db( 0x0320, { 0 } );
+    db( 0x0321, { 0 } );
+    db( 0x0322, { 0 } );
+    db( 0x0323, { 0 } );
+    db( 0x0324, { 0 } );
+    db( 0x0325, { 0 } );
+    db( 0x0326, { 0 } );
+    db( 0x0327, { 2 } );
+    db( 0x0328, { 0 } );
+    db( 0x0329, { 0 } );
+    db( 0x032a, { 0 } );
+    db( 0x032b, { 0 } );
+    db( 0x032c, { 0 } );
+    db( 0x032d, { 0 } );
+    db( 0x032e, { 0 } );
+    db( 0x032f, { 0 } );
+    db( 0x0330, { 0 } );
+    db( 0x0331, { 0 } );
+    db( 0x0332, { 0 } );
+    db( 0x0333, { 0 } );
+    db( 0x0334, { 35,55,0x10 } );
+    db( 0x0337, { 34,54,0x10 } );
+    db( 0x033a, { 85,65,0x10 } );
+    db( 0x033d, { 84,64,0x10 } );
+    db( 0x0340, { 0 } );
+    db( 0x0341, { 0,0,0,0,0 } );
+    return true;
+}
+
+// Initialise before main(), like the x86 build's initialised data
+static bool data_initialised = init_data();
+
+// Routines
+static void FCDMAT();
+static void TBCPMV();
+static void MAKEMV();
+static void INITBD();
+static void PATH();
+static void MPIECE();
+static void ENPSNT();
+static void ADJPTR();
+static void CASTLE();
+static void ADMOVE();
+static void GENMOV();
+static void INCHK();
+static void INCHK1();
+static void ATTACK();
+static void ATKSAV();
+static void PNCK();
+static void PINFND();
+static void XCHNG();
+static void NEXTAD();
+static void POINTS();
+static void LIMIT();
+static void MOVE();
+static void UNMOVE();
+static void SORTM();
+static void EVAL();
+static void FNDMOV();
+static void ASCEND();
+static void BOOK();
+static void CPTRMV();
+static void BITASN();
+static void ASNTBI();
+static void VALMOV();
+static void ROYALT();
+static void DIVIDE();
+static void MLTPLY();
+static void EXECMV();
+
+// FCDMAT, line 509
+static void FCDMAT()
+{
+    RET;                                        // stub in the x86 build too
+}
+
+// TBCPMV, line 510
+static void TBCPMV()
+{
+    RET;                                        // stub in the x86 build too
+}
+
+// MAKEMV, line 511
+static void MAKEMV()
+{
+    RET;                                        // stub in the x86 build too
+}
+
+// INITBD, line 803
+static void INITBD()
+{
+    b = (uint8_t)(120);                         // LD b,120
+    set_HL( (uint16_t)(BOARDA) );               // LD hl,BOARDA
+back01:
+    mem[HL()] = (uint8_t)(-1);                  // LD (hl),-1
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    if( --b != 0 ) goto back01;                 // DJNZ back01
+    b = (uint8_t)(8);                           // LD b,8
+    ix = (uint16_t)(BOARDA);                    // LD ix,BOARDA
+IB2:
+    a = mem[(uint16_t)(ix-8)];                  // LD a,(ix-8)
+    mem[(uint16_t)(ix+21)] = a;                 // LD (ix+21),a
+    a |= (1<<7);                                // SET 7,a
+    mem[(uint16_t)(ix+91)] = a;                 // LD (ix+91),a
+    mem[(uint16_t)(ix+31)] = (uint8_t)(PAWN);   // LD (ix+31),PAWN
+    mem[(uint16_t)(ix+81)] = (uint8_t)(BPAWN);  // LD (ix+81),BPAWN
+    mem[(uint16_t)(ix+41)] = (uint8_t)(0);      // LD (ix+41),0
+    mem[(uint16_t)(ix+51)] = (uint8_t)(0);      // LD (ix+51),0
+    mem[(uint16_t)(ix+61)] = (uint8_t)(0);      // LD (ix+61),0
+    mem[(uint16_t)(ix+71)] = (uint8_t)(0);      // LD (ix+71),0
+    ix++;                                       // INC ix
+    if( --b != 0 ) goto IB2;                    // DJNZ IB2
+    ix = (uint16_t)(POSK);                      // LD ix,POSK
+    mem[(uint16_t)(ix+0)] = (uint8_t)(25);      // LD (ix+0),25
+    mem[(uint16_t)(ix+1)] = (uint8_t)(95);      // LD (ix+1),95
+    mem[(uint16_t)(ix+2)] = (uint8_t)(24);      // LD (ix+2),24
+    mem[(uint16_t)(ix+3)] = (uint8_t)(94);      // LD (ix+3),94
+    RET;                                        // RET
+}
+
+// PATH, line 855
+static void PATH()
+{
+    set_HL( (uint16_t)(M2) );                   // LD hl,M2
+    a = mem[HL()];                              // LD a,(hl)
+    { unsigned int v = c; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,c
+    mem[HL()] = a;                              // LD (hl),a
+    ix = rd16(M2);                              // LD ix,(M2)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    { unsigned int v = (uint8_t)(-1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,-1
+    if( fsz == 0 ) goto PA2;                    // JR Z,PA2
+    mem[P2] = a;                                // LD (P2),a
+    a &= (uint8_t)(7); fsz = a; fc = false; fpv = parity(a); // AND a,7
+    mem[T2] = a;                                // LD (T2),a
+    if( fsz == 0 ) RET;                         // RET Z
+    a = mem[P2];                                // LD a,(P2)
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    a ^= mem[HL()]; fc = false;                 // XOR a,(hl)
+    fsz = a & (1<<7); fpv = fsz == 0;           // BIT 7,a
+    if( fsz == 0 ) goto PA1;                    // JR Z,PA1
+    a = (uint8_t)(1);                           // LD a,1
+    RET;                                        // RET
+PA1:
+    a = (uint8_t)(2);                           // LD a,2
+    RET;                                        // RET
+PA2:
+    a = (uint8_t)(3);                           // LD a,3
+    RET;                                        // RET
+}
+
+// MPIECE, line 894
+static void MPIECE()
+{
+    a ^= mem[HL()];                             // XOR a,(hl)
+    a &= (uint8_t)(0x87);                       // AND a,87H
+    { unsigned int v = (uint8_t)(BPAWN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,BPAWN
+    if( fsz != 0 ) goto rel001;                 // JR NZ,rel001
+    a--;                                        // DEC a
+rel001:
+    a &= (uint8_t)(7); fsz = a; fc = false; fpv = parity(a); // AND a,7
+    mem[T1] = a;                                // LD (T1),a
+    iy = rd16(T1);                              // LD iy,(T1)
+    b = mem[(uint16_t)(iy+DCOUNT)];             // LD b,(iy+DCOUNT)
+    a = mem[(uint16_t)(iy+DPOINT)];             // LD a,(iy+DPOINT)
+    mem[INDX2] = a;                             // LD (INDX2),a
+    iy = rd16(INDX2);                           // LD iy,(INDX2)
+MP5:
+    c = mem[(uint16_t)(iy+DIRECT)];             // LD c,(iy+DIRECT)
+    a = mem[M1];                                // LD a,(M1)
+    mem[M2] = a;                                // LD (M2),a
+MP10:
+    CALL( PATH );                               // CALL PATH
+    do_callback( "Suppress King moves" );       // CALLBACK "Suppress King moves"
+    { unsigned int v = (uint8_t)(2); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,2
+    if( !fc ) goto MP15;                        // JR NC,MP15
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    ex_af();                                    // EX af,af'
+    a = mem[T1];                                // LD a,(T1)
+    { unsigned int v = (uint8_t)(PAWN+1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,PAWN+1
+    if( fc ) goto MP20;                         // JR C,MP20
+    CALL( ADMOVE );                             // CALL ADMOVE
+    ex_af();                                    // EX af,af'
+    if( fsz != 0 ) goto MP15;                   // JR NZ,MP15
+    a = mem[T1];                                // LD a,(T1)
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto MP15;                   // JR Z,MP15
+    { unsigned int v = (uint8_t)(BISHOP); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,BISHOP
+    if( !fc ) goto MP10;                        // JR NC,MP10
+MP15:
+    iy++;                                       // INC iy
+    if( --b != 0 ) goto MP5;                    // DJNZ MP5
+    a = mem[T1];                                // LD a,(T1)
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) CALL( CASTLE );              // CALL Z,CASTLE
+    RET;                                        // RET
+MP20:
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(3); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,3
+    if( fc ) goto MP35;                         // JR C,MP35
+    if( fsz == 0 ) goto MP30;                   // JR Z,MP30
+    ex_af();                                    // EX af,af'
+    if( fsz != 0 ) goto MP15;                   // JR NZ,MP15
+    a = mem[M2];                                // LD a,(M2)
+    { unsigned int v = (uint8_t)(91); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,91
+    if( !fc ) goto MP25;                        // JR NC,MP25
+    { unsigned int v = (uint8_t)(29); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,29
+    if( !fc ) goto MP26;                        // JR NC,MP26
+MP25:
+    set_HL( (uint16_t)(P2) );                   // LD hl,P2
+    mem[HL()] |= (1<<5);                        // SET 5,(hl)
+MP26:
+    CALL( ADMOVE );                             // CALL ADMOVE
+    iy++;                                       // INC iy
+    b--;                                        // DEC b
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    fsz = mem[HL()] & (1<<3); fpv = fsz == 0;   // BIT 3,(hl)
+    if( fsz == 0 ) goto MP10;                   // JR Z,MP10
+    goto MP15;                                  // JP MP15
+MP30:
+    ex_af();                                    // EX af,af'
+    if( fsz != 0 ) goto MP15;                   // JR NZ,MP15
+MP31:
+    CALL( ADMOVE );                             // CALL ADMOVE
+    goto MP15;                                  // JP MP15
+MP35:
+    ex_af();                                    // EX af,af'
+    if( fsz == 0 ) goto MP36;                   // JR Z,MP36
+    a = mem[M2];                                // LD a,(M2)
+    { unsigned int v = (uint8_t)(91); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,91
+    if( !fc ) goto MP37;                        // JR NC,MP37
+    { unsigned int v = (uint8_t)(29); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,29
+    if( !fc ) goto MP31;                        // JR NC,MP31
+MP37:
+    set_HL( (uint16_t)(P2) );                   // LD hl,P2
+    mem[HL()] |= (1<<5);                        // SET 5,(hl)
+    goto MP31;                                  // JR MP31
+MP36:
+    CALL( ENPSNT );                             // CALL ENPSNT
+    goto MP15;                                  // JP MP15
+}
+
+// ENPSNT, line 984
+static void ENPSNT()
+{
+    a = mem[M1];                                // LD a,(M1)
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    if( fsz == 0 ) goto rel002;                 // JR Z,rel002
+    { unsigned int v = (uint8_t)(10); unsigned int r = a + v; a = (uint8_t)r; } // ADD a,10
+rel002:
+    { unsigned int v = (uint8_t)(61); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,61
+    if( fc ) RET;                               // RET C
+    { unsigned int v = (uint8_t)(69); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,69
+    if( !fc ) RET;                              // RET NC
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    fsz = mem[(uint16_t)(ix+MLFLG)] & (1<<4); fpv = fsz == 0; // BIT 4,(ix+MLFLG)
+    if( fsz == 0 ) RET;                         // RET Z
+    a = mem[(uint16_t)(ix+MLTOP)];              // LD a,(ix+MLTOP)
+    mem[M4] = a;                                // LD (M4),a
+    ix = rd16(M4);                              // LD ix,(M4)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    mem[P3] = a;                                // LD (P3),a
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(PAWN); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,PAWN
+    if( fsz != 0 ) RET;                         // RET NZ
+    a = mem[M4];                                // LD a,(M4)
+    set_HL( (uint16_t)(M2) );                   // LD hl,M2
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; a = (uint8_t)r; fsz = a; } // SUB a,(hl)
+    if( (fsz&0x80) == 0 ) goto rel003;          // JP P,rel003
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+rel003:
+    { unsigned int v = (uint8_t)(10); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,10
+    if( fsz != 0 ) RET;                         // RET NZ
+    set_HL( (uint16_t)(P2) );                   // LD hl,P2
+    mem[HL()] |= (1<<6);                        // SET 6,(hl)
+    CALL( ADMOVE );                             // CALL ADMOVE
+    a = mem[M1];                                // LD a,(M1)
+    mem[M3] = a;                                // LD (M3),a
+    a = mem[M4];                                // LD a,(M4)
+    mem[M1] = a;                                // LD (M1),a
+    mem[M2] = a;                                // LD (M2),a
+    a = mem[P3];                                // LD a,(P3)
+    mem[P2] = a;                                // LD (P2),a
+    CALL( ADMOVE );                             // CALL ADMOVE
+    a = mem[M3];                                // LD a,(M3)
+    mem[M1] = a;                                // LD (M1),a
+    ADJPTR();                                 // falls through
+}
+
+// ADJPTR, line 1041
+static void ADJPTR()
+{
+    set_HL( rd16(MLLST) );                      // LD hl,(MLLST)
+    set_DE( (uint16_t)(-6) );                   // LD de,-6
+    { unsigned int r = HL() + DE(); fc = r > 0xffff; set_HL( (uint16_t)r ); } // ADD hl,de
+    wr16( MLLST, HL() );                        // LD (MLLST),hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    RET;                                        // RET
+}
+
+// CASTLE, line 1065
+static void CASTLE()
+{
+    a = mem[P1];                                // LD a,(P1)
+    fsz = a & (1<<3); fpv = fsz == 0;           // BIT 3,a
+    if( fsz != 0 ) RET;                         // RET NZ
+    a = mem[CKFLG];                             // LD a,(CKFLG)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz != 0 ) RET;                         // RET NZ
+    set_BC( (uint16_t)(0x0FF03) );              // LD bc,0FF03H
+CA5:
+    a = mem[M1];                                // LD a,(M1)
+    { unsigned int v = c; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,c
+    c = a;                                      // LD c,a
+    mem[M3] = a;                                // LD (M3),a
+    ix = rd16(M3);                              // LD ix,(M3)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    a &= (uint8_t)(0x7F);                       // AND a,7FH
+    { unsigned int v = (uint8_t)(ROOK); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,ROOK
+    if( fsz != 0 ) goto CA20;                   // JR NZ,CA20
+    a = c;                                      // LD a,c
+    goto CA15;                                  // JR CA15
+CA10:
+    ix = rd16(M3);                              // LD ix,(M3)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    fsz = a;                                    // AND a,a
+    if( fsz != 0 ) goto CA20;                   // JR NZ,CA20
+    a = mem[M3];                                // LD a,(M3)
+    { unsigned int v = (uint8_t)(22); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,22
+    if( fsz == 0 ) goto CA15;                   // JR Z,CA15
+    { unsigned int v = (uint8_t)(92); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,92
+    if( fsz == 0 ) goto CA15;                   // JR Z,CA15
+    CALL( ATTACK );                             // CALL ATTACK
+    fsz = a;                                    // AND a,a
+    if( fsz != 0 ) goto CA20;                   // JR NZ,CA20
+    a = mem[M3];                                // LD a,(M3)
+CA15:
+    { unsigned int v = b; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,b
+    mem[M3] = a;                                // LD (M3),a
+    set_HL( (uint16_t)(M1) );                   // LD hl,M1
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fsz != 0 ) goto CA10;                   // JR NZ,CA10
+    { unsigned int v = b; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,b
+    { unsigned int v = b; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // SUB a,b
+    mem[M2] = a;                                // LD (M2),a
+    set_HL( (uint16_t)(P2) );                   // LD hl,P2
+    mem[HL()] = (uint8_t)(0x40);                // LD (hl),40H
+    CALL( ADMOVE );                             // CALL ADMOVE
+    set_HL( (uint16_t)(M1) );                   // LD hl,M1
+    a = mem[HL()];                              // LD a,(hl)
+    mem[HL()] = c;                              // LD (hl),c
+    { unsigned int v = b; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,b
+    mem[M2] = a;                                // LD (M2),a
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    mem[P2] = a;                                // LD (P2),a
+    CALL( ADMOVE );                             // CALL ADMOVE
+    CALL( ADJPTR );                             // CALL ADJPTR
+    a = mem[M3];                                // LD a,(M3)
+    mem[M1] = a;                                // LD (M1),a
+CA20:
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( fsz == 0 ) RET;                         // RET Z
+    set_BC( (uint16_t)(0x01FC) );               // LD bc,01FCH
+    goto CA5;                                   // JP CA5
+}
+
+// ADMOVE, line 1137
+static void ADMOVE()
+{
+    set_DE( rd16(MLNXT) );                      // LD de,(MLNXT)
+    set_HL( (uint16_t)(MLEND) );                // LD hl,MLEND
+    fc = false;                                 // AND a,a
+    { unsigned int x = HL(), v = DE() + (fc?1:0); unsigned int r = x - v; fc = x < v; fpv = ((x^v)&(x^r)&0x8000) != 0; fsz = (r&0xffff)==0 ? 0 : (((r>>8)&0x80)|1); set_HL( (uint16_t)r ); } // SBC hl,de
+    if( fc ) goto AM10;                         // JR C,AM10
+    set_HL( rd16(MLLST) );                      // LD hl,(MLLST)
+    wr16( MLLST, DE() );                        // LD (MLLST),de
+    mem[HL()] = e;                              // LD (hl),e
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = d;                              // LD (hl),d
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    fsz = mem[HL()] & (1<<3); fpv = fsz == 0;   // BIT 3,(hl)
+    if( fsz != 0 ) goto rel004;                 // JR NZ,rel004
+    set_HL( (uint16_t)(P2) );                   // LD hl,P2
+    mem[HL()] |= (1<<4);                        // SET 4,(hl)
+rel004:
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[M1];                                // LD a,(M1)
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[M2];                                // LD a,(M2)
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[P2];                                // LD a,(P2)
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    wr16( MLNXT, HL() );                        // LD (MLNXT),hl
+    RET;                                        // RET
+AM10:
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    RET;                                        // RET
+}
+
+// GENMOV, line 1189
+static void GENMOV()
+{
+    CALL( INCHK );                              // CALL INCHK
+    mem[CKFLG] = a;                             // LD (CKFLG),a
+    set_DE( rd16(MLNXT) );                      // LD de,(MLNXT)
+    set_HL( rd16(MLPTRI) );                     // LD hl,(MLPTRI)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = e;                              // LD (hl),e
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = d;                              // LD (hl),d
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    wr16( MLPTRI, HL() );                       // LD (MLPTRI),hl
+    wr16( MLLST, HL() );                        // LD (MLLST),hl
+    a = (uint8_t)(21);                          // LD a,21
+GM5:
+    mem[M1] = a;                                // LD (M1),a
+    ix = rd16(M1);                              // LD ix,(M1)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto GM10;                   // JR Z,GM10
+    { unsigned int v = (uint8_t)(-1); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,-1
+    if( fsz == 0 ) goto GM10;                   // JR Z,GM10
+    mem[P1] = a;                                // LD (P1),a
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    a ^= mem[HL()]; fc = false;                 // XOR a,(hl)
+    fsz = a & (1<<7); fpv = fsz == 0;           // BIT 7,a
+    if( fsz == 0 ) CALL( MPIECE );              // CALL Z,MPIECE
+GM10:
+    a = mem[M1];                                // LD a,(M1)
+    a++;                                        // INC a
+    { unsigned int v = (uint8_t)(99); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,99
+    if( fsz != 0 ) goto GM5;                    // JP NZ,GM5
+    RET;                                        // RET
+}
+
+// INCHK, line 1234
+static void INCHK()
+{
+    a = mem[COLOR];                             // LD a,(COLOR)
+    INCHK1();                                 // falls through
+}
+
+// INCHK1, line 1235
+static void INCHK1()
+{
+    set_HL( (uint16_t)(POSK) );                 // LD hl,POSK
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto rel005;                 // JR Z,rel005
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+rel005:
+    a = mem[HL()];                              // LD a,(hl)
+    mem[M3] = a;                                // LD (M3),a
+    ix = rd16(M3);                              // LD ix,(M3)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    mem[P1] = a;                                // LD (P1),a
+    a &= (uint8_t)(7); fsz = a; fc = false; fpv = parity(a); // AND a,7
+    mem[T1] = a;                                // LD (T1),a
+    CALL( ATTACK );                             // CALL ATTACK
+    RET;                                        // RET
+}
+
+// ATTACK, line 1284
+static void ATTACK()
+{
+    push( BC() );                               // PUSH bc
+    a = 0; fc = false;                          // XOR a,a
+    b = (uint8_t)(16);                          // LD b,16
+    mem[INDX2] = a;                             // LD (INDX2),a
+    iy = rd16(INDX2);                           // LD iy,(INDX2)
+AT5:
+    c = mem[(uint16_t)(iy+DIRECT)];             // LD c,(iy+DIRECT)
+    d = (uint8_t)(0);                           // LD d,0
+    a = mem[M3];                                // LD a,(M3)
+    mem[M2] = a;                                // LD (M2),a
+AT10:
+    { uint8_t r = ++d; fsz = r; fpv = r == 0x80; } // INC d
+    CALL( PATH );                               // CALL PATH
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,1
+    if( fsz == 0 ) goto AT14A;                  // JR Z,AT14A
+    { unsigned int v = (uint8_t)(2); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,2
+    if( fsz == 0 ) goto AT14B;                  // JR Z,AT14B
+    fsz = a; fc = false;                        // AND a,a
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(9); fc = a < v; } // CP a,9
+    if( !fc ) goto AT10;                        // JR NC,AT10
+AT12:
+    iy++;                                       // INC iy
+    if( --b != 0 ) goto AT5;                    // DJNZ AT5
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+AT13:
+    set_BC( pop() );                            // POP bc
+    RET;                                        // RET
+AT14A:
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    d |= (1<<5);                                // SET 5,d
+    goto AT14;                                  // JP AT14
+AT14B:
+    fsz = d & (1<<5);                           // BIT 5,d
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    d |= (1<<6);                                // SET 6,d
+AT14:
+    a = mem[T2];                                // LD a,(T2)
+    e = a;                                      // LD e,a
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(9); fc = a < v; } // CP a,9
+    if( fc ) goto AT25;                         // JR C,AT25
+    a = e;                                      // LD a,e
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz != 0 ) goto AT15;                   // JR NZ,AT15
+    d |= (1<<7);                                // SET 7,d
+    goto AT30;                                  // JR AT30
+AT15:
+    a = d;                                      // LD a,d
+    a &= (uint8_t)(0x0F);                       // AND a,0FH
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,1
+    if( fsz != 0 ) goto AT16;                   // JR NZ,AT16
+    a = e;                                      // LD a,e
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto AT30;                   // JR Z,AT30
+AT16:
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(13); fc = a < v; } // CP a,13
+    if( fc ) goto AT21;                         // JR C,AT21
+    a = e;                                      // LD a,e
+    { unsigned int v = (uint8_t)(BISHOP); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,BISHOP
+    if( fsz == 0 ) goto AT30;                   // JR Z,AT30
+    a = d;                                      // LD a,d
+    a &= (uint8_t)(0x0F);                       // AND a,0FH
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,1
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    { unsigned int v = e; unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,e
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    a = mem[P2];                                // LD a,(P2)
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto AT20;                   // JR Z,AT20
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(15); fc = a < v; } // CP a,15
+    if( fc ) goto AT12;                         // JR C,AT12
+    goto AT30;                                  // JR AT30
+AT20:
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(15); fc = a < v; } // CP a,15
+    if( !fc ) goto AT12;                        // JR NC,AT12
+    goto AT30;                                  // JR AT30
+AT21:
+    a = e;                                      // LD a,e
+    { unsigned int v = (uint8_t)(ROOK); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,ROOK
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+    goto AT30;                                  // JR AT30
+AT25:
+    a = e;                                      // LD a,e
+    { unsigned int v = (uint8_t)(KNIGHT); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,KNIGHT
+    if( fsz != 0 ) goto AT12;                   // JR NZ,AT12
+AT30:
+    a = mem[T1];                                // LD a,(T1)
+    { unsigned int v = (uint8_t)(7); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,7
+    if( fsz == 0 ) goto AT31;                   // JR Z,AT31
+    fsz = d & (1<<5); fpv = fsz == 0;           // BIT 5,d
+    if( fsz == 0 ) goto AT32;                   // JR Z,AT32
+    a = (uint8_t)(1);                           // LD a,1
+    goto AT13;                                  // JP AT13
+AT31:
+    CALL( ATKSAV );                             // CALL ATKSAV
+AT32:
+    a = mem[T2];                                // LD a,(T2)
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto AT12;                   // JP Z,AT12
+    { unsigned int v = (uint8_t)(KNIGHT); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,KNIGHT
+    if( fsz == 0 ) goto AT12;                   // JP Z,AT12
+    goto AT10;                                  // JP AT10
+}
+
+// ATKSAV, line 1398
+static void ATKSAV()
+{
+    push( BC() );                               // PUSH bc
+    push( DE() );                               // PUSH de
+    a = mem[NPINS];                             // LD a,(NPINS)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz != 0 ) CALL( PNCK );                // CALL NZ,PNCK
+    ix = rd16(T2);                              // LD ix,(T2)
+    set_HL( (uint16_t)(ATKLST) );               // LD hl,ATKLST
+    set_BC( (uint16_t)(0) );                    // LD bc,0
+    a = mem[P2];                                // LD a,(P2)
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto rel006;                 // JR Z,rel006
+    c = (uint8_t)(7);                           // LD c,7
+rel006:
+    a &= (uint8_t)(7);                          // AND a,7
+    e = a;                                      // LD e,a
+    fsz = d & (1<<7);                           // BIT 7,d
+    if( fsz == 0 ) goto rel007;                 // JR Z,rel007
+    e = (uint8_t)(QUEEN);                       // LD e,QUEEN
+rel007:
+    { unsigned int r = HL() + BC(); set_HL( (uint16_t)r ); } // ADD hl,bc
+    mem[HL()]++;                                // INC (hl)
+    d = (uint8_t)(0);                           // LD d,0
+    { unsigned int r = HL() + DE(); set_HL( (uint16_t)r ); } // ADD hl,de
+    a = mem[HL()];                              // LD a,(hl)
+    a &= (uint8_t)(0x0F); fsz = a; fc = false;  // AND a,0FH
+    if( fsz == 0 ) goto AS20;                   // JR Z,AS20
+    a = mem[HL()];                              // LD a,(hl)
+    a &= (uint8_t)(0x0F0); fsz = a; fc = false; // AND a,0F0H
+    if( fsz == 0 ) goto AS19;                   // JR Z,AS19
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    goto AS20;                                  // JR AS20
+AS19:
+    { uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((m<<4)|(a&0x0f)); a = (uint8_t)((a&0xf0)|(m>>4)); } // RLD
+    a = mem[(uint16_t)(ix+PVALUE)];             // LD a,(ix+PVALUE)
+    { uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((a<<4)|(m>>4)); a = (uint8_t)((a&0xf0)|(m&0x0f)); fsz = a; fpv = parity(a); } // RRD
+    goto AS25;                                  // JR AS25
+AS20:
+    a = mem[(uint16_t)(ix+PVALUE)];             // LD a,(ix+PVALUE)
+    { uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((m<<4)|(a&0x0f)); a = (uint8_t)((a&0xf0)|(m>>4)); fsz = a; fpv = parity(a); } // RLD
+AS25:
+    set_DE( pop() );                            // POP de
+    set_BC( pop() );                            // POP bc
+    RET;                                        // RET
+}
+
+// PNCK, line 1456
+static void PNCK()
+{
+    d = c;                                      // LD d,c
+    e = (uint8_t)(0);                           // LD e,0
+    c = a;                                      // LD c,a
+    b = (uint8_t)(0);                           // LD b,0
+    a = mem[M2];                                // LD a,(M2)
+    set_HL( (uint16_t)(PLISTA) );               // LD hl,PLISTA
+PC1:
+    { uint16_t x = HL(), n = BC(); uint8_t v; do { v = mem[x++]; n--; } while( n!=0 && v!=a ); set_HL(x); set_BC(n); fsz = (uint8_t)(a-v); fpv = n != 0; } // CPIR
+    if( fsz != 0 ) RET;                         // RET NZ
+    ex_af();                                    // EX af,af'
+    fsz = e & (1<<0);                           // BIT 0,e
+    if( fsz != 0 ) goto PC5;                    // JR NZ,PC5
+    e |= (1<<0);                                // SET 0,e
+    push( HL() );                               // PUSH hl
+    ix = pop();                                 // POP ix
+    a = mem[(uint16_t)(ix+9)];                  // LD a,(ix+9)
+    { unsigned int v = d; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,d
+    if( fsz == 0 ) goto PC3;                    // JR Z,PC3
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+    { unsigned int v = d; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,d
+    if( fsz != 0 ) goto PC5;                    // JR NZ,PC5
+PC3:
+    ex_af();                                    // EX af,af'
+    if( fpv ) goto PC1;                         // JP PE,PC1
+    RET;                                        // RET
+PC5:
+    { uint16_t w = pop(); a = (uint8_t)(w>>8); set_F( (uint8_t)w ); } // POP af
+    set_DE( pop() );                            // POP de
+    set_BC( pop() );                            // POP bc
+    RET;                                        // RET
+}
+
+// PINFND, line 1499
+static void PINFND()
+{
+    a = 0;                                      // XOR a,a
+    mem[NPINS] = a;                             // LD (NPINS),a
+    set_DE( (uint16_t)(POSK) );                 // LD de,POSK
+PF1:
+    a = mem[DE()];                              // LD a,(de)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto PF26;                   // JP Z,PF26
+    { unsigned int v = (uint8_t)(-1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,-1
+    if( fsz == 0 ) RET;                         // RET Z
+    mem[M3] = a;                                // LD (M3),a
+    ix = rd16(M3);                              // LD ix,(M3)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    mem[P1] = a;                                // LD (P1),a
+    b = (uint8_t)(8);                           // LD b,8
+    a = 0;                                      // XOR a,a
+    mem[INDX2] = a;                             // LD (INDX2),a
+    iy = rd16(INDX2);                           // LD iy,(INDX2)
+PF2:
+    a = mem[M3];                                // LD a,(M3)
+    mem[M2] = a;                                // LD (M2),a
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    mem[M4] = a;                                // LD (M4),a
+    c = mem[(uint16_t)(iy+DIRECT)];             // LD c,(iy+DIRECT)
+PF5:
+    CALL( PATH );                               // CALL PATH
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto PF5;                    // JR Z,PF5
+    { unsigned int v = (uint8_t)(3); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,3
+    if( fsz == 0 ) goto PF25;                   // JP Z,PF25
+    { unsigned int v = (uint8_t)(2); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,2
+    a = mem[M4];                                // LD a,(M4)
+    if( fsz == 0 ) goto PF15;                   // JR Z,PF15
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto PF25;                   // JP Z,PF25
+    a = mem[T2];                                // LD a,(T2)
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz == 0 ) goto PF19;                   // JP Z,PF19
+    l = a;                                      // LD l,a
+    a = b;                                      // LD a,b
+    { unsigned int v = (uint8_t)(5); fc = a < v; } // CP a,5
+    if( fc ) goto PF10;                         // JR C,PF10
+    a = l;                                      // LD a,l
+    { unsigned int v = (uint8_t)(BISHOP); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,BISHOP
+    if( fsz != 0 ) goto PF25;                   // JP NZ,PF25
+    goto PF20;                                  // JP PF20
+PF10:
+    a = l;                                      // LD a,l
+    { unsigned int v = (uint8_t)(ROOK); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,ROOK
+    if( fsz != 0 ) goto PF25;                   // JP NZ,PF25
+    goto PF20;                                  // JP PF20
+PF15:
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz != 0 ) goto PF25;                   // JP NZ,PF25
+    a = mem[M2];                                // LD a,(M2)
+    mem[M4] = a;                                // LD (M4),a
+    goto PF5;                                   // JP PF5
+PF19:
+    a = mem[P1];                                // LD a,(P1)
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz != 0 ) goto PF20;                   // JR NZ,PF20
+    push( BC() );                               // PUSH bc
+    push( DE() );                               // PUSH de
+    push( iy );                                 // PUSH iy
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    b = (uint8_t)(14);                          // LD b,14
+    set_HL( (uint16_t)(ATKLST) );               // LD hl,ATKLST
+back02:
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    if( --b != 0 ) goto back02;                 // DJNZ back02
+    a = (uint8_t)(7);                           // LD a,7
+    mem[T1] = a;                                // LD (T1),a
+    CALL( ATTACK );                             // CALL ATTACK
+    set_HL( (uint16_t)(WACT) );                 // LD hl,WACT
+    set_DE( (uint16_t)(BACT) );                 // LD de,BACT
+    a = mem[P1];                                // LD a,(P1)
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto rel008;                 // JR Z,rel008
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+rel008:
+    a = mem[HL()];                              // LD a,(hl)
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,(hl)
+    { uint8_t r = --a; fsz = r; }               // DEC a
+    iy = pop();                                 // POP iy
+    set_DE( pop() );                            // POP de
+    set_BC( pop() );                            // POP bc
+    if( (fsz&0x80) == 0 ) goto PF25;            // JP P,PF25
+PF20:
+    set_HL( (uint16_t)(NPINS) );                // LD hl,NPINS
+    mem[HL()]++;                                // INC (hl)
+    ix = rd16(NPINS);                           // LD ix,(NPINS)
+    mem[(uint16_t)(ix+PLISTD)] = c;             // LD (ix+PLISTD),c
+    a = mem[M4];                                // LD a,(M4)
+    mem[(uint16_t)(ix+PLIST)] = a;              // LD (ix+PLIST),a
+PF25:
+    iy++;                                       // INC iy
+    if( --b != 0 ) goto PF27;                   // DJNZ PF27
+PF26:
+    set_DE( (uint16_t)(DE()+1) );               // INC de
+    goto PF1;                                   // JP PF1
+PF27:
+    goto PF2;                                   // JP PF2
+}
+
+// XCHNG, line 1605
+static void XCHNG()
+{
+    exx();                                      // EXX
+    a = mem[P1];                                // LD a,(P1)
+    set_HL( (uint16_t)(WACT) );                 // LD hl,WACT
+    set_DE( (uint16_t)(BACT) );                 // LD de,BACT
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto rel009;                 // JR Z,rel009
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+rel009:
+    b = mem[HL()];                              // LD b,(hl)
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    c = mem[HL()];                              // LD c,(hl)
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    exx();                                      // EXX
+    c = (uint8_t)(0);                           // LD c,0
+    e = (uint8_t)(0);                           // LD e,0
+    ix = rd16(T3);                              // LD ix,(T3)
+    d = mem[(uint16_t)(ix+PVALUE)];             // LD d,(ix+PVALUE)
+    { uint8_t v = d; d = (uint8_t)(v<<1); fc = (v&0x80) != 0; fsz = d; fpv = parity(d); } // SLA d
+    b = d;                                      // LD b,d
+    CALL( NEXTAD );                             // CALL NEXTAD
+    if( fsz == 0 ) RET;                         // RET Z
+XC10:
+    l = a;                                      // LD l,a
+    CALL( NEXTAD );                             // CALL NEXTAD
+    if( fsz == 0 ) goto XC18;                   // JR Z,XC18
+    ex_af();                                    // EX af,af'
+    a = b;                                      // LD a,b
+    { unsigned int v = l; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,l
+    if( !fc ) goto XC19;                        // JR NC,XC19
+    ex_af();                                    // EX af,af'
+XC15:
+    { unsigned int v = l; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,l
+    if( fc ) RET;                               // RET C
+    CALL( NEXTAD );                             // CALL NEXTAD
+    if( fsz == 0 ) RET;                         // RET Z
+    l = a;                                      // LD l,a
+    CALL( NEXTAD );                             // CALL NEXTAD
+    if( fsz != 0 ) goto XC15;                   // JR NZ,XC15
+XC18:
+    ex_af();                                    // EX af,af'
+    a = b;                                      // LD a,b
+XC19:
+    fsz = c & (1<<0);                           // BIT 0,c
+    if( fsz == 0 ) goto rel010;                 // JR Z,rel010
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+rel010:
+    { unsigned int v = e; unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,e
+    e = a;                                      // LD e,a
+    ex_af();                                    // EX af,af'
+    if( fsz == 0 ) RET;                         // RET Z
+    b = l;                                      // LD b,l
+    goto XC10;                                  // JP XC10
+}
+
+// NEXTAD, line 1667
+static void NEXTAD()
+{
+    c++;                                        // INC c
+    exx();                                      // EXX
+    a = b;                                      // LD a,b
+    b = c;                                      // LD b,c
+    c = a;                                      // LD c,a
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    a = 0;                                      // XOR a,a
+    { unsigned int v = b; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,b
+    if( fsz == 0 ) goto NX6;                    // JR Z,NX6
+    b--;                                        // DEC b
+back03:
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fsz == 0 ) goto back03;                 // JR Z,back03
+    { uint8_t m = mem[HL()]; mem[HL()] = (uint8_t)((a<<4)|(m>>4)); a = (uint8_t)((a&0xf0)|(m&0x0f)); } // RRD
+    { unsigned int v = a; unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,a
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+NX6:
+    exx();                                      // EXX
+    RET;                                        // RET
+}
+
+// POINTS, line 1737
+static void POINTS()
+{
+    a = 0; fpv = parity(a);                     // XOR a,a
+    fsz = (uint8_t)(sargon_native_points - 0); fc = (uint8_t)sargon_native_points < (uint8_t)0; // CMP _sargon_native_points,0
+    if( fsz != 0 ) goto PTNAT;                  // JNZ PTNAT
+    mem[MTRL] = a;                              // LD (MTRL),a
+    mem[BRDC] = a;                              // LD (BRDC),a
+    mem[PTSL] = a;                              // LD (PTSL),a
+    mem[PTSW1] = a;                             // LD (PTSW1),a
+    mem[PTSW2] = a;                             // LD (PTSW2),a
+    mem[PTSCK] = a;                             // LD (PTSCK),a
+    set_HL( (uint16_t)(T1) );                   // LD hl,T1
+    mem[HL()] = (uint8_t)(7);                   // LD (hl),7
+    a = (uint8_t)(21);                          // LD a,21
+PT5:
+    mem[M3] = a;                                // LD (M3),a
+    ix = rd16(M3);                              // LD ix,(M3)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    { unsigned int v = (uint8_t)(-1); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,-1
+    if( fsz == 0 ) goto PT25;                   // JP Z,PT25
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    mem[HL()] = a;                              // LD (hl),a
+    a &= (uint8_t)(7);                          // AND a,7
+    mem[T3] = a;                                // LD (T3),a
+    { unsigned int v = (uint8_t)(KNIGHT); fc = a < v; } // CP a,KNIGHT
+    if( fc ) goto PT6X;                         // JR C,PT6X
+    { unsigned int v = (uint8_t)(ROOK); fc = a < v; } // CP a,ROOK
+    if( fc ) goto PT6B;                         // JR C,PT6B
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto PT6AA;                  // JR Z,PT6AA
+    a = mem[MOVENO];                            // LD a,(MOVENO)
+    { unsigned int v = (uint8_t)(7); fc = a < v; } // CP a,7
+    if( fc ) goto PT6A;                         // JR C,PT6A
+    goto PT6X;                                  // JP PT6X
+PT6AA:
+    fsz = mem[HL()] & (1<<4);                   // BIT 4,(hl)
+    if( fsz == 0 ) goto PT6A;                   // JR Z,PT6A
+    a = (uint8_t)(+6);                          // LD a,+6
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    if( fsz == 0 ) goto PT6D;                   // JR Z,PT6D
+    a = (uint8_t)(-6);                          // LD a,-6
+    goto PT6D;                                  // JP PT6D
+PT6A:
+    fsz = mem[HL()] & (1<<3);                   // BIT 3,(hl)
+    if( fsz == 0 ) goto PT6X;                   // JR Z,PT6X
+    goto PT6C;                                  // JP PT6C
+PT6B:
+    fsz = mem[HL()] & (1<<3);                   // BIT 3,(hl)
+    if( fsz != 0 ) goto PT6X;                   // JR NZ,PT6X
+PT6C:
+    a = (uint8_t)(-2);                          // LD a,-2
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    if( fsz == 0 ) goto PT6D;                   // JR Z,PT6D
+    a = (uint8_t)(+2);                          // LD a,+2
+PT6D:
+    set_HL( (uint16_t)(BRDC) );                 // LD hl,BRDC
+    { unsigned int v = mem[HL()]; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,(hl)
+    mem[HL()] = a;                              // LD (hl),a
+PT6X:
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    b = (uint8_t)(14);                          // LD b,14
+    set_HL( (uint16_t)(ATKLST) );               // LD hl,ATKLST
+back04:
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    if( --b != 0 ) goto back04;                 // DJNZ back04
+    CALL( ATTACK );                             // CALL ATTACK
+    set_HL( (uint16_t)(BACT) );                 // LD hl,BACT
+    a = mem[WACT];                              // LD a,(WACT)
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,(hl)
+    set_HL( (uint16_t)(BRDC) );                 // LD hl,BRDC
+    { unsigned int v = mem[HL()]; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,(hl)
+    mem[HL()] = a;                              // LD (hl),a
+    a = mem[P1];                                // LD a,(P1)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto PT25;                   // JP Z,PT25
+    CALL( XCHNG );                              // CALL XCHNG
+    a = 0;                                      // XOR a,a
+    { unsigned int v = e; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,e
+    if( fsz == 0 ) goto PT23;                   // JR Z,PT23
+    d--;                                        // DEC d
+    a = mem[P1];                                // LD a,(P1)
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    a ^= mem[HL()];                             // XOR a,(hl)
+    fsz = a & (1<<7);                           // BIT 7,a
+    a = e;                                      // LD a,e
+    if( fsz != 0 ) goto PT20;                   // JR NZ,PT20
+    set_HL( (uint16_t)(PTSL) );                 // LD hl,PTSL
+    { unsigned int v = mem[HL()]; fc = a < v; } // CP a,(hl)
+    if( fc ) goto PT23;                         // JR C,PT23
+    mem[HL()] = e;                              // LD (hl),e
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    a = mem[M3];                                // LD a,(M3)
+    { unsigned int v = mem[(uint16_t)(ix+MLTOP)]; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,(ix+MLTOP)
+    if( fsz != 0 ) goto PT23;                   // JR NZ,PT23
+    mem[PTSCK] = a;                             // LD (PTSCK),a
+    goto PT23;                                  // JP PT23
+PT20:
+    set_HL( (uint16_t)(PTSW1) );                // LD hl,PTSW1
+    { unsigned int v = mem[HL()]; fc = a < v; } // CP a,(hl)
+    if( fc ) goto rel011;                       // JR C,rel011
+    a = mem[HL()];                              // LD a,(hl)
+    mem[HL()] = e;                              // LD (hl),e
+rel011:
+    set_HL( (uint16_t)(PTSW2) );                // LD hl,PTSW2
+    { unsigned int v = mem[HL()]; fc = a < v; } // CP a,(hl)
+    if( fc ) goto PT23;                         // JR C,PT23
+    mem[HL()] = a;                              // LD (hl),a
+PT23:
+    set_HL( (uint16_t)(P1) );                   // LD hl,P1
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    a = d;                                      // LD a,d
+    if( fsz == 0 ) goto rel012;                 // JR Z,rel012
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+rel012:
+    set_HL( (uint16_t)(MTRL) );                 // LD hl,MTRL
+    { unsigned int v = mem[HL()]; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,(hl)
+    mem[HL()] = a;                              // LD (hl),a
+PT25:
+    a = mem[M3];                                // LD a,(M3)
+    a++;                                        // INC a
+    { unsigned int v = (uint8_t)(99); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,99
+    if( fsz != 0 ) goto PT5;                    // JP NZ,PT5
+    a = mem[PTSCK];                             // LD a,(PTSCK)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto PT25A;                  // JR Z,PT25A
+    a = mem[PTSW2];                             // LD a,(PTSW2)
+    mem[PTSW1] = a;                             // LD (PTSW1),a
+    a = 0;                                      // XOR a,a
+    mem[PTSW2] = a;                             // LD (PTSW2),a
+PT25A:
+    a = mem[PTSL];                              // LD a,(PTSL)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto rel013;                 // JR Z,rel013
+    a--;                                        // DEC a
+rel013:
+    b = a;                                      // LD b,a
+    a = mem[PTSW1];                             // LD a,(PTSW1)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto rel014;                 // JR Z,rel014
+    a = mem[PTSW2];                             // LD a,(PTSW2)
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto rel014;                 // JR Z,rel014
+    a--;                                        // DEC a
+    { uint8_t v = a; a = (uint8_t)(v>>1); }     // SRL a
+rel014:
+    { unsigned int v = b; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,b
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    if( fsz == 0 ) goto rel015;                 // JR Z,rel015
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+rel015:
+    set_HL( (uint16_t)(MTRL) );                 // LD hl,MTRL
+    { unsigned int v = mem[HL()]; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,(hl)
+    set_HL( (uint16_t)(MV0) );                  // LD hl,MV0
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // SUB a,(hl)
+    b = a;                                      // LD b,a
+    a = (uint8_t)(30);                          // LD a,30
+    CALL( LIMIT );                              // CALL LIMIT
+    e = a;                                      // LD e,a
+    a = mem[BRDC];                              // LD a,(BRDC)
+    set_HL( (uint16_t)(BC0) );                  // LD hl,BC0
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,(hl)
+    b = a;                                      // LD b,a
+    a = mem[PTSCK];                             // LD a,(PTSCK)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto rel026;                 // JR Z,rel026
+    b = (uint8_t)(0);                           // LD b,0
+rel026:
+    a = (uint8_t)(6);                           // LD a,6
+    CALL( LIMIT );                              // CALL LIMIT
+    d = a;                                      // LD d,a
+    a = e;                                      // LD a,e
+    { unsigned int v = a; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,a
+    { unsigned int v = a; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,a
+    { unsigned int v = d; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,d
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    fsz = mem[HL()] & (1<<7);                   // BIT 7,(hl)
+    if( fsz != 0 ) goto rel016;                 // JR NZ,rel016
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+rel016:
+    { unsigned int v = (uint8_t)(0x80); unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,80H
+    goto PTEND;                                 // JMP PTEND
+PTNAT:
+    do_callback( "native POINTS()" );           // CALLBACK "native POINTS()"
+PTEND:
+    do_callback( "end of POINTS()" );           // CALLBACK "end of POINTS()"
+    mem[VALM] = a;                              // LD (VALM),a
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    mem[(uint16_t)(ix+MLVAL)] = a;              // LD (ix+MLVAL),a
+    RET;                                        // RET
+}
+
+// LIMIT, line 1926
+static void LIMIT()
+{
+    fsz = b & (1<<7);                           // BIT 7,b
+    if( fsz == 0 ) goto LIM10;                  // JP Z,LIM10
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+    { unsigned int v = b; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,b
+    if( !fc ) RET;                              // RET NC
+    a = b;                                      // LD a,b
+    RET;                                        // RET
+LIM10:
+    { unsigned int v = b; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,b
+    if( fc ) RET;                               // RET C
+    a = b;                                      // LD a,b
+    RET;                                        // RET
+}
+
+// MOVE, line 1954
+static void MOVE()
+{
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+MV1:
+    a = mem[HL()];                              // LD a,(hl)
+    mem[M1] = a;                                // LD (M1),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[HL()];                              // LD a,(hl)
+    mem[M2] = a;                                // LD (M2),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    d = mem[HL()];                              // LD d,(hl)
+    ix = rd16(M1);                              // LD ix,(M1)
+    e = mem[(uint16_t)(ix+BOARD)];              // LD e,(ix+BOARD)
+    fsz = d & (1<<5);                           // BIT 5,d
+    if( fsz != 0 ) goto MV15;                   // JR NZ,MV15
+    a = e;                                      // LD a,e
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz == 0 ) goto MV20;                   // JR Z,MV20
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto MV30;                   // JR Z,MV30
+MV5:
+    iy = rd16(M2);                              // LD iy,(M2)
+    e |= (1<<3);                                // SET 3,e
+    mem[(uint16_t)(iy+BOARD)] = e;              // LD (iy+BOARD),e
+    mem[(uint16_t)(ix+BOARD)] = (uint8_t)(0);   // LD (ix+BOARD),0
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz != 0 ) goto MV40;                   // JR NZ,MV40
+    a = d;                                      // LD a,d
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz != 0 ) RET;                         // RET NZ
+    set_HL( (uint16_t)(POSQ) );                 // LD hl,POSQ
+    fsz = d & (1<<7);                           // BIT 7,d
+    if( fsz == 0 ) goto MV10;                   // JR Z,MV10
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+MV10:
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    mem[HL()] = a;                              // LD (hl),a
+    RET;                                        // RET
+MV15:
+    e |= (1<<2);                                // SET 2,e
+    goto MV5;                                   // JP MV5
+MV20:
+    set_HL( (uint16_t)(POSQ) );                 // LD hl,POSQ
+MV21:
+    fsz = e & (1<<7);                           // BIT 7,e
+    if( fsz == 0 ) goto MV22;                   // JR Z,MV22
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+MV22:
+    a = mem[M2];                                // LD a,(M2)
+    mem[HL()] = a;                              // LD (hl),a
+    goto MV5;                                   // JP MV5
+MV30:
+    set_HL( (uint16_t)(POSK) );                 // LD hl,POSK
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz == 0 ) goto MV21;                   // JR Z,MV21
+    e |= (1<<4);                                // SET 4,e
+    goto MV21;                                  // JP MV21
+MV40:
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    set_DE( (uint16_t)(8) );                    // LD de,8
+    { unsigned int r = HL() + DE(); set_HL( (uint16_t)r ); } // ADD hl,de
+    goto MV1;                                   // JP MV1
+}
+
+// UNMOVE, line 2026
+static void UNMOVE()
+{
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+UM1:
+    a = mem[HL()];                              // LD a,(hl)
+    mem[M1] = a;                                // LD (M1),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[HL()];                              // LD a,(hl)
+    mem[M2] = a;                                // LD (M2),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    d = mem[HL()];                              // LD d,(hl)
+    ix = rd16(M2);                              // LD ix,(M2)
+    e = mem[(uint16_t)(ix+BOARD)];              // LD e,(ix+BOARD)
+    fsz = d & (1<<5);                           // BIT 5,d
+    if( fsz != 0 ) goto UM15;                   // JR NZ,UM15
+    a = e;                                      // LD a,e
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz == 0 ) goto UM20;                   // JR Z,UM20
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto UM30;                   // JR Z,UM30
+UM5:
+    fsz = d & (1<<4);                           // BIT 4,d
+    if( fsz != 0 ) goto UM16;                   // JR NZ,UM16
+UM6:
+    iy = rd16(M1);                              // LD iy,(M1)
+    mem[(uint16_t)(iy+BOARD)] = e;              // LD (iy+BOARD),e
+    a = d;                                      // LD a,d
+    a &= (uint8_t)(0x8F);                       // AND a,8FH
+    mem[(uint16_t)(ix+BOARD)] = a;              // LD (ix+BOARD),a
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz != 0 ) goto UM40;                   // JR NZ,UM40
+    a = d;                                      // LD a,d
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz != 0 ) RET;                         // RET NZ
+    set_HL( (uint16_t)(POSQ) );                 // LD hl,POSQ
+    fsz = d & (1<<7); fpv = fsz == 0;           // BIT 7,d
+    if( fsz == 0 ) goto UM10;                   // JR Z,UM10
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+UM10:
+    a = mem[M2];                                // LD a,(M2)
+    mem[HL()] = a;                              // LD (hl),a
+    RET;                                        // RET
+UM15:
+    e &= ~(1<<2);                               // RES 2,e
+    goto UM5;                                   // JP UM5
+UM16:
+    e &= ~(1<<3);                               // RES 3,e
+    goto UM6;                                   // JP UM6
+UM20:
+    set_HL( (uint16_t)(POSQ) );                 // LD hl,POSQ
+UM21:
+    fsz = e & (1<<7);                           // BIT 7,e
+    if( fsz == 0 ) goto UM22;                   // JR Z,UM22
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+UM22:
+    a = mem[M1];                                // LD a,(M1)
+    mem[HL()] = a;                              // LD (hl),a
+    goto UM5;                                   // JP UM5
+UM30:
+    set_HL( (uint16_t)(POSK) );                 // LD hl,POSK
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz == 0 ) goto UM21;                   // JR Z,UM21
+    e &= ~(1<<4);                               // RES 4,e
+    goto UM21;                                  // JP UM21
+UM40:
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    set_DE( (uint16_t)(8) );                    // LD de,8
+    { unsigned int r = HL() + DE(); set_HL( (uint16_t)r ); } // ADD hl,de
+    goto UM1;                                   // JP UM1
+}
+
+// SORTM, line 2099
+static void SORTM()
+{
+    set_BC( rd16(MLPTRI) );                     // LD bc,(MLPTRI)
+    set_DE( (uint16_t)(0) );                    // LD de,0
+SR5:
+    h = b;                                      // LD h,b
+    l = c;                                      // LD l,c
+    c = mem[HL()];                              // LD c,(hl)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    b = mem[HL()];                              // LD b,(hl)
+    mem[HL()] = d;                              // LD (hl),d
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    mem[HL()] = e;                              // LD (hl),e
+    a = 0;                                      // XOR a,a
+    { unsigned int v = b; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,b
+    if( fsz == 0 ) RET;                         // RET Z
+    wr16( MLPTRJ, BC() );                       // LD (MLPTRJ),bc
+    CALL( EVAL );                               // CALL EVAL
+    set_HL( rd16(MLPTRI) );                     // LD hl,(MLPTRI)
+    set_BC( rd16(MLPTRJ) );                     // LD bc,(MLPTRJ)
+SR15:
+    e = mem[HL()];                              // LD e,(hl)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    d = mem[HL()];                              // LD d,(hl)
+    a = 0;                                      // XOR a,a
+    { unsigned int v = d; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,d
+    if( fsz == 0 ) goto SR25;                   // JR Z,SR25
+    push( DE() );                               // PUSH de
+    ix = pop();                                 // POP ix
+    a = mem[VALM];                              // LD a,(VALM)
+    { unsigned int v = mem[(uint16_t)(ix+MLVAL)]; fc = a < v; } // CP a,(ix+MLVAL)
+    if( !fc ) goto SR30;                        // JR NC,SR30
+SR25:
+    mem[HL()] = b;                              // LD (hl),b
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    mem[HL()] = c;                              // LD (hl),c
+    goto SR5;                                   // JP SR5
+SR30:
+    { uint8_t t = d; d = h; h = t; t = e; e = l; l = t; } // EX de,hl
+    goto SR15;                                  // JP SR15
+}
+
+// EVAL, line 2152
+static void EVAL()
+{
+    CALL( MOVE );                               // CALL MOVE
+    CALL( INCHK );                              // CALL INCHK
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto EV5;                    // JR Z,EV5
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    mem[VALM] = a;                              // LD (VALM),a
+    goto EV10;                                  // JP EV10
+EV5:
+    CALL( PINFND );                             // CALL PINFND
+    CALL( POINTS );                             // CALL POINTS
+EV10:
+    CALL( UNMOVE );                             // CALL UNMOVE
+    RET;                                        // RET
+}
+
+// FNDMOV, line 2182
+static void FNDMOV()
+{
+    a = mem[MOVENO];                            // LD a,(MOVENO)
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( fsz == 0 ) CALL( BOOK );                // CALL Z,BOOK
+    a = 0;                                      // XOR a,a
+    mem[NPLY] = a;                              // LD (NPLY),a
+    set_HL( (uint16_t)(0) );                    // LD hl,0
+    wr16( BESTM, HL() );                        // LD (BESTM),hl
+    set_HL( (uint16_t)(MLIST) );                // LD hl,MLIST
+    wr16( MLNXT, HL() );                        // LD (MLNXT),hl
+    set_HL( (uint16_t)(PLYIX-2) );              // LD hl,PLYIX-2
+    wr16( MLPTRI, HL() );                       // LD (MLPTRI),hl
+    a = mem[KOLOR];                             // LD a,(KOLOR)
+    mem[COLOR] = a;                             // LD (COLOR),a
+    set_HL( (uint16_t)(SCORE) );                // LD hl,SCORE
+    wr16( SCRIX, HL() );                        // LD (SCRIX),hl
+    a = mem[PLYMAX];                            // LD a,(PLYMAX)
+    { unsigned int v = (uint8_t)(2); unsigned int r = a + v; a = (uint8_t)r; } // ADD a,2
+    b = a;                                      // LD b,a
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+back05:
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    if( --b != 0 ) goto back05;                 // DJNZ back05
+    mem[BC0] = a;                               // LD (BC0),a
+    mem[MV0] = a;                               // LD (MV0),a
+    CALL( PINFND );                             // CALL PINFND
+    CALL( POINTS );                             // CALL POINTS
+    a = mem[BRDC];                              // LD a,(BRDC)
+    mem[BC0] = a;                               // LD (BC0),a
+    a = mem[MTRL];                              // LD a,(MTRL)
+    mem[MV0] = a;                               // LD (MV0),a
+FM5:
+    set_HL( (uint16_t)(NPLY) );                 // LD hl,NPLY
+    mem[HL()]++;                                // INC (hl)
+    a = 0; fsz = a; fc = false; fpv = parity(a); // XOR a,a
+    mem[MATEF] = a;                             // LD (MATEF),a
+    CALL( GENMOV );                             // CALL GENMOV
+    do_callback( "after GENMOV()" );            // CALLBACK "after GENMOV()"
+    a = mem[NPLY];                              // LD a,(NPLY)
+    set_HL( (uint16_t)(PLYMAX) );               // LD hl,PLYMAX
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fc ) CALL( SORTM );                     // CALL C,SORTM
+    set_HL( rd16(MLPTRI) );                     // LD hl,(MLPTRI)
+    wr16( MLPTRJ, HL() );                       // LD (MLPTRJ),hl
+FM15:
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    e = mem[HL()];                              // LD e,(hl)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    d = mem[HL()];                              // LD d,(hl)
+    a = d;                                      // LD a,d
+    fsz = a;                                    // AND a,a
+    if( fsz == 0 ) goto FM25;                   // JR Z,FM25
+    wr16( MLPTRJ, DE() );                       // LD (MLPTRJ),de
+    set_HL( rd16(MLPTRI) );                     // LD hl,(MLPTRI)
+    mem[HL()] = e;                              // LD (hl),e
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = d;                              // LD (hl),d
+    a = mem[NPLY];                              // LD a,(NPLY)
+    set_HL( (uint16_t)(PLYMAX) );               // LD hl,PLYMAX
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fc ) goto FM18;                         // JR C,FM18
+    CALL( MOVE );                               // CALL MOVE
+    CALL( INCHK );                              // CALL INCHK
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto rel017;                 // JR Z,rel017
+    CALL( UNMOVE );                             // CALL UNMOVE
+    goto FM15;                                  // JP FM15
+rel017:
+    a = mem[NPLY];                              // LD a,(NPLY)
+    set_HL( (uint16_t)(PLYMAX) );               // LD hl,PLYMAX
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fsz != 0 ) goto FM35;                   // JR NZ,FM35
+    a = mem[COLOR];                             // LD a,(COLOR)
+    a ^= (uint8_t)(0x80); fsz = a; fc = false; fpv = parity(a); // XOR a,80H
+    CALL( INCHK1 );                             // CALL INCHK1
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto FM35;                   // JR Z,FM35
+    goto FM19;                                  // JP FM19
+FM18:
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    a = mem[(uint16_t)(ix+MLVAL)];              // LD a,(ix+MLVAL)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz == 0 ) goto FM15;                   // JR Z,FM15
+    CALL( MOVE );                               // CALL MOVE
+FM19:
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    a = (uint8_t)(0x80);                        // LD a,80H
+    a ^= mem[HL()];                             // XOR a,(hl)
+    mem[HL()] = a;                              // LD (hl),a
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz != 0 ) goto rel018;                 // JR NZ,rel018
+    set_HL( (uint16_t)(MOVENO) );               // LD hl,MOVENO
+    mem[HL()]++;                                // INC (hl)
+rel018:
+    set_HL( rd16(SCRIX) );                      // LD hl,(SCRIX)
+    a = mem[HL()];                              // LD a,(hl)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    mem[HL()] = a;                              // LD (hl),a
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    wr16( SCRIX, HL() );                        // LD (SCRIX),hl
+    goto FM5;                                   // JP FM5
+FM25:
+    a = mem[MATEF];                             // LD a,(MATEF)
+    fsz = a;                                    // AND a,a
+    if( fsz != 0 ) goto FM30;                   // JR NZ,FM30
+    a = mem[CKFLG];                             // LD a,(CKFLG)
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    a = (uint8_t)(0x80);                        // LD a,80H
+    if( fsz == 0 ) goto FM36;                   // JR Z,FM36
+    a = mem[MOVENO];                            // LD a,(MOVENO)
+    mem[PMATE] = a;                             // LD (PMATE),a
+    a = (uint8_t)(0x0FF);                       // LD a,0FFH
+    goto FM36;                                  // JP FM36
+FM30:
+    a = mem[NPLY];                              // LD a,(NPLY)
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( fsz == 0 ) RET;                         // RET Z
+    CALL( ASCEND );                             // CALL ASCEND
+    set_HL( rd16(SCRIX) );                      // LD hl,(SCRIX)
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    a = mem[HL()];                              // LD a,(hl)
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    goto FM37;                                  // JP FM37
+FM35:
+    CALL( PINFND );                             // CALL PINFND
+    CALL( POINTS );                             // CALL POINTS
+    CALL( UNMOVE );                             // CALL UNMOVE
+    a = mem[VALM];                              // LD a,(VALM)
+FM36:
+    set_HL( (uint16_t)(MATEF) );                // LD hl,MATEF
+    mem[HL()] |= (1<<0);                        // SET 0,(hl)
+    set_HL( rd16(SCRIX) );                      // LD hl,(SCRIX)
+FM37:
+    do_callback( "Alpha beta cutoff?" );        // CALLBACK "Alpha beta cutoff?"
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(hl)
+    if( fc ) goto FM40;                         // JR C,FM40
+    if( fsz == 0 ) goto FM40;                   // JR Z,FM40
+    { unsigned int v = a; a = (uint8_t)(0-v); } // NEG
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    { unsigned int v = mem[HL()]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(hl)
+    do_callback( "No. Best move?" );            // CALLBACK "No. Best move?"
+    if( fc ) goto FM15;                         // JP C,FM15
+    if( fsz == 0 ) goto FM15;                   // JP Z,FM15
+    mem[HL()] = a;                              // LD (hl),a
+    do_callback( "Yes! Best move" );            // CALLBACK "Yes! Best move"
+    a = mem[NPLY];                              // LD a,(NPLY)
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,1
+    if( fsz != 0 ) goto FM15;                   // JP NZ,FM15
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    wr16( BESTM, HL() );                        // LD (BESTM),hl
+    a = mem[SCORE+1];                           // LD a,(SCORE+1)
+    { unsigned int v = (uint8_t)(0x0FF); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,0FFH
+    if( fsz != 0 ) goto FM15;                   // JP NZ,FM15
+    set_HL( (uint16_t)(PLYMAX) );               // LD hl,PLYMAX
+    mem[HL()]--;                                // DEC (hl)
+    mem[HL()]--;                                // DEC (hl)
+    a = mem[KOLOR];                             // LD a,(KOLOR)
+    fsz = a & (1<<7); fpv = fsz == 0;           // BIT 7,a
+    if( fsz == 0 ) RET;                         // RET Z
+    set_HL( (uint16_t)(PMATE) );                // LD hl,PMATE
+    { uint8_t r = --mem[HL()]; fsz = r; fpv = r == 0x7f; } // DEC (hl)
+    RET;                                        // RET
+FM40:
+    CALL( ASCEND );                             // CALL ASCEND
+    goto FM15;                                  // JP FM15
+}
+
+// ASCEND, line 2350
+static void ASCEND()
+{
+    set_HL( (uint16_t)(COLOR) );                // LD hl,COLOR
+    a = (uint8_t)(0x80);                        // LD a,80H
+    a ^= mem[HL()]; fc = false;                 // XOR a,(hl)
+    mem[HL()] = a;                              // LD (hl),a
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto rel019;                 // JR Z,rel019
+    set_HL( (uint16_t)(MOVENO) );               // LD hl,MOVENO
+    mem[HL()]--;                                // DEC (hl)
+rel019:
+    set_HL( rd16(SCRIX) );                      // LD hl,(SCRIX)
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    wr16( SCRIX, HL() );                        // LD (SCRIX),hl
+    set_HL( (uint16_t)(NPLY) );                 // LD hl,NPLY
+    { uint8_t r = --mem[HL()]; fsz = r; fpv = r == 0x7f; } // DEC (hl)
+    set_HL( rd16(MLPTRI) );                     // LD hl,(MLPTRI)
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    d = mem[HL()];                              // LD d,(hl)
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    e = mem[HL()];                              // LD e,(hl)
+    wr16( MLNXT, DE() );                        // LD (MLNXT),de
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    d = mem[HL()];                              // LD d,(hl)
+    set_HL( (uint16_t)(HL()-1) );               // DEC hl
+    e = mem[HL()];                              // LD e,(hl)
+    wr16( MLPTRI, HL() );                       // LD (MLPTRI),hl
+    wr16( MLPTRJ, DE() );                       // LD (MLPTRJ),de
+    CALL( UNMOVE );                             // CALL UNMOVE
+    RET;                                        // RET
+}
+
+// BOOK, line 2390
+static void BOOK()
+{
+    { uint16_t w = pop(); a = (uint8_t)(w>>8); set_F( (uint8_t)w ); } // POP af
+    set_HL( (uint16_t)(SCORE+1) );              // LD hl,SCORE+1
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(BMOVES-2) );             // LD hl,BMOVES-2
+    wr16( BESTM, HL() );                        // LD (BESTM),hl
+    set_HL( (uint16_t)(BESTM) );                // LD hl,BESTM
+    a = mem[KOLOR];                             // LD a,(KOLOR)
+    fsz = a; fc = false;                        // AND a,a
+    if( fsz != 0 ) goto BM5;                    // JR NZ,BM5
+    a = ldar(); fsz = a; fpv = false;           // LD a,r
+    do_callback( "LDAR" );                      // CALLBACK "LDAR"
+    fsz = a & (1<<0); fpv = fsz == 0;           // BIT 0,a
+    if( fsz == 0 ) RET;                         // RET Z
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    { uint8_t r = ++mem[HL()]; fsz = r; fpv = r == 0x80; } // INC (hl)
+    RET;                                        // RET
+BM5:
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    a = mem[(uint16_t)(ix+MLFRP)];              // LD a,(ix+MLFRP)
+    { unsigned int v = (uint8_t)(22); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,22
+    if( fsz == 0 ) goto BM9;                    // JR Z,BM9
+    { unsigned int v = (uint8_t)(27); unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,27
+    if( fsz == 0 ) goto BM9;                    // JR Z,BM9
+    { unsigned int v = (uint8_t)(34); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,34
+    if( fsz == 0 ) goto BM9;                    // JR Z,BM9
+    if( fc ) RET;                               // RET C
+    { unsigned int v = (uint8_t)(35); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,35
+    if( fsz == 0 ) RET;                         // RET Z
+BM9:
+    mem[HL()]++;                                // INC (hl)
+    mem[HL()]++;                                // INC (hl)
+    { uint8_t r = ++mem[HL()]; fsz = r; fpv = r == 0x80; } // INC (hl)
+    RET;                                        // RET
+}
+
+// CPTRMV, line 2748
+static void CPTRMV()
+{
+    CALL( FNDMOV );                             // CALL FNDMOV
+    do_callback( "After FNDMOV()" );            // CALLBACK "After FNDMOV()"
+    set_HL( rd16(BESTM) );                      // LD hl,(BESTM)
+    wr16( MLPTRJ, HL() );                       // LD (MLPTRJ),hl
+    a = mem[SCORE+1];                           // LD a,(SCORE+1)
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( fsz != 0 ) goto CP0C;                   // JR NZ,CP0C
+    c = (uint8_t)(1);                           // LD c,1
+    CALL( FCDMAT );                             // CALL FCDMAT
+CP0C:
+    CALL( MOVE );                               // CALL MOVE
+    CALL( EXECMV );                             // CALL EXECMV
+    a = b;                                      // LD a,b
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz != 0 ) goto CP10;                   // JR NZ,CP10
+    d = e;                                      // LD d,e
+    CALL( BITASN );                             // CALL BITASN
+    wr16( MVEMSG+3, HL() );                     // LD (MVEMSG+3),hl
+    d = c;                                      // LD d,c
+    CALL( BITASN );                             // CALL BITASN
+    wr16( MVEMSG, HL() );                       // LD (MVEMSG),hl
+    ;                                           // PRTBLK MVEMSG,5
+    goto CP1C;                                  // JR CP1C
+CP10:
+    fsz = b & (1<<1);                           // BIT 1,b
+    if( fsz == 0 ) goto rel020;                 // JR Z,rel020
+    ;                                           // PRTBLK O_O,5
+    goto CP1C;                                  // JR CP1C
+rel020:
+    fsz = b & (1<<2);                           // BIT 2,b
+    if( fsz == 0 ) goto rel021;                 // JR Z,rel021
+    ;                                           // PRTBLK O_O_O,5
+    goto CP1C;                                  // JR CP1C
+rel021:
+    ;                                           // PRTBLK P_PEP,5
+CP1C:
+    a = mem[COLOR];                             // LD a,(COLOR)
+    b = a;                                      // LD b,a
+    a ^= (uint8_t)(0x80); fsz = a; fc = false; fpv = parity(a); // XOR a,80H
+    mem[COLOR] = a;                             // LD (COLOR),a
+    CALL( INCHK );                              // CALL INCHK
+    fsz = a;                                    // AND a,a
+    a = b;                                      // LD a,b
+    mem[COLOR] = a;                             // LD (COLOR),a
+    if( fsz == 0 ) goto CP24;                   // JR Z,CP24
+    ;                                           // CARRET
+    a = mem[SCORE+1];                           // LD a,(SCORE+1)
+    { unsigned int v = (uint8_t)(0x0FF); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,0FFH
+    if( fsz != 0 ) CALL( TBCPMV );              // CALL NZ,TBCPMV
+    ;                                           // PRTBLK CKMSG,5
+    set_HL( (uint16_t)(LINECT) );               // LD hl,LINECT
+    mem[HL()]++;                                // INC (hl)
+CP24:
+    a = mem[SCORE+1];                           // LD a,(SCORE+1)
+    { unsigned int v = (uint8_t)(0x0FF); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,0FFH
+    if( fsz != 0 ) RET;                         // RET NZ
+    c = (uint8_t)(0);                           // LD c,0
+    CALL( FCDMAT );                             // CALL FCDMAT
+    RET;                                        // RET
+}
+
+// BITASN, line 2947
+static void BITASN()
+{
+    { unsigned int v = a; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // SUB a,a
+    e = (uint8_t)(10);                          // LD e,10
+    CALL( DIVIDE );                             // CALL DIVIDE
+    d--;                                        // DEC d
+    { unsigned int v = (uint8_t)(0x60); unsigned int r = a + v; a = (uint8_t)r; } // ADD a,60H
+    l = a;                                      // LD l,a
+    a = d;                                      // LD a,d
+    { unsigned int v = (uint8_t)(0x30); unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,30H
+    h = a;                                      // LD h,a
+    RET;                                        // RET
+}
+
+// ASNTBI, line 3030
+static void ASNTBI()
+{
+    a = l;                                      // LD a,l
+    { unsigned int v = (uint8_t)(0x30); unsigned int r = a - v; a = (uint8_t)r; } // SUB a,30H
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( (fsz&0x80) != 0 ) goto AT04;            // JP M,AT04
+    { unsigned int v = (uint8_t)(9); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,9
+    if( !fc ) goto AT04;                        // JR NC,AT04
+    { uint8_t r = ++a; fsz = r; fpv = r == 0x80; } // INC a
+    d = a;                                      // LD d,a
+    e = (uint8_t)(10);                          // LD e,10
+    CALL( MLTPLY );                             // CALL MLTPLY
+    a = h;                                      // LD a,h
+    { unsigned int v = (uint8_t)(0x40); unsigned int r = a - v; a = (uint8_t)r; } // SUB a,40H
+    { unsigned int v = (uint8_t)(1); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1
+    if( (fsz&0x80) != 0 ) goto AT04;            // JP M,AT04
+    { unsigned int v = (uint8_t)(9); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,9
+    if( !fc ) goto AT04;                        // JR NC,AT04
+    { unsigned int v = d; unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,d
+    b = (uint8_t)(0);                           // LD b,0
+    RET;                                        // RET
+AT04:
+    b = a;                                      // LD b,a
+    RET;                                        // RET
+}
+
+// VALMOV, line 3067
+static void VALMOV()
+{
+    set_HL( rd16(MLPTRJ) );                     // LD hl,(MLPTRJ)
+    push( HL() );                               // PUSH hl
+    a = mem[KOLOR];                             // LD a,(KOLOR)
+    a ^= (uint8_t)(0x80); fsz = a; fc = false; fpv = parity(a); // XOR a,80H
+    mem[COLOR] = a;                             // LD (COLOR),a
+    set_HL( (uint16_t)(PLYIX-2) );              // LD hl,PLYIX-2
+    wr16( MLPTRI, HL() );                       // LD (MLPTRI),hl
+    set_HL( (uint16_t)(MLIST+1024) );           // LD hl,MLIST+1024
+    wr16( MLNXT, HL() );                        // LD (MLNXT),hl
+    CALL( GENMOV );                             // CALL GENMOV
+    ix = (uint16_t)(MLIST+1024);                // LD ix,MLIST+1024
+VA5:
+    a = mem[MVEMSG];                            // LD a,(MVEMSG)
+    { unsigned int v = mem[(uint16_t)(ix+MLFRP)]; unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,(ix+MLFRP)
+    if( fsz != 0 ) goto VA6;                    // JR NZ,VA6
+    a = mem[MVEMSG+1];                          // LD a,(MVEMSG+1)
+    { unsigned int v = mem[(uint16_t)(ix+MLTOP)]; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,(ix+MLTOP)
+    if( fsz == 0 ) goto VA7;                    // JR Z,VA7
+VA6:
+    e = mem[(uint16_t)(ix+MLPTR)];              // LD e,(ix+MLPTR)
+    d = mem[(uint16_t)(ix+MLPTR+1)];            // LD d,(ix+MLPTR+1)
+    a = 0;                                      // XOR a,a
+    { unsigned int v = d; unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,d
+    if( fsz == 0 ) goto VA10;                   // JR Z,VA10
+    push( DE() );                               // PUSH de
+    ix = pop();                                 // POP ix
+    goto VA5;                                   // JR VA5
+VA7:
+    wr16( MLPTRJ, ix );                         // LD (MLPTRJ),ix
+    CALL( MOVE );                               // CALL MOVE
+    CALL( INCHK );                              // CALL INCHK
+    fsz = a; fc = false; fpv = parity(a);       // AND a,a
+    if( fsz != 0 ) goto VA9;                    // JR NZ,VA9
+    set_HL( pop() );                            // POP hl
+    RET;                                        // RET
+VA9:
+    CALL( UNMOVE );                             // CALL UNMOVE
+VA10:
+    a = (uint8_t)(1);                           // LD a,1
+    set_HL( pop() );                            // POP hl
+    wr16( MLPTRJ, HL() );                       // LD (MLPTRJ),hl
+    RET;                                        // RET
+}
+
+// ROYALT, line 3360
+static void ROYALT()
+{
+    set_HL( (uint16_t)(POSK) );                 // LD hl,POSK
+    b = (uint8_t)(4);                           // LD b,4
+back06:
+    mem[HL()] = (uint8_t)(0);                   // LD (hl),0
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    if( --b != 0 ) goto back06;                 // DJNZ back06
+    a = (uint8_t)(21);                          // LD a,21
+RY04:
+    mem[M1] = a;                                // LD (M1),a
+    set_HL( (uint16_t)(POSK) );                 // LD hl,POSK
+    ix = rd16(M1);                              // LD ix,(M1)
+    a = mem[(uint16_t)(ix+BOARD)];              // LD a,(ix+BOARD)
+    fsz = a & (1<<7);                           // BIT 7,a
+    if( fsz == 0 ) goto rel023;                 // JR Z,rel023
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+rel023:
+    a &= (uint8_t)(7);                          // AND a,7
+    { unsigned int v = (uint8_t)(KING); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,KING
+    if( fsz == 0 ) goto RY08;                   // JR Z,RY08
+    { unsigned int v = (uint8_t)(QUEEN); unsigned int r = a - v; fsz = (uint8_t)r; } // CP a,QUEEN
+    if( fsz != 0 ) goto RY0C;                   // JR NZ,RY0C
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+    set_HL( (uint16_t)(HL()+1) );               // INC hl
+RY08:
+    a = mem[M1];                                // LD a,(M1)
+    mem[HL()] = a;                              // LD (hl),a
+RY0C:
+    a = mem[M1];                                // LD a,(M1)
+    a++;                                        // INC a
+    { unsigned int v = (uint8_t)(99); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,99
+    if( fsz != 0 ) goto RY04;                   // JR NZ,RY04
+    RET;                                        // RET
+}
+
+// DIVIDE, line 3612
+static void DIVIDE()
+{
+    push( BC() );                               // PUSH bc
+    b = (uint8_t)(8);                           // LD b,8
+DD04:
+    { uint8_t v = d; d = (uint8_t)(v<<1); fc = (v&0x80) != 0; } // SLA d
+    a = (uint8_t)((a<<1)|fc);                   // RLA
+    { unsigned int v = e; unsigned int r = a - v; fc = a < v; a = (uint8_t)r; fsz = a; } // SUB a,e
+    if( (fsz&0x80) != 0 ) goto rel027;          // JP M,rel027
+    { uint8_t r = ++d; fsz = r; fpv = r == 0x80; } // INC d
+    goto rel024;                                // JR rel024
+rel027:
+    { unsigned int v = e; unsigned int r = a + v; fc = r > 0xff; fpv = ((a^~v)&(a^r)&0x80) != 0; a = (uint8_t)r; fsz = a; } // ADD a,e
+rel024:
+    if( --b != 0 ) goto DD04;                   // DJNZ DD04
+    set_BC( pop() );                            // POP bc
+    RET;                                        // RET
+}
+
+// MLTPLY, line 3630
+static void MLTPLY()
+{
+    push( BC() );                               // PUSH bc
+    { unsigned int v = a; unsigned int r = a - v; a = (uint8_t)r; } // SUB a,a
+    b = (uint8_t)(8);                           // LD b,8
+ML04:
+    fsz = d & (1<<0);                           // BIT 0,d
+    if( fsz == 0 ) goto rel025;                 // JR Z,rel025
+    { unsigned int v = e; unsigned int r = a + v; a = (uint8_t)r; } // ADD a,e
+rel025:
+    { uint8_t v = a; a = (uint8_t)((v>>1)|(v&0x80)); fc = (v&1) != 0; } // SRA a
+    { uint8_t v = d; d = (uint8_t)((v>>1)|(fc?0x80:0)); fc = (v&1) != 0; fsz = d; fpv = parity(d); } // RR d
+    if( --b != 0 ) goto ML04;                   // DJNZ ML04
+    set_BC( pop() );                            // POP bc
+    RET;                                        // RET
+}
+
+// EXECMV, line 3720
+static void EXECMV()
+{
+    push( ix );                                 // PUSH ix
+    push( (uint16_t)((a<<8)|get_F()) );         // PUSH af
+    ix = rd16(MLPTRJ);                          // LD ix,(MLPTRJ)
+    c = mem[(uint16_t)(ix+MLFRP)];              // LD c,(ix+MLFRP)
+    e = mem[(uint16_t)(ix+MLTOP)];              // LD e,(ix+MLTOP)
+    CALL( MAKEMV );                             // CALL MAKEMV
+    d = mem[(uint16_t)(ix+MLFLG)];              // LD d,(ix+MLFLG)
+    b = (uint8_t)(0);                           // LD b,0
+    fsz = d & (1<<6);                           // BIT 6,d
+    if( fsz == 0 ) goto EX14;                   // JR Z,EX14
+    set_DE( (uint16_t)(6) );                    // LD de,6
+    { unsigned int r = ix + DE(); ix = (uint16_t)r; } // ADD ix,de
+    c = mem[(uint16_t)(ix+MLFRP)];              // LD c,(ix+MLFRP)
+    e = mem[(uint16_t)(ix+MLTOP)];              // LD e,(ix+MLTOP)
+    a = e;                                      // LD a,e
+    { unsigned int v = c; unsigned int r = a - v; fc = a < v; fsz = (uint8_t)r; } // CP a,c
+    if( fsz != 0 ) goto EX04;                   // JR NZ,EX04
+    { uint8_t r = ++b; fsz = r; fpv = r == 0x80; } // INC b
+    goto EX10;                                  // JR EX10
+EX04:
+    { unsigned int v = (uint8_t)(0x1A); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,1AH
+    if( fsz != 0 ) goto EX08;                   // JR NZ,EX08
+    b |= (1<<1);                                // SET 1,b
+    goto EX10;                                  // JR EX10
+EX08:
+    { unsigned int v = (uint8_t)(0x60); unsigned int r = a - v; fc = a < v; fpv = ((a^v)&(a^r)&0x80) != 0; fsz = (uint8_t)r; } // CP a,60H
+    if( fsz != 0 ) goto EX0C;                   // JR NZ,EX0C
+    b |= (1<<1);                                // SET 1,b
+    goto EX10;                                  // JR EX10
+EX0C:
+    b |= (1<<2);                                // SET 2,b
+EX10:
+    CALL( MAKEMV );                             // CALL MAKEMV
+EX14:
+    { uint16_t w = pop(); a = (uint8_t)(w>>8); set_F( (uint8_t)w ); } // POP af
+    ix = pop();                                 // POP ix
+    RET;                                        // RET
+}
+
+// Call Sargon from C, with optional registers in and out
+extern "C" void sargon( int api_command_code, z80_registers *registers )
+{
+    if( registers )
+    {
+        a = (uint8_t)registers->af;
+        set_F( (uint8_t)(registers->af>>8) );
+        set_HL( registers->hl );
+        set_BC( registers->bc );
+        set_DE( registers->de );
+        ix = registers->ix;
+        iy = registers->iy;
+    }
+    sp = sizeof(stack)/sizeof(stack[0]);  // a callback may have abandoned the last call with longjmp()
+    push( 0 );
+    switch( api_command_code )
+    {
+        case 1: INITBD(); break;
+        case 2: ROYALT(); break;
+        case 3: CPTRMV(); break;
+        case 4: VALMOV(); break;
+        case 5: ASNTBI(); break;
+        case 6: EXECMV(); break;
+        case 7: XCHNG(); break;
+        case 8: GENMOV(); break;
+        case 9: POINTS(); break;
+        case 10: ATTACK(); break;
+        case 11: PINFND(); break;
+    }
+    if( registers )
+    {
+        registers->af = (uint16_t)((get_F()<<8) | a);
+        registers->hl = HL();
+        registers->bc = BC();
+        registers->de = DE();
+        registers->ix = ix;
+        registers->iy = iy;
+    }
+}
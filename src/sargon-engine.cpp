@@ -27,12 +27,23 @@
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
+#include <atomic>
+#include <map>
+#include <deque>
 
 #include "util.h"
 #include "thc.h"
 #include "sargon-interface.h"
 #include "sargon-asm-interface.h"
 #include "sargon-pv.h"
+#include "sargon-repetition.h"
+#include "sargon-book.h"
+#include "sargon-kpk.h"
+#include "sargon-points.h"
+#include "sargon-profile.h"
+#include "sargon-stats.h"
+#include "sargon-timeline.h"
+#include "sargon-pool.h"
 
 // Measure elapsed time, nodes    
 static unsigned long base_time;
@@ -41,6 +52,11 @@ static unsigned long base_time;
 #define VERSION "1978 V1.01"
 #define ENGINE_NAME "Sargon"
 static int depth_option;    // 0=auto, other values for fixed depth play
+static bool repetition_in_search_option;    // detect repetitions inside the search tree
+static bool own_book_option;                // play moves from an external opening book
+static std::string book_file_name;
+static bool kpk_bitbase_option;             // use King and Pawn v King bitbase
+static bool search_stats_option;            // report search tree statistics after each search
 static std::string logfile_name;
 static unsigned long total_callbacks;
 static unsigned long genmov_callbacks;
@@ -67,6 +83,16 @@ static MATING mating;
 // The list of repetition moves to avoid, normally empty
 static std::vector<thc::Move> the_repetition_moves;
 
+// The list of moves the KPK bitbase tells us to avoid, normally empty
+static std::vector<thc::Move> the_kpk_moves;
+
+// Multiplexed mode, many games (sessions) share a pool of engine processes,
+//  see sessions_main() and sessions_router()
+static bool sessions_mode;
+static bool worker_mode;                // an engine process in the pool
+static std::string current_session;     // prefixes each response line
+static std::atomic<bool> abort_search;  // input for the session being searched
+
 // Command line interface
 static bool process( const std::string &s );
 static std::string cmd_uci();
@@ -80,13 +106,15 @@ static void        cmd_position( const std::string &whole_cmd_line, const std::v
 // Misc
 static bool is_new_game();
 static int log( const char *fmt, ... );
+static void respond( const std::string &rsp );
+static void respond_session( const std::string &id, const std::string &rsp );
 static bool run_sargon( int plymax, bool avoid_book );
 static std::string generate_progress_report( bool &we_are_forcing_mate, bool &we_are_stalemating_now );
 static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsigned long ms_inc, int depth );
 static bool repetition_calculate( thc::ChessRules &cr, std::vector<thc::Move> &repetition_moves );
 static bool test_whether_move_repeats( thc::ChessRules &cr, thc::Move mv );
-static void repetition_remove_moves( const std::vector<thc::Move> &repetition_moves );
 static bool repetition_test();
+static KPK_RESULT kpk_calculate( thc::ChessRules &cr, std::vector<thc::Move> &kpk_moves, std::vector<thc::Move> &good_moves );
 
 // A threadsafe-queue. (from https://stackoverflow.com/questions/15278343/c11-thread-safe-queue )
 template <class T>
@@ -133,6 +161,9 @@ static SafeQueue<std::string> async_queue;
 static void timer_thread();
 static void read_stdin();
 static void write_stdout();
+static void sessions_main();
+static bool sessions_enqueue( const std::string &s );
+static int  sessions_router( int nbr_workers );
 static void timer_clear();          // Clear the timer
 static void timer_end();            // End the timer subsystem system
 static void timer_set( int ms );    // Set a timeout event, ms millisecs into the future (0 and -1 are special values)
@@ -227,8 +258,34 @@ int main( int argc, char *argv[] )
     }
     return 0;
 #endif
+    const char *usage=
+    "A UCI chess engine, the classic 1978 program Sargon.\n"
+    "\n"
+    "Usage:\n"
+    " sargon-engine [switches]\n"
+    "\n"
+    "Switches:\n"
+    " -sessions [N]  Play many games at once, each line in and out is a UCI\n"
+    "                command prefixed by a session id, eg\n"
+    "                \"g17 go wtime 60000 btime 60000\". The sessions are shared\n"
+    "                between N engine processes (default one per core), each\n"
+    "                searches for one session at a time. isready is answered\n"
+    "                at once, even while a search is running.\n"
+    " -help          Show this text\n";
+    if( argc>1 && 0==strcmp(argv[1],"-help") )
+    {
+        printf( "%s", usage );
+        return 0;
+    }
+    if( argc>1 && 0==strcmp(argv[1],"-sessions") )
+        return sessions_router( argc>2 ? atoi(argv[2]) : 0 );
+    if( argc>1 && 0==strcmp(argv[1],"-worker") )    // started by sessions_router()
+    {
+        sessions_mode = true;
+        worker_mode = true;
+    }
     std::thread first(read_stdin);
-    std::thread second(write_stdout);
+    std::thread second(sessions_mode ? sessions_main : write_stdout);
     std::thread third(timer_thread);
 
     // Wait for main threads to finish
@@ -238,6 +295,7 @@ int main( int argc, char *argv[] )
     // Tell timer thread to finish, then kill it immediately
     timer_end();
     third.detach();
+    sargon_timeline_stop();
     return 0;
 }
 
@@ -337,14 +395,34 @@ static void read_stdin()
     {
         static char buf[8192];
         if( NULL == fgets(buf,sizeof(buf)-2,stdin) )
+        {
             quit = true;
+            if( sessions_mode )
+                sessions_enqueue("quit");
+        }
         else
         {
             std::string s(buf);
             util::rtrim(s);
-            async_queue.enqueue(s);
-            if( s == "quit" )
-                quit = true;
+            if( worker_mode )       // remove the pool's "index<tab>" prefix
+            {
+                size_t offset = s.find('\t');
+                if( offset != std::string::npos )
+                    s = s.substr(offset+1);
+            }
+            if( sargon_timeline_active() )
+            {
+                sargon_timeline_track( "input" );
+                sargon_timeline_instant( "input", "\"cmd\":\"%s\"", sargon_timeline_escape(s).c_str() );
+            }
+            if( sessions_mode )
+                quit = sessions_enqueue(s);
+            else
+            {
+                async_queue.enqueue(s);
+                if( s == "quit" )
+                    quit = true;
+            }
         }
     }
 }
@@ -361,17 +439,72 @@ static void write_stdout()
     }
 } 
 
-// Run Sargon analysis, until completion or timer abort (see callback() for timer abort)
+// Put each step of sargon_run_engine() on the timeline
+static unsigned long long search_start; // not a local, survives the longjmp() of an abort
+static void run_sargon_timeline( RUN_ENGINE_STEP step )
+{
+    static unsigned long long t;
+    switch( step )
+    {
+        case RUN_ENGINE_START:
+            t = sargon_timeline_now();
+            break;
+        case RUN_ENGINE_IMPORTED:
+            sargon_timeline_span( "sargon_import_position", t );
+            search_start = sargon_timeline_now();
+            break;
+        case RUN_ENGINE_SEARCHED:
+            sargon_timeline_span( "CPTRMV", search_start, "\"aborted\":false" );
+            t = sargon_timeline_now();
+            break;
+        case RUN_ENGINE_DONE:
+            sargon_timeline_span( "sargon_pv_get", t, "\"length\":%d", static_cast<int>(the_pv.variation.size()) );
+            break;
+    }
+}
+
+// Run Sargon analysis, until completion or timer abort (see sargon_callback() for timer abort)
 static jmp_buf jmp_buf_env;
 static bool run_sargon( int plymax, bool avoid_book )
 {
     bool aborted = false;
+    sargon_stats_enable( search_stats_option );
+    if( search_stats_option )
+        sargon_stats_new_search();
+    if( plymax < 1 )  // constrain as sargon_run_engine() does, before setjmp() as it's reported after an abort
+        plymax = 1;
+    else if( plymax > 20 )
+        plymax = 20;
+    unsigned long long start = sargon_timeline_now();
     int val;
     val = setjmp(jmp_buf_env);
     if( val )
+    {
         aborted = true;
+        sargon_timeline_span( "CPTRMV", search_start, "\"aborted\":true" );
+        sargon_timeline_instant( "abort", "\"plymax\":%d", plymax );
+    }
     else
-        sargon_run_engine(the_position,plymax,the_pv,avoid_book); // the_pv updated only if not aborted
+    {
+        sargon_run_engine( the_position, plymax, the_pv, avoid_book, run_sargon_timeline );  // the_pv updated only if not aborted
+    }
+    sargon_timeline_span( "run_sargon", start, "\"plymax\":%d,\"aborted\":%s", plymax, aborted?"true":"false" );
+    sargon_timeline_counter( "nodes", "\"nodes\":%lu", end_of_points_callbacks );
+    sargon_timeline_counter( "callbacks", "\"total\":%lu,\"genmov\":%lu,\"bestmove\":%lu",
+        total_callbacks, genmov_callbacks, bestmove_callbacks );
+    if( search_stats_option && (aborted || the_pv.variation.size()>0) )    // not for a book move
+    {
+        std::string report = sargon_stats_report();
+        log( "Search statistics, PLYMAX=%d%s\n%s", plymax, aborted?" (aborted)":"", report.c_str() );
+        std::string info = util::sprintf( "info string Search statistics, PLYMAX=%d%s\n", plymax, aborted?" (aborted)":"" );
+        size_t start = 0, end;
+        while( (end=report.find('\n',start)) != std::string::npos )
+        {
+            info += "info string " + report.substr(start,end-start) + "\n";
+            start = end+1;
+        }
+        respond( info );
+    }
     return aborted;
 }
 
@@ -380,10 +513,12 @@ static bool process( const std::string &s )
 {
     bool quit=false;
     std::string rsp;
+    unsigned long long start = sargon_timeline_now();
     std::vector<std::string> fields_raw, fields;
     util::split( s, fields_raw );
     for( std::string f: fields_raw )
         fields.push_back( util::tolower(f) ); 
+    sargon_timeline_span( "parse", start );
     if( fields.size() == 0 )
         return false;
     std::string cmd = fields[0];
@@ -407,11 +542,7 @@ static bool process( const std::string &s )
     else if( cmd=="position" )
         cmd_position( s, fields );
     if( rsp != "" )
-    {
-        log( "rsp>%s\n", rsp.c_str() );
-        fprintf( stdout, "%s", rsp.c_str() );
-        fflush( stdout );
-    }
+        respond( rsp );
     log( "function process() returns, cmd=%s\n"
          "total callbacks=%lu\n"
          "bestmove callbacks=%lu\n"
@@ -423,9 +554,51 @@ static bool process( const std::string &s )
             genmov_callbacks,
             end_of_points_callbacks );
     log( "%s\n", sargon_pv_report_stats().c_str() );
+    log( "%s\n", sargon_repetition_report_stats().c_str() );
+    log( "%s\n", sargon_points_report_stats().c_str() );
+    if( cmd=="go" && sargon_profile_available() )
+        log( "Per routine profile\n%s\n", sargon_profile_report().c_str() );
+    if( sargon_timeline_active() )
+    {
+        sargon_timeline_span( cmd.c_str(), start, "\"cmd\":\"%s\"", sargon_timeline_escape(s).c_str() );
+        sargon_timeline_flush();
+    }
     return quit;
 }
 
+// Send a response to the GUI, in -sessions mode each line is prefixed by the
+//  session id
+static void respond( const std::string &rsp )
+{
+    respond_session( current_session, rsp );
+}
+
+// As respond(), for a given session. A -sessions worker also prefixes each
+//  line with the "index<tab>" the pool expects
+static void respond_session( const std::string &id, const std::string &rsp )
+{
+    static std::mutex mtx;      // sessions_enqueue() responds from the read_stdin() thread
+    log( "rsp>%s\n", rsp.c_str() );
+    std::string out = rsp;
+    if( sessions_mode )
+    {
+        out.clear();
+        size_t begin = 0;
+        while( begin < rsp.length() )
+        {
+            size_t end = rsp.find( '\n', begin );
+            end = (end==std::string::npos ? rsp.length() : end+1);
+            out += (worker_mode ? "0\t" : "") + id + " " + rsp.substr(begin,end-begin);
+            begin = end;
+        }
+    }
+    unsigned long long start = sargon_timeline_now();
+    std::lock_guard<std::mutex> lck(mtx);
+    fputs( out.c_str(), stdout );
+    fflush( stdout );
+    sargon_timeline_span( "respond", start );
+}
+
 static std::string cmd_uci()
 {
     std::string rsp=
@@ -433,6 +606,13 @@ static std::string cmd_uci()
     "id author Dan and Kathe Spracklin, Windows port by Bill Forster\n"
     "option name FixedDepth type spin min 0 max 20 default 0\n"
     "option name LogFileName type string default\n"
+    "option name RepetitionInSearch type check default false\n"
+    "option name OwnBook type check default false\n"
+    "option name BookFile type string default\n"
+    "option name KPKBitbase type check default false\n"
+    "option name NativePoints type combo default Off var Off var On var Differential\n"
+    "option name SearchStats type check default false\n"
+    "option name TimelineFile type string default\n"
     "uciok\n";
     return rsp;
 }
@@ -470,6 +650,85 @@ static void cmd_setoption( const std::vector<std::string> &fields )
     {
         logfile_name = fields[4];
     }
+
+    // Option "RepetitionInSearch"
+    //   check, default is false. If true positions that repeat earlier
+    //   positions (in the game or in the search path) are scored as draws
+    //   throughout the search tree, not just at the root
+    // eg "setoption name RepetitionInSearch value true"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="repetitioninsearch" && fields[3]=="value" )
+    {
+        repetition_in_search_option = (fields[4]=="true");
+    }
+
+    // Option "OwnBook"
+    //   check, default is false. If true play moves from the opening book
+    //   named by option "BookFile" while available
+    // eg "setoption name OwnBook value true"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="ownbook" && fields[3]=="value" )
+    {
+        own_book_option = (fields[4]=="true");
+    }
+
+    // Option "BookFile"
+    //   string, default is empty string (no book). Book files are built from
+    //   PGN files with the sargon-make-book tool
+    // eg "setoption name BookFile value c:\sargon\book.bin"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="bookfile" && fields[3]=="value" )
+    {
+        book_file_name = fields[4];
+        bool ok = sargon_book_open( book_file_name );
+        log( "Opening book %s %s\n", book_file_name.c_str(), ok ? "opened" : "could not be opened" );
+    }
+
+    // Option "KPKBitbase"
+    //   check, default is false. If true King and Pawn v King positions are
+    //   resolved by a bitbase, both at the root and at leaf nodes in the search
+    // eg "setoption name KPKBitbase value true"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="kpkbitbase" && fields[3]=="value" )
+    {
+        kpk_bitbase_option = (fields[4]=="true");
+        if( kpk_bitbase_option )
+            sargon_kpk_init();  // build it now rather than during the first search
+    }
+
+    // Option "NativePoints"
+    //   combo, default is Off. On replaces Sargon's assembly language POINTS()
+    //   evaluation with a native C++ implementation, Differential runs both
+    //   and asserts (and logs) if they ever disagree
+    // eg "setoption name NativePoints value Differential"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="nativepoints" && fields[3]=="value" )
+    {
+        POINTS_MODE mode = POINTS_ASM;
+        if( fields[4] == "on" )
+            mode = POINTS_NATIVE;
+        else if( fields[4] == "differential" )
+            mode = POINTS_DIFFERENTIAL;
+        sargon_points_set_mode( mode );
+    }
+
+    // Option "SearchStats"
+    //   check, default is false. If true each search is followed by a table
+    //   of per ply search statistics (nodes, moves generated and searched,
+    //   cutoffs, evaluations and the effective branching factor), logged and
+    //   sent to the GUI as "info string" lines
+    // eg "setoption name SearchStats value true"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="searchstats" && fields[3]=="value" )
+    {
+        search_stats_option = (fields[4]=="true");
+    }
+
+    // Option "TimelineFile"
+    //   string, default is empty string (no timeline). A timeline of engine
+    //   activity (commands, position set up, each iteration of the search,
+    //   aborts, PV output) in Chrome trace event format, for chrome://tracing
+    //   or https://ui.perfetto.dev. Cheap enough to leave on in tournaments
+    // eg "setoption name TimelineFile value c:\windows\temp\sargon-timeline.json"
+    else if( fields.size()>4 && fields[1]=="name" && fields[2]=="timelinefile" && fields[3]=="value" )
+    {
+        bool ok = sargon_timeline_start( fields[4] );
+        log( "Timeline file %s %s\n", fields[4].c_str(), ok ? "opened" : "could not be opened" );
+    }
 }
 
 static std::string cmd_go( const std::vector<std::string> &fields )
@@ -481,6 +740,7 @@ static std::string cmd_go( const std::vector<std::string> &fields )
     bestmove_callbacks = 0;
     genmov_callbacks = 0;
     end_of_points_callbacks = 0;
+    sargon_profile_reset();
 
     // Work out our time and increment
     // eg cmd ="wtime 30000 btime 30000 winc 0 binc 0"
@@ -526,6 +786,7 @@ static std::string cmd_go( const std::vector<std::string> &fields )
     }
     bool new_game = is_new_game();
     thc::Move bestmove = calculate_next_move( new_game, ms_time, ms_inc, depth );
+    stop_rsp.clear();   // this is the bestmove, a stop that interrupted the search gets nothing more
     return util::sprintf( "bestmove %s\n", bestmove.TerseOut().c_str() );
 }
 
@@ -540,6 +801,7 @@ static void cmd_go_infinite()
     bestmove_callbacks = 0;
     genmov_callbacks = 0;
     end_of_points_callbacks = 0;
+    sargon_profile_reset();
     while( !aborted )
     {
         aborted = run_sargon(plymax,true);  // note avoid_book = true
@@ -551,9 +813,7 @@ static void cmd_go_infinite()
             std::string out = generate_progress_report( we_are_forcing_mate, we_are_stalemating_now );
             if( out.length() > 0 )
             {
-                fprintf( stdout, out.c_str() );
-                fflush( stdout );
-                log( "rsp>%s\n", out.c_str() );
+                respond( out );
                 stop_rsp = util::sprintf( "bestmove %s\n", the_pv.variation[0].TerseOut().c_str() ); 
             }
         }
@@ -568,6 +828,7 @@ static void cmd_go_infinite()
 
 // cmd_position(), set a new (or same or same plus one or two half moves) position
 static bool cmd_position_signals_new_game;
+static thc::ChessRules prev_position;
 static bool is_new_game()
 {
     return cmd_position_signals_new_game;
@@ -575,8 +836,9 @@ static bool is_new_game()
 
 static void cmd_position( const std::string &whole_cmd_line, const std::vector<std::string> &fields )
 {
-    static thc::ChessRules prev_position;
+    unsigned long long start = sargon_timeline_now();
     bool position_changed = true;
+    int nbr_moves = 0;
 
     // Get base starting position
     thc::ChessRules tmp;
@@ -600,7 +862,9 @@ static void cmd_position( const std::string &whole_cmd_line, const std::vector<s
         look_for_moves = true;
     }
 
-    // Add moves
+    // Add moves, and keep a record of the positions since the last
+    //  irreversible move for in-search repetition detection
+    sargon_repetition_history_clear();
     if( look_for_moves )
     {
         bool expect_move = false;
@@ -615,9 +879,14 @@ static void cmd_position( const std::string &whole_cmd_line, const std::vector<s
                 bool okay = move.TerseIn(&the_position,parm.c_str());
                 if( !okay )
                     break;
+                sargon_repetition_history_push( the_position );
+                bool irreversible = (move.capture!=' ' || toupper(the_position.squares[move.src])=='P');
                 the_position.PlayMove( move );
+                if( irreversible )
+                    sargon_repetition_history_clear();
                 last_move_but_one = last_move;
                 last_move         = move;
+                nbr_moves++;
             }
             else if( parm == "moves" )
                 expect_move = true;
@@ -662,11 +931,14 @@ static void cmd_position( const std::string &whole_cmd_line, const std::vector<s
 
     // For next time
     prev_position = the_position;
+    sargon_timeline_span( "cmd_position", start, "\"moves\":%d,\"new_game\":%s",
+        nbr_moves, cmd_position_signals_new_game?"true":"false" );
 }
 
 // Return true if PV has us (the engine) forcing mate
 static std::string generate_progress_report( bool &we_are_forcing_mate, bool &we_are_stalemating_now )
 {
+    unsigned long long start = sargon_timeline_now();
     we_are_forcing_mate    = false;
     we_are_stalemating_now = false;
     int     score_cp   = the_pv.value;
@@ -786,6 +1058,7 @@ static std::string generate_progress_report( bool &we_are_forcing_mate, bool &we
                     1000L * ((unsigned long) nodes / (unsigned long)elapsed_time ),
                     buf_pv.c_str() );
     }
+    sargon_timeline_span( "generate_progress_report", start );
     return out;
 }
 
@@ -987,6 +1260,10 @@ static void log_state_changes( const std::string &msg, PlayingState old_state, P
         log( "%s, state = %s -> %s\n", msg.c_str(), old_txt, new_txt );
 }
 
+// The state carries over from move to move
+static PlayingState state = ADAPTIVE_NO_TARGET_YET;
+static int plymax_target;
+
 static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsigned long ms_inc, int depth )
 {
     // Timers
@@ -999,11 +1276,9 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
     bool timer_running = false;
 
     // States
-    static PlayingState state = ADAPTIVE_NO_TARGET_YET;
     PlayingState old_state;
 
     // Misc
-    static int plymax_target;
     int plymax = 1;
     int stalemates = 0;
     unsigned long base = elapsed_milliseconds();
@@ -1049,6 +1324,36 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
         }
     }
 
+    // Play from the opening book if possible, no need to run Sargon at all
+    if( own_book_option && sargon_book_is_open() && !mating.active )
+    {
+        thc::Move book_move;
+        if( sargon_book_probe(the_position,book_move) )
+        {
+            std::string out = util::sprintf( "info string book move %s\n", book_move.TerseOut().c_str() );
+            respond( out );
+            return book_move;
+        }
+    }
+
+    // In King and Pawn v King the bitbase tells us which moves keep the win (or
+    //  hold the draw). Sargon only gets to choose between those moves, and if
+    //  there's only one no need to run Sargon at all
+    the_kpk_moves.clear();
+    if( kpk_bitbase_option )
+    {
+        std::vector<thc::Move> good_moves;
+        KPK_RESULT result = kpk_calculate( the_position, the_kpk_moves, good_moves );
+        if( result != KPK_NOT_KPK )
+        {
+            std::string out = util::sprintf( "info string KPK bitbase, %s\n",
+                result==KPK_DRAW ? "draw" : (result==KPK_WHITE_WINS ? "White wins" : "Black wins") );
+            respond( out );
+            if( good_moves.size() == 1 )
+                return good_moves[0];
+        }
+    }
+
     // Initial state machine
     old_state = state;
     switch( state )
@@ -1095,9 +1400,7 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
                     mating.active = false;
                     state = (state==PLAYING_OUT_MATE_ADAPTIVE ? ADAPTIVE_NO_TARGET_YET : FIXED);
                 }
-                fprintf( stdout, out.c_str() );
-                fflush( stdout );
-                log( "rsp>%s\n", out.c_str() );
+                respond( out );
                 log( "(%s mating line)\n", mating.nbr<=1 ? "Finishing" : "Continuing" );
                 stop_rsp = util::sprintf( "bestmove %s\n", mating_move.TerseOut().c_str() ); 
                 return mating_move;
@@ -1216,9 +1519,7 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
             bool repeating = (state==REPEATING_ADAPTIVE || state==REPEATING_FIXED || state==REPEATING_FIXED_WITH_LOOPING);
             if( (!repeating||we_are_forcing_mate) && info.length() > 0 )
             {
-                fprintf( stdout, info.c_str() );
-                fflush( stdout );
-                log( "rsp>%s\n", info.c_str() );
+                respond( info );
                 stop_rsp = util::sprintf( "bestmove %s\n", the_pv.variation[0].TerseOut().c_str() ); 
                 info.clear();
             }
@@ -1404,9 +1705,7 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
                     the_pv = repetition_fallback_pv;
                 else if( info.length() > 0 )
                 {
-                    fprintf( stdout, info.c_str() );
-                    fflush( stdout );
-                    log( "rsp>%s\n", info.c_str() );
+                    respond( info );
                     stop_rsp = util::sprintf( "bestmove %s\n", the_pv.variation[0].TerseOut().c_str() ); 
                     info.clear();
                 }
@@ -1508,9 +1807,7 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
             std::string out = util::sprintf( "info score mate %d pv%s\n",
                 --mating.nbr,
                 buf_pv.c_str() );
-            fprintf( stdout, out.c_str() );
-            fflush( stdout );
-            log( "rsp>%s\n", out.c_str() );
+            respond( out );
             stop_rsp = util::sprintf( "bestmove %s\n", mating_move.TerseOut().c_str() ); 
             return mating_move;
         }
@@ -1727,6 +2024,393 @@ static thc::Move calculate_next_move( bool new_game, unsigned long ms_time, unsi
 }
 #endif
 
+/*
+
+    Multiplexed mode (the -sessions command line switch)
+
+    One engine process plays many games at once. Each input line is a UCI
+    command prefixed by a session id, a word chosen by the client, eg
+    "g17 position startpos moves e2e4", and each line of output is prefixed
+    by the id of the session it belongs to. "g17 quit" ends session g17, a
+    plain "quit" (or the end of input) ends the process.
+
+    Sargon is a single 64K memory image, so the sessions are shared between
+    a pool of worker processes (see sargon-pool.h), by default one per core.
+    The -sessions process is only a router, sessions_router() gives each
+    new session to the worker with fewest sessions and passes its commands
+    to that worker, and the workers' output to stdout. Each worker is this
+    program started with -worker, and runs sessions_main() for its share of
+    the sessions.
+
+    Each session has its own position, PV, mating line, repetition and KPK
+    move lists, repetition history, time management state and the options
+    FixedDepth, RepetitionInSearch, OwnBook and KPKBitbase (the options
+    BookFile, LogFileName, NativePoints and TimelineFile are shared by the
+    sessions on a worker). A worker's sessions take turns with the engine
+    by exchanging their state with the globals the single game code above
+    uses, so that code runs unchanged.
+
+    A worker's sessions_main() processes one command at a time, for one
+    session at a time. isready is answered at once as it arrives, even
+    while a search is running. New input for the session being searched
+    (eg stop) interrupts the search, as any input does in normal mode.
+    Other commands for the worker's other sessions wait in the inbox until
+    the search ends, so a long search (or go infinite) on a worker delays
+    the worker's other sessions; with no more sessions than cores each
+    session has a worker to itself. When the worker is free it takes
+    waiting commands other than go first, oldest first, so each session's
+    commands stay in order. Then it searches for a session that has
+    already been sent stop (its search ends after the first ply), or else
+    for the waiting session whose clock will run out soonest, deducting
+    the time the session spent waiting from its clock.
+
+*/
+
+// Everything that belongs to one game
+struct SESSION
+{
+    thc::ChessRules        position;
+    thc::ChessRules        prev_position;
+    bool                   new_game = false;
+    PV                     pv;
+    MATING                 mating = MATING();
+    std::vector<thc::Move> repetition_moves;
+    std::vector<thc::Move> kpk_moves;
+    std::vector<uint64_t>  repetition_history;
+    PlayingState           state = ADAPTIVE_NO_TARGET_YET;
+    int                    plymax_target = 0;
+    std::string            stop_rsp;
+    int                    depth_option = 0;
+    bool                   repetition_in_search_option = false;
+    bool                   own_book_option = false;
+    bool                   kpk_bitbase_option = false;
+    bool                   search_stats_option = false;
+};
+
+// Exchange a session's state with the globals. Exchanging a session's state
+//  in loads it, exchanging it again saves it
+static void session_exchange( SESSION &s )
+{
+    std::swap( the_position,                   s.position );
+    std::swap( prev_position,                  s.prev_position );
+    std::swap( cmd_position_signals_new_game,  s.new_game );
+    std::swap( the_pv,                         s.pv );
+    std::swap( mating,                         s.mating );
+    std::swap( the_repetition_moves,           s.repetition_moves );
+    std::swap( the_kpk_moves,                  s.kpk_moves );
+    std::swap( state,                          s.state );
+    std::swap( plymax_target,                  s.plymax_target );
+    std::swap( stop_rsp,                       s.stop_rsp );
+    std::swap( depth_option,                   s.depth_option );
+    std::swap( repetition_in_search_option,    s.repetition_in_search_option );
+    std::swap( own_book_option,                s.own_book_option );
+    std::swap( kpk_bitbase_option,             s.kpk_bitbase_option );
+    std::swap( search_stats_option,            s.search_stats_option );
+    sargon_repetition_history_swap( s.repetition_history );
+}
+
+// Commands waiting to be processed, per session
+struct PENDING
+{
+    std::string   cmd;
+    unsigned long received;     // elapsed_milliseconds() on arrival
+    unsigned long seq;          // arrival order
+};
+static std::mutex sessions_mtx;
+static std::condition_variable sessions_cv;
+static std::map< std::string, std::deque<PENDING> > inbox;
+static std::string searching_session;
+static bool sessions_quit;
+
+// Sessions, the loaded session's state is in the globals, not in its SESSION
+static std::map<std::string,SESSION> sessions;
+static std::string loaded_session;
+
+// Queue a line from stdin (called by the read_stdin() thread), returns true
+//  for quit
+static bool sessions_enqueue( const std::string &s )
+{
+    static unsigned long seq;
+    std::vector<std::string> fields;
+    util::split( s, fields );
+    if( fields.size() == 0 )
+        return false;
+    std::lock_guard<std::mutex> lck(sessions_mtx);
+    if( fields.size()==1 && fields[0]=="quit" )
+    {
+        sessions_quit = true;
+        abort_search = true;
+        sessions_cv.notify_one();
+        return true;
+    }
+    if( fields.size() == 1 )
+        return false;
+    std::string id = fields[0];
+    size_t offset = s.find(id) + id.length();
+    PENDING p;
+    p.cmd      = s.substr( s.find_first_not_of(" \t",offset) );
+    if( fields.size()==2 && util::tolower(fields[1])=="isready" )
+    {
+        respond_session( id, cmd_isready() );   // don't wait for a search to end
+        return false;
+    }
+    p.received = elapsed_milliseconds();
+    p.seq      = seq++;
+    inbox[id].push_back(p);
+    if( id == searching_session )
+        abort_search = true;
+    sessions_cv.notify_one();
+    return false;
+}
+
+// Load a session and process a command for it
+static void session_process( const std::string &id, const std::string &cmd )
+{
+    if( id != loaded_session )
+    {
+        if( loaded_session != "" )
+            session_exchange( sessions[loaded_session] );
+        session_exchange( sessions[id] );
+        loaded_session = id;
+    }
+    current_session = id;
+    if( sargon_timeline_active() )
+        sargon_timeline_track( "session " + id );
+    log( "cmd>%s %s\n", id.c_str(), cmd.c_str() );
+    bool quit = process(cmd);
+    if( quit )
+    {
+        sessions.erase(id);         // the globals hold its state, until the
+        loaded_session.clear();     //  next session is loaded
+    }
+}
+
+// Position of the clock time (wtime or btime) for the side to move in a go
+//  command's fields, or 0 if there isn't one
+static size_t go_clock( const std::string &id, const std::vector<std::string> &fields )
+{
+    bool white = (id==loaded_session ? the_position.white : sessions[id].position.white);
+    for( size_t i=1; i+1<fields.size(); i++ )
+    {
+        if( fields[i] == (white ? "wtime" : "btime") )
+            return i+1;
+    }
+    return 0;
+}
+
+// Is a stop waiting for a session, behind a go ?
+static bool session_stopped( const std::deque<PENDING> &pending )
+{
+    for( const PENDING &p: pending )
+    {
+        if( util::tolower(p.cmd) == "stop" )
+            return true;
+    }
+    return false;
+}
+
+// Read queued commands and process them, session by session
+static void sessions_main()
+{
+    std::unique_lock<std::mutex> lck(sessions_mtx);
+    for(;;)
+    {
+        sessions_cv.wait( lck, []{ return sessions_quit || !inbox.empty(); } );
+        if( sessions_quit )
+            break;
+
+        // Commands other than go first, oldest first. Otherwise go for a
+        //  session that has been sent stop, or for the session whose clock
+        //  will run out first (sessions without a clock last), oldest first
+        auto next = inbox.end();
+        bool next_is_go = true;
+        unsigned long next_deadline = 0;
+        for( auto it=inbox.begin(); it!=inbox.end(); ++it )
+        {
+            const PENDING &p = it->second.front();
+            std::vector<std::string> fields;
+            util::split( util::tolower(p.cmd), fields );
+            bool is_go = (fields.size()>0 && fields[0]=="go");
+            unsigned long deadline = 0xffffffff;
+            if( is_go )
+            {
+                size_t clock = go_clock( it->first, fields );
+                if( session_stopped(it->second) )
+                    deadline = 0;
+                else if( clock )
+                    deadline = p.received + atol(fields[clock].c_str());
+            }
+            bool better = false;
+            if( next == inbox.end() )
+                better = true;
+            else if( is_go != next_is_go )
+                better = !is_go;
+            else if( is_go && deadline != next_deadline )
+                better = (deadline < next_deadline);
+            else
+                better = (p.seq < next->second.front().seq);
+            if( better )
+            {
+                next = it;
+                next_is_go = is_go;
+                next_deadline = deadline;
+            }
+        }
+        std::string id = next->first;
+        PENDING p = next->second.front();
+        next->second.pop_front();
+        if( next->second.empty() )
+            inbox.erase(next);
+
+        // Deduct the time spent waiting from the session's clock
+        std::string cmd = p.cmd;
+        if( next_is_go )
+        {
+            std::vector<std::string> fields;
+            util::split( util::tolower(p.cmd), fields );
+            size_t clock = go_clock( id, fields );
+            unsigned long waited = elapsed_milliseconds() - p.received;
+            if( clock && waited > 0 )
+            {
+                long ms = atol(fields[clock].c_str()) - static_cast<long>(waited);
+                fields[clock] = util::sprintf( "%ld", ms>1 ? ms : 1L );
+                cmd = "go";
+                for( size_t i=1; i<fields.size(); i++ )
+                    cmd += " " + fields[i];
+            }
+            searching_session = id;
+            abort_search = (inbox.find(id) != inbox.end());
+        }
+        lck.unlock();
+        session_process( id, cmd );
+        lck.lock();
+        searching_session.clear();
+        abort_search = false;
+    }
+}
+
+// The -sessions router's state, sessions are pinned to the worker that has
+//  their state
+static std::mutex router_mtx;
+static std::map<std::string,int> router_sessions;   // session id -> worker
+static std::vector<int>  router_load;                // sessions per worker
+static std::vector<bool> router_failed;              // couldn't be restarted
+static bool router_quit;
+
+// Pass each line from stdin to the worker that has its session, a new
+//  session goes to the worker with fewest sessions
+static void router_read_stdin()
+{
+    static char buf[8192];
+    while( fgets(buf,sizeof(buf)-2,stdin) )
+    {
+        std::string s(buf);
+        util::rtrim(s);
+        std::vector<std::string> fields;
+        util::split( s, fields );
+        if( fields.size()==1 && fields[0]=="quit" )
+            break;
+        if( fields.size() < 2 )
+            continue;
+        std::lock_guard<std::mutex> lck(router_mtx);
+        int worker = -1;
+        auto it = router_sessions.find(fields[0]);
+        if( it != router_sessions.end() )
+            worker = it->second;
+        else
+        {
+            for( int i=0; i<sargon_pool_size(); i++ )
+            {
+                if( !router_failed[i] && (worker<0 || router_load[i]<router_load[worker]) )
+                    worker = i;
+            }
+            if( worker < 0 )
+                continue;
+            router_sessions[fields[0]] = worker;
+            router_load[worker]++;
+        }
+        if( fields[1] == "quit" )
+        {
+            router_sessions.erase(fields[0]);
+            router_load[worker]--;
+        }
+        sargon_pool_send( worker, 0, s );
+    }
+
+    // Quit (or end of input) ends the workers, they each report end of file
+    std::lock_guard<std::mutex> lck(router_mtx);
+    router_quit = true;
+    for( int i=0; i<sargon_pool_size(); i++ )
+    {
+        if( !router_failed[i] )
+            sargon_pool_send( i, 0, "quit" );
+    }
+}
+
+// Write the workers' output to stdout, until they have all ended
+static void router_write_stdout()
+{
+    int ended = 0;
+    while( ended < sargon_pool_size() )
+    {
+        int worker;
+        unsigned long idx;
+        std::string line;
+        if( sargon_pool_result(worker,idx,line) )
+        {
+            line += "\n";
+            fputs( line.c_str(), stdout );
+            fflush( stdout );
+            continue;
+        }
+        std::lock_guard<std::mutex> lck(router_mtx);
+        if( router_quit )
+        {
+            ended++;
+            continue;
+        }
+
+        // A worker has stopped unexpectedly, its sessions' state is lost.
+        //  Tell them, and start a new worker (their next commands start new
+        //  sessions)
+        for( auto it=router_sessions.begin(); it!=router_sessions.end(); )
+        {
+            if( it->second != worker )
+                ++it;
+            else
+            {
+                std::string msg = it->first + " info string engine process failed, session lost\n";
+                fputs( msg.c_str(), stdout );
+                it = router_sessions.erase(it);
+            }
+        }
+        fflush( stdout );
+        router_load[worker] = 0;
+        if( !sargon_pool_cancel(worker) )
+        {
+            router_failed[worker] = true;
+            ended++;
+        }
+    }
+}
+
+// Run the -sessions router, returns the program's exit code
+static int sessions_router( int nbr_workers )
+{
+    if( !sargon_pool_start(nbr_workers,5,0) )    // depth and time not used
+    {
+        fprintf( stderr, "Cannot start engine processes\n" );
+        return -1;
+    }
+    router_load.resize( sargon_pool_size(), 0 );
+    router_failed.resize( sargon_pool_size(), false );
+    std::thread first(router_read_stdin);
+    std::thread second(router_write_stdout);
+    first.join();
+    second.join();
+    sargon_pool_stop();
+    return 0;
+}
 // Simple logging facility gives us some debug capability when running under control of a GUI
 static int log( const char *fmt, ... )
 {
@@ -1801,15 +2485,36 @@ static bool test_whether_move_repeats( thc::ChessRules &cr, thc::Move mv )
     return (repetition_count > 1);
 }
 
-struct NativeMove
+// If the position is King and Pawn v King, calculate the moves that throw away
+//  a win (or lose a draw) and so should be avoided, and the remaining good moves
+static KPK_RESULT kpk_calculate( thc::ChessRules &cr, std::vector<thc::Move> &kpk_moves, std::vector<thc::Move> &good_moves )
 {
-    unsigned char ptr_lo;
-    unsigned char ptr_hi;
-    unsigned char square_src;
-    unsigned char square_dst;
-    unsigned char flags;
-    unsigned char value;
-};
+    kpk_moves.clear();
+    good_moves.clear();
+    KPK_RESULT result = sargon_kpk_probe(cr);
+    if( result == KPK_NOT_KPK )
+        return result;
+    KPK_RESULT we_win  = cr.white ? KPK_WHITE_WINS : KPK_BLACK_WINS;
+    KPK_RESULT we_lose = cr.white ? KPK_BLACK_WINS : KPK_WHITE_WINS;
+    std::vector<thc::Move> v;
+    cr.GenLegalMoveList(v);
+    for( thc::Move mv: v )
+    {
+        KPK_RESULT after = sargon_kpk_probe_after_move(cr,mv);
+        bool avoid = false;
+        if( result == we_win )
+            avoid = (after != we_win);
+        else if( result == KPK_DRAW )
+            avoid = (after == we_lose);
+        if( avoid )
+            kpk_moves.push_back(mv);
+        else
+            good_moves.push_back(mv);
+    }
+    if( good_moves.size() == 0 )    // shouldn't happen, but if it does don't
+        kpk_moves.clear();          //  restrict Sargon at all
+    return result;
+}
 
 static void show()
 {
@@ -1875,7 +2580,7 @@ static bool repetition_test()
             ok = false;
     }
 
-    // Non destructive test of function  repetition_remove_moves()
+    // Non destructive test of function  sargon_remove_root_moves()
     unsigned int plyix = peekw(PLYIX);
     unsigned int mllst = peekw(MLLST);
     unsigned int mlnxt = peekw(MLNXT);
@@ -1939,7 +2644,7 @@ static bool repetition_test()
     mv.src = thc::f3;
     mv.dst = thc::e5;
     v.push_back(mv);
-    repetition_remove_moves(v);
+    sargon_remove_root_moves(v);
     //show();
 
     // Check whether it matches our expectations
@@ -1982,143 +2687,47 @@ static bool repetition_test()
     return ok;
 }
 
-// Remove candidate moves that will cause the position to repeat
-static void repetition_remove_moves(  const std::vector<thc::Move> &repetition_moves  )
-{
-    //show();
-
-    // Locate the list of candidate moves (ptr ends up being 0x400 always)
-    unsigned int addr = PLYIX;
-    unsigned int base = peekw(addr);
-    unsigned int ptr  = base;
-
-    // Read a vector of NativeMove
-    unsigned int mlnxt = peekw(MLNXT);
-    if( ptr!=0x400 || mlnxt<=ptr || ((mlnxt-ptr)%6)!=0 || ((mlnxt-ptr)/6>250) )
-        return; // sanity checks
-    std::vector<NativeMove> vin;
-    while( ptr < mlnxt )
-    {
-        NativeMove nm;
-        nm.ptr_lo = peekb(ptr++);
-        nm.ptr_hi = peekb(ptr++);
-        nm.square_src = peekb(ptr++);
-        nm.square_dst = peekb(ptr++);
-        nm.flags = peekb(ptr++);
-        nm.value = peekb(ptr++);
-        vin.push_back(nm);
-    }
-
-    // Create an edited (reduced) vector
-    std::vector<NativeMove> vout;
-    bool second_byte=false;
-    bool copy_move_and_second_byte_if_present = true;
-    for( NativeMove nm: vin )
-    {
-        if( second_byte )
-            second_byte = false;
-        else
-        {
-            if( nm.flags & 0x40 )
-                second_byte = true;
-            thc::Square src, dst;
-            copy_move_and_second_byte_if_present = true;
-            if( sargon_export_square(nm.square_src,src) && sargon_export_square(nm.square_dst,dst) )
-            {
-                for( thc::Move mv: repetition_moves )
-                {
-                    if( mv.src==src && mv.dst==dst )
-                    {
-                        copy_move_and_second_byte_if_present = false;
-                        break;
-                    }
-                }
-            }
-        }
-        if( copy_move_and_second_byte_if_present )
-            vout.push_back(nm);
-    }
-
-    // Fixup ptr fields
-    ptr = base;
-    unsigned int ptr_final_move = ptr;
-    unsigned int ptr_end = ptr + 6*vout.size();
-    second_byte=false;
-    for( NativeMove &nm: vout )
-    {
-        if( second_byte )
-        {
-            second_byte = false;
-            nm.ptr_lo = 0;
-            nm.ptr_hi = 0;
-        }
-        else
-        {
-            if( nm.flags & 0x40 )
-                second_byte = true;
-            ptr_final_move = ptr;
-            unsigned int ptr_next = (second_byte ? ptr+12 : ptr+6);
-            if( ptr_next == ptr_end )
-                ptr_next = 0;
-            nm.ptr_lo = ((ptr_next)&0xff);
-            nm.ptr_hi = (((ptr_next)>>8)&0xff);
-        }
-        ptr += 6;
-    }
-
-    // Write vector back
-    if( vout.size() )  // but if no moves left, make no changes
-    {
-        pokew( MLLST, ptr_final_move );
-        pokew( MLNXT, ptr_end );
-        ptr = base;
-        for( NativeMove nm: vout )
-        {
-            pokeb( ptr++, nm.ptr_lo );
-            pokeb( ptr++, nm.ptr_hi );
-            pokeb( ptr++, nm.square_src );
-            pokeb( ptr++, nm.square_dst );
-            pokeb( ptr++, nm.flags );
-            pokeb( ptr++, nm.value );
-        }
-    }
-
-    //show();
-}
-
 extern "C" {
-    void callback( uint32_t reg_edi, uint32_t reg_esi, uint32_t reg_ebp, uint32_t reg_esp,
-                   uint32_t reg_ebx, uint32_t reg_edx, uint32_t reg_ecx, uint32_t reg_eax,
-                   uint32_t reg_eflags )
+    void sargon_callback( const char *msg, z80_registers &registers )
     {
-        uint32_t *sp = &reg_edi;
-        sp--;
-
-        // expecting code at return address to be 0xeb = 2 byte opcode, (0xeb + 8 bit relative jump),
-        uint32_t ret_addr = *sp;
-        const unsigned char *code = (const unsigned char *)ret_addr;
-        const char *msg = (const char *)(code+2);   // ASCIIZ text should come after that
         total_callbacks++;
+        if( (total_callbacks&0xffff)==0 && sargon_timeline_active() )
+            sargon_timeline_counter( "nodes", "\"nodes\":%lu", end_of_points_callbacks );
         if( 0 == strcmp(msg,"after GENMOV()") )
         {
             genmov_callbacks++;
             if( peekb(NPLY)==1 && the_repetition_moves.size()>0 )
-                repetition_remove_moves( the_repetition_moves );
+                sargon_remove_root_moves( the_repetition_moves );
+            if( peekb(NPLY)==1 && the_kpk_moves.size()>0 )
+                sargon_remove_root_moves( the_kpk_moves );
+            if( repetition_in_search_option )
+                sargon_repetition_callback_after_genmov();
+        }
+        else if( 0 == strcmp(msg,"native POINTS()") )
+        {
+            unsigned char value = sargon_points_callback_native();
+            registers.af = (registers.af&0xff00) | value;   // MODIFY VALUE !
         }
         else if( 0 == strcmp(msg,"end of POINTS()") )
         {
             end_of_points_callbacks++;
+            unsigned char value = static_cast<unsigned char>(registers.af&0xff);
+            sargon_points_callback_end_of_points( value );
             sargon_pv_callback_end_of_points();
+            if( kpk_bitbase_option && sargon_kpk_callback_end_of_points(value) )
+                registers.af = (registers.af&0xff00) | value;   // MODIFY VALUE !
         }
         else if( 0 == strcmp(msg,"Yes! Best move") )
         {
             bestmove_callbacks++;
             sargon_pv_callback_yes_best_move();
         }
+        sargon_stats_callback( msg, registers );
 
-        // Abort run_sargon() if new event in queue (and not PLYMAX==1 which is
+        // Abort run_sargon() if new event in queue, or in -sessions mode new input
+        //  for the session being searched (and not PLYMAX==1 which is
         //  effectively instantaneous, finds a baseline move)
-        if( !async_queue.empty() && peekb(PLYMAX)>1 )
+        if( (!async_queue.empty() || abort_search) && peekb(PLYMAX)>1 )
         {
             longjmp( jmp_buf_env, 1 );
         }
@@ -605,8 +605,11 @@ static void sargon_import_position_inner( const thc::ChessPosition &cp )
 }
 
 // Run Sargon move calculation
-void sargon_run_engine( const thc::ChessPosition &cp, int plymax, PV &pv, bool avoid_book )
+void sargon_run_engine( const thc::ChessPosition &cp, int plymax, PV &pv, bool avoid_book,
+                        void (*hook)( RUN_ENGINE_STEP step ) )
 {
+    if( hook )
+        hook( RUN_ENGINE_START );
     sargon_pv_clear( cp );
     if( plymax < 1 )  // constrain to sensible range
         plymax = 1;
@@ -615,13 +618,131 @@ void sargon_run_engine( const thc::ChessPosition &cp, int plymax, PV &pv, bool a
     pokeb( PLYMAX, plymax );
     sargon_import_position( cp, avoid_book );
     pokeb( KOLOR, peekb(COLOR) );  // Set KOLOR (Sargon's colour) to COLOR (side to move)
+    if( hook )
+        hook( RUN_ENGINE_IMPORTED );
     sargon(api_CPTRMV);
+    if( hook )
+        hook( RUN_ENGINE_SEARCHED );
     pv = sargon_pv_get(); // only update if CPTRMV completes (engine uses longjmp to abort if timeout)
+    if( hook )
+        hook( RUN_ENGINE_DONE );
+}
+
+// A Sargon move list entry
+struct NativeMove
+{
+    unsigned char ptr_lo;
+    unsigned char ptr_hi;
+    unsigned char square_src;
+    unsigned char square_dst;
+    unsigned char flags;
+    unsigned char value;
+};
+
+// Remove candidate moves from the root move list (or keep only those moves)
+void sargon_remove_root_moves( const std::vector<thc::Move> &moves, bool keep_only )
+{
+    // Locate the list of candidate moves (ptr ends up being 0x400 always)
+    unsigned int addr = PLYIX;
+    unsigned int base = peekw(addr);
+    unsigned int ptr  = base;
+
+    // Read a vector of NativeMove
+    unsigned int mlnxt = peekw(MLNXT);
+    if( ptr!=0x400 || mlnxt<=ptr || ((mlnxt-ptr)%6)!=0 || ((mlnxt-ptr)/6>250) )
+        return; // sanity checks
+    std::vector<NativeMove> vin;
+    while( ptr < mlnxt )
+    {
+        NativeMove nm;
+        nm.ptr_lo = peekb(ptr++);
+        nm.ptr_hi = peekb(ptr++);
+        nm.square_src = peekb(ptr++);
+        nm.square_dst = peekb(ptr++);
+        nm.flags = peekb(ptr++);
+        nm.value = peekb(ptr++);
+        vin.push_back(nm);
+    }
+
+    // Create an edited (reduced) vector
+    std::vector<NativeMove> vout;
+    bool second_byte=false;
+    bool copy_move_and_second_byte_if_present = true;
+    for( NativeMove nm: vin )
+    {
+        if( second_byte )
+            second_byte = false;
+        else
+        {
+            if( nm.flags & 0x40 )
+                second_byte = true;
+            thc::Square src, dst;
+            bool listed = false;
+            if( sargon_export_square(nm.square_src,src) && sargon_export_square(nm.square_dst,dst) )
+            {
+                for( thc::Move mv: moves )
+                {
+                    if( mv.src==src && mv.dst==dst )
+                    {
+                        listed = true;
+                        break;
+                    }
+                }
+            }
+            copy_move_and_second_byte_if_present = (listed == keep_only);
+        }
+        if( copy_move_and_second_byte_if_present )
+            vout.push_back(nm);
+    }
+
+    // Fixup ptr fields
+    ptr = base;
+    unsigned int ptr_final_move = ptr;
+    unsigned int ptr_end = ptr + 6*vout.size();
+    second_byte=false;
+    for( NativeMove &nm: vout )
+    {
+        if( second_byte )
+        {
+            second_byte = false;
+            nm.ptr_lo = 0;
+            nm.ptr_hi = 0;
+        }
+        else
+        {
+            if( nm.flags & 0x40 )
+                second_byte = true;
+            ptr_final_move = ptr;
+            unsigned int ptr_next = (second_byte ? ptr+12 : ptr+6);
+            if( ptr_next == ptr_end )
+                ptr_next = 0;
+            nm.ptr_lo = ((ptr_next)&0xff);
+            nm.ptr_hi = (((ptr_next)>>8)&0xff);
+        }
+        ptr += 6;
+    }
+
+    // Write vector back
+    if( vout.size() )  // but if no moves left, make no changes
+    {
+        pokew( MLLST, ptr_final_move );
+        pokew( MLNXT, ptr_end );
+        ptr = base;
+        for( NativeMove nm: vout )
+        {
+            pokeb( ptr++, nm.ptr_lo );
+            pokeb( ptr++, nm.ptr_hi );
+            pokeb( ptr++, nm.square_src );
+            pokeb( ptr++, nm.square_dst );
+            pokeb( ptr++, nm.flags );
+            pokeb( ptr++, nm.value );
+        }
+    }
 }
 
 const unsigned char *peek(int offset)
 {
-    unsigned char *sargon_mem_base = &sargon_base_address;
+    unsigned char *sargon_mem_base = sargon_base_address;
     unsigned char *addr = sargon_mem_base + offset;
     return addr;
 }
@@ -645,7 +766,7 @@ unsigned int peekw(int offset)
 
 unsigned char *poke(int offset)
 {
-    unsigned char *sargon_mem_base = &sargon_base_address;
+    unsigned char *sargon_mem_base = sargon_base_address;
     unsigned char *addr = sargon_mem_base + offset;
     return addr;
 }
@@ -680,3 +801,48 @@ std::string algebraic( unsigned int sq )
     return s;
 }
 
+
+// The x86 code calls back into this function at each CALLBACK point, with the
+//  saved registers on the stack. Present them to the portable sargon_callback()
+//  (as used by the C++ build of Sargon) and write back any changes. Only the
+//  32 bit x86 build calls it, the stack slots are 32 bits wide there
+#if defined(_M_IX86) || defined(__i386__)
+extern "C" {
+    void callback( uint32_t reg_edi, uint32_t reg_esi, uint32_t reg_ebp, uint32_t reg_esp,
+                   uint32_t reg_ebx, uint32_t reg_edx, uint32_t reg_ecx, uint32_t reg_eax,
+                   uint32_t reg_eflags )
+    {
+        uint32_t *sp = &reg_edi;
+        sp--;
+
+        // expecting code at return address to be 0xeb = 2 byte opcode, (0xeb + 8 bit relative jump),
+        uintptr_t ret_addr = *sp;
+        const unsigned char *code = reinterpret_cast<const unsigned char *>(ret_addr);
+        const char *msg = (const char *)(code+2);   // ASCIIZ text should come after that
+        z80_registers registers;
+        registers.af = static_cast<uint16_t>( ((reg_eflags&0xff)<<8) | (reg_eax&0xff) );
+        registers.hl = static_cast<uint16_t>(reg_ebx);
+        registers.bc = static_cast<uint16_t>(reg_ecx);
+        registers.de = static_cast<uint16_t>(reg_edx);
+        registers.ix = static_cast<uint16_t>(reg_esi);
+        registers.iy = static_cast<uint16_t>(reg_edi);
+        sargon_callback( msg, registers );
+
+        // Note use of volatile keyword, the registers are restored from the stack
+        volatile uint32_t *peax    = &reg_eax;
+        volatile uint32_t *pebx    = &reg_ebx;
+        volatile uint32_t *pecx    = &reg_ecx;
+        volatile uint32_t *pedx    = &reg_edx;
+        volatile uint32_t *pesi    = &reg_esi;
+        volatile uint32_t *pedi    = &reg_edi;
+        volatile uint32_t *peflags = &reg_eflags;
+        *peax    = (reg_eax&0xffffff00)    | (registers.af&0xff);
+        *peflags = (reg_eflags&0xffffff00) | (registers.af>>8);
+        *pebx    = (reg_ebx&0xffff0000)    | registers.hl;
+        *pecx    = (reg_ecx&0xffff0000)    | registers.bc;
+        *pedx    = (reg_edx&0xffff0000)    | registers.de;
+        *pesi    = (reg_esi&0xffff0000)    | registers.ix;
+        *pedi    = (reg_edi&0xffff0000)    | registers.iy;
+    }
+};
+#endif
@@ -40,8 +40,22 @@ unsigned int sargon_import_value( double value );
 // Sargon square convention -> string
 std::string algebraic( unsigned int sq );
 
-// Run Sargon move calculation
-void sargon_run_engine( const thc::ChessPosition &cp, int plymax, PV &pv, bool avoid_book );
+// Run Sargon move calculation. The optional hook is called at each step (eg
+//  to time the steps), after the last step pv is the result
+enum RUN_ENGINE_STEP
+{
+    RUN_ENGINE_START,       // nothing done yet
+    RUN_ENGINE_IMPORTED,    // position imported, about to call CPTRMV()
+    RUN_ENGINE_SEARCHED,    // CPTRMV() complete (not reached if a callback aborts)
+    RUN_ENGINE_DONE         // pv read
+};
+void sargon_run_engine( const thc::ChessPosition &cp, int plymax, PV &pv, bool avoid_book,
+                        void (*hook)( RUN_ENGINE_STEP step )=NULL );
+
+// Edit Sargon's list of candidate moves at the root (call from the callback
+//  after GENMOV() at ply 1). Remove the listed moves, or if keep_only, remove
+//  all other moves. If no moves would be left the list is unchanged
+void sargon_remove_root_moves( const std::vector<thc::Move> &moves, bool keep_only=false );
 
 // Peek and poke at Sargon
 const unsigned char *peek(int offset);
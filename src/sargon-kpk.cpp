@@ -0,0 +1,358 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-kpk.cpp
+ *       King and Pawn v King bitbase
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "thc.h"
+#include "sargon-interface.h"
+#include "sargon-asm-interface.h"
+#include "sargon-kpk.h"
+
+/*
+
+  Sargon has no endgame knowledge at all. A simple example from the README,
+  White Ke4, Pd4 v Black Kd7, needs a depth 13 search before Sargon finds
+  the only winning move Kd5. Here we provide a King and Pawn v King
+  bitbase, which resolves any such position instantly.
+
+  Positions are normalised so that White has the pawn and the pawn is on
+  files a-d. The bitbase is then indexed by side to move (2) x pawn square
+  (24) x White king square (64) x Black king square (64), one bit per
+  position (set = White wins), 196608 bits = 24K bytes.
+
+  The bitbase is built by retrograde analysis. Each position's successors
+  are generated once with thc's move generator; positions where the pawn
+  promotes safely, Black captures the pawn or there are no legal moves are
+  resolved immediately. Then we iterate: White to move wins if any
+  successor wins, Black to move loses if every successor wins. When
+  nothing changes any more, all unresolved positions are draws.
+
+*/
+
+static const int NBR_POSITIONS = 2*24*64*64;
+static unsigned char bitbase[NBR_POSITIONS/8];
+static bool initialised;
+
+// Stats
+static unsigned long nbr_leaf_hits;
+
+// Index positions normalised to White pawn on files a-d, (thc squares, a8=0 .. h1=63)
+static int make_index( bool white_to_move, int wk, int bk, int wp )
+{
+    int file = wp&7;
+    int rank = 8 - (wp>>3);     // 2-7
+    int pidx = file*6 + rank-2;
+    return (((white_to_move?0:1)*24 + pidx)*64 + wk)*64 + bk;
+}
+
+static bool adjacent( int sq1, int sq2 )
+{
+    int df = (sq1&7)  - (sq2&7);
+    int dr = (sq1>>3) - (sq2>>3);
+    return -1<=df && df<=1 && -1<=dr && dr<=1;
+}
+
+static bool pawn_attacks( int wp, int sq )
+{
+    return (wp>>3)-1 == (sq>>3) && ( (wp&7)-1 == (sq&7) || (wp&7)+1 == (sq&7) );
+}
+
+static bool is_legal( bool white_to_move, int wk, int bk, int wp )
+{
+    if( wk==bk || wk==wp || bk==wp || adjacent(wk,bk) )
+        return false;
+    if( white_to_move && pawn_attacks(wp,bk) )
+        return false;   // Black is in check with White to move
+    return true;
+}
+
+static void setup( thc::ChessRules &cr, bool white_to_move, int wk, int bk, int wp )
+{
+    memset( cr.squares, ' ', 64 );
+    cr.squares[wk] = 'K';
+    cr.squares[bk] = 'k';
+    cr.squares[wp] = 'P';
+    cr.white = white_to_move;
+    cr.wking_square = static_cast<thc::Square>(wk);
+    cr.bking_square = static_cast<thc::Square>(bk);
+    cr.enpassant_target = thc::SQUARE_INVALID;
+    cr.wking  = 0;
+    cr.wqueen = 0;
+    cr.bking  = 0;
+    cr.bqueen = 0;
+}
+
+// After a promotion to Queen or Rook (weaker side now to move), is the result
+//  a straightforward KQK or KRK win ? Yes unless the new piece is captured
+//  immediately or the weaker side is stalemated
+static bool promotion_wins( thc::ChessRules &cr )
+{
+    thc::MOVELIST list;
+    cr.GenLegalMoveList( &list );
+    if( list.count == 0 )
+    {
+        thc::Square king = cr.white ? cr.wking_square : cr.bking_square;
+        return cr.AttackedSquare( king, !cr.white );   // checkmate, not stalemate
+    }
+    for( int i=0; i<list.count; i++ )
+    {
+        if( list.moves[i].capture != ' ' )
+            return false;
+    }
+    return true;
+}
+
+void sargon_kpk_init()
+{
+    if( initialised )
+        return;
+    enum { UNKNOWN, WIN, DRAW, INVALID };
+    std::vector<unsigned char> status( NBR_POSITIONS, UNKNOWN );
+    std::vector<int> succ_start( NBR_POSITIONS+1, 0 );
+    std::vector<int> succ;
+    thc::ChessRules cr;
+    thc::MOVELIST list;
+    for( int idx=0; idx<NBR_POSITIONS; idx++ )
+    {
+        succ_start[idx] = static_cast<int>(succ.size());
+        int bk   = idx&63;
+        int wk   = (idx>>6)&63;
+        int pidx = (idx>>12) % 24;
+        bool white_to_move = ((idx>>12)/24 == 0);
+        int wp = (8-(pidx%6+2))*8 + pidx/6;
+        if( !is_legal(white_to_move,wk,bk,wp) )
+        {
+            status[idx] = INVALID;
+            continue;
+        }
+        setup( cr, white_to_move, wk, bk, wp );
+        cr.GenLegalMoveList( &list );
+        if( list.count == 0 )
+        {
+            bool black_mated = !white_to_move && cr.AttackedSquare(cr.bking_square,true);
+            status[idx] = black_mated ? WIN : DRAW;
+            continue;
+        }
+        for( int i=0; status[idx]==UNKNOWN && i<list.count; i++ )
+        {
+            thc::Move mv = list.moves[i];
+            if( white_to_move )
+            {
+                if( mv.special==thc::SPECIAL_PROMOTION_QUEEN || mv.special==thc::SPECIAL_PROMOTION_ROOK )
+                {
+                    cr.PushMove( mv );
+                    if( promotion_wins(cr) )
+                        status[idx] = WIN;
+                    cr.PopMove( mv );
+                }
+                else if( mv.special==thc::SPECIAL_PROMOTION_BISHOP || mv.special==thc::SPECIAL_PROMOTION_KNIGHT )
+                    ;   // can't win
+                else if( mv.src == wp )
+                    succ.push_back( make_index(false,wk,bk,mv.dst) );
+                else
+                    succ.push_back( make_index(false,mv.dst,bk,wp) );
+            }
+            else
+            {
+                if( mv.capture != ' ' )
+                    status[idx] = DRAW;     // Black captures the pawn
+                else
+                    succ.push_back( make_index(true,wk,mv.dst,wp) );
+            }
+        }
+    }
+    succ_start[NBR_POSITIONS] = static_cast<int>(succ.size());
+
+    // Iterate until no more wins are found
+    bool changed = true;
+    while( changed )
+    {
+        changed = false;
+        for( int idx=0; idx<NBR_POSITIONS; idx++ )
+        {
+            if( status[idx] != UNKNOWN )
+                continue;
+            bool white_to_move = ((idx>>12)/24 == 0);
+            bool any=false, all=true;
+            for( int j=succ_start[idx]; j<succ_start[idx+1]; j++ )
+            {
+                if( status[succ[j]] == WIN )
+                    any = true;
+                else
+                    all = false;
+            }
+            if( white_to_move ? any : all )
+            {
+                status[idx] = WIN;
+                changed = true;
+            }
+        }
+    }
+    memset( bitbase, 0, sizeof(bitbase) );
+    for( int idx=0; idx<NBR_POSITIONS; idx++ )
+    {
+        if( status[idx] == WIN )
+            bitbase[idx>>3] |= (1<<(idx&7));
+    }
+    initialised = true;
+}
+
+// Probe with actual (not normalised) squares
+static KPK_RESULT probe_raw( bool white_to_move, int wk, int bk, int pawn, bool white_has_pawn )
+{
+    if( !initialised )
+        sargon_kpk_init();
+
+    // Normalise so White has the pawn
+    if( !white_has_pawn )
+    {
+        int temp = wk;
+        wk = bk^56;
+        bk = temp^56;
+        pawn ^= 56;
+        white_to_move = !white_to_move;
+    }
+
+    // Normalise so pawn is on files a-d
+    if( (pawn&7) > 3 )
+    {
+        wk   ^= 7;
+        bk   ^= 7;
+        pawn ^= 7;
+    }
+    int rank = 8 - (pawn>>3);
+    if( rank<2 || rank>7 || !is_legal(white_to_move,wk,bk,pawn) )
+        return KPK_NOT_KPK;
+    int idx = make_index(white_to_move,wk,bk,pawn);
+    bool win = (bitbase[idx>>3] & (1<<(idx&7))) != 0;
+    if( !win )
+        return KPK_DRAW;
+    return white_has_pawn ? KPK_WHITE_WINS : KPK_BLACK_WINS;
+}
+
+KPK_RESULT sargon_kpk_probe( const thc::ChessPosition &cp )
+{
+    int wk=-1, bk=-1, pawn=-1, nbr_pawns=0;
+    bool white_has_pawn = false;
+    for( int sq=0; sq<64; sq++ )
+    {
+        switch( cp.squares[sq] )
+        {
+            case ' ':                                                       break;
+            case 'K':   wk = sq;                                            break;
+            case 'k':   bk = sq;                                            break;
+            case 'P':   pawn = sq;  nbr_pawns++;    white_has_pawn = true;  break;
+            case 'p':   pawn = sq;  nbr_pawns++;    white_has_pawn = false; break;
+            default:    return KPK_NOT_KPK;
+        }
+    }
+    if( wk<0 || bk<0 || nbr_pawns!=1 )
+        return KPK_NOT_KPK;
+    return probe_raw( cp.white, wk, bk, pawn, white_has_pawn );
+}
+
+KPK_RESULT sargon_kpk_probe_after_move( thc::ChessRules &cr, thc::Move mv )
+{
+    bool mover_is_white = cr.white;
+    cr.PushMove( mv );
+    KPK_RESULT result = sargon_kpk_probe(cr);
+    if( result == KPK_NOT_KPK )
+    {
+        // Maybe we have left KPK, by capturing the pawn or promoting it ?
+        int nbr_kings=0, nbr_minors=0, nbr_majors=0, nbr_others=0;
+        for( int sq=0; sq<64; sq++ )
+        {
+            switch( toupper(cr.squares[sq]) )
+            {
+                case ' ':                   break;
+                case 'K':   nbr_kings++;    break;
+                case 'N':
+                case 'B':   nbr_minors++;   break;
+                case 'R':
+                case 'Q':   nbr_majors++;   break;
+                default:    nbr_others++;   break;
+            }
+        }
+        bool promotion = (mv.special>=thc::SPECIAL_PROMOTION_QUEEN && mv.special<=thc::SPECIAL_PROMOTION_KNIGHT);
+        if( nbr_kings==2 && nbr_others==0 && nbr_majors==0 && nbr_minors<=1 )
+            result = KPK_DRAW;  // bare kings, or promotion to a minor piece
+        else if( promotion && nbr_kings==2 && nbr_others==0 && nbr_minors==0 && nbr_majors==1 )
+        {
+            if( !promotion_wins(cr) )
+                result = KPK_DRAW;
+            else
+                result = mover_is_white ? KPK_WHITE_WINS : KPK_BLACK_WINS;
+        }
+    }
+    cr.PopMove( mv );
+    return result;
+}
+
+bool sargon_kpk_callback_end_of_points( unsigned char &value )
+{
+    // Look for exactly two kings and a pawn on Sargon's board
+    const unsigned char *board = peek(BOARDA);
+    int wk=-1, bk=-1, pawn=-1, nbr_pieces=0;
+    bool white_has_pawn = false;
+    for( int idx=21; idx<=98; idx++ )
+    {
+        unsigned char piece = board[idx];
+        if( piece==0 || piece==0xff )
+            continue;
+        if( ++nbr_pieces > 3 )
+            return false;
+        int sq = (7-(idx/10-2))*8 + (idx%10-1);    // Sargon 21=a1 .. 98=h8 -> thc a8=0 .. h1=63
+        bool white = ((piece&0x80) == 0);
+        switch( piece&7 )
+        {
+            case 6:     if( white ) wk = sq; else bk = sq;      break;
+            case 1:     pawn = sq; white_has_pawn = white;      break;
+            default:    return false;
+        }
+    }
+    if( wk<0 || bk<0 || pawn<0 )
+        return false;
+
+    // The side that just moved is COLOR
+    bool white_moved = ((peekb(COLOR)&0x80) == 0);
+    KPK_RESULT result = probe_raw( !white_moved, wk, bk, pawn, white_has_pawn );
+    if( result == KPK_NOT_KPK )
+        return false;
+    nbr_leaf_hits++;
+
+    // Replace the material term (white positive, Pawn=2, Queen=18), with
+    //  zero for a draw or roughly a Queen for a win, plus a little extra
+    //  for each step the pawn has advanced so that Sargon makes progress.
+    //  Then scale the score exactly as the end of POINTS() does
+    int mtrl = 0;
+    if( result == KPK_WHITE_WINS )
+        mtrl = 16 + (8 - (pawn>>3));
+    else if( result == KPK_BLACK_WINS )
+        mtrl = 0 - (16 + 1 + (pawn>>3));
+    int mv0 = static_cast<signed char>(peekb(MV0));
+    int e = mtrl - mv0;
+    if( e > 30 )
+        e = 30;
+    else if( e < -30 )
+        e = -30;
+    int a = e*4;
+    if( white_moved )
+        a = 0-a;
+    value = static_cast<unsigned char>( (a+0x80) & 0xff );
+    return true;
+}
+
+std::string sargon_kpk_report_stats()
+{
+    return util::sprintf( "kpk bitbase leaf hits=%lu\n", nbr_leaf_hits );
+}
@@ -0,0 +1,44 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-kpk.h
+ *       King and Pawn v King bitbase
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_KPK_H_INCLUDED
+#define SARGON_KPK_H_INCLUDED
+
+#include <string>
+#include "thc.h"
+
+enum KPK_RESULT
+{
+    KPK_NOT_KPK,        // not a (legal) King and Pawn v King position
+    KPK_DRAW,
+    KPK_WHITE_WINS,
+    KPK_BLACK_WINS
+};
+
+// Build the bitbase (by retrograde analysis, takes a fraction of a second),
+//  called automatically on first use if not called explicitly
+void sargon_kpk_init();
+
+// Look up a position
+KPK_RESULT sargon_kpk_probe( const thc::ChessPosition &cp );
+
+// Look up the position after a move, this also resolves moves that
+//  leave KPK by capturing the pawn or promoting it
+KPK_RESULT sargon_kpk_probe_after_move( thc::ChessRules &cr, thc::Move mv );
+
+// Call from the "end of POINTS()" callback with the score in al. If the board
+//  is a KPK position, value is replaced with a score reflecting the bitbase
+//  result and true is returned
+bool sargon_kpk_callback_end_of_points( unsigned char &value );
+
+std::string sargon_kpk_report_stats();
+
+#endif // SARGON_KPK_H_INCLUDED
@@ -0,0 +1,251 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-make-book.cpp
+ *       Build a sargon-engine opening book from PGN games
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "util.h"
+#include "thc.h"
+#include "sargon-book.h"
+
+// Book building parameters
+static int max_plies = 20;     // only positions in the first max_plies half moves are booked
+static int min_count = 2;      // a move must be played at least min_count times to be booked
+
+// Count of times each move is played in each position
+static std::map< std::pair<uint64_t,uint16_t>, unsigned long > counts;
+static unsigned long nbr_games;
+static unsigned long nbr_bad_games;
+
+static bool read_pgn( const std::string &filename );
+static void add_game( const std::string &fen, const std::string &movetext );
+static bool write_book( const std::string &filename );
+
+int main( int argc, const char *argv[] )
+{
+    const char *usage=
+    "Build an opening book for sargon-engine from one or more PGN files.\n"
+    "\n"
+    "Usage:\n"
+    " sargon-make-book [switches] games.pgn [more-games.pgn ...] book.bin\n"
+    "\n"
+    "Switches:\n"
+    " -plies N  Book positions from the first N half moves of each game (default 20)\n"
+    " -min N    Only book moves played at least N times (default 2)\n"
+    "\n"
+    "Point sargon-engine at the book with UCI options BookFile and OwnBook.\n";
+    int argi = 1;
+    while( argi < argc )
+    {
+        std::string arg( argv[argi] );
+        if( arg[0] != '-' )
+            break;
+        if( arg=="-plies" && argi+1<argc )
+            max_plies = atoi(argv[++argi]);
+        else if( arg=="-min" && argi+1<argc )
+            min_count = atoi(argv[++argi]);
+        else
+        {
+            printf( "Unknown switch %s\n", arg.c_str() );
+            printf( "%s\n", usage );
+            return -1;
+        }
+        argi++;
+    }
+    if( argc-argi < 2 )
+    {
+        printf( "%s\n", usage );
+        return -1;
+    }
+    for( ; argi<argc-1; argi++ )
+    {
+        if( !read_pgn(argv[argi]) )
+        {
+            printf( "Cannot open %s\n", argv[argi] );
+            return -1;
+        }
+    }
+    std::string fout( argv[argc-1] );
+    if( !write_book(fout) )
+    {
+        printf( "Cannot write %s\n", fout.c_str() );
+        return -1;
+    }
+    return 0;
+}
+
+// A simple PGN reader, it handles tags, comments, variations, NAGs and
+//  move numbers and otherwise expects standard SAN moves
+static bool read_pgn( const std::string &filename )
+{
+    std::ifstream in(filename);
+    if( !in )
+        return false;
+    std::string fen, movetext, line;
+    bool in_movetext = false;
+    while( std::getline(in,line) )
+    {
+        util::rtrim(line);
+        if( line.length()>0 && line[0]=='[' )
+        {
+            if( in_movetext )
+            {
+                add_game( fen, movetext );
+                fen.clear();
+                movetext.clear();
+                in_movetext = false;
+            }
+            if( util::prefix(line,"[FEN \"") )
+            {
+                size_t end = line.find('"',6);
+                if( end != std::string::npos )
+                    fen = line.substr(6,end-6);
+            }
+        }
+        else if( line.length() > 0 )
+        {
+            in_movetext = true;
+            movetext += line;
+            movetext += '\n';
+        }
+    }
+    if( in_movetext )
+        add_game( fen, movetext );
+    return true;
+}
+
+static void add_game( const std::string &fen, const std::string &movetext )
+{
+    // Strip comments and variations, leaving a clean list of tokens
+    std::string clean;
+    int depth=0;
+    bool in_brace=false, in_semicolon=false;
+    for( char c: movetext )
+    {
+        if( in_semicolon )
+        {
+            if( c == '\n' )
+                in_semicolon = false;
+        }
+        else if( in_brace )
+        {
+            if( c == '}' )
+                in_brace = false;
+        }
+        else if( c == '{' )
+            in_brace = true;
+        else if( c == ';' )
+            in_semicolon = true;
+        else if( c == '(' )
+            depth++;
+        else if( c == ')' )
+        {
+            if( depth > 0 )
+                depth--;
+        }
+        else if( depth == 0 )
+            clean += (c=='\n' ? ' ' : c);
+    }
+    std::vector<std::string> tokens;
+    util::split( clean, tokens );
+
+    // Play through the moves
+    thc::ChessRules cr;
+    if( fen != "" && !cr.Forsyth(fen.c_str()) )
+    {
+        nbr_bad_games++;
+        return;
+    }
+    nbr_games++;
+    int ply = 0;
+    for( std::string token: tokens )
+    {
+        if( ply >= max_plies )
+            break;
+        if( token=="1-0" || token=="0-1" || token=="1/2-1/2" || token=="*" )
+            break;
+        if( token[0] == '$' )
+            continue;
+
+        // Remove move number prefix, eg "12." or "12..."
+        size_t i=0;
+        while( i<token.length() && isdigit(token[i]) )
+            i++;
+        if( i>0 && i<token.length() && token[i]=='.' )
+        {
+            while( i<token.length() && token[i]=='.' )
+                i++;
+            token = token.substr(i);
+        }
+        else if( i>0 && i==token.length() )
+            continue;
+
+        // Remove annotation suffixes
+        while( token.length()>0 && (token.back()=='!' || token.back()=='?') )
+            token.pop_back();
+        if( token.length() == 0 )
+            continue;
+        thc::Move mv;
+        if( !mv.NaturalIn(&cr,token.c_str()) )
+        {
+            nbr_bad_games++;
+            break;
+        }
+        std::pair<uint64_t,uint16_t> key( sargon_book_hash(cr), sargon_book_encode_move(mv) );
+        counts[key]++;
+        cr.PlayMove(mv);
+        ply++;
+    }
+}
+
+static bool write_book( const std::string &filename )
+{
+    std::vector<BOOK_ENTRY> entries;
+    for( auto it=counts.begin(); it!=counts.end(); ++it )
+    {
+        if( it->second < static_cast<unsigned long>(min_count) )
+            continue;
+        BOOK_ENTRY e;
+        e.key    = it->first.first;
+        e.move   = it->first.second;
+        e.weight = static_cast<uint16_t>( it->second>0xffff ? 0xffff : it->second );
+        entries.push_back(e);
+    }
+
+    // Sort by key, then most popular move first
+    std::sort( entries.begin(), entries.end(),
+        [](const BOOK_ENTRY &a, const BOOK_ENTRY &b)
+        {
+            if( a.key != b.key )
+                return a.key < b.key;
+            return a.weight > b.weight;
+        }
+    );
+    std::ofstream out( filename, std::ios::binary );
+    if( !out )
+        return false;
+    for( const BOOK_ENTRY &e: entries )
+    {
+        unsigned char buf[BOOK_ENTRY_SIZE];
+        sargon_book_write_entry( buf, e );
+        out.write( reinterpret_cast<const char *>(buf), BOOK_ENTRY_SIZE );
+    }
+    printf( "%lu games read (%lu with errors), %lu positions/moves, %u entries written to %s\n",
+        nbr_games, nbr_bad_games, static_cast<unsigned long>(counts.size()),
+        static_cast<unsigned int>(entries.size()), filename.c_str() );
+    return true;
+}
@@ -20,6 +20,9 @@
 #include "sargon-asm-interface.h"
 #include "sargon-interface.h"
 #include "sargon-pv.h"
+#include "sargon-points.h"
+#include "sargon-trace.h"
+#include "sargon-stats.h"
 
 // Entry points
 void sargon_minimax_main();
@@ -30,7 +33,7 @@ static std::string get_key();
 static std::string overwrite_before_offset( const std::string &s, size_t offset, const std::string &insert );
 static std::string overwrite_at_offset( const std::string &s, size_t offset, const std::string &insert );
 
-// Control callback() behaviour
+// Control sargon_callback() behaviour
 static bool callback_minimax_mods_active;
 
 // Get this program to document itself. Start with this intro which outlines the
@@ -598,7 +601,7 @@ private:
     std::string pv_key;
     AsciiArt ascii_art;
 
-    // Some variables accessed by callback() need to be visible
+    // Some variables accessed by sargon_callback() need to be visible
 public:
     std::map<std::string,unsigned int> values;
     std::map<std::string,unsigned int> cardinal_nbr;
@@ -655,6 +658,7 @@ public:
         //  effects node traversal and generates a best move.
         thc::ChessPosition cp;
         cp.Forsyth(pos_probe);
+        sargon_trace_search( std::string("Minimax model, ") + pos_probe );
         sargon_run_engine( cp, 3, pv, true );
         callback_minimax_mods_active = false;
     }
@@ -1292,36 +1296,46 @@ bool sargon_minimax_regression_test( bool quiet)
 extern void after_genmov();
 
 
+// The value returned to Sargon's LDAR instruction (the Z80 refresh register,
+//  a source of randomness for choosing book moves), see sargon_callback()
+static uint8_t ldar_reg;
+
+// Set the next LDAR values, so the book moves of a test don't depend on the
+//  tests run before it
+void sargon_ldar_seed( uint8_t seed )
+{
+    ldar_reg = seed;
+}
+
 // Sargon calls back into this function as it runs, we can monitor what's going on by
 //  reading registers and peeking at memory, and influence it by modifying registers
 //  and poking at memory.
 extern "C" {
-    void callback( uint32_t reg_edi, uint32_t reg_esi, uint32_t reg_ebp, uint32_t reg_esp,
-                   uint32_t reg_ebx, uint32_t reg_edx, uint32_t reg_ecx, uint32_t reg_eax,
-                   uint32_t reg_eflags )
+    void sargon_callback( const char *msg, z80_registers &registers )
     {
-        uint32_t *sp = &reg_edi;
-        sp--;
-
-        // expecting code at return address to be 0xeb = 2 byte opcode, (0xeb + 8 bit relative jump),
-        uint32_t ret_addr = *sp;
-        const unsigned char *code = (const unsigned char *)ret_addr;
-        const char *msg = (const char *)(code+2);   // ASCIIZ text should come after that
         if( 0 == strcmp(msg,"LDAR") )
         {
             // For testing purposes, make LDAR output increment, results in
             //  deterministic choice of book moves
-            static uint8_t a_reg;
-            a_reg++;
-            volatile uint32_t *peax = &reg_eax;
-            *peax = a_reg;
+            ldar_reg++;
+            registers.af = (registers.af&0xff00) | ldar_reg;
         }
         else if( std::string(msg) == "after GENMOV()" )
             after_genmov();
+        else if( std::string(msg) == "native POINTS()" )
+        {
+            unsigned char value = sargon_points_callback_native();
+            registers.af = (registers.af&0xff00) | value;
+        }
         else if( std::string(msg) == "end of POINTS()" )
+        {
+            sargon_points_callback_end_of_points( static_cast<unsigned char>(registers.af&0xff) );
             sargon_pv_callback_end_of_points();
+        }
         else if( std::string(msg) == "Yes! Best move" )
             sargon_pv_callback_yes_best_move();
+        sargon_trace_callback( msg, registers );
+        sargon_stats_callback( msg, registers );
 
         // Remaining Callbacks only apply when we are running our minimax tests and
         //  heavily manipulating Sargon's operations
@@ -1337,10 +1351,8 @@ extern "C" {
             {
                 // Change al to 2 and ch to 1 and MPIECE will exit without
                 //  generating (non-castling) king moves
-                volatile uint32_t *peax = &reg_eax;   // note use of volatile keyword
-                *peax = 2;                            // MODIFY VALUE !
-                volatile uint32_t *pecx = &reg_ecx;   // note use of volatile keyword
-                *pecx = 0x100;                        // MODIFY VALUE !
+                registers.af = (registers.af&0xff00) | 2;   // MODIFY VALUE !
+                registers.bc = 0x100;                       // MODIFY VALUE !
             }
         }
 
@@ -1358,8 +1370,7 @@ extern "C" {
                                             running_example->lines[key].c_str() );
             running_example->progress.push_back(prog);
             unsigned int value = running_example->values[key];
-            volatile uint32_t *peax = &reg_eax;     // note use of volatile keyword
-            *peax = value;                          // MODIFY VALUE !
+            registers.af = (registers.af&0xff00) | (value&0xff);   // MODIFY VALUE !
         }
 
         // For purposes of minimax tracing experiment, describe and annotate the
@@ -1379,8 +1390,8 @@ extern "C" {
             if( key == "(root)" )
                 key = "";
             key += toupper(c); 
-            unsigned int al  = reg_eax&0xff;
-            unsigned int bx  = reg_ebx&0xffff;
+            unsigned int al  = registers.af&0xff;
+            unsigned int bx  = registers.hl;
             unsigned int val = peekb(bx);
             bool jmp = (al <= val);   // Note that Sargon integer values have reverse sense to
                                       //  float centipawns.
@@ -1415,8 +1426,8 @@ extern "C" {
         else if( std::string(msg) == "No. Best move?" )
         {
             Progress prog;
-            unsigned int al  = reg_eax&0xff;
-            unsigned int bx  = reg_ebx&0xffff;
+            unsigned int al  = registers.af&0xff;
+            unsigned int bx  = registers.hl;
             unsigned int val = peekb(bx);
             bool jmp = (al <= val);   // Note that Sargon integer values have reverse sense to
                                       //  float centipawns.
@@ -0,0 +1,651 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-points.cpp
+ *       Native C++ implementation of Sargon's POINTS() evaluation
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "util.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-points.h"
+
+// This is a line by line transliteration of the Sargon routines POINTS,
+//  ATTACK, ATKSAV, PNCK, XCHNG and NEXTAD. All arithmetic is done on
+//  unsigned bytes, exactly as the Z80 does it, including some quirks that
+//  must be preserved to get identical results. For example when the pin list
+//  is searched, PNCK overwrites register d (the ATTACK scan flags) with the
+//  attack direction, so ATKSAV then tests bit 7 of the direction, rather than
+//  the "queen found this scan" flag, to select the attack list slot.
+//
+//  The attack list (ATKLST) is immediately followed in memory by the pin list
+//  (PLISTA), and on rare occasions ATKSAV overflows from one into the other.
+//  So we work on a private copy of a window of memory starting at ATKLST,
+//  which faithfully reproduces such overflows. Sargon's other scratch
+//  variables (M2, M3, P1, P2, T1, T2, T3, INDX2) are not maintained.
+//
+//  ATTACK can optionally (and by default does) use precomputed ray tables
+//  and an occupancy bitboard instead of stepping through the DIRECT table
+//  one square at a time. The pieces along each ray are visited in the same
+//  order, so the attack list is built in exactly the same order.
+
+// Piece types and colour
+static const unsigned char KNIGHT = 2;
+static const unsigned char BISHOP = 3;
+static const unsigned char ROOK   = 4;
+static const unsigned char QUEEN  = 5;
+static const unsigned char KING   = 6;
+static const unsigned char BLACK  = 0x80;
+
+// Sargon tables and move list fields that aren't exported in the asm interface
+static const int DIRECT = 0x0100;          // direction table
+static const int PVALUE = 0x0126 - 1;      // piece values, indexed by piece type 1-6
+static const int MLTOP  = 3;               // move list "to" field
+
+// Attack list window, attack list (WACT..) at offset 0, black attack list
+//  (BACT..) at offset 7, pin list (PLISTA) at offset 14, pin directions
+//  (PLISTD) at offset 24
+static const int WINDOW_SIZE = 64;
+static const int WACT_OFFSET = 0;
+static const int BACT_OFFSET = 7;
+static const int PLIST_OFFSET = PLISTA - ATKLST;
+static const int PLIST_SIZE = 20;
+
+static POINTS_MODE points_mode = POINTS_ASM;
+static bool use_rays = true;
+static unsigned long native_evaluations;
+static unsigned long differential_checks;
+static unsigned long differential_mismatches;
+static std::string first_mismatch;
+
+// Evaluation context, the state the Z80 keeps in registers and variables
+struct CONTEXT
+{
+    const unsigned char *mem;
+    const unsigned char *board;
+    unsigned char lst[WINDOW_SIZE];
+    unsigned char npins;
+    unsigned char p1;       // piece on square being evaluated
+    unsigned char p2;       // piece found by PATH
+    unsigned char t2;       // piece type found by PATH
+    unsigned char m2;       // position found by PATH
+    uint64_t occupied;      // occupancy bitboard mirror of the board
+};
+
+// Ray tables. Bitboard squares are numbered a1=0, b1=1 .. h8=63. Every
+//  Sargon direction that is positive is also positive in bitboard terms,
+//  so the nearest piece along a ray is the lowest set bit for positive
+//  directions and the highest set bit for negative directions
+static bool rays_initialised;
+static uint64_t ray_masks[120][16];     // indexed by Sargon square, direction index
+static signed char index_to_bit[120];   // -1 for border squares
+static unsigned char bit_to_index[64];
+
+static void rays_init( const unsigned char *mem )
+{
+    for( int idx=0; idx<120; idx++ )
+    {
+        int file = idx%10 - 1;
+        int rank = idx/10 - 2;
+        bool on_board = (0<=file && file<8 && 0<=rank && rank<8);
+        index_to_bit[idx] = on_board ? static_cast<signed char>(rank*8+file) : -1;
+        if( on_board )
+            bit_to_index[rank*8+file] = static_cast<unsigned char>(idx);
+    }
+    for( int idx=0; idx<120; idx++ )
+    {
+        for( int i=0; i<16; i++ )
+        {
+            uint64_t mask = 0;
+            if( index_to_bit[idx] >= 0 )
+            {
+                int direction = static_cast<signed char>( mem[DIRECT+i] );
+                int knight = (i >= 8);   // direction count b < 9
+                for( int sq=idx+direction; 0<=sq && sq<120 && index_to_bit[sq]>=0; sq+=direction )
+                {
+                    mask |= (1ULL << index_to_bit[sq]);
+                    if( knight )
+                        break;
+                }
+            }
+            ray_masks[idx][i] = mask;
+        }
+    }
+    rays_initialised = true;
+}
+
+static int lowest_bit( uint64_t bits )
+{
+#ifdef _MSC_VER
+    unsigned long ret;
+    if( _BitScanForward( &ret, static_cast<unsigned long>(bits) ) )
+        return static_cast<int>(ret);
+    _BitScanForward( &ret, static_cast<unsigned long>(bits>>32) );
+    return static_cast<int>(ret) + 32;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+static int highest_bit( uint64_t bits )
+{
+#ifdef _MSC_VER
+    unsigned long ret;
+    if( _BitScanReverse( &ret, static_cast<unsigned long>(bits>>32) ) )
+        return static_cast<int>(ret) + 32;
+    _BitScanReverse( &ret, static_cast<unsigned long>(bits) );
+    return static_cast<int>(ret);
+#else
+    return 63 - __builtin_clzll(bits);
+#endif
+}
+
+static uint64_t occupancy( const unsigned char *board )
+{
+    uint64_t occupied = 0;
+    for( int bit=0; bit<64; bit++ )
+    {
+        if( board[bit_to_index[bit]] & 7 )
+            occupied |= (1ULL << bit);
+    }
+    return occupied;
+}
+
+// Z80 RLD and RRD with the accumulator, return new accumulator
+static unsigned char rld( unsigned char &m, unsigned char a )
+{
+    unsigned char ret = (a&0xf0) | (m>>4);
+    m = static_cast<unsigned char>( (m<<4) | (a&0x0f) );
+    return ret;
+}
+
+static unsigned char rrd( unsigned char &m, unsigned char a )
+{
+    unsigned char ret = (a&0xf0) | (m&0x0f);
+    m = static_cast<unsigned char>( (a<<4) | (m>>4) );
+    return ret;
+}
+
+// PATH, returns 0 empty, 1 opposite colour, 2 same colour, 3 off board
+static int path( CONTEXT &ctx, unsigned char direction )
+{
+    ctx.m2 = static_cast<unsigned char>(ctx.m2 + direction);
+    unsigned char piece = ctx.board[ctx.m2];
+    if( piece == 0xff )
+        return 3;
+    ctx.p2 = piece;
+    ctx.t2 = piece&7;
+    if( ctx.t2 == 0 )
+        return 0;
+    return ((ctx.p2^ctx.p1)&0x80) ? 1 : 2;
+}
+
+// PNCK, returns false if the attacker is pinned and not a valid attacker
+static bool pin_check( CONTEXT &ctx, unsigned char direction )
+{
+    bool found = false;
+    for( int i=0; i<ctx.npins; i++ )
+    {
+        if( ctx.lst[PLIST_OFFSET+i] != ctx.m2 )
+            continue;
+        if( found )
+            return false;
+        found = true;
+        unsigned char pin_direction = ctx.lst[PLIST_OFFSET+i+10];
+        unsigned char neg = static_cast<unsigned char>(0-pin_direction);
+        if( pin_direction!=direction && neg!=direction )
+            return false;
+    }
+    return true;
+}
+
+// ATKSAV
+static void attack_save( CONTEXT &ctx, unsigned char flags, unsigned char direction )
+{
+    if( ctx.npins )
+    {
+        if( !pin_check(ctx,direction) )
+            return;
+        flags = direction;  // see comment at top of file
+    }
+    unsigned char value = ctx.mem[PVALUE+ctx.t2];
+    int idx = (ctx.p2&BLACK) ? BACT_OFFSET : WACT_OFFSET;
+    ctx.lst[idx]++;
+    idx += (flags&0x80) ? QUEEN : (ctx.p2&7);
+    unsigned char data = ctx.lst[idx];
+    if( (data&0x0f) == 0 )
+        rld( ctx.lst[idx], value );
+    else if( (data&0xf0) == 0 )
+    {
+        rld( ctx.lst[idx], 0 );
+        rrd( ctx.lst[idx], value );
+    }
+    else
+        rld( ctx.lst[idx+1], value );
+}
+
+// ATTACK from label AT14 on, determine if a piece encountered while scanning
+//  attacks the square, and save it if so. Returns true to continue the scan
+//  in this direction
+static bool piece_encountered( CONTEXT &ctx, int r, int b, unsigned char &d, unsigned char direction )
+{
+    if( r == 1 )
+    {
+        if( d & 0x40 )
+            return false;
+        d |= 0x20;
+    }
+    else
+    {
+        if( d & 0x20 )
+            return false;
+        d |= 0x40;
+    }
+    unsigned char e = ctx.t2;
+    bool attacks = false;
+    if( b < 9 )
+        attacks = (e == KNIGHT);
+    else if( e == QUEEN )
+    {
+        d |= 0x80;
+        attacks = true;
+    }
+    else if( (d&0x0f)==1 && e==KING )
+        attacks = true;
+    else if( b < 13 )
+        attacks = (e == ROOK);
+    else if( e == BISHOP )
+        attacks = true;
+    else if( (d&0x0f)==1 && e==1 )
+    {
+        if( ctx.p2 & BLACK )
+            attacks = (b >= 15);
+        else
+            attacks = (b < 15);
+    }
+    if( !attacks )
+        return false;
+    attack_save( ctx, d, direction );
+    return ctx.t2!=KING && ctx.t2!=KNIGHT;
+}
+
+// ATTACK, as called from POINTS (T1 == 7), stepping square by square
+static void attack_steps( CONTEXT &ctx, unsigned char m3 )
+{
+    for( int b=16; b>0; b-- )
+    {
+        unsigned char direction = ctx.mem[DIRECT+16-b];
+        unsigned char d = 0;
+        ctx.m2 = m3;
+        for(;;)
+        {
+            d++;
+            int r = path( ctx, direction );
+            if( r == 0 )
+            {
+                if( b >= 9 )
+                    continue;
+                break;
+            }
+            if( r==3 || !piece_encountered(ctx,r,b,d,direction) )
+                break;
+        }
+    }
+}
+
+// ATTACK, as called from POINTS (T1 == 7), visiting only occupied squares
+static void attack_rays( CONTEXT &ctx, unsigned char m3 )
+{
+    int from_file = index_to_bit[m3] & 7;
+    int from_rank = index_to_bit[m3] >> 3;
+    const uint64_t *masks = ray_masks[m3];
+    for( int b=16; b>0; b-- )
+    {
+        unsigned char direction = ctx.mem[DIRECT+16-b];
+        uint64_t bits = ctx.occupied & masks[16-b];
+        unsigned char d = 0;
+        while( bits )
+        {
+            int bit = (direction&0x80) ? highest_bit(bits) : lowest_bit(bits);
+            bits &= ~(1ULL << bit);
+
+            // Scan count as PATH steps would have left it
+            int steps = 1;
+            if( b >= 9 )
+            {
+                int df = (bit&7) - from_file;
+                int dr = (bit>>3) - from_rank;
+                df = df<0 ? -df : df;
+                dr = dr<0 ? -dr : dr;
+                steps = df>dr ? df : dr;
+            }
+            d = static_cast<unsigned char>( (d&0xf0) | steps );
+            ctx.m2 = bit_to_index[bit];
+            ctx.p2 = ctx.board[ctx.m2];
+            ctx.t2 = ctx.p2&7;
+            int r = ((ctx.p2^ctx.p1)&0x80) ? 1 : 2;
+            if( !piece_encountered(ctx,r,b,d,direction) )
+                break;
+        }
+    }
+}
+
+// NEXTAD, returns value of next attacker or defender, or zero
+struct LISTS
+{
+    unsigned char count[2];
+    int ptr[2];
+};
+
+static unsigned char next_attacker_defender( CONTEXT &ctx, LISTS &lists, unsigned char &c )
+{
+    c++;
+    int side = c&1;
+    if( lists.count[side] == 0 )
+        return 0;
+    lists.count[side]--;
+    int p = lists.ptr[side];
+    do
+    {
+        p++;
+    } while( p<WINDOW_SIZE-1 && ctx.lst[p]==0 );
+    unsigned char a = rrd( ctx.lst[p], 0 );
+    lists.ptr[side] = p-1;
+    return static_cast<unsigned char>(a+a);
+}
+
+// XCHNG, returns points lost (e) and updates doubled piece value (d)
+static unsigned char exchange( CONTEXT &ctx, unsigned char &d )
+{
+    LISTS lists;
+    int own   = (ctx.p1&BLACK) ? BACT_OFFSET : WACT_OFFSET;
+    int other = (ctx.p1&BLACK) ? WACT_OFFSET : BACT_OFFSET;
+    lists.count[0] = ctx.lst[own];
+    lists.ptr[0]   = own;
+    lists.count[1] = ctx.lst[other];
+    lists.ptr[1]   = other;
+    unsigned char c = 0;
+    unsigned char e = 0;
+    d = static_cast<unsigned char>( ctx.mem[PVALUE+(ctx.p1&7)] * 2 );
+    unsigned char b = d;
+    unsigned char a = next_attacker_defender( ctx, lists, c );
+    if( a == 0 )
+        return e;
+    unsigned char l;
+    unsigned char saved;    // af' on the Z80, zero corresponds to Z flag set
+    for(;;)
+    {
+        // XC10
+        l = a;
+        a = next_attacker_defender( ctx, lists, c );
+        if( a != 0 )
+        {
+            saved = a;
+            if( b >= l )
+                a = b;      // to XC19
+            else
+            {
+                // XC15
+                for(;;)
+                {
+                    if( a < l )
+                        return e;
+                    a = next_attacker_defender( ctx, lists, c );
+                    if( a == 0 )
+                        return e;
+                    l = a;
+                    a = next_attacker_defender( ctx, lists, c );
+                    if( a == 0 )
+                        break;
+                }
+                saved = 0;  // XC18
+                a = b;
+            }
+        }
+        else
+        {
+            saved = 0;  // XC18
+            a = b;
+        }
+
+        // XC19
+        if( c & 1 )
+            a = static_cast<unsigned char>(0-a);
+        e = static_cast<unsigned char>(e+a);
+        a = saved;
+        if( a == 0 )
+            return e;
+        b = l;
+    }
+}
+
+// LIMIT
+static unsigned char limit( unsigned char lim, unsigned char b )
+{
+    if( b & 0x80 )
+    {
+        unsigned char a = static_cast<unsigned char>(0-lim);
+        return a>=b ? a : b;
+    }
+    return lim<b ? lim : b;
+}
+
+// POINTS
+void sargon_points_native( POINTS_RESULT &r )
+{
+    CONTEXT ctx;
+    ctx.mem   = peek(0);
+    ctx.board = ctx.mem + BOARDA;
+    memcpy( ctx.lst, ctx.mem+ATKLST, WINDOW_SIZE );
+    ctx.npins = ctx.mem[NPINS];
+    if( !rays_initialised )
+        rays_init( ctx.mem );
+    ctx.occupied = use_rays ? occupancy(ctx.board) : 0;
+    unsigned char color  = ctx.mem[COLOR];
+    unsigned char moveno = ctx.mem[MOVENO];
+    unsigned int  mlptrj = ctx.mem[MLPTRJ] + (ctx.mem[MLPTRJ+1]<<8);
+    unsigned char moving_to = ctx.mem[(mlptrj+MLTOP)&0xffff];
+    unsigned char mtrl=0, brdc=0, ptsl=0, ptsw1=0, ptsw2=0, ptsck=0;
+    for( unsigned char m3=21; m3!=99; m3++ )
+    {
+        unsigned char piece = ctx.board[m3];
+        if( piece == 0xff )
+            continue;
+        ctx.p1 = piece;
+        unsigned char t3 = piece&7;
+
+        // Development penalties and castling bonus
+        bool penalty=false;
+        if( t3 < KNIGHT )
+            ;
+        else if( t3 < ROOK )
+            penalty = !(piece&0x08);
+        else if( t3==KING && (piece&0x10) )
+            brdc = static_cast<unsigned char>( brdc + ((piece&BLACK) ? -6 : 6) );
+        else if( t3==KING || moveno<7 )
+            penalty = ((piece&0x08) != 0);
+        if( penalty )
+            brdc = static_cast<unsigned char>( brdc + ((piece&BLACK) ? 2 : -2) );
+
+        // Board control
+        memset( ctx.lst, 0, 14 );
+        if( use_rays )
+            attack_rays( ctx, m3 );
+        else
+            attack_steps( ctx, m3 );
+        brdc = static_cast<unsigned char>( brdc + ctx.lst[WACT_OFFSET] - ctx.lst[BACT_OFFSET] );
+        if( piece == 0 )
+            continue;
+
+        // Exchanges
+        unsigned char d;
+        unsigned char e = exchange( ctx, d );
+        if( e != 0 )
+        {
+            d--;
+            if( ((piece^color)&0x80) == 0 )
+            {
+                if( e >= ptsl )
+                {
+                    ptsl = e;
+                    if( m3 == moving_to )
+                        ptsck = m3;
+                }
+            }
+            else
+            {
+                unsigned char a = e;
+                if( a >= ptsw1 )
+                {
+                    a = ptsw1;
+                    ptsw1 = e;
+                }
+                if( a >= ptsw2 )
+                    ptsw2 = a;
+            }
+        }
+
+        // Material
+        unsigned char a = (piece&BLACK) ? static_cast<unsigned char>(0-d) : d;
+        mtrl = static_cast<unsigned char>(mtrl+a);
+    }
+    if( ptsck )
+    {
+        ptsw1 = ptsw2;
+        ptsw2 = 0;
+    }
+    unsigned char b = ptsl;
+    if( b )
+        b--;
+    unsigned char a = 0;
+    if( ptsw1 && ptsw2 )
+        a = static_cast<unsigned char>(ptsw2-1) >> 1;
+    a = static_cast<unsigned char>(a-b);
+    if( color & 0x80 )
+        a = static_cast<unsigned char>(0-a);
+    a = static_cast<unsigned char>(a + mtrl - ctx.mem[MV0]);
+    unsigned char e = limit( 30, a );
+    b = static_cast<unsigned char>(brdc - ctx.mem[BC0]);
+    if( ptsck )
+        b = 0;
+    unsigned char d = limit( 6, b );
+    a = static_cast<unsigned char>(4*e + d);
+    if( !(color & 0x80) )
+        a = static_cast<unsigned char>(0-a);
+    a = static_cast<unsigned char>(a+0x80);
+    r.brdc  = brdc;
+    r.mtrl  = mtrl;
+    r.ptsl  = ptsl;
+    r.ptsw1 = ptsw1;
+    r.ptsw2 = ptsw2;
+    r.ptsck = ptsck;
+    r.value = a;
+
+    // Leave the attack and pin lists as the assembly language would
+    if( points_mode == POINTS_NATIVE )
+        memcpy( poke(ATKLST), ctx.lst, PLIST_OFFSET+PLIST_SIZE );
+}
+
+void sargon_points_set_mode( POINTS_MODE mode )
+{
+    points_mode = mode;
+    sargon_native_points = (mode==POINTS_NATIVE ? 1 : 0);
+}
+
+POINTS_MODE sargon_points_get_mode()
+{
+    return points_mode;
+}
+
+void sargon_points_set_rays( bool rays )
+{
+    use_rays = rays;
+}
+
+std::string sargon_points_benchmark( unsigned long iterations, bool &ok, double &ns_steps, double &ns_rays )
+{
+    bool save = use_rays;
+    POINTS_RESULT r[2];
+    double ns[2];
+    for( int i=0; i<2; i++ )
+    {
+        use_rays = (i==1);
+        std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
+            sargon_points_native( r[i] );
+        std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - base);
+        ns[i] = static_cast<double>(elapsed.count()) / (iterations ? iterations : 1);
+    }
+    use_rays = save;
+    ok = (0 == memcmp( &r[0], &r[1], sizeof(POINTS_RESULT) ));
+    ns_steps = ns[0];
+    ns_rays  = ns[1];
+    return util::sprintf( "steps %.0f ns, rays %.0f ns, speedup %.2f, results %s",
+        ns[0], ns[1], ns[1]>0 ? ns[0]/ns[1] : 0.0, ok ? "identical" : "DIFFER" );
+}
+
+unsigned char sargon_points_callback_native()
+{
+    native_evaluations++;
+    POINTS_RESULT r;
+    sargon_points_native( r );
+    pokeb( BRDC,  r.brdc );
+    pokeb( MTRL,  r.mtrl );
+    pokeb( PTSL,  r.ptsl );
+    pokeb( PTSW1, r.ptsw1 );
+    pokeb( PTSW2, r.ptsw2 );
+    pokeb( PTSCK, r.ptsck );
+    return r.value;
+}
+
+bool sargon_points_callback_end_of_points( unsigned char value )
+{
+    if( points_mode != POINTS_DIFFERENTIAL )
+        return true;
+    differential_checks++;
+    POINTS_RESULT r;
+    sargon_points_native( r );
+    bool ok = r.brdc  == peekb(BRDC)  &&
+              r.mtrl  == peekb(MTRL)  &&
+              r.ptsl  == peekb(PTSL)  &&
+              r.ptsw1 == peekb(PTSW1) &&
+              r.ptsw2 == peekb(PTSW2) &&
+              r.ptsck == peekb(PTSCK) &&
+              r.value == value;
+    if( !ok )
+    {
+        differential_mismatches++;
+        if( first_mismatch == "" )
+        {
+            first_mismatch = util::sprintf(
+                "asm BRDC=%02x MTRL=%02x PTSL=%02x PTSW1=%02x PTSW2=%02x PTSCK=%02x value=%02x, "
+                "native BRDC=%02x MTRL=%02x PTSL=%02x PTSW1=%02x PTSW2=%02x PTSCK=%02x value=%02x",
+                peekb(BRDC), peekb(MTRL), peekb(PTSL), peekb(PTSW1), peekb(PTSW2), peekb(PTSCK), value,
+                r.brdc, r.mtrl, r.ptsl, r.ptsw1, r.ptsw2, r.ptsck, r.value );
+        }
+    }
+    assert( ok );
+    return ok;
+}
+
+std::string sargon_points_report_stats()
+{
+    std::string s = util::sprintf( "POINTS() native evaluations=%lu, differential checks=%lu, mismatches=%lu",
+        native_evaluations, differential_checks, differential_mismatches );
+    if( first_mismatch != "" )
+        s += "\nFirst mismatch: " + first_mismatch;
+    return s;
+}
@@ -0,0 +1,66 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-points.h
+ *       Native C++ implementation of Sargon's POINTS() evaluation
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_POINTS_H_INCLUDED
+#define SARGON_POINTS_H_INCLUDED
+
+#include <string>
+
+// Which implementation of POINTS() does Sargon use ?
+enum POINTS_MODE
+{
+    POINTS_ASM,             // original assembly language (the default)
+    POINTS_NATIVE,          // native C++ replacement
+    POINTS_DIFFERENTIAL     // assembly language, checked against native C++
+};
+
+// Results of a native evaluation, these are the Sargon variables of the
+//  same name, plus the final score (as returned in al)
+struct POINTS_RESULT
+{
+    unsigned char brdc;
+    unsigned char mtrl;
+    unsigned char ptsl;
+    unsigned char ptsw1;
+    unsigned char ptsw2;
+    unsigned char ptsck;
+    unsigned char value;
+};
+
+// Select an implementation, normally once at startup
+void sargon_points_set_mode( POINTS_MODE mode );
+POINTS_MODE sargon_points_get_mode();
+
+// Native ATTACK uses precomputed ray tables and an occupancy bitboard by
+//  default, or steps through the board one square at a time like the
+//  original if false
+void sargon_points_set_rays( bool rays );
+
+// Micro-benchmark, evaluate the current Sargon position natively, both ways,
+//  iterations times each. Checks the results are identical, returns report
+std::string sargon_points_benchmark( unsigned long iterations, bool &ok, double &ns_steps, double &ns_rays );
+
+// Evaluate the current Sargon position natively, without changing any Sargon
+//  variables
+void sargon_points_native( POINTS_RESULT &r );
+
+// Call from the "native POINTS()" callback, evaluates natively, stores the
+//  results in the Sargon variables and returns the score to go in al
+unsigned char sargon_points_callback_native();
+
+// Call from the "end of POINTS()" callback with the score in al (before any
+//  other callback modifies it). In differential mode asserts that the native
+//  evaluation matches the assembly language evaluation exactly
+bool sargon_points_callback_end_of_points( unsigned char value );
+
+std::string sargon_points_report_stats();
+
+#endif // SARGON_POINTS_H_INCLUDED
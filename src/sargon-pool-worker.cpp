@@ -0,0 +1,260 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-pool-worker.cpp
+ *       The worker side of the pool, analyse positions from stdin
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "util.h"
+#include "thc.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-pv.h"
+#include "sargon-pool.h"
+
+static unsigned long elapsed_milliseconds( std::chrono::time_point<std::chrono::steady_clock> base )
+{
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
+    return static_cast<unsigned long>(ms.count());
+}
+
+//
+//  Worker, analyse positions from stdin, results to stdout
+//
+
+static unsigned long nodes;
+static unsigned long callbacks;
+static std::vector<thc::Move> searchmoves;     // if not empty, only search these moves
+
+// Timed analysis, as in sargon-engine the callback aborts Sargon with longjmp()
+static jmp_buf jmp_buf_env;
+static bool timing;
+static unsigned long time_limit;
+static std::chrono::time_point<std::chrono::steady_clock> time_base;
+
+extern "C" {
+    void sargon_callback( const char *msg, z80_registers & )   // registers not needed
+    {
+        callbacks++;
+        if( 0 == strcmp(msg,"end of POINTS()") )
+        {
+            nodes++;
+            sargon_pv_callback_end_of_points();
+        }
+        else if( 0 == strcmp(msg,"Yes! Best move") )
+            sargon_pv_callback_yes_best_move();
+        else if( 0 == strcmp(msg,"after GENMOV()") )
+        {
+            if( peekb(NPLY)==1 && searchmoves.size()>0 )
+                sargon_remove_root_moves( searchmoves, true );
+        }
+
+        // Abort when out of time (but not PLYMAX==1 which is effectively
+        //  instantaneous, and finds a baseline move). Don't read the clock
+        //  on every callback
+        if( timing && (callbacks&0x3f)==0 && peekb(PLYMAX)>1 && elapsed_milliseconds(time_base)>=time_limit )
+            longjmp( jmp_buf_env, 1 );
+    }
+};
+
+// Run Sargon, returns false if aborted (in which case pv is unchanged)
+static bool run_sargon( const thc::ChessRules &cr, int plymax, PV &pv )
+{
+    if( setjmp(jmp_buf_env) )
+        return false;
+    sargon_run_engine( cr, plymax, pv, true );
+    return true;
+}
+
+static std::string json_string( const std::string &s )
+{
+    std::string ret = "\"";
+    for( char c: s )
+    {
+        if( c=='"' || c=='\\' )
+        {
+            ret += '\\';
+            ret += c;
+        }
+        else if( static_cast<unsigned char>(c) < ' ' )
+            ret += util::sprintf( "\\u%04x", c );
+        else
+            ret += c;
+    }
+    ret += '"';
+    return ret;
+}
+
+// An EPD line has the four position fields of a FEN followed by operations
+//  like bm Nf3; id "test 1"; A FEN line has the position fields followed by
+//  the halfmove clock and move number
+static bool parse_epd( const std::string &line, std::string &fen, std::string &id )
+{
+    std::vector<std::string> fields;
+    util::split( line, fields );
+    if( fields.size() < 4 )
+        return false;
+    fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    if( fields.size()>=6 && isdigit(fields[4][0]) && isdigit(fields[5][0]) )
+        fen += " " + fields[4] + " " + fields[5];
+    else
+        fen += " 0 1";
+    id.clear();
+    size_t offset = line.find(" id \"");
+    if( offset != std::string::npos )
+    {
+        offset += 5;
+        size_t end = line.find('"',offset);
+        if( end != std::string::npos )
+            id = line.substr(offset,end-offset);
+    }
+    return true;
+}
+
+// Analyse one position, returning the JSON result. Options optionally
+//  override the depth and time, and restrict the moves searched, eg
+//  "depth 6 time 2000 searchmoves e2e4 d2d4"
+static std::string analyse( unsigned long idx, const std::string &line, const std::string &options, int plymax, int movetime_ms )
+{
+    std::string json = util::sprintf( "{\"index\":%lu", idx );
+    std::string fen, id;
+    thc::ChessRules cr;
+    thc::TERMINAL terminal;
+    bool ok = parse_epd( line, fen, id ) && cr.Forsyth( fen.c_str() );
+    if( id.length() > 0 )
+        json += ",\"id\":" + json_string(id);
+    json += ",\"fen\":" + json_string( ok ? fen : line );
+    if( !ok )
+        return json + ",\"error\":\"bad position\"}";
+    if( !cr.Evaluate(terminal) )
+        return json + ",\"error\":\"illegal position\"}";
+    if( terminal != thc::NOT_TERMINAL )
+        return json + ",\"error\":\"no legal moves\"}";
+    std::vector<std::string> fields;
+    util::split( options, fields );
+    searchmoves.clear();
+    bool in_searchmoves = false;
+    for( size_t i=0; i<fields.size(); i++ )
+    {
+        thc::Move mv;
+        if( fields[i]=="depth" && i+1<fields.size() )
+        {
+            plymax = atoi( fields[++i].c_str() );
+            in_searchmoves = false;
+        }
+        else if( fields[i]=="time" && i+1<fields.size() )
+        {
+            movetime_ms = atoi( fields[++i].c_str() );
+            in_searchmoves = false;
+        }
+        else if( fields[i] == "searchmoves" )
+            in_searchmoves = true;
+        else if( in_searchmoves && mv.TerseIn(&cr,fields[i].c_str()) )
+            searchmoves.push_back(mv);
+        else
+            return json + ",\"error\":" + json_string("bad option " + fields[i]) + "}";
+    }
+    if( plymax < 1 )
+        plymax = 1;
+    else if( plymax > 20 )
+        plymax = 20;
+    std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+    nodes = 0;
+    PV pv;
+    int depth = plymax;
+    if( movetime_ms <= 0 )
+        sargon_run_engine( cr, plymax, pv, true );
+    else
+    {
+        time_base  = base;
+        time_limit = static_cast<unsigned long>(movetime_ms);
+        timing = true;
+        depth = 0;
+        for( int d=1; d<=plymax; d++ )
+        {
+            if( !run_sargon(cr,d,pv) )
+                break;
+            depth = d;  // deepest complete iteration
+            if( elapsed_milliseconds(base) >= time_limit )
+                break;
+        }
+        timing = false;
+    }
+    unsigned long ms = elapsed_milliseconds(base);
+    searchmoves.clear();
+
+    // Normally the best move is the first move of the PV, as in sargon-engine
+    thc::Move bestmove;
+    if( pv.variation.size() > 0 )
+        bestmove = pv.variation[0];
+    else if( !bestmove.TerseIn( &cr, sargon_export_move(BESTM).c_str() ) )
+        return json + ",\"error\":\"no move found\"}";
+    thc::ChessRules tmp = cr;
+    std::string san = bestmove.NaturalOut(&tmp);
+
+    // As in sargon-engine, a PV that ends in mate or stalemate overrides
+    //  Sargon's value
+    std::string san_pv;
+    std::string score = util::sprintf( "\"cp\":%d", cr.white ? pv.value : 0-pv.value );
+    tmp = cr;
+    for( unsigned int i=0; i<pv.variation.size(); i++ )
+    {
+        thc::Move mv = pv.variation[i];
+        if( san_pv.length() > 0 )
+            san_pv += " ";
+        san_pv += mv.NaturalOut(&tmp);
+        tmp.PlayMove(mv);
+        if( tmp.Evaluate(terminal) && terminal!=thc::NOT_TERMINAL )
+        {
+            if( terminal==thc::TERMINAL_WCHECKMATE || terminal==thc::TERMINAL_BCHECKMATE )
+                score = util::sprintf( "\"mate\":%d", i%2==0 ? (i+2)/2 : 0-(i+2)/2 );
+            else
+                score = "\"cp\":0";
+            break;
+        }
+    }
+    if( san_pv.length() == 0 )
+        san_pv = san;
+    json += util::sprintf( ",\"bestmove\":\"%s\",\"san\":%s,\"pv\":%s,%s,\"depth\":%d,\"nodes\":%lu,\"time\":%lu}",
+                bestmove.TerseOut().c_str(), json_string(san).c_str(), json_string(san_pv).c_str(),
+                score.c_str(), depth, nodes, ms );
+    return json;
+}
+
+int sargon_pool_worker( int plymax, int movetime_ms )
+{
+    static char buf[8192];
+    while( fgets(buf,sizeof(buf)-2,stdin) )
+    {
+        std::string s(buf);
+        util::rtrim(s);
+        size_t offset = s.find('\t');
+        if( offset == std::string::npos )
+            continue;
+        unsigned long idx = strtoul( s.c_str(), NULL, 10 );
+        std::string position = s.substr(offset+1);
+        std::string options;
+        offset = position.find('\t');
+        if( offset != std::string::npos )
+        {
+            options  = position.substr(offset+1);
+            position = position.substr(0,offset);
+        }
+        std::string json = analyse( idx, position, options, plymax, movetime_ms );
+        fprintf( stdout, "%lu\t%s\n", idx, json.c_str() );
+        fflush( stdout );
+    }
+    return 0;
+}
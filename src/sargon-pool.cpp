@@ -0,0 +1,358 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-pool.cpp
+ *       A pool of worker processes analysing positions in parallel
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#include "util.h"
+#include "sargon-pool.h"
+
+// A minimal reader for the flat JSON results of sargon-pool-worker.cpp
+std::string sargon_pool_field( const std::string &json, const std::string &name )
+{
+    std::string key = "\"" + name + "\":";
+    size_t offset = json.find(key);
+    if( offset == std::string::npos )
+        return "";
+    offset += key.length();
+    std::string ret;
+    if( offset<json.length() && json[offset]=='"' )
+    {
+        for( offset++; offset<json.length() && json[offset]!='"'; offset++ )
+        {
+            if( json[offset]=='\\' && offset+1<json.length() )
+                offset++;
+            ret += json[offset];
+        }
+    }
+    else
+    {
+        size_t end = json.find_first_of( ",}", offset );
+        ret = json.substr( offset, end==std::string::npos ? std::string::npos : end-offset );
+    }
+    return ret;
+}
+
+//
+//  Worker processes, each connected to the master with a pair of pipes
+//
+
+struct WorkerProcess
+{
+    FILE *to;       // worker's stdin
+    FILE *from;     // worker's stdout
+#ifdef _WIN32
+    HANDLE process;
+#else
+    pid_t pid;
+#endif
+};
+
+static std::vector<WorkerProcess> workers;
+static std::vector<std::thread> readers;
+
+static std::string own_path()
+{
+#ifdef _WIN32
+    char buf[MAX_PATH+1];
+    DWORD len = GetModuleFileNameA( NULL, buf, MAX_PATH );
+    return std::string( buf, len );
+#else
+    char buf[4096];
+    ssize_t len = readlink( "/proc/self/exe", buf, sizeof(buf)-1 );
+    return len>0 ? std::string(buf,len) : std::string("/proc/self/exe");
+#endif
+}
+
+static bool worker_start( WorkerProcess &w, int plymax, int movetime_ms )
+{
+    std::string path = own_path();
+    std::string depth = util::sprintf( "%d", plymax );
+    std::string movetime = util::sprintf( "%d", movetime_ms );
+#ifdef _WIN32
+
+    // The master's ends of the pipes must not be inherited, otherwise other
+    //  workers would hold them open, and a worker would never see end of file
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+    HANDLE in_read, in_write, out_read, out_write;
+    if( !CreatePipe(&in_read,&in_write,&sa,0) )
+        return false;
+    if( !CreatePipe(&out_read,&out_write,&sa,0) )
+    {
+        CloseHandle(in_read);
+        CloseHandle(in_write);
+        return false;
+    }
+    SetHandleInformation( in_write, HANDLE_FLAG_INHERIT, 0 );
+    SetHandleInformation( out_read, HANDLE_FLAG_INHERIT, 0 );
+    STARTUPINFOA si;
+    memset( &si, 0, sizeof(si) );
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput  = in_read;
+    si.hStdOutput = out_write;
+    si.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION pi;
+    std::string cmd = "\"" + path + "\" -worker -depth " + depth + " -time " + movetime;
+    std::vector<char> cmd_buf( cmd.begin(), cmd.end() );
+    cmd_buf.push_back('\0');
+    bool ok = CreateProcessA( NULL, &cmd_buf[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi ) != 0;
+    CloseHandle(in_read);
+    CloseHandle(out_write);
+    if( !ok )
+    {
+        CloseHandle(in_write);
+        CloseHandle(out_read);
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    w.process = pi.hProcess;
+    w.to   = _fdopen( _open_osfhandle(reinterpret_cast<intptr_t>(in_write),0), "w" );
+    w.from = _fdopen( _open_osfhandle(reinterpret_cast<intptr_t>(out_read),_O_RDONLY), "r" );
+#else
+    int in[2], out[2];
+    if( pipe(in) != 0 )
+        return false;
+    if( pipe(out) != 0 )
+    {
+        close(in[0]);
+        close(in[1]);
+        return false;
+    }
+
+    // As for Windows, the master's ends of the pipes must not be inherited
+    fcntl( in[1],  F_SETFD, FD_CLOEXEC );
+    fcntl( out[0], F_SETFD, FD_CLOEXEC );
+    pid_t pid = fork();
+    if( pid == 0 )
+    {
+        dup2( in[0], 0 );
+        dup2( out[1], 1 );
+        close(in[0]);
+        close(out[1]);
+        execl( path.c_str(), path.c_str(), "-worker", "-depth", depth.c_str(), "-time", movetime.c_str(), (char *)NULL );
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    if( pid < 0 )
+    {
+        close(in[1]);
+        close(out[0]);
+        return false;
+    }
+    w.pid  = pid;
+    w.to   = fdopen( in[1], "w" );
+    w.from = fdopen( out[0], "r" );
+#endif
+    return w.to!=NULL && w.from!=NULL;
+}
+
+// Close the worker's stdin, so it finishes, and wait for it
+static void worker_stop( WorkerProcess &w )
+{
+    if( w.to )
+        fclose( w.to );
+    w.to = NULL;
+#ifdef _WIN32
+    WaitForSingleObject( w.process, INFINITE );
+    CloseHandle( w.process );
+#else
+    int status;
+    waitpid( w.pid, &status, 0 );
+#endif
+}
+
+// A result, or a worker reporting it has stopped (json empty)
+struct Result
+{
+    int worker;
+    unsigned long idx;
+    std::string json;
+};
+
+static std::mutex results_mtx;
+static std::condition_variable results_cv;
+static std::deque<Result> results;
+static void (*notify)();
+
+static void post( const Result &r )
+{
+    {
+        std::lock_guard<std::mutex> lck(results_mtx);
+        results.push_back(r);
+        results_cv.notify_one();
+    }
+    if( notify )
+        notify();
+}
+
+static void read_worker( int worker, FILE *from )
+{
+    static const int MAXLEN = 65536;
+    std::vector<char> buf(MAXLEN);
+    Result r;
+    r.worker = worker;
+    while( fgets(&buf[0],MAXLEN-2,from) )
+    {
+        std::string s(&buf[0]);
+        util::rtrim(s);
+        size_t offset = s.find('\t');
+        if( offset == std::string::npos )
+            continue;
+        r.idx  = strtoul( s.c_str(), NULL, 10 );
+        r.json = s.substr(offset+1);
+        post( r );
+    }
+    r.idx = 0;
+    r.json.clear();
+    post( r );
+}
+
+//
+//  Master side
+//
+
+static int pool_plymax;
+static int pool_movetime_ms;
+
+bool sargon_pool_start( int nbr_workers, int plymax, int movetime_ms )
+{
+    pool_plymax = plymax;
+    pool_movetime_ms = movetime_ms;
+    if( nbr_workers <= 0 )
+        nbr_workers = static_cast<int>( std::thread::hardware_concurrency() );
+    if( nbr_workers <= 0 )
+        nbr_workers = 1;
+#ifndef _WIN32
+    signal( SIGPIPE, SIG_IGN );  // a worker that dies is reported, not fatal to the master
+#endif
+    for( int i=0; i<nbr_workers; i++ )
+    {
+        WorkerProcess w;
+        if( !worker_start(w,plymax,movetime_ms) )
+        {
+            sargon_pool_stop();
+            return false;
+        }
+        workers.push_back(w);
+        readers.push_back( std::thread(read_worker,i,w.from) );
+    }
+    return true;
+}
+
+int sargon_pool_size()
+{
+    return static_cast<int>( workers.size() );
+}
+
+void sargon_pool_send( int worker, unsigned long idx, const std::string &position, const std::string &options )
+{
+    FILE *to = workers[worker].to;
+    if( options.length() > 0 )
+        fprintf( to, "%lu\t%s\t%s\n", idx, position.c_str(), options.c_str() );
+    else
+        fprintf( to, "%lu\t%s\n", idx, position.c_str() );
+    fflush( to );
+}
+
+bool sargon_pool_ready()
+{
+    std::lock_guard<std::mutex> lck(results_mtx);
+    return !results.empty();
+}
+
+void sargon_pool_notify( void (*fn)() )
+{
+    notify = fn;
+}
+
+// Kill the worker, discard anything it has reported and start a new one
+bool sargon_pool_cancel( int worker )
+{
+    WorkerProcess &w = workers[worker];
+#ifdef _WIN32
+    TerminateProcess( w.process, 1 );
+#else
+    kill( w.pid, SIGKILL );
+#endif
+    worker_stop( w );
+    readers[worker].join();
+    fclose( w.from );
+    {
+        std::lock_guard<std::mutex> lck(results_mtx);
+        for( auto it=results.begin(); it!=results.end(); )
+        {
+            if( it->worker == worker )
+                it = results.erase(it);
+            else
+                ++it;
+        }
+    }
+    if( !worker_start(w,pool_plymax,pool_movetime_ms) )
+    {
+        w.to = NULL;
+        w.from = NULL;
+        return false;
+    }
+    readers[worker] = std::thread(read_worker,worker,w.from);
+    return true;
+}
+
+bool sargon_pool_result( int &worker, unsigned long &idx, std::string &json )
+{
+    std::unique_lock<std::mutex> lck(results_mtx);
+    results_cv.wait( lck, []{return !results.empty();} );
+    Result r = results.front();
+    results.pop_front();
+    worker = r.worker;
+    idx    = r.idx;
+    json   = r.json;
+    return json.length() > 0;
+}
+
+// Stop the workers, each reader thread then posts its end of file
+void sargon_pool_stop()
+{
+    for( WorkerProcess &w: workers )
+        worker_stop( w );
+    for( std::thread &t: readers )
+    {
+        if( t.joinable() )
+            t.join();
+    }
+    for( WorkerProcess &w: workers )
+    {
+        if( w.from )
+            fclose( w.from );
+    }
+    workers.clear();
+    readers.clear();
+    results.clear();
+}
@@ -0,0 +1,69 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-pool.h
+ *       A pool of worker processes analysing positions in parallel
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_POOL_H_INCLUDED
+#define SARGON_POOL_H_INCLUDED
+
+#include <string>
+
+// Sargon's state is a single 64K memory image, so positions are analysed in
+//  parallel by worker processes, not threads. A worker is the same program
+//  as the master, started with the switches -worker -depth N -time MS (so
+//  programs using the pool must pass those to sargon_pool_worker()). The
+//  worker side is in sargon-pool-worker.cpp, the master side and
+//  sargon_pool_field() in sargon-pool.cpp. sargon-engine -sessions links
+//  the master side only, its workers are engines, not analysers.
+
+// Worker side; read "index<tab>position" lines (optionally followed by
+//  "<tab>options", see sargon_pool_send()) from stdin, a position is a FEN
+//  or an EPD line, and write "index<tab>result" lines to stdout. If
+//  movetime_ms is non zero, analysis deepens iteratively up to plymax until
+//  movetime_ms has elapsed. Returns the program's exit code
+int sargon_pool_worker( int plymax, int movetime_ms );
+
+// The result is a single line JSON object with the fields index, id (if the
+//  EPD has an id operation), fen, and either error or bestmove (terse),
+//  san, pv (SAN), cp (centipawns from the side to move's point of view) or
+//  mate (in N moves, negative if the side to move is mated), depth, nodes
+//  (calls to POINTS()) and time (milliseconds)
+std::string sargon_pool_field( const std::string &json, const std::string &name );
+
+// Master side; start nbr_workers workers (0 = one per core), returns false
+//  if they couldn't be started
+bool sargon_pool_start( int nbr_workers, int plymax, int movetime_ms );
+int  sargon_pool_size();
+
+// Send a position to a worker (0 to sargon_pool_size()-1). A worker should
+//  be given one position at a time, so a long analysis doesn't hold up
+//  positions queued behind it. Options override the depth and time the
+//  workers were started with, and can restrict the moves searched, eg
+//  "depth 6 time 2000 searchmoves e2e4 d2d4"
+void sargon_pool_send( int worker, unsigned long idx, const std::string &position, const std::string &options="" );
+
+// Wait for the next result from any worker. Returns false if a worker
+//  stopped unexpectedly
+bool sargon_pool_result( int &worker, unsigned long &idx, std::string &json );
+
+// Check whether a result is waiting (so sargon_pool_result() won't block),
+//  and optionally have a function called (from another thread) whenever a
+//  result arrives, so the master can wait for results and other events
+bool sargon_pool_ready();
+void sargon_pool_notify( void (*fn)() );
+
+// Abandon a worker's analysis; the worker is killed and replaced, and
+//  nothing more is reported for its position. Returns false if the
+//  replacement couldn't be started
+bool sargon_pool_cancel( int worker );
+
+// Stop the workers (any positions being analysed are completed first)
+void sargon_pool_stop();
+
+#endif // SARGON_POOL_H_INCLUDED
@@ -0,0 +1,117 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-profile.cpp
+ *       Sargon per routine calls and cycle counts
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "sargon-asm-interface.h"
+#include "sargon-profile.h"
+
+/*
+
+  When the x86 code is generated with convert-z80-to-x86 -profile, every
+  CALL of a Sargon routine is bracketed with PROFILE_ENTER n and
+  PROFILE_LEAVE n macros (n identifies the routine, sargon_profile_names[n]
+  in the generated sargon-asm-interface.h). The macros read the time stamp
+  counter and accumulate into the variables below. Total cycles include
+  callees, self cycles exclude them. Time spent in C++ callbacks is counted
+  as self cycles of the routine making the callback.
+
+  The profile stack is indexed by depth, frame 0 is a dummy parent for the
+  outermost call. Frames abandoned by a routine discarding its return
+  address, or by the engine aborting a search with longjmp(), are detected
+  and discarded by the macros, using the esp recorded with each frame.
+  A call nested too deeply for the stack gets no frame, so it isn't timed,
+  it's only counted in sargon_profile_overflows.
+
+*/
+
+#ifdef SARGON_PROFILE
+
+extern "C" {
+    uint32_t sargon_profile_depth = 1;
+    uint32_t sargon_profile_esp[sargon_profile_stack_size] = { 0xffffffff };
+    uint64_t sargon_profile_start[sargon_profile_stack_size];
+    uint64_t sargon_profile_children[sargon_profile_stack_size];
+    uint32_t sargon_profile_overflows;
+    uint32_t sargon_profile_calls[sargon_profile_nbr];
+    uint64_t sargon_profile_total[sargon_profile_nbr];
+    uint64_t sargon_profile_self[sargon_profile_nbr];
+};
+
+bool sargon_profile_available()
+{
+    return true;
+}
+
+void sargon_profile_reset()
+{
+    sargon_profile_depth = 1;
+    sargon_profile_esp[0] = 0xffffffff;
+    sargon_profile_children[0] = 0;
+    sargon_profile_overflows = 0;
+    for( int i=0; i<sargon_profile_nbr; i++ )
+    {
+        sargon_profile_calls[i] = 0;
+        sargon_profile_total[i] = 0;
+        sargon_profile_self[i] = 0;
+    }
+}
+
+std::string sargon_profile_report()
+{
+    std::vector<int> order;
+    uint64_t all_self = 0;
+    for( int i=0; i<sargon_profile_nbr; i++ )
+    {
+        all_self += sargon_profile_self[i];
+        if( sargon_profile_calls[i] > 0 )
+            order.push_back(i);
+    }
+    std::sort( order.begin(), order.end(), [](int a, int b) { return sargon_profile_self[a] > sargon_profile_self[b]; } );
+    std::string s = util::sprintf( "%-8s %12s %14s %14s %7s %10s\n", "routine", "calls", "total cycles", "self cycles", "self %", "self/call" );
+    for( int i: order )
+    {
+        double self = static_cast<double>(sargon_profile_self[i]);
+        s += util::sprintf( "%-8s %12lu %14llu %14llu %6.1f%% %10.0f\n",
+                sargon_profile_names[i],
+                static_cast<unsigned long>(sargon_profile_calls[i]),
+                static_cast<unsigned long long>(sargon_profile_total[i]),
+                static_cast<unsigned long long>(sargon_profile_self[i]),
+                all_self ? 100.0*self/all_self : 0.0,
+                self / sargon_profile_calls[i] );
+    }
+    if( sargon_profile_overflows > 0 )
+        s += util::sprintf( "%lu calls nested more than %d deep not profiled\n",
+                static_cast<unsigned long>(sargon_profile_overflows), sargon_profile_stack_size-1 );
+    return s;
+}
+
+#else
+
+bool sargon_profile_available()
+{
+    return false;
+}
+
+void sargon_profile_reset()
+{
+}
+
+std::string sargon_profile_report()
+{
+    return "Per routine profile not available, generate sargon-x86.asm and sargon-asm-interface.h\n"
+           "with convert-z80-to-x86 -profile\n";
+}
+
+#endif
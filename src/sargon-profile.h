@@ -0,0 +1,28 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-profile.h
+ *       Sargon per routine calls and cycle counts
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_PROFILE_H_INCLUDED
+#define SARGON_PROFILE_H_INCLUDED
+
+#include <string>
+
+// Counters are only available if sargon-x86.asm and sargon-asm-interface.h
+//  were generated with convert-z80-to-x86 -profile
+bool sargon_profile_available();
+
+// Zero all counters, call between (not during) calls to sargon()
+void sargon_profile_reset();
+
+// Table of calls, total cycles and self cycles for each routine, most
+//  expensive (self cycles) first
+std::string sargon_profile_report();
+
+#endif // SARGON_PROFILE_H_INCLUDED
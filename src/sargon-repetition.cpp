@@ -0,0 +1,199 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-repetition.cpp
+ *       Sargon in-search repetition detection
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "thc.h"
+#include "sargon-interface.h"
+#include "sargon-asm-interface.h"
+#include "sargon-repetition.h"
+
+/*
+
+  Sargon itself knows nothing about repetition. The engine has always avoided
+  repeating moves at the root (see repetition_remove_moves() in
+  sargon-engine.cpp), but deeper in the tree Sargon still happily searches
+  shuffling lines to full depth. Here we keep a hash of the position at each
+  ply of the current search path, plus hashes of the game positions that
+  preceded the root. When a newly reached position matches one of them we
+  treat it as a draw.
+
+  The "after GENMOV()" callback is our hook. It is called immediately after
+  FNDMOV has made a move on the board (via MOVE) and descended a ply. So the
+  board at that point is the position at ply NPLY on the current path, and
+  entries in the hash stack below NPLY are always the ancestors of this
+  position (an entry is overwritten whenever the search descends through a
+  different move at that ply). No UNMOVE hook is needed.
+
+  To score a repeated position as a draw, we empty the move list GENMOV has
+  just built and clear CKFLG. FNDMOV then falls straight through to FM25,
+  its "no moves" case, and since the king is not in check it applies the
+  stalemate score of 80H - Sargon's neutral score - and skips the subtree.
+
+*/
+
+// Hash codes indexed by Sargon board index (0-119) and piece code, where
+//  piece code = piece type (1-6) + 8 if black
+static uint64_t hash_codes[120][16];
+static uint64_t hash_black_to_move;
+static bool hash_codes_initialised;
+
+// Hash stack, one entry per ply
+static const int MAX_PLY = 64;
+static uint64_t hash_stack[MAX_PLY];
+
+// Game history hashes, positions before the root since the last irreversible move
+static std::vector<uint64_t> history;
+
+// Stats
+static unsigned long nbr_checked;
+static unsigned long nbr_repeats;
+
+static void hash_codes_init()
+{
+    // Deterministic xorshift64 sequence, we don't need anything fancier
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for( int i=0; i<120; i++ )
+    {
+        for( int j=0; j<16; j++ )
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            hash_codes[i][j] = x;
+        }
+    }
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    hash_black_to_move = x;
+    hash_codes_initialised = true;
+}
+
+// Hash the position currently on Sargon's board. Only piece type and colour
+//  contribute, Sargon's moved and castled flags are ignored (so positions
+//  differing only in castling rights are treated as the same position)
+static uint64_t hash_sargon_board()
+{
+    uint64_t hash = 0;
+    const unsigned char *board = peek(BOARDA);
+    for( int idx=21; idx<=98; idx++ )
+    {
+        unsigned char piece = board[idx];
+        if( piece==0 || piece==0xff )
+            continue;
+        int code = (piece&7) | ((piece&0x80) ? 8 : 0);
+        hash ^= hash_codes[idx][code];
+    }
+    if( peekb(COLOR) & 0x80 )
+        hash ^= hash_black_to_move;
+    return hash;
+}
+
+// Hash a thc position, producing the same result as hash_sargon_board() for
+//  the same position
+static uint64_t hash_thc_position( const thc::ChessPosition &cp )
+{
+    uint64_t hash = 0;
+    for( int sq=0; sq<64; sq++ )
+    {
+        int code=0;
+        switch( cp.squares[sq] )
+        {
+            case 'P': code = 1;     break;
+            case 'N': code = 2;     break;
+            case 'B': code = 3;     break;
+            case 'R': code = 4;     break;
+            case 'Q': code = 5;     break;
+            case 'K': code = 6;     break;
+            case 'p': code = 1+8;   break;
+            case 'n': code = 2+8;   break;
+            case 'b': code = 3+8;   break;
+            case 'r': code = 4+8;   break;
+            case 'q': code = 5+8;   break;
+            case 'k': code = 6+8;   break;
+        }
+        if( code == 0 )
+            continue;
+
+        // thc squares run a8,b8 .. h1, Sargon board index 21=a1 .. 98=h8
+        int file = sq&7;
+        int rank = 7 - (sq>>3);
+        int idx  = 21 + file + 10*rank;
+        hash ^= hash_codes[idx][code];
+    }
+    if( !cp.WhiteToPlay() )
+        hash ^= hash_black_to_move;
+    return hash;
+}
+
+void sargon_repetition_history_clear()
+{
+    history.clear();
+    nbr_checked = 0;
+    nbr_repeats = 0;
+}
+
+void sargon_repetition_history_push( const thc::ChessPosition &cp )
+{
+    if( !hash_codes_initialised )
+        hash_codes_init();
+    history.push_back( hash_thc_position(cp) );
+}
+
+void sargon_repetition_history_swap( std::vector<uint64_t> &saved )
+{
+    history.swap( saved );
+}
+
+bool sargon_repetition_callback_after_genmov()
+{
+    if( !hash_codes_initialised )
+        hash_codes_init();
+    int nply = peekb(NPLY);
+    if( nply<1 || nply>=MAX_PLY )
+        return false;
+    uint64_t hash = hash_sargon_board();
+    hash_stack[nply] = hash;
+    if( nply < 2 )
+        return false;   // never change the root move list
+    nbr_checked++;
+
+    // A position can only repeat with the same side to move, and at least
+    //  four half moves after its earlier occurrence
+    bool repeat = false;
+    for( int i=nply-4; !repeat && i>=1; i-=2 )
+    {
+        if( hash_stack[i] == hash )
+            repeat = true;
+    }
+    for( unsigned int i=0; !repeat && i<history.size(); i++ )
+    {
+        if( history[i] == hash )
+            repeat = true;
+    }
+    if( !repeat )
+        return false;
+
+    // Empty the ply's move list and clear the check flag, so that FNDMOV
+    //  scores the position as a draw (its stalemate score)
+    nbr_repeats++;
+    pokew( peekw(MLPTRI), 0 );
+    pokeb( CKFLG, 0 );
+    return true;
+}
+
+std::string sargon_repetition_report_stats()
+{
+    return util::sprintf( "repetition nodes checked=%lu, repeats found=%lu\n", nbr_checked, nbr_repeats );
+}
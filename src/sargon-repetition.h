@@ -0,0 +1,37 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-repetition.h
+ *       Sargon in-search repetition detection
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_REPETITION_H_INCLUDED
+#define SARGON_REPETITION_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "thc.h"
+
+// Positions that occurred in the game before the root position. Call clear()
+//  then push() each position (with side to move) in game order
+void sargon_repetition_history_clear();
+void sargon_repetition_history_push( const thc::ChessPosition &cp );
+
+// Exchange the game history with a saved history, so that several games can
+//  take turns using the engine
+void sargon_repetition_history_swap( std::vector<uint64_t> &saved );
+
+// Call from the "after GENMOV()" callback. Records the current position in
+//  the per ply hash stack. If the position repeats an earlier position in the
+//  search path or the game history the ply's move list is emptied, so Sargon
+//  scores the node as a draw and skips the subtree. Returns true if so.
+bool sargon_repetition_callback_after_genmov();
+
+std::string sargon_repetition_report_stats();
+
+#endif // SARGON_REPETITION_H_INCLUDED
@@ -0,0 +1,799 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-server.cpp
+ *       Local analysis server, a request queue in front of a worker pool
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+/*
+
+    Clients connect to a Unix domain socket (and optionally a localhost TCP
+    port) and send requests, one JSON object per line;
+
+    {"id":1,"fen":"<fen>","depth":6}
+    {"id":"b","fen":"<fen>","time":2000,"searchmoves":["e2e4","d2d4"],"priority":1,"deadline":5000}
+    {"id":2,"cmd":"cancel","cancel":"b"}
+    {"id":3,"cmd":"stats"}
+
+    The response to an analysis request has the same id, and the fields of
+    a sargon-batch result (see sargon-pool.h), or an error field. The
+    requests are queued, and the highest priority request (then the one with
+    the earliest deadline, then the oldest) goes to the next idle worker of
+    a pool of worker processes (see sargon-pool.h), which stay running
+    between requests.
+
+    A deadline is in milliseconds from when the request is received. A
+    request still queued at its deadline is answered with an error, and a
+    request in progress is given only the time remaining (so depth
+    requests with deadlines use iterative deepening). If a client
+    disconnects, its queued requests are discarded and any workers
+    analysing its requests are killed and replaced.
+
+    Each client has a reader thread, which passes lines to the scheduler,
+    and a writer thread, which sends the responses the scheduler queues,
+    so a client that is slow to read never holds up the scheduler or other
+    clients. A client with more than MAX_OUTBOX bytes of responses unread
+    is disconnected.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+typedef SOCKET socket_t;
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#define SD_BOTH SHUT_RDWR
+#endif
+#include "util.h"
+#include "sargon-pool.h"
+
+// Server parameters
+static int plymax = 5;                      // depth if a request gives neither depth nor time
+static int nbr_workers = 0;                 // 0 means one per core
+static unsigned int max_queue = 1000;       // requests beyond this are rejected
+static std::string socket_path = "sargon-server.sock";
+static int tcp_port = 0;                    // 0 means no TCP listener
+
+typedef std::chrono::time_point<std::chrono::steady_clock> TIME;
+
+static unsigned long elapsed_milliseconds( TIME base, TIME now )
+{
+    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
+    return ms.count()>0 ? static_cast<unsigned long>(ms.count()) : 0;
+}
+
+// A connected client
+struct Client
+{
+    socket_t sock;
+    bool connected;                 // scheduler thread only
+    std::mutex mtx;                 // for the rest, shared with the writer thread
+    std::condition_variable cv;
+    std::deque<std::string> outbox; // responses waiting to be sent
+    size_t outbox_bytes;
+    bool closed;                    // disconnected, writer thread closes the socket
+};
+static const size_t MAX_OUTBOX = 1024*1024;
+
+// A line from a client, or the client disconnecting (line empty)
+struct Event
+{
+    std::shared_ptr<Client> client;
+    std::string line;
+};
+
+// An analysis request, queued or in progress
+struct Request
+{
+    std::shared_ptr<Client> client;
+    std::string id;                 // as JSON, echoed in the response
+    std::string fen;
+    std::string options;            // see sargon_pool_send()
+    int depth;                      // 0 if not given
+    int time_ms;                    // 0 if not given
+    int priority;
+    unsigned long seq;
+    TIME received;
+    bool has_deadline;
+    TIME deadline;
+};
+
+// Statistics
+static unsigned long nbr_completed;
+static unsigned long nbr_expired;
+static unsigned long nbr_cancelled;
+static unsigned long nbr_rejected;
+static std::deque<unsigned long> latencies;     // of the most recent requests
+static const size_t MAX_LATENCIES = 1000;
+
+static std::mutex events_mtx;
+static std::condition_variable events_cv;
+static std::deque<Event> events;
+
+static socket_t listen_unix( const std::string &path );
+static socket_t listen_tcp( int port );
+static void accept_clients( socket_t listener );
+static void scheduler();
+
+int main( int argc, const char *argv[] )
+{
+    const char *usage=
+    "Serve Sargon analysis to local clients, requests are queued and shared\n"
+    "by a pool of worker processes.\n"
+    "\n"
+    "Usage:\n"
+    " sargon-server [switches]\n"
+    "\n"
+    "Switches:\n"
+    " -socket PATH  Listen on Unix domain socket PATH (default sargon-server.sock)\n"
+    " -port N       Also listen on localhost TCP port N\n"
+    " -workers N    Use N worker processes (default one per core)\n"
+    " -depth N      Depth for requests that give neither depth nor time (default 5)\n"
+    " -queue N      Reject requests when N are queued (default 1000)\n"
+    "\n"
+    "The protocol is one JSON object per line, see sargon-server.cpp.\n";
+    int argi = 1;
+    bool worker = false;
+    int movetime = 0;       // workers only, see sargon-pool.h
+    while( argi < argc )
+    {
+        std::string arg( argv[argi] );
+        if( arg=="-socket" && argi+1<argc )
+            socket_path = argv[++argi];
+        else if( arg=="-port" && argi+1<argc )
+            tcp_port = atoi(argv[++argi]);
+        else if( arg=="-workers" && argi+1<argc )
+            nbr_workers = atoi(argv[++argi]);
+        else if( arg=="-depth" && argi+1<argc )
+            plymax = atoi(argv[++argi]);
+        else if( arg=="-queue" && argi+1<argc )
+            max_queue = static_cast<unsigned int>( atoi(argv[++argi]) );
+        else if( arg=="-worker" )
+            worker = true;
+        else if( arg=="-time" && argi+1<argc )
+            movetime = atoi(argv[++argi]);
+        else
+        {
+            printf( "Unknown switch %s\n", arg.c_str() );
+            printf( "%s\n", usage );
+            return -1;
+        }
+        argi++;
+    }
+    if( plymax < 1 )
+        plymax = 1;
+    else if( plymax > 20 )
+        plymax = 20;
+    if( worker )
+        return sargon_pool_worker( plymax, movetime );
+#ifdef _WIN32
+    WSADATA wsa;
+    if( WSAStartup(MAKEWORD(2,2),&wsa) != 0 )
+    {
+        fprintf( stderr, "Cannot initialise sockets\n" );
+        return -1;
+    }
+#endif
+    socket_t unix_listener = listen_unix( socket_path );
+    if( unix_listener == INVALID_SOCKET )
+    {
+        fprintf( stderr, "Cannot listen on %s\n", socket_path.c_str() );
+        return -1;
+    }
+    socket_t tcp_listener = INVALID_SOCKET;
+    if( tcp_port > 0 )
+    {
+        tcp_listener = listen_tcp( tcp_port );
+        if( tcp_listener == INVALID_SOCKET )
+        {
+            fprintf( stderr, "Cannot listen on localhost port %d\n", tcp_port );
+            return -1;
+        }
+    }
+    if( !sargon_pool_start(nbr_workers,plymax,0) )
+    {
+        fprintf( stderr, "Cannot start worker processes\n" );
+        return -1;
+    }
+    nbr_workers = sargon_pool_size();
+    fprintf( stderr, "sargon-server listening on %s", socket_path.c_str() );
+    if( tcp_listener != INVALID_SOCKET )
+        fprintf( stderr, " and localhost port %d", tcp_port );
+    fprintf( stderr, ", %d workers\n", nbr_workers );
+    std::thread( accept_clients, unix_listener ).detach();
+    if( tcp_listener != INVALID_SOCKET )
+        std::thread( accept_clients, tcp_listener ).detach();
+    scheduler();    // never returns
+    return 0;
+}
+
+//
+//  Sockets
+//
+
+static socket_t listen_unix( const std::string &path )
+{
+    socket_t s = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( s == INVALID_SOCKET )
+        return s;
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    if( path.length() >= sizeof(addr.sun_path) )
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    strcpy( addr.sun_path, path.c_str() );
+    remove( path.c_str() );     // left over from an earlier run
+    if( bind(s,reinterpret_cast<struct sockaddr *>(&addr),sizeof(addr))!=0 || listen(s,SOMAXCONN)!=0 )
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static socket_t listen_tcp( int port )
+{
+    socket_t s = socket( AF_INET, SOCK_STREAM, 0 );
+    if( s == INVALID_SOCKET )
+        return s;
+    int on = 1;
+    setsockopt( s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on) );
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons( static_cast<unsigned short>(port) );
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );    // local clients only
+    if( bind(s,reinterpret_cast<struct sockaddr *>(&addr),sizeof(addr))!=0 || listen(s,SOMAXCONN)!=0 )
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static void post_event( const Event &e )
+{
+    std::lock_guard<std::mutex> lck(events_mtx);
+    events.push_back(e);
+    events_cv.notify_one();
+}
+
+// Called by the pool when a result arrives
+static void pool_notify()
+{
+    std::lock_guard<std::mutex> lck(events_mtx);
+    events_cv.notify_one();
+}
+
+// Pass a client's requests to the scheduler, one line at a time
+static void read_client( std::shared_ptr<Client> client )
+{
+    static const size_t MAXLEN = 65536;
+    std::string line;
+    char buf[4096];
+    for(;;)
+    {
+        int len = recv( client->sock, buf, sizeof(buf), 0 );
+        if( len <= 0 )
+            break;
+        for( int i=0; i<len; i++ )
+        {
+            if( buf[i] == '\n' )
+            {
+                util::rtrim(line);
+                if( line.length() > 0 )
+                {
+                    Event e;
+                    e.client = client;
+                    e.line = line;
+                    post_event(e);
+                }
+                line.clear();
+            }
+            else if( line.length() < MAXLEN )
+                line += buf[i];
+        }
+    }
+    Event e;
+    e.client = client;
+    post_event(e);
+}
+
+// Send a client's queued responses, until the scheduler sees it disconnect
+static void write_client( std::shared_ptr<Client> client )
+{
+    std::unique_lock<std::mutex> lck(client->mtx);
+    bool ok = true;
+    for(;;)
+    {
+        client->cv.wait( lck, [&]{ return client->closed || !client->outbox.empty(); } );
+        if( client->closed )
+            break;
+        std::string s = client->outbox.front();
+        client->outbox.pop_front();
+        client->outbox_bytes -= s.length();
+        lck.unlock();
+        const char *p = s.c_str();
+        size_t len = s.length();
+        while( ok && len>0 )
+        {
+            int n = send( client->sock, p, static_cast<int>(len), 0 );
+            if( n <= 0 )
+            {
+                shutdown( client->sock, SD_BOTH );   // reader sees a disconnect
+                ok = false;
+            }
+            else
+            {
+                p += n;
+                len -= n;
+            }
+        }
+        lck.lock();
+    }
+    closesocket( client->sock );
+}
+
+// Accept connections. An error like running out of file descriptors can
+//  persist until other clients disconnect, so retry with a growing delay
+//  rather than spinning
+static void accept_clients( socket_t listener )
+{
+    int delay = 0;
+    for(;;)
+    {
+        socket_t s = accept( listener, NULL, NULL );
+        if( s == INVALID_SOCKET )
+        {
+            if( delay == 0 )
+                fprintf( stderr, "Cannot accept connections, retrying\n" );
+            delay = delay==0 ? 10 : std::min(2*delay,1000);
+            std::this_thread::sleep_for( std::chrono::milliseconds(delay) );
+            continue;
+        }
+        if( delay > 0 )
+            fprintf( stderr, "Accepting connections again\n" );
+        delay = 0;
+        std::shared_ptr<Client> client = std::make_shared<Client>();
+        client->sock = s;
+        client->connected = true;
+        client->outbox_bytes = 0;
+        client->closed = false;
+        std::thread( read_client, client ).detach();
+        std::thread( write_client, client ).detach();
+    }
+}
+
+// Queue a response for the client's writer thread, never blocks
+static void respond( Client &client, const std::string &json )
+{
+    if( !client.connected )
+        return;
+    std::lock_guard<std::mutex> lck(client.mtx);
+    if( client.outbox_bytes > MAX_OUTBOX )
+        return;     // already being disconnected
+    std::string s = json + "\n";
+    client.outbox_bytes += s.length();
+    client.outbox.push_back(s);
+    if( client.outbox_bytes > MAX_OUTBOX )
+        shutdown( client.sock, SD_BOTH );   // not reading, reader sees a disconnect
+    client.cv.notify_one();
+}
+
+//
+//  Requests
+//
+
+// Skip a JSON string, i indexes the opening quote and ends up after the closing quote
+static bool skip_string( const std::string &s, size_t &i )
+{
+    for( i++; i<s.length() && s[i]!='"'; i++ )
+    {
+        if( s[i] == '\\' )
+            i++;
+    }
+    if( i >= s.length() )
+        return false;
+    i++;
+    return true;
+}
+
+// A minimal parser for the flat JSON objects of the protocol. Values are
+//  kept as JSON text, so strings keep their quotes and arrays their brackets
+static bool parse_object( const std::string &s, std::map<std::string,std::string> &fields )
+{
+    size_t i = s.find_first_not_of(" \t");
+    if( i==std::string::npos || s[i]!='{' )
+        return false;
+    i = s.find_first_not_of( " \t", i+1 );
+    if( i!=std::string::npos && s[i]=='}' )
+        return true;
+    while( i!=std::string::npos && s[i]=='"' )
+    {
+        size_t start = i;
+        if( !skip_string(s,i) )
+            return false;
+        std::string key = s.substr( start+1, i-start-2 );
+        i = s.find_first_not_of( " \t", i );
+        if( i==std::string::npos || s[i]!=':' )
+            return false;
+        i = s.find_first_not_of( " \t", i+1 );
+        if( i == std::string::npos )
+            return false;
+        start = i;
+        if( s[i] == '"' )
+        {
+            if( !skip_string(s,i) )
+                return false;
+        }
+        else if( s[i] == '[' )
+        {
+            for( i++; i<s.length() && s[i]!=']'; )
+            {
+                if( s[i] != '"' )
+                    i++;
+                else if( !skip_string(s,i) )
+                    return false;
+            }
+            if( i >= s.length() )
+                return false;
+            i++;
+        }
+        else
+        {
+            while( i<s.length() && s[i]!=',' && s[i]!='}' && s[i]!=' ' )
+                i++;
+        }
+        fields[key] = s.substr( start, i-start );
+        i = s.find_first_not_of( " \t", i );
+        if( i == std::string::npos )
+            return false;
+        if( s[i] == '}' )
+            return true;
+        if( s[i] != ',' )
+            return false;
+        i = s.find_first_not_of( " \t", i+1 );
+    }
+    return false;
+}
+
+// The text of a JSON string (or the JSON text of any other value)
+static std::string json_text( const std::string &raw )
+{
+    if( raw.length()<2 || raw[0]!='"' )
+        return raw;
+    std::string ret;
+    for( size_t i=1; i+1<raw.length(); i++ )
+    {
+        if( raw[i]=='\\' && i+2<raw.length() )
+        {
+            i++;
+            ret += (raw[i]=='n' ? '\n' : (raw[i]=='t' ? '\t' : raw[i]));
+        }
+        else
+            ret += raw[i];
+    }
+    return ret;
+}
+
+// The elements of a JSON array of strings, separated by spaces
+static std::string json_array( const std::string &raw )
+{
+    std::string ret;
+    size_t i = 0;
+    while( i < raw.length() )
+    {
+        if( raw[i] != '"' )
+            i++;
+        else
+        {
+            size_t start = i;
+            if( !skip_string(raw,i) )
+                break;
+            if( ret.length() > 0 )
+                ret += " ";
+            ret += json_text( raw.substr(start,i-start) );
+        }
+    }
+    return ret;
+}
+
+static std::string error_response( const std::string &id, const std::string &msg )
+{
+    return "{\"id\":" + id + ",\"error\":\"" + msg + "\"}";
+}
+
+// Nearest rank percentile of sorted, non empty, v, ie v[ceil(percent*n/100)-1]
+static unsigned long percentile( const std::vector<unsigned long> &v, size_t percent )
+{
+    size_t rank = (percent*v.size() + 99) / 100;
+    if( rank < 1 )
+        rank = 1;
+    else if( rank > v.size() )
+        rank = v.size();
+    return v[rank-1];
+}
+
+static std::string stats_response( const std::string &id, size_t nbr_queued, int nbr_running )
+{
+    std::vector<unsigned long> v( latencies.begin(), latencies.end() );
+    std::sort( v.begin(), v.end() );
+    unsigned long p50=0, p90=0, p99=0, max=0;
+    if( v.size() > 0 )
+    {
+        p50 = percentile( v, 50 );
+        p90 = percentile( v, 90 );
+        p99 = percentile( v, 99 );
+        max = v[ v.size()-1 ];
+    }
+    return util::sprintf( "{\"id\":%s,\"queued\":%lu,\"running\":%d,\"workers\":%d,"
+                          "\"completed\":%lu,\"expired\":%lu,\"cancelled\":%lu,\"rejected\":%lu,"
+                          "\"latency\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}}",
+                id.c_str(), static_cast<unsigned long>(nbr_queued), nbr_running, nbr_workers,
+                nbr_completed, nbr_expired, nbr_cancelled, nbr_rejected,
+                p50, p90, p99, max );
+}
+
+// Highest priority first, then earliest deadline, then oldest
+static bool before( const Request &a, const Request &b )
+{
+    if( a.priority != b.priority )
+        return a.priority > b.priority;
+    if( a.has_deadline != b.has_deadline )
+        return a.has_deadline;
+    if( a.has_deadline && a.deadline!=b.deadline )
+        return a.deadline < b.deadline;
+    return a.seq < b.seq;
+}
+
+//
+//  Scheduler, the only thread that touches the queue, the pool and the
+//   statistics, and the only thread that writes to clients
+//
+
+static void scheduler()
+{
+    std::vector<Request> queue;
+    std::vector<Request> running( nbr_workers );
+    std::vector<bool> busy( nbr_workers, false );
+    unsigned long seq = 0;
+    sargon_pool_notify( pool_notify );
+    for(;;)
+    {
+        // Wait for client events, results, or the next deadline of a queued request
+        std::deque<Event> todo;
+        {
+            std::unique_lock<std::mutex> lck(events_mtx);
+            auto ready = []{ return !events.empty() || sargon_pool_ready(); };
+            bool has_deadline = false;
+            TIME next_deadline;
+            for( const Request &r: queue )
+            {
+                if( r.has_deadline && (!has_deadline || r.deadline<next_deadline) )
+                {
+                    next_deadline = r.deadline;
+                    has_deadline = true;
+                }
+            }
+            if( has_deadline )
+                events_cv.wait_until( lck, next_deadline, ready );
+            else
+                events_cv.wait( lck, ready );
+            todo.swap(events);
+        }
+        TIME now = std::chrono::steady_clock::now();
+
+        // Requests and disconnects
+        for( Event &e: todo )
+        {
+            Client &client = *e.client;
+            if( e.line.length() == 0 )
+            {
+                for( size_t i=0; i<queue.size(); )
+                {
+                    if( queue[i].client == e.client )
+                    {
+                        queue.erase( queue.begin()+i );
+                        nbr_cancelled++;
+                    }
+                    else
+                        i++;
+                }
+                for( int i=0; i<nbr_workers; i++ )
+                {
+                    if( busy[i] && running[i].client==e.client )
+                    {
+                        if( !sargon_pool_cancel(i) )
+                            fprintf( stderr, "Cannot restart worker process %d\n", i );
+                        busy[i] = false;
+                        running[i].client.reset();
+                        nbr_cancelled++;
+                    }
+                }
+                client.connected = false;
+                {
+                    std::lock_guard<std::mutex> lck(client.mtx);
+                    client.closed = true;
+                    client.cv.notify_one();
+                }
+                continue;
+            }
+            std::map<std::string,std::string> fields;
+            if( !parse_object(e.line,fields) )
+            {
+                respond( client, error_response("null","bad request") );
+                continue;
+            }
+            std::string id = fields.count("id") ? fields["id"] : "null";
+            std::string cmd = json_text( fields["cmd"] );
+            if( cmd == "stats" )
+            {
+                int nbr_running = static_cast<int>( std::count(busy.begin(),busy.end(),true) );
+                respond( client, stats_response(id,queue.size(),nbr_running) );
+            }
+            else if( cmd == "cancel" )
+            {
+                std::string target = fields["cancel"];
+                bool found = false;
+                for( size_t i=0; i<queue.size(); i++ )
+                {
+                    if( queue[i].client==e.client && queue[i].id==target )
+                    {
+                        respond( client, error_response(target,"cancelled") );
+                        queue.erase( queue.begin()+i );
+                        found = true;
+                        break;
+                    }
+                }
+                for( int i=0; !found && i<nbr_workers; i++ )
+                {
+                    if( busy[i] && running[i].client==e.client && running[i].id==target )
+                    {
+                        if( !sargon_pool_cancel(i) )
+                            fprintf( stderr, "Cannot restart worker process %d\n", i );
+                        busy[i] = false;
+                        respond( client, error_response(target,"cancelled") );
+                        running[i].client.reset();
+                        found = true;
+                    }
+                }
+                if( found )
+                    nbr_cancelled++;
+                respond( client, "{\"id\":" + id + ",\"cancelled\":" + (found?"true":"false") + "}" );
+            }
+            else if( cmd.length() > 0 )
+                respond( client, error_response(id,"unknown cmd") );
+            else if( fields["fen"].length() == 0 )
+                respond( client, error_response(id,"no fen") );
+            else if( queue.size() >= max_queue )
+            {
+                respond( client, error_response(id,"queue full") );
+                nbr_rejected++;
+            }
+            else
+            {
+                Request r;
+                r.client   = e.client;
+                r.id       = id;
+                r.fen      = json_text( fields["fen"] );
+                r.depth    = atoi( fields["depth"].c_str() );
+                r.time_ms  = atoi( fields["time"].c_str() );
+                r.priority = atoi( fields["priority"].c_str() );
+                r.options  = json_array( fields["searchmoves"] );
+                if( r.options.length() > 0 )
+                    r.options = "searchmoves " + r.options;
+                r.seq      = seq++;
+                r.received = now;
+                r.has_deadline = fields.count("deadline") > 0;
+                r.deadline = now + std::chrono::milliseconds( atoi(fields["deadline"].c_str()) );
+                queue.push_back(r);
+            }
+        }
+
+        // Results
+        while( sargon_pool_ready() )
+        {
+            int worker;
+            unsigned long idx;
+            std::string json;
+            bool ok = sargon_pool_result( worker, idx, json );
+            if( !ok )
+            {
+                fprintf( stderr, "Worker process %d stopped unexpectedly\n", worker );
+                if( !sargon_pool_cancel(worker) )
+                    fprintf( stderr, "Cannot restart worker process %d\n", worker );
+            }
+            if( !busy[worker] )
+                continue;
+            Request &r = running[worker];
+            busy[worker] = false;
+            if( !ok )
+                respond( *r.client, error_response(r.id,"worker stopped") );
+            else
+            {
+                // Replace the worker's index with the request's id
+                size_t offset = json.find(',');
+                unsigned long latency = elapsed_milliseconds( r.received, now );
+                if( offset != std::string::npos )
+                    json = "{\"id\":" + r.id + json.substr(offset);
+                respond( *r.client, json );
+                nbr_completed++;
+                latencies.push_back( latency );
+                if( latencies.size() > MAX_LATENCIES )
+                    latencies.pop_front();
+            }
+            r.client.reset();
+        }
+
+        // Expire queued requests that have reached their deadlines
+        for( size_t i=0; i<queue.size(); )
+        {
+            if( queue[i].has_deadline && queue[i].deadline<=now )
+            {
+                respond( *queue[i].client, error_response(queue[i].id,"deadline expired") );
+                queue.erase( queue.begin()+i );
+                nbr_expired++;
+            }
+            else
+                i++;
+        }
+
+        // Give idle workers the best queued requests
+        for( int i=0; i<nbr_workers && queue.size()>0; i++ )
+        {
+            if( busy[i] )
+                continue;
+            size_t best = 0;
+            for( size_t j=1; j<queue.size(); j++ )
+            {
+                if( before(queue[j],queue[best]) )
+                    best = j;
+            }
+            Request r = queue[best];
+            queue.erase( queue.begin()+best );
+            int time_ms = r.time_ms;
+            if( r.has_deadline )
+            {
+                int remaining = static_cast<int>( elapsed_milliseconds(now,r.deadline) );
+                if( time_ms==0 || remaining<time_ms )
+                    time_ms = remaining>0 ? remaining : 1;
+            }
+            int depth = r.depth>0 ? r.depth : (time_ms>0 ? 20 : plymax);
+            std::string options = util::sprintf( "depth %d time %d", depth, time_ms );
+            if( r.options.length() > 0 )
+                options += " " + r.options;
+            running[i] = r;
+            busy[i] = true;
+            sargon_pool_send( i, r.seq, r.fen, options );
+        }
+    }
+}
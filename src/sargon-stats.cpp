@@ -0,0 +1,198 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-stats.cpp
+ *       Search tree statistics, per ply counts of nodes, moves generated
+ *       and searched, alpha-beta cutoffs and evaluations
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <string.h>
+#include <string>
+#include "util.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-stats.h"
+
+/*
+
+  FNDMOV calls GENMOV once for each node it expands, and the "after
+  GENMOV()" callback follows with NPLY the ply of the moves generated.
+  Every move that gets a value, either a leaf evaluation or a value backed
+  up from the ply below, passes the "Alpha beta cutoff?" callback with NPLY
+  its ply, the value in register A and the value to compare with (the
+  score two ply above) at HL. If A is not greater Sargon abandons the rest
+  of the node's moves, a cutoff. Otherwise if the move beats the moves
+  searched before it "Yes! Best move" follows. After a cutoff Sargon
+  ascends and goes straight to the next move one ply up, so the refuted
+  move at that ply never passes "Alpha beta cutoff?" and is counted as
+  searched at the cutoff instead.
+
+*/
+
+#define MAX_PLY 32      // NPLY can exceed PLYMAX by one (for a check)
+
+struct PLY_STATS
+{
+    unsigned long nodes;
+    unsigned long generated;
+    unsigned long searched;
+    unsigned long cutoffs;
+    unsigned long first_move_cutoffs;
+    unsigned long best_moves;
+    unsigned long evaluations;
+};
+
+static bool enabled;
+static PLY_STATS search[MAX_PLY];
+static PLY_STATS totals[MAX_PLY];
+static unsigned long moves_searched_at_node[MAX_PLY];   // at the current node of each ply
+
+void sargon_stats_enable( bool enable )
+{
+    enabled = enable;
+}
+
+void sargon_stats_new_search()
+{
+    memset( search, 0, sizeof(search) );
+    memset( moves_searched_at_node, 0, sizeof(moves_searched_at_node) );
+}
+
+void sargon_stats_reset_totals()
+{
+    memset( totals, 0, sizeof(totals) );
+}
+
+void sargon_stats_callback( const char *msg, const z80_registers &registers )
+{
+    if( !enabled )
+        return;
+    unsigned int nply = peekb(NPLY);
+    if( nply >= MAX_PLY )
+        nply = MAX_PLY-1;
+    PLY_STATS &s = search[nply];
+    PLY_STATS &t = totals[nply];
+    if( 0 == strcmp(msg,"after GENMOV()") )
+    {
+        // Count the moves by following the links from the ply's list pointer
+        unsigned long generated = 0;
+        unsigned int p = peekw( peekw(MLPTRI) );
+        while( (p&0xff00) != 0 && generated < 256 )
+        {
+            generated++;
+            p = peekw(p);
+        }
+        s.nodes++;
+        t.nodes++;
+        s.generated += generated;
+        t.generated += generated;
+        moves_searched_at_node[nply] = 0;
+    }
+    else if( 0 == strcmp(msg,"Alpha beta cutoff?") )
+    {
+        s.searched++;
+        t.searched++;
+        moves_searched_at_node[nply]++;
+        unsigned char value         = static_cast<unsigned char>(registers.af&0xff);
+        unsigned char two_ply_above = peekb(registers.hl);
+        if( value <= two_ply_above )
+        {
+            s.cutoffs++;
+            t.cutoffs++;
+            if( moves_searched_at_node[nply] == 1 )
+            {
+                s.first_move_cutoffs++;
+                t.first_move_cutoffs++;
+            }
+            if( nply > 1 )
+            {
+                search[nply-1].searched++;
+                totals[nply-1].searched++;
+                moves_searched_at_node[nply-1]++;
+            }
+        }
+    }
+    else if( 0 == strcmp(msg,"Yes! Best move") )
+    {
+        s.best_moves++;
+        t.best_moves++;
+    }
+    else if( 0 == strcmp(msg,"end of POINTS()") )
+    {
+        s.evaluations++;
+        t.evaluations++;
+    }
+}
+
+// The effective branching factor b solves N = b + b^2 + ... + b^d, where
+//  N moves were searched (on average per search), to depth d
+static double effective_branching_factor( double n, int d )
+{
+    if( d<1 || n<1 )
+        return 0.0;
+    double lo=1.0, hi=n;
+    for( int i=0; i<100; i++ )
+    {
+        double b = (lo+hi) / 2;
+        double sum = 0, power = 1;
+        for( int j=0; j<d; j++ )
+        {
+            power *= b;
+            sum += power;
+        }
+        if( sum > n )
+            hi = b;
+        else
+            lo = b;
+    }
+    return lo;
+}
+
+static std::string percent( unsigned long numerator, unsigned long denominator )
+{
+    return denominator==0 ? std::string("-") : util::sprintf( "%.1f%%", 100.0*numerator/denominator );
+}
+
+std::string sargon_stats_report( bool report_totals )
+{
+    const PLY_STATS *stats = report_totals ? totals : search;
+    std::string s = util::sprintf( "%3s %10s %11s %10s %10s %7s %10s %7s %10s %11s\n",
+        "ply", "nodes", "generated", "searched", "cutoffs", "", "first", "", "best", "evaluations" );
+    PLY_STATS all;
+    memset( &all, 0, sizeof(all) );
+    int depth = 0;
+    for( int i=0; i<MAX_PLY; i++ )
+    {
+        const PLY_STATS &p = stats[i];
+        if( p.nodes==0 && p.searched==0 && p.evaluations==0 )
+            continue;
+        if( p.searched > 0 )
+            depth = i;
+        s += util::sprintf( "%3d %10lu %11lu %10lu %10lu %7s %10lu %7s %10lu %11lu\n",
+            i, p.nodes, p.generated, p.searched,
+            p.cutoffs, percent(p.cutoffs,p.nodes).c_str(),
+            p.first_move_cutoffs, percent(p.first_move_cutoffs,p.cutoffs).c_str(),
+            p.best_moves, p.evaluations );
+        all.nodes              += p.nodes;
+        all.generated          += p.generated;
+        all.searched           += p.searched;
+        all.cutoffs            += p.cutoffs;
+        all.first_move_cutoffs += p.first_move_cutoffs;
+        all.best_moves         += p.best_moves;
+        all.evaluations        += p.evaluations;
+    }
+    s += util::sprintf( "%3s %10lu %11lu %10lu %10lu %7s %10lu %7s %10lu %11lu\n",
+        "all", all.nodes, all.generated, all.searched,
+        all.cutoffs, percent(all.cutoffs,all.nodes).c_str(),
+        all.first_move_cutoffs, percent(all.first_move_cutoffs,all.cutoffs).c_str(),
+        all.best_moves, all.evaluations );
+    double searches = stats[1].nodes>0 ? static_cast<double>(stats[1].nodes) : 1.0;
+    s += util::sprintf( "Effective branching factor %.2f (depth %d), %s of moves generated were searched\n",
+        effective_branching_factor(all.searched/searches,depth), depth,
+        percent(all.searched,all.generated).c_str() );
+    return s;
+}
@@ -0,0 +1,40 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-stats.h
+ *       Search tree statistics, per ply counts of nodes, moves generated
+ *       and searched, alpha-beta cutoffs and evaluations
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_STATS_H_INCLUDED
+#define SARGON_STATS_H_INCLUDED
+
+#include <string>
+#include "sargon-asm-interface.h"
+
+// Statistics are only collected when enabled (default off)
+void sargon_stats_enable( bool enable );
+
+// Zero the counts for a new search. Counts are also accumulated into
+//  totals (over all searches) until sargon_stats_reset_totals()
+void sargon_stats_new_search();
+void sargon_stats_reset_totals();
+
+// Call from sargon_callback(), uses the "after GENMOV()", "Alpha beta
+//  cutoff?", "Yes! Best move" and "end of POINTS()" callbacks
+void sargon_stats_callback( const char *msg, const z80_registers &registers );
+
+// A table with a line for each ply; nodes (GENMOV calls at that ply),
+//  moves generated, moves searched, cutoffs (as a count and a percentage
+//  of nodes), cutoffs on the first move searched (count and percentage of
+//  cutoffs), new best moves (with perfect move ordering only the first
+//  move searched at each node) and leaf evaluations. Followed by a summary
+//  line with the effective branching factor. For the most recent search,
+//  or the totals
+std::string sargon_stats_report( bool totals=false );
+
+#endif // SARGON_STATS_H_INCLUDED
@@ -15,18 +15,44 @@
 #include <vector>
 #include <algorithm>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "util.h"
 #include "thc.h"
 #include "sargon-asm-interface.h"
 #include "sargon-interface.h"
 #include "sargon-pv.h"
+#include "sargon-points.h"
+#include "sargon-profile.h"
+#include "sargon-z80.h"
+#include "sargon-benchmark.h"
+#include "sargon-trace.h"
 
 // Individual tests
 bool sargon_position_tests( bool quiet, int comprehensive );
 bool sargon_timing_tests( bool quiet, int comprehensive );
 bool sargon_whole_game_tests( bool quiet, int comprehensive );
+bool sargon_attack_benchmark( bool quiet, int comprehensive );
+bool sargon_xchng_benchmark( bool quiet, int comprehensive );
+bool sargon_routine_benchmark( bool quiet, int comprehensive );
+bool sargon_move_benchmark( bool quiet, int comprehensive, const BENCHMARK_OPTIONS &options );
 extern void sargon_minimax_main();
 extern bool sargon_minimax_regression_test( bool quiet);
+extern void sargon_ldar_seed( uint8_t seed );
+static bool whole_game_test( int i, bool quiet );
+static bool position_test( int i, int nbr_tests_to_run, bool quiet );
+static int  nbr_whole_game_tests( int comprehensive );
+static int  nbr_position_tests( int comprehensive );
+static void position_tests_machinery();
+static void z80_callback( const char *msg, z80_registers &registers );
+static bool sargon_sharded_tests( const std::string &exe, const std::string &test_types, const std::string &job_args,
+                                  int nbr_processes, int comprehensive, bool serial_check, bool quiet, std::string &summary );
+static uint8_t position_test_ldar_seed( int i );
+static bool run_job( char job_type, int job_idx, bool quiet, int comprehensive );
+
+// Also run the original Z80 code in the Z80 interpreter during timing tests
+static bool z80_reference;
 
 // main()
 int main( int argc, const char *argv[] )
@@ -45,48 +71,190 @@ int main( int argc, const char *argv[] )
     "Sargon test suite\n"
     "\n"
     "Usage:\n"
-    "sargon-tests tests [-1|-2|-3] [-v] [-doc]\n"
+    "sargon-tests tests [-1|-2|-3] [-v] [-native|-differential] [-z80[=dir]|-z80i[=dir]] [-j N [-serial-check]]\n"
+    "             [-reps N] [-warmup N] [-cpu N] [-json file] [-stats] [-trace file] [-doc]\n"
+    "sargon-tests -compare baseline.json results.json\n"
+    "sargon-tests -compare-trace first.trace second.trace\n"
     "\n"
     "tests = combine 'p' for position tests, 'g' for whole game tests, 'm' for\n"
-    "        minimax tests, 't' for timing tests\n"
+    "        minimax tests, 't' for timing tests, 'a' for native ATTACK ray table\n"
+    "        micro-benchmark, 'x' for XCHNG micro-benchmark, 'r' for GENMOV, POINTS,\n"
+    "        ATTACK and PINFND micro-benchmarks, 'b' for benchmark\n"
     "\n"
     "-1|-2|-3 = fast, middling or comprehensive suite of tests respectively\n"
     "\n"
     "-v means verbose, (i.e. print extra information)\n"
     "\n"
+    "-native means use native C++ POINTS() instead of assembly language\n"
+    "\n"
+    "-differential means check native C++ POINTS() against assembly language\n"
+    "     POINTS() on every evaluation\n"
+    "\n"
+    "-z80 means timing tests also run the original Z80 code in a Z80 interpreter,\n"
+    "     check it calculates the same moves and predict TRS-80 move times. It\n"
+    "     loads sargon-z80.lst and sargon-z80-and-x86.asm from dir (default stages)\n"
+    "\n"
+    "-z80i is the same as -z80, but interprets every instruction instead of\n"
+    "     translating and caching blocks of Z80 code, to check the translation\n"
+    "\n"
+    "-j N means run the position, whole game and minimax tests in N processes\n"
+    "     at once (0 = one per core), longest tests first. Output is still in test\n"
+    "     order. Timing tests and micro-benchmarks then run one at a time\n"
+    "\n"
+    "-serial-check means after the -j tests, run the same tests again one at a\n"
+    "     time in this process, and fail if any test passes in one run and fails\n"
+    "     in the other\n"
+    "\n"
+    "-reps N means the benchmark takes N timed samples of each position at each\n"
+    "     level (default 10), after -warmup N untimed runs (default 1)\n"
+    "\n"
+    "-cpu N means pin the benchmark to CPU N\n"
+    "\n"
+    "-json file means also write the benchmark results to a JSON file\n"
+    "\n"
+    "-stats means the benchmark also reports search statistics for each level,\n"
+    "     per ply counts of nodes, moves generated and searched, alpha-beta\n"
+    "     cutoffs (and cutoffs by the first move searched), new best moves and\n"
+    "     evaluations\n"
+    "\n"
+    "-compare means compare two benchmark JSON files, reporting statistically\n"
+    "     significant changes, and fail if anything is slower\n"
+    "\n"
+    "-trace file means write a binary trace of every Sargon callback during the\n"
+    "     tests (the tests then run in a single process)\n"
+    "\n"
+    "-compare-trace means compare two trace files, eg from sargon-tests and\n"
+    "     sargon-tests-cpp, and report the first difference in the searches\n"
+    "\n"
     "-doc means don't run any tests, instead run minimax models and print results\n"
     "     in the form of documentation\n"
     "\n"
     "Examples:\n"
     " sargon-tests pg -3 -v\n"
     "    Run a comprehensive, verbose set of position and whole game tests\n"
+    " sargon-tests pgm -3 -j 8\n"
+    "    Run the comprehensive position, whole game and minimax tests, 8 at a time\n"
     " sargon-tests t\n"
     "    Run timing tests\n"
+    " sargon-tests t -z80\n"
+    "    Run timing tests, with the original Z80 code as a reference\n"
+    " sargon-tests b -2 -cpu 2 -json after.json\n"
+    "    Benchmark levels 1-4, pinned to CPU 2, then sargon-tests -compare\n"
+    "    before.json after.json shows the effect of a change\n"
+    " sargon-tests pg -2 -trace x86.trace\n"
+    "    Trace the tests, then sargon-tests-cpp pg -2 -trace cpp.trace and\n"
+    "    sargon-tests -compare-trace x86.trace cpp.trace checks both builds\n"
+    "    search identically\n"
     " sargon-tests -doc\n"        
     "    Run the minimax models and print out the results as documentation\n";
     bool ok = false, minimax_doc=false, quiet=true;
+    std::string compare_baseline, compare_results;
+    std::string trace_file, compare_trace1, compare_trace2;
+    BENCHMARK_OPTIONS benchmark_options;
     std::string test_types;
+    std::string z80_dir;
     int comprehensive = 1;
+    int nbr_processes = 1;
+    bool serial_check = false;
+    std::string job_args;   // switches passed on to -j test processes
+    char job_type = 0;      // a -j test process runs a single test
+    int  job_idx  = 0;
     for( int i=1; i<argc; i++ )
     {
         std::string s = argv[i];
-        if( i==1 && s.find_first_not_of("gptm") == std::string::npos )
+        if( i==1 && s.find_first_not_of("gptmaxrb") == std::string::npos )
         {
             test_types = s;
             ok = true;
         }
+        else if( i==1 && s=="-job" && argc>3 )
+        {
+            job_type = argv[2][0];
+            job_idx  = atoi(argv[3]);
+            i += 2;
+            ok = true;
+        }
         else if( i==1 && argc==2 && s=="-doc" )
         {
             minimax_doc = true;
             ok = true;
         }
+        else if( i==1 && argc==4 && s=="-compare" )
+        {
+            compare_baseline = argv[2];
+            compare_results  = argv[3];
+            i += 2;
+            ok = true;
+        }
+        else if( i==1 && argc==4 && s=="-compare-trace" )
+        {
+            compare_trace1 = argv[2];
+            compare_trace2 = argv[3];
+            i += 2;
+            ok = true;
+        }
         else if( s=="-1" || s=="-2" || s=="-3" )
         {
             comprehensive = s[1]-'0';   // "-3" -> 3 etc
+            job_args += " " + s;
         }
         else if( s=="-v" )
         {
             quiet = false;
+            job_args += " " + s;
+        }
+        else if( s=="-native" )
+        {
+            sargon_points_set_mode( POINTS_NATIVE );
+            job_args += " " + s;
+        }
+        else if( s=="-differential" )
+        {
+            sargon_points_set_mode( POINTS_DIFFERENTIAL );
+            job_args += " " + s;
+        }
+        else if( s=="-j" && i+1<argc )
+        {
+            nbr_processes = atoi(argv[++i]);
+        }
+        else if( s=="-serial-check" )
+        {
+            serial_check = true;
+        }
+        else if( s=="-reps" && i+1<argc )
+        {
+            benchmark_options.reps = atoi(argv[++i]);
+        }
+        else if( s=="-warmup" && i+1<argc )
+        {
+            benchmark_options.warmup = atoi(argv[++i]);
+        }
+        else if( s=="-cpu" && i+1<argc )
+        {
+            benchmark_options.cpu = atoi(argv[++i]);
+        }
+        else if( s=="-json" && i+1<argc )
+        {
+            benchmark_options.json_file = argv[++i];
+        }
+        else if( s=="-stats" )
+        {
+            benchmark_options.stats = true;
+        }
+        else if( s=="-trace" && i+1<argc )
+        {
+            trace_file = argv[++i];
+        }
+        else if( s=="-z80" || util::prefix(s,"-z80=") )
+        {
+            z80_reference = true;
+            z80_dir = s.length()>5 ? s.substr(5) : "stages";
+        }
+        else if( s=="-z80i" || util::prefix(s,"-z80i=") )
+        {
+            z80_reference = true;
+            z80_dir = s.length()>6 ? s.substr(6) : "stages";
+            sargon_z80_set_translate( false );
         }
         else
         {
@@ -101,13 +269,62 @@ int main( int argc, const char *argv[] )
     }
 
     util::tests();
-    if( minimax_doc )
+    if( z80_reference )
+    {
+        std::string error;
+        if( !sargon_z80_load( z80_dir+"/sargon-z80.lst", z80_dir+"/sargon-z80-and-x86.asm", error ) )
+        {
+            printf( "%s\n", error.c_str() );
+            return -1;
+        }
+        sargon_z80_set_callback( z80_callback );
+        sargon_z80( api_INITBD );
+    }
+    if( job_type )
+        ok = run_job( job_type, job_idx, quiet, comprehensive );
+    else if( compare_baseline.length() > 0 )
+        ok = sargon_benchmark_compare( compare_baseline, compare_results );
+    else if( compare_trace1.length() > 0 )
+    {
+        std::string report;
+        ok = sargon_trace_compare( compare_trace1, compare_trace2, report );
+        printf( "%s", report.c_str() );
+    }
+    else if( minimax_doc )
         sargon_minimax_main();
     else
     {
         std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
         bool ok=true, passed;
-        for( char c: test_types )
+
+        // With -j, position, whole game and minimax tests run in parallel first
+        std::string serial_types = test_types;
+        std::string summary;
+        if( trace_file.length() > 0 )
+        {
+            if( !sargon_trace_start(trace_file) )
+            {
+                printf( "Cannot create trace file %s\n", trace_file.c_str() );
+                return -1;
+            }
+            nbr_processes = 1;
+        }
+        if( nbr_processes != 1 )
+        {
+            std::string sharded_types;
+            serial_types.clear();
+            for( char c: test_types )
+            {
+                if( c=='p' || c=='g' || c=='m' )
+                    sharded_types += c;
+                else
+                    serial_types += c;
+            }
+            passed = sargon_sharded_tests( argv[0], sharded_types, job_args, nbr_processes, comprehensive, serial_check, quiet, summary );
+            if( !passed )
+                ok = false;
+        }
+        for( char c: serial_types )
         {
             if( c == 'p' )
             {
@@ -133,127 +350,176 @@ int main( int argc, const char *argv[] )
                 if( !passed )
                     ok = false;
             }
+            else if( c == 'a' )
+            {
+                passed = sargon_attack_benchmark(quiet,comprehensive);
+                if( !passed )
+                    ok = false;
+            }
+            else if( c == 'x' )
+            {
+                passed = sargon_xchng_benchmark(quiet,comprehensive);
+                if( !passed )
+                    ok = false;
+            }
+            else if( c == 'r' )
+            {
+                passed = sargon_routine_benchmark(quiet,comprehensive);
+                if( !passed )
+                    ok = false;
+            }
+            else if( c == 'b' )
+            {
+                passed = sargon_move_benchmark(quiet,comprehensive,benchmark_options);
+                if( !passed )
+                    ok = false;
+            }
         }
+        if( trace_file.length() > 0 )
+            summary += util::sprintf( " (%lu events traced)", sargon_trace_stop() );
         std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
         std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
         double elapsed = static_cast<double>(ms.count());
-        printf( "%s tests passed. Elapsed time = %.3f seconds\n", ok?"All":"Not all", elapsed/1000.0 ); 
+        if( sargon_points_get_mode() != POINTS_ASM )
+            printf( "%s\n", sargon_points_report_stats().c_str() );
+        printf( "%s tests passed. Elapsed time = %.3f seconds%s\n", ok?"All":"Not all", elapsed/1000.0, summary.c_str() );
     }
     return ok ? 0 : -1;
 }
 
-bool sargon_whole_game_tests( bool quiet, int comprehensive )
+// Number of whole game tests and known position tests to run
+static int nbr_whole_game_tests( int comprehensive )
 {
-    bool ok = true;
-    printf( "* Whole game tests\n" );
     int nbr_tests_to_run = 2;
     if( comprehensive > 1 )
         nbr_tests_to_run = comprehensive==2 ? 4 : 6;
+    return nbr_tests_to_run;
+}
+
+bool sargon_whole_game_tests( bool quiet, int comprehensive )
+{
+    bool ok = true;
+    printf( "* Whole game tests\n" );
+    int nbr_tests_to_run = nbr_whole_game_tests( comprehensive );
     for( int i=0; i<nbr_tests_to_run; i++ )
     {
-        int plymax = "334455"[i] - '0'; // two 3 ply games, then 2 4 ply games, then 2 5 ply games
-        printf( "Entire PLYMAX=%d 1.%c4 game test ", plymax, i%2==0 ? 'd' : 'e' );
-        std::string game_text;
-        std::string between_moves;
-        thc::ChessRules cr;
-        bool regenerate_position=true;
-        int nbr_moves_played = 0;
-        unsigned char moveno=1;
-        pokeb(MOVENO,moveno);
-        while( nbr_moves_played < 200 )
-        {
-            pokeb(KOLOR,0); // Sargon is white
-            pokeb(PLYMAX, plymax );
-            if( regenerate_position )
-                sargon_import_position(cr);
-            sargon(api_CPTRMV);
-            thc::ChessRules cr_after;
-            sargon_export_position(cr_after);
-            std::string terse = sargon_export_move(BESTM);
-            thc::Move mv;
-            bool ok = mv.TerseIn( &cr, terse.c_str() );
-            if( !ok )
-            {
-                if( !quiet )
-                {
-                    printf( "Sargon doesn't find move - %s\n%s", terse.c_str(), cr.ToDebugStr().c_str() );
-                    printf( "(After)\n%s",cr_after.ToDebugStr().c_str() );
-                }
-                if( !ok )
-                    break;
-            }
-            std::string s = mv.NaturalOut(&cr);
-            if( quiet )
-                printf( "." );
-            else
-                printf( "Sargon plays %s\n", s.c_str() );
-            game_text += between_moves;
-            game_text += s;
-            between_moves = " ";
-            cr.PlayMove(mv);
-            nbr_moves_played++;
-            if( strcmp(cr.squares,cr_after.squares) != 0 )
+        bool pass = whole_game_test( i, quiet );
+        if( !pass )
+            ok = false;
+    }
+    return ok;
+}
+
+// Whole game test i, Sargon (at depth 3,3,4,4,5,5) plays the Tarrasch static
+//  evaluator
+static bool whole_game_test( int i, bool quiet )
+{
+    int plymax = "334455"[i] - '0'; // two 3 ply games, then 2 4 ply games, then 2 5 ply games
+    printf( "Entire PLYMAX=%d 1.%c4 game test ", plymax, i%2==0 ? 'd' : 'e' );
+    std::string game_text;
+    std::string between_moves;
+    thc::ChessRules cr;
+    bool regenerate_position=true;
+    int nbr_moves_played = 0;
+    unsigned char moveno=1;
+    pokeb(MOVENO,moveno);
+
+    // Sargon's first move comes from its book, 1.d4 or 1.e4 depending on the
+    //  LDAR callback, seed LDAR as if the games were run in order, from the
+    //  start, in this process (each game calls LDAR once)
+    sargon_ldar_seed( static_cast<uint8_t>(i) );
+    while( nbr_moves_played < 200 )
+    {
+        pokeb(KOLOR,0); // Sargon is white
+        pokeb(PLYMAX, plymax );
+        if( regenerate_position )
+            sargon_import_position(cr);
+        sargon_trace_search( util::sprintf("Whole game test %d, move %d", i+1, nbr_moves_played/2+1) );
+        sargon(api_CPTRMV);
+        thc::ChessRules cr_after;
+        sargon_export_position(cr_after);
+        std::string terse = sargon_export_move(BESTM);
+        thc::Move mv;
+        bool ok = mv.TerseIn( &cr, terse.c_str() );
+        if( !ok )
+        {
+            if( !quiet )
             {
-                printf( "Position mismatch after Sargon move ?!\n" );
-                //break;
+                printf( "Sargon doesn't find move - %s\n%s", terse.c_str(), cr.ToDebugStr().c_str() );
+                printf( "(After)\n%s",cr_after.ToDebugStr().c_str() );
             }
-            std::vector<thc::Move> moves;
-            thc::ChessEvaluation ce=cr;
-            ce.GenLegalMoveListSorted( moves );
-            if( moves.size() == 0 )
-            {
-                if( !quiet )
-                    printf( "Tarrasch static evaluator doesn't find move\n" );
+            if( !ok )
                 break;
-            }
-            mv = moves[0];
-            s = mv.NaturalOut(&cr);
+        }
+        std::string s = mv.NaturalOut(&cr);
+        if( quiet )
+            printf( "." );
+        else
+            printf( "Sargon plays %s\n", s.c_str() );
+        game_text += between_moves;
+        game_text += s;
+        between_moves = " ";
+        cr.PlayMove(mv);
+        nbr_moves_played++;
+        if( strcmp(cr.squares,cr_after.squares) != 0 )
+        {
+            printf( "Position mismatch after Sargon move ?!\n" );
+            //break;
+        }
+        std::vector<thc::Move> moves;
+        thc::ChessEvaluation ce=cr;
+        ce.GenLegalMoveListSorted( moves );
+        if( moves.size() == 0 )
+        {
             if( !quiet )
-                printf( "Tarrasch static evaluator plays %s\n", s.c_str() );
-            game_text += " ";
-            game_text += s;
-            nbr_moves_played++;
-            pokeb(COLOR,0x80);
-            ok = sargon_play_move(mv);
-            cr.PlayMove(mv);
-            if( ok )
+                printf( "Tarrasch static evaluator doesn't find move\n" );
+            break;
+        }
+        mv = moves[0];
+        s = mv.NaturalOut(&cr);
+        if( !quiet )
+            printf( "Tarrasch static evaluator plays %s\n", s.c_str() );
+        game_text += " ";
+        game_text += s;
+        nbr_moves_played++;
+        pokeb(COLOR,0x80);
+        ok = sargon_play_move(mv);
+        cr.PlayMove(mv);
+        if( ok )
+        {
+            sargon_export_position(cr_after);
+            if( strcmp(cr.squares,cr_after.squares) != 0 )
             {
-                sargon_export_position(cr_after);
-                if( strcmp(cr.squares,cr_after.squares) != 0 )
-                {
-                    printf( "Position mismatch after Tarrasch static evaluator move ?!\n" );
-                    //break;
-                }
+                printf( "Position mismatch after Tarrasch static evaluator move ?!\n" );
+                //break;
             }
-            if( moveno <= 254 )
-                moveno++;
-            pokeb(MOVENO,moveno);
-            regenerate_position = !ok;
-            if( regenerate_position )
-                printf( "Move by move operation has broken down, need to regenerate position ??\n" );
-        }
-        // We now have introduced book moves (by starting MOVENO at 1 and incrementing it after each pair of half moves), and
-        //  they are reproducible by the LDAR callback(). Some games end in repetition with Sargon winning easily, in
-        //  particular Sargon does seem to have difficulty mating the opponent if there are too many mates available at higher
-        //  plymax
-        const char *expected_games[] =
-        {
-            "d4 d5 Nc3 Nc6 Be3 e5 Nf3 Nxd4 Bxd4 exd4 Qxd4 Nf6 O-O-O Be6 e3 Qd7 Bb5 c6 Ne5 Qc7 Be2 c5 Qa4+ Kd8 Nf3 Be7 Kd2 g6 h4 Kc8 Ng5 Kb8 Nxe6 fxe6 h5 e5 hxg6 a6 Bd3 e4 Nxd5 Nxd5 Qxe4 Rd8 gxh7 Ka7 h8=Q Rxh8 Qxd5 Qb6 Rxh8 Rxh8 Kc1 Rh2 Bc4 Kb8 Qe5+ Ka7 Qxh2 Ka8 Qh8+ Ka7 Qe5 Bd8 Rd6 Qa5 Qd5 Bc7 Rf6 Kb8 c3 Ka7 g3 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7",
-            "e4 d5 Qf3 Nf6 Nc3 e6 e5 Ng8 Nh3 Nc6 Bb5 f5 exf6 Nxf6 O-O e5 Re1 Be6 Bxc6+ bxc6 Rxe5 Qd7 Ng5 c5 Nxe6 c6 Nxc5+ Qe7 Rxe7+ Bxe7 Qe3 Kf7 Qe6+ Ke8 Qxc6+ Kf7 Qe6+ Ke8 Nxd5 Nxd5 Qxd5 Rb8 Qe6 Ra8 d4 Rb8 Bg5 Rxb2 Qxe7#",
-            "d4 d5 Nc3 Nc6 Bf4 Nf6 Nb5 e5 dxe5 Ne4 e6 Bxe6 Nxc7+ Kd7 Nxa8 Qxa8 Nh3 f5 Qd3 Be7 O-O-O Rg8 f3 Nc5 Qe3 d4 c3 Bxa2 cxd4 Ne6 d5 Nxf4 dxc6+ Kxc6 Qxe7 Qb8 Qd7+ Kb6 Qd4+ Ka5 b4+ Kb5 Nxf4 Qa8 Kb2 Bc4 Qc5+ Ka4 Qxc4 Qb8 Ra1#",
-            "e4 d5 Qf3 Nf6 e5 Ne4 d3 Nc5 Nc3 e6 d4 Nca6 Be3 Nc6 O-O-O f5 Nh3 Bb4 Bxa6 bxa6 Bg5 Qd7 a3 Bxc3 Qxc3 O-O Kd2 Bb7 Ke2 a5 b4 a4 b5 Ne7 Qb4 c5 dxc5 Rab8 Qxa4 Ra8 Bf4 Rfe8 c3 Red8 Rhg1 Rdc8 Be3 Rcb8 f4 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8",
-            "d4 d5 Nc3 Nc6 e4 Nf6 e5 Ne4 Be3 g6 Bb5 Nxc3 bxc3 f5 Nf3 Bd7 Bxc6 bxc6 Ng5 Bg7 e6 Bc8 Nf7 Bxd4 Qxd4 Bxe6 Nxd8 Rxd8 Qxh8+ Kd7 Qxh7 c5 Bxc5 Rc8 Qxe7+ Kc6 Qxe6+ Kb7 Rb1+ Ka8 Qxc8#",
-            "e4 d5 Nc3 Nf6 e5 Ne4 Qf3 Nxc3 bxc3 Nc6 Bb5 e6 Ne2 f5 O-O Be7 c4 O-O Bb2 Rb8 cxd5 Qxd5 Qxd5 exd5 Bd4 Bd7 Bxa7 Ra8 Bd4 Rab8 Rfb1 Ra8 c3 Rab8 Nf4 Nxd4 Bxd7 Nc6 Nxd5 Bd8 Bxc6 b6 e6 Rc8 e7 Bxe7 Nxe7+ Kh8 Nxc8 Rxc8 Re1 Rb8 Re7 Rc8 Bb7 Rb8 Rxc7 Rd8 d4 Rb8 Rb1 Rd8 Rxb6 Rb8 Bc6 Rxb6 Rc8#"
-        };
-        std::string expected = expected_games[i];
-        bool pass = (game_text == expected);
-        if( !pass )
-            ok = false;
-        printf( " %s\n", pass ? "PASS" : "FAIL" );
-        if( !pass )
-            printf( "FAIL reason: Expected=%s, Calculated=%s\n", expected.c_str(), game_text.c_str() );
+        }
+        if( moveno <= 254 )
+            moveno++;
+        pokeb(MOVENO,moveno);
+        regenerate_position = !ok;
+        if( regenerate_position )
+            printf( "Move by move operation has broken down, need to regenerate position ??\n" );
     }
-    return ok;
+    // We now have introduced book moves (by starting MOVENO at 1 and incrementing it after each pair of half moves), and
+    //  they are reproducible by the LDAR callback(). Some games end in repetition with Sargon winning easily, in
+    //  particular Sargon does seem to have difficulty mating the opponent if there are too many mates available at higher
+    //  plymax
+    const char *expected_games[] =
+    {
+        "d4 d5 Nc3 Nc6 Be3 e5 Nf3 Nxd4 Bxd4 exd4 Qxd4 Nf6 O-O-O Be6 e3 Qd7 Bb5 c6 Ne5 Qc7 Be2 c5 Qa4+ Kd8 Nf3 Be7 Kd2 g6 h4 Kc8 Ng5 Kb8 Nxe6 fxe6 h5 e5 hxg6 a6 Bd3 e4 Nxd5 Nxd5 Qxe4 Rd8 gxh7 Ka7 h8=Q Rxh8 Qxd5 Qb6 Rxh8 Rxh8 Kc1 Rh2 Bc4 Kb8 Qe5+ Ka7 Qxh2 Ka8 Qh8+ Ka7 Qe5 Bd8 Rd6 Qa5 Qd5 Bc7 Rf6 Kb8 c3 Ka7 g3 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7 Rf6 Kb8 Rf8+ Ka7",
+        "e4 d5 Qf3 Nf6 Nc3 e6 e5 Ng8 Nh3 Nc6 Bb5 f5 exf6 Nxf6 O-O e5 Re1 Be6 Bxc6+ bxc6 Rxe5 Qd7 Ng5 c5 Nxe6 c6 Nxc5+ Qe7 Rxe7+ Bxe7 Qe3 Kf7 Qe6+ Ke8 Qxc6+ Kf7 Qe6+ Ke8 Nxd5 Nxd5 Qxd5 Rb8 Qe6 Ra8 d4 Rb8 Bg5 Rxb2 Qxe7#",
+        "d4 d5 Nc3 Nc6 Bf4 Nf6 Nb5 e5 dxe5 Ne4 e6 Bxe6 Nxc7+ Kd7 Nxa8 Qxa8 Nh3 f5 Qd3 Be7 O-O-O Rg8 f3 Nc5 Qe3 d4 c3 Bxa2 cxd4 Ne6 d5 Nxf4 dxc6+ Kxc6 Qxe7 Qb8 Qd7+ Kb6 Qd4+ Ka5 b4+ Kb5 Nxf4 Qa8 Kb2 Bc4 Qc5+ Ka4 Qxc4 Qb8 Ra1#",
+        "e4 d5 Qf3 Nf6 e5 Ne4 d3 Nc5 Nc3 e6 d4 Nca6 Be3 Nc6 O-O-O f5 Nh3 Bb4 Bxa6 bxa6 Bg5 Qd7 a3 Bxc3 Qxc3 O-O Kd2 Bb7 Ke2 a5 b4 a4 b5 Ne7 Qb4 c5 dxc5 Rab8 Qxa4 Ra8 Bf4 Rfe8 c3 Red8 Rhg1 Rdc8 Be3 Rcb8 f4 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8 Rg1 Rc8 Rgf1 Rcb8",
+        "d4 d5 Nc3 Nc6 e4 Nf6 e5 Ne4 Be3 g6 Bb5 Nxc3 bxc3 f5 Nf3 Bd7 Bxc6 bxc6 Ng5 Bg7 e6 Bc8 Nf7 Bxd4 Qxd4 Bxe6 Nxd8 Rxd8 Qxh8+ Kd7 Qxh7 c5 Bxc5 Rc8 Qxe7+ Kc6 Qxe6+ Kb7 Rb1+ Ka8 Qxc8#",
+        "e4 d5 Nc3 Nf6 e5 Ne4 Qf3 Nxc3 bxc3 Nc6 Bb5 e6 Ne2 f5 O-O Be7 c4 O-O Bb2 Rb8 cxd5 Qxd5 Qxd5 exd5 Bd4 Bd7 Bxa7 Ra8 Bd4 Rab8 Rfb1 Ra8 c3 Rab8 Nf4 Nxd4 Bxd7 Nc6 Nxd5 Bd8 Bxc6 b6 e6 Rc8 e7 Bxe7 Nxe7+ Kh8 Nxc8 Rxc8 Re1 Rb8 Re7 Rc8 Bb7 Rb8 Rxc7 Rd8 d4 Rb8 Rb1 Rd8 Rxb6 Rb8 Bc6 Rxb6 Rc8#"
+    };
+    std::string expected = expected_games[i];
+    bool pass = (game_text == expected);
+    printf( " %s\n", pass ? "PASS" : "FAIL" );
+    if( !pass )
+        printf( "FAIL reason: Expected=%s, Calculated=%s\n", expected.c_str(), game_text.c_str() );
+    return pass;
 }
 
 struct TEST
@@ -486,8 +752,21 @@ static TEST tests[]=
 bool sargon_position_tests( bool quiet, int comprehensive )
 {
     bool ok = true;
+    position_tests_machinery();
+    printf( "* Known position tests\n" );
+    int nbr_tests_to_run = nbr_position_tests( comprehensive );
+    for( int i=0; i<nbr_tests_to_run; i++ )
+    {
+        bool pass = position_test( i, nbr_tests_to_run, quiet );
+        if( !pass )
+            ok = false;
+    }
+    return ok;
+}
 
-    // A little test of some of our internal machinery
+// A little test of some of our internal machinery
+static void position_tests_machinery()
+{
     thc::ChessPosition cp, cp2;
     std::string en_passant_fen1 = "r4rk1/pb1pq1pp/5p2/2ppP3/5P2/2Q5/PPP3PP/2KR1B1R w - c6 0 15";
     cp.Forsyth( en_passant_fen1.c_str() );   // en passant provides a good workout on import and export
@@ -496,63 +775,544 @@ bool sargon_position_tests( bool quiet, int comprehensive )
     std::string en_passant_fen2 = cp2.ForsythPublish();
     if( en_passant_fen2 != en_passant_fen1 )
         printf( "Unexpected internal event, expected en_passant_fen2=%s  to equal en_passant_fen1=%s\n", en_passant_fen2.c_str(), en_passant_fen1.c_str() );
+}
 
-    printf( "* Known position tests\n" );
+static int nbr_position_tests( int comprehensive )
+{
     int nbr_tests = sizeof(tests)/sizeof(tests[0]);
     int nbr_tests_to_run = nbr_tests;
     if( comprehensive < 3 )
         nbr_tests_to_run = comprehensive==2 ? nbr_tests-1 : 10;
-    for( int i=0; i<nbr_tests_to_run; i++ )
+    return nbr_tests_to_run;
+}
+
+// From the initial position Sargon plays 1.d4 or 1.e4 depending on the LDAR
+//  callback, seed LDAR as if the position tests were run in order, from the
+//  start, in this process (each initial position test calls LDAR once)
+static uint8_t position_test_ldar_seed( int i )
+{
+    thc::ChessPosition initial;
+    uint8_t seed = 0;
+    for( int j=0; j<i; j++ )
+    {
+        thc::ChessPosition cp;
+        cp.Forsyth( tests[j].fen );
+        if( cp == initial )
+            seed++;
+    }
+    return seed;
+}
+
+// Known position test i (of nbr_tests_to_run)
+static bool position_test( int i, int nbr_tests_to_run, bool quiet )
+{
+    TEST *pt = &tests[i];
+    thc::ChessRules cr;
+    cr.Forsyth(pt->fen);
+    if( !quiet )
+    {
+        std::string intro = util::sprintf("\nTest position %d is", i+1 );
+        std::string s = cr.ToDebugStr( intro.c_str() );
+        printf( "%s\n", s.c_str() );
+        printf( "Expected PV=%s\n", pt->pv );
+    }
+    printf( "Test %d of %d: PLYMAX=%d:", i+1, nbr_tests_to_run, pt->plymax_required );
+    if( 0 == strcmp(pt->fen,"2rq1r1k/3npp1p/3p1n1Q/pp1P2N1/8/2P4P/1P4P1/R4R1K w - - 0 1") )
+        printf( " (sorry this particular test is very slow) :" );
+    PV pv;
+    sargon_ldar_seed( position_test_ldar_seed(i) );
+    sargon_trace_search( util::sprintf("Test position %d, PLYMAX=%d, %s", i+1, pt->plymax_required, pt->fen) );
+    sargon_run_engine( cr, pt->plymax_required, pv, false );
+    std::vector<thc::Move> &v = pv.variation;
+    std::string s_pv;
+    std::string spacer;
+    for( thc::Move mv: v )
+    {
+        s_pv += spacer;
+        spacer = " ";
+        s_pv += mv.NaturalOut(&cr);
+        cr.PlayMove(mv);
+    }
+    std::string sargon_move = sargon_export_move(BESTM);
+    bool pass = (s_pv==std::string(pt->pv));
+    if( !pass )
+        printf( "FAIL\n Fail reason: Expected PV=%s, Calculated PV=%s\n", pt->pv, s_pv.c_str() );
+    else
+    {
+        pass = (sargon_move==std::string(pt->solution));
+        if( !pass )
+            printf( "FAIL\n Fail reason: Expected move=%s, Calculated move=%s\n", pt->solution, sargon_move.c_str() );
+        else if( *pt->pv  )
+        {
+            pass = (pv.value==pt->centipawns);
+            if( !pass )
+                printf( "FAIL\n Fail reason: Expected centipawns=%d, Calculated centipawns=%d\n", pt->centipawns, pv.value );
+        }
+    }
+    if( pass )
+        printf( " PASS\n" );
+    return pass;
+}
+
+/*
+
+    Sharded tests (the -j switch)
+
+    Each position test, whole game test and the minimax tests run as a
+    separate job, in a separate sargon-tests process (Sargon's state is a
+    single 64K memory image, so they can't share a process), started with
+    "-job type index" plus the switches that affect the tests. Up to N jobs
+    run at once, longest first, so the slowest tests don't start last and
+    hold up the finish. Each job's output is captured and printed in the
+    usual test order, and a job passes if its process exits with status 0.
+    Tests that play Sargon's book moves seed its LDAR callback as a serial
+    run would (see position_test_ldar_seed() and whole_game_test()), so a
+    test passes or fails the same way in its own process, and -serial-check
+    confirms it.
+
+*/
+
+// A test run by a separate sargon-tests process
+struct JOB
+{
+    char          type;     // 'p' position test, 'g' whole game test, 'm' minimax tests
+    int           idx;
+    double        cost;     // estimated, for longest first scheduling
+    bool          started;
+    bool          done;
+    bool          passed;
+    std::string   output;
+    unsigned long ms;
+};
+
+// Run one test, in a process started by sargon_sharded_tests()
+static bool run_job( char job_type, int job_idx, bool quiet, int comprehensive )
+{
+    bool ok = false;
+    if( job_type=='p' && job_idx>=0 && job_idx<nbr_position_tests(comprehensive) )
+        ok = position_test( job_idx, nbr_position_tests(comprehensive), quiet );
+    else if( job_type=='g' && job_idx>=0 && job_idx<nbr_whole_game_tests(comprehensive) )
+        ok = whole_game_test( job_idx, quiet );
+    else if( job_type=='m' )
+        ok = sargon_minimax_regression_test( quiet );
+    else
+        printf( "Unknown test -job %c %d\n", job_type, job_idx );
+    return ok;
+}
+
+static bool sargon_sharded_tests( const std::string &exe, const std::string &test_types, const std::string &job_args,
+                                  int nbr_processes, int comprehensive, bool serial_check, bool quiet, std::string &summary )
+{
+    // Each extra ply costs Sargon roughly five times as much work, and a whole
+    //  game is about 100 Sargon moves
+    std::vector<JOB> jobs;
+    for( char c: test_types )
+    {
+        int n = (c=='p' ? nbr_position_tests(comprehensive) : (c=='g' ? nbr_whole_game_tests(comprehensive) : 1));
+        for( int i=0; i<n; i++ )
+        {
+            JOB job;
+            job.type    = c;
+            job.idx     = i;
+            int plymax  = (c=='p' ? tests[i].plymax_required : (c=='g' ? "334455"[i]-'0' : 1));
+            job.cost    = (c=='g' ? 100.0 : 1.0);
+            for( int j=0; j<plymax; j++ )
+                job.cost *= 5.0;
+            job.started = false;
+            job.done    = false;
+            job.passed  = false;
+            job.ms      = 0;
+            jobs.push_back(job);
+        }
+    }
+    if( nbr_processes < 1 )
+        nbr_processes = std::thread::hardware_concurrency();
+    if( nbr_processes < 1 )
+        nbr_processes = 1;
+    std::vector<JOB*> longest_first;
+    for( JOB &job: jobs )
+        longest_first.push_back( &job );
+    std::stable_sort( longest_first.begin(), longest_first.end(),
+                      []( const JOB *a, const JOB *b ) { return a->cost > b->cost; } );
+
+    // Each thread runs one job process at a time
+    std::mutex mtx;
+    std::condition_variable cv;
+    auto runner = [&]()
+    {
+        for(;;)
+        {
+            JOB *job = NULL;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                for( JOB *p: longest_first )
+                {
+                    if( !p->started )
+                    {
+                        job = p;
+                        job->started = true;
+                        break;
+                    }
+                }
+            }
+            if( !job )
+                break;
+            std::string cmd = util::sprintf( "\"%s\" -job %c %d%s", exe.c_str(), job->type, job->idx, job_args.c_str() );
+            std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+            std::string output;
+            int status = -1;
+#ifdef _WIN32
+            FILE *f = _popen( cmd.c_str(), "r" );
+#else
+            FILE *f = popen( cmd.c_str(), "r" );
+#endif
+            if( f )
+            {
+                char buf[1024];
+                size_t len;
+                while( (len=fread(buf,1,sizeof(buf),f)) > 0 )
+                    output.append( buf, len );
+#ifdef _WIN32
+                status = _pclose(f);
+#else
+                status = pclose(f);
+#endif
+            }
+            if( status!=0 && output.find("FAIL")==std::string::npos )
+                output += util::sprintf( " FAIL\n Fail reason: test process %s (status %d)\n", f?"failed":"could not be started", status );
+            std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+            std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
+            std::lock_guard<std::mutex> lck(mtx);
+            job->output = output;
+            job->passed = (status == 0);
+            job->ms     = static_cast<unsigned long>(ms.count());
+            job->done   = true;
+            cv.notify_one();
+        }
+    };
+    std::vector<std::thread> threads;
+    for( int i=0; i<nbr_processes && i<static_cast<int>(jobs.size()); i++ )
+        threads.push_back( std::thread(runner) );
+
+    // Print the results in test order, as they become available
+    bool ok = true;
+    double total_ms = 0;
+    char prev_type = 0;
+    for( JOB &job: jobs )
+    {
+        if( job.type != prev_type )
+        {
+            if( job.type == 'p' )
+            {
+                position_tests_machinery();
+                printf( "* Known position tests\n" );
+            }
+            else if( job.type == 'g' )
+                printf( "* Whole game tests\n" );
+            prev_type = job.type;
+        }
+        fflush( stdout );
+        std::unique_lock<std::mutex> lck(mtx);
+        cv.wait( lck, [&]{ return job.done; } );
+        printf( "%s", job.output.c_str() );
+        if( !job.passed )
+            ok = false;
+        total_ms += job.ms;
+    }
+    fflush( stdout );
+    for( std::thread &t: threads )
+        t.join();
+    summary = util::sprintf( " (%d tests in %d processes, %.3f seconds of test time)",
+                                static_cast<int>(jobs.size()), static_cast<int>(threads.size()), total_ms/1000.0 );
+
+    // Optionally check running the tests one at a time, in this process, passes
+    //  and fails exactly the same tests
+    if( serial_check )
+    {
+        printf( "* Serial check, the same tests one at a time\n" );
+        int nbr_differences = 0;
+        for( const JOB &job: jobs )
+        {
+            bool passed = run_job( job.type, job.idx, quiet, comprehensive );
+            if( passed != job.passed )
+            {
+                printf( "Serial check FAIL: -job %c %d %s with -j, but %s serially\n", job.type, job.idx,
+                    job.passed ? "passed" : "failed", passed ? "passed" : "failed" );
+                nbr_differences++;
+            }
+        }
+        if( nbr_differences > 0 )
+            ok = false;
+        printf( "Serial check %s, %d of %d tests differ\n", nbr_differences==0 ? "PASS" : "FAIL",
+            nbr_differences, static_cast<int>(jobs.size()) );
+    }
+    return ok;
+}
+
+// Compare native POINTS() with ATTACK stepping square by square against
+//  ATTACK using ray tables and an occupancy bitboard, on the test positions
+bool sargon_attack_benchmark( bool quiet, int comprehensive )
+{
+    bool ok = true;
+    printf( "* Native ATTACK ray table micro-benchmark\n" );
+    unsigned long iterations = comprehensive==1 ? 1000 : (comprehensive==2 ? 10000 : 100000);
+    int nbr_tests = sizeof(tests)/sizeof(tests[0]);
+    double total_steps=0, total_rays=0;
+    for( int i=0; i<nbr_tests; i++ )
     {
         TEST *pt = &tests[i];
         thc::ChessRules cr;
         cr.Forsyth(pt->fen);
-        if( !quiet )
+        sargon_import_position(cr);
+        bool pass;
+        double ns_steps, ns_rays;
+        std::string report = sargon_points_benchmark( iterations, pass, ns_steps, ns_rays );
+        total_steps += ns_steps;
+        total_rays  += ns_rays;
+        if( !quiet || !pass )
+            printf( "Test %d of %d: %s\n", i+1, nbr_tests, report.c_str() );
+        if( !pass )
+            ok = false;
+    }
+    printf( "Average POINTS() time: steps %.0f ns, rays %.0f ns, speedup %.2f, results %s\n",
+        total_steps/nbr_tests, total_rays/nbr_tests,
+        total_rays>0 ? total_steps/total_rays : 0.0, ok ? "identical" : "DIFFER" );
+    return ok;
+}
+
+// Time Sargon's exchange evaluation XCHNG (and NEXTAD) on prepared attack
+//  lists. These routines make heavy use of the Z80 EXX and EX AF,AF'
+//  instructions, so timing with exx_lock_free set to 0 and 1 in sargon-x86.asm
+//  compares emulating them with (implicitly locked) XCHG and without
+struct XCHNG_TEST
+{
+    unsigned char piece;        // piece attacked (P1)
+    unsigned char atklst[14];   // white count, white slots, black count, black slots
+    unsigned char points_lost;  // expected results, register e
+    unsigned char value;        //  and register d
+    const char *description;
+};
+
+static XCHNG_TEST xchng_tests[]=
+{
+    { 0x02, {1,1,0,0,0,0,0, 1,1,0,0,0,0,0},             0x04, 0x06, "N attacked by p, defended by P" },
+    { 0x04, {1,0,0,0,0,9,0, 2,0,3,3,0,0,0},             0x0a, 0x0a, "R attacked by n,b, defended by Q" },
+    { 0x85, {2,1,0,0,5,0,0, 3,0,3,3,0,0,10},            0x10, 0x12, "q attacked by P,R, defended by n,b,k" },
+    { 0x81, {0,0,0,0,0,0,0, 2,0,3,0,0,0,10},            0x00, 0x02, "p defended by n,k" },
+    { 0x03, {3,0x11,0,0,0x55,0,0, 3,0,0x33,0,0,9,0},    0x00, 0x06, "B attacked by n,n,q, defended by P,P,R,R" }
+};
+
+bool sargon_xchng_benchmark( bool quiet, int comprehensive )
+{
+    bool ok = true;
+    printf( "* XCHNG micro-benchmark\n" );
+    unsigned long iterations = comprehensive==1 ? 100000 : (comprehensive==2 ? 1000000 : 10000000);
+    int nbr_tests = sizeof(xchng_tests)/sizeof(xchng_tests[0]);
+    double total_ns = 0;
+    for( int i=0; i<nbr_tests; i++ )
+    {
+        XCHNG_TEST *pt = &xchng_tests[i];
+        z80_registers regs;
+        std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
         {
-            std::string intro = util::sprintf("\nTest position %d is", i+1 );
-            std::string s = cr.ToDebugStr( intro.c_str() );
-            printf( "%s\n", s.c_str() );
-            printf( "Expected PV=%s\n", pt->pv );
-        }
-        printf( "Test %d of %d: PLYMAX=%d:", i+1, nbr_tests_to_run, pt->plymax_required );
-        if( 0 == strcmp(pt->fen,"2rq1r1k/3npp1p/3p1n1Q/pp1P2N1/8/2P4P/1P4P1/R4R1K w - - 0 1") )
-            printf( " (sorry this particular test is very slow) :" );
-        PV pv;
-        sargon_run_engine( cr, pt->plymax_required, pv, false );
-        std::vector<thc::Move> &v = pv.variation;
-        std::string s_pv;
-        std::string spacer;
-        for( thc::Move mv: v )
-        {
-            s_pv += spacer;
-            spacer = " ";
-            s_pv += mv.NaturalOut(&cr);
-            cr.PlayMove(mv);
-        }
-        std::string sargon_move = sargon_export_move(BESTM);
-        bool pass = (s_pv==std::string(pt->pv));
+            memcpy( poke(ATKLST), pt->atklst, sizeof(pt->atklst) );  // XCHNG consumes the lists
+            pokeb( P1, pt->piece );
+            pokeb( T3, pt->piece&7 );
+            memset( &regs, 0, sizeof(regs) );
+            sargon( api_XCHNG, &regs );
+        }
+        std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - base);
+        double ns = static_cast<double>(elapsed.count()) / iterations;
+        total_ns += ns;
+        unsigned char e = static_cast<unsigned char>(regs.de&0xff);
+        unsigned char d = static_cast<unsigned char>(regs.de>>8);
+        bool pass = (e==pt->points_lost && d==pt->value);
+        if( !quiet || !pass )
+            printf( "Test %d of %d: %s, %.1f ns%s\n", i+1, nbr_tests, pt->description, ns,
+                pass ? "" : util::sprintf(" FAIL e=%02x d=%02x, expected e=%02x d=%02x",
+                                        e, d, pt->points_lost, pt->value).c_str() );
         if( !pass )
-            printf( "FAIL\n Fail reason: Expected PV=%s, Calculated PV=%s\n", pt->pv, s_pv.c_str() );
-        else
+            ok = false;
+    }
+    printf( "Average XCHNG time (including call overhead) %.1f ns\n", total_ns/nbr_tests );
+    return ok;
+}
+
+// Time Sargon's move generator GENMOV, evaluation POINTS, attack finder
+//  ATTACK and pin finder PINFND, each called directly through its api_*
+//  entry point, on the test positions. The inputs are set up as FNDMOV sets
+//  them up at ply 0 (ply 1 for GENMOV), so a change to one routine, or to
+//  the code generated for it, can be measured on its own
+bool sargon_routine_benchmark( bool quiet, int comprehensive )
+{
+    bool ok = true;
+    printf( "* GENMOV, POINTS, ATTACK and PINFND micro-benchmarks\n" );
+    unsigned long iterations = comprehensive==1 ? 1000 : (comprehensive==2 ? 10000 : 100000);
+    double total_genmov=0, total_points=0, total_attack=0, total_pinfnd=0;
+    std::vector<std::string> fens;
+    int nbr_tests = sizeof(tests)/sizeof(tests[0]);
+    for( int i=0; i<nbr_tests; i++ )
+    {
+        if( std::find(fens.begin(),fens.end(),tests[i].fen) == fens.end() )
+            fens.push_back( tests[i].fen );
+    }
+    int nbr_positions = static_cast<int>(fens.size());
+    for( int i=0; i<nbr_positions; i++ )
+    {
+        thc::ChessRules cr;
+        cr.Forsyth(fens[i].c_str());
+        sargon_import_position(cr);
+        unsigned int  mlptrj = peekw(MLPTRJ);
+        unsigned char color  = peekb(COLOR);
+        std::string fail;
+        z80_registers regs;
+        std::chrono::time_point<std::chrono::steady_clock> base, now;
+
+        // PINFND, the pin list is then in place for ATTACK and POINTS
+        sargon( api_PINFND );
+        std::string pins( reinterpret_cast<const char *>(peek(PLISTA)), peekb(NPINS) );
+        base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
+            sargon( api_PINFND );
+        now = std::chrono::steady_clock::now();
+        double ns_pinfnd = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(now-base).count() ) / iterations;
+        if( pins != std::string(reinterpret_cast<const char *>(peek(PLISTA)), peekb(NPINS)) )
+            fail += " PINFND results vary";
+
+        // POINTS, as the evaluation at ply 0
+        auto points = [&]()
         {
-            pass = (sargon_move==std::string(pt->solution));
-            if( !pass )
-                printf( "FAIL\n Fail reason: Expected move=%s, Calculated move=%s\n", pt->solution, sargon_move.c_str() );
-            else if( *pt->pv  )
+            pokew( MLPTRJ, mlptrj );
+            pokeb( BC0, 0 );
+            pokeb( MV0, 0 );
+            memset( &regs, 0, sizeof(regs) );
+            sargon( api_POINTS, &regs );
+            return static_cast<unsigned char>( regs.af&0xff );
+        };
+        unsigned char value = points();
+        base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
+            points();
+        now = std::chrono::steady_clock::now();
+        double ns_points = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(now-base).count() ) / iterations;
+        if( points() != value )
+            fail += " POINTS results vary";
+
+        // ATTACK, on every square as POINTS calls it
+        std::string attacks;
+        auto attack = [&]()
+        {
+            attacks.clear();
+            for( int sq=21; sq<99; sq++ )
             {
-                pass = (pv.value==pt->centipawns);
-                if( !pass )
-                    printf( "FAIL\n Fail reason: Expected centipawns=%d, Calculated centipawns=%d\n", pt->centipawns, pv.value );
+                unsigned char piece = peekb(BOARDA+sq);
+                if( piece == 0xff )
+                    continue;
+                memset( poke(ATKLST), 0, 14 );
+                pokeb( M3, sq );
+                pokeb( P1, piece );
+                pokeb( T1, 7 );
+                sargon( api_ATTACK );
+                attacks.append( reinterpret_cast<const char *>(peek(ATKLST)), 14 );
             }
+        };
+        attack();
+        std::string attacks_first = attacks;
+        unsigned long nbr_squares = static_cast<unsigned long>(attacks.length()/14);
+        base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
+            attack();
+        now = std::chrono::steady_clock::now();
+        double ns_attack = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(now-base).count() ) / (iterations*nbr_squares);
+        if( attacks != attacks_first )
+            fail += " ATTACK results vary";
+
+        // GENMOV, as the move generation at ply 1
+        auto genmov = [&]()
+        {
+            pokeb( NPLY, 1 );
+            pokew( MLNXT, MLIST );
+            pokew( MLPTRI, PLYIX-2 );
+            pokew( MLPTRJ, mlptrj );
+            pokeb( COLOR, color );
+            sargon( api_GENMOV );
+            return (peekw(MLNXT)-MLIST) / 6;
+        };
+        unsigned int nbr_moves = genmov();
+        std::vector<std::string> moves;
+        for( unsigned int j=0; j<nbr_moves; j++ )
+            moves.push_back( sargon_export_move(MLIST+6*j,false) );
+        base = std::chrono::steady_clock::now();
+        for( unsigned long j=0; j<iterations; j++ )
+            genmov();
+        now = std::chrono::steady_clock::now();
+        double ns_genmov = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(now-base).count() ) / iterations;
+        if( genmov() != nbr_moves )
+            fail += " GENMOV results vary";
+
+        // The (pseudo legal) moves generated should include every legal move
+        std::vector<thc::Move> legal;
+        cr.GenLegalMoveList( legal );
+        for( thc::Move mv: legal )
+        {
+            std::string terse = mv.TerseOut().substr(0,4);   // Sargon always promotes to Queen
+            if( std::find(moves.begin(),moves.end(),terse) == moves.end() )
+                fail += " GENMOV missed " + terse;
         }
-        if( pass )
-            printf( " PASS\n" );
-        else
+        total_genmov += ns_genmov;
+        total_points += ns_points;
+        total_attack += ns_attack;
+        total_pinfnd += ns_pinfnd;
+        if( !quiet || fail.length()>0 )
+            printf( "Position %d of %d: %s\n GENMOV %.1f ns (%u moves), POINTS %.1f ns (value %02x), ATTACK %.1f ns, PINFND %.1f ns (%d pins)%s%s\n",
+                i+1, nbr_positions, fens[i].c_str(), ns_genmov, nbr_moves, ns_points, value, ns_attack, ns_pinfnd,
+                static_cast<int>(pins.length()), fail.length()>0 ? " FAIL" : "", fail.c_str() );
+        if( fail.length() > 0 )
             ok = false;
     }
+    printf( "Average times per call (including call overhead) GENMOV %.1f ns, POINTS %.1f ns, ATTACK %.1f ns, PINFND %.1f ns\n",
+        total_genmov/nbr_positions, total_points/nbr_positions, total_attack/nbr_positions, total_pinfnd/nbr_positions );
     return ok;
 }
 
+// The Z80 interpreter equivalent of sargon_callback(), deterministic LDAR as for the x86 code
+static void z80_callback( const char *msg, z80_registers &registers )
+{
+    if( 0 == strcmp(msg,"LDAR") )
+    {
+        static uint8_t a_reg;
+        a_reg++;
+        registers.af = (registers.af&0xff00) | a_reg;
+    }
+}
+
+// Calculate a move with the original Z80 code, same inputs as sargon_run_engine()
+static std::string z80_run_engine( const thc::ChessPosition &cp, int plymax )
+{
+    pokeb( PLYMAX, plymax );
+    sargon_import_position( cp );
+    pokeb( KOLOR, peekb(COLOR) );
+    sargon_z80_import_from_x86();
+    if( !sargon_z80(api_CPTRMV) )
+        return sargon_z80_error();
+    return sargon_z80_export_move();
+}
+
+// Benchmark the timing test positions, levels 1-3, 1-4 or 1-5
+bool sargon_move_benchmark( bool quiet, int comprehensive, const BENCHMARK_OPTIONS &options )
+{
+    int nbr_tests = sizeof(tests)/sizeof(tests[0]);
+    int nbr_tests_to_run = comprehensive==1 ? 12 : (comprehensive==2 ? 20 : nbr_tests);
+    std::vector<std::string> fens;
+    for( int i=nbr_tests-nbr_tests_to_run; i<nbr_tests; i++ )
+        fens.push_back( tests[i].fen );
+    BENCHMARK_OPTIONS benchmark_options = options;
+    benchmark_options.max_level = comprehensive+2;
+    return sargon_benchmark( fens, benchmark_options, quiet );
+}
+
 bool sargon_timing_tests( bool quiet, int comprehensive )
 {
     bool ok = true;
@@ -640,7 +1400,10 @@ Level 6: ..................................   34 tests
         if( offset < 0 )
             offset = 0;  // should never happen, just being cautious
         printf( "Level %d: ", level );
+        sargon_profile_reset();
         int multiplier = level<3 ? (level<2?100:10) : 1;
+        int nbr_positions = nbr_tests_to_run;
+        std::vector<std::string> x86_moves;
         for( int i=0; i<nbr_tests_to_run; i++ )
         {
             if( level==6 && i+offset==nbr_tests-12 )
@@ -651,7 +1414,10 @@ Level 6: ..................................   34 tests
                 thc::ChessRules cr;
                 cr.Forsyth(pt->fen);
                 PV pv;
+                sargon_trace_search( util::sprintf("Timing test, PLYMAX=%d, %s", level, pt->fen) );
                 sargon_run_engine( cr, level, pv, false );
+                if( j == 0 )
+                    x86_moves.push_back( sargon_export_move(BESTM) );
             }
             printf(".");
         }
@@ -677,6 +1443,45 @@ Level 6: ..................................   34 tests
                 exponent, level-1,
                 speedup ); 
         }
+        if( sargon_profile_available() )
+            printf( "%s", sargon_profile_report().c_str() );
+
+        // Run the same positions on the original Z80 code, check it calculates the
+        //  same moves and predict TRS-80 times from the T-states of the search
+        //  (FNDMOV, CPTRMV also updates the TRS-80 display). Emulation is slow
+        //  (a minute or more per position at level 5), so fewer levels unless -2 or -3
+        int z80_max_level = comprehensive==1 ? 3 : (comprehensive==2 ? 4 : 5);
+        if( z80_reference && level<=z80_max_level )
+        {
+            std::vector<std::string> differences;
+            sargon_z80_reset_stats();
+            printf( "    Z80: " );
+            for( int i=0; i<nbr_positions; i++ )
+            {
+                TEST *pt = &tests[i+offset];
+                thc::ChessRules cr;
+                cr.Forsyth(pt->fen);
+                std::string z80_move = z80_run_engine( cr, level );
+                bool book = (peekb(MOVENO) == 1);  // book moves depend on the LDAR callback sequence
+                if( z80_move != x86_moves[i] && !book )
+                    differences.push_back( util::sprintf( "%s: Z80 %s, x86 %s", pt->fen, z80_move.c_str(), x86_moves[i].c_str() ) );
+                printf(".");
+            }
+            double z80_avg_s = sargon_z80_routine_tstates("FNDMOV") / SARGON_Z80_TRS80_HZ / nbr_positions;
+            printf( " %4d tests\n         Avg=%.1f secs predicted for TRS-80, %.1f x manual's figure, moves %s\n",
+                nbr_positions, z80_avg_s,
+                z80_avg_s / trs_80,
+                differences.size()==0 ? "match x86" : "DIFFER" );
+            for( std::string &diff: differences )
+                printf( "         %s\n", diff.c_str() );
+            if( differences.size() > 0 )
+                ok = false;
+            if( !quiet )
+            {
+                printf( "%s", sargon_z80_report_stats().c_str() );
+                printf( "%s", sargon_z80_report_translation().c_str() );
+            }
+        }
         if( level == 6 )
         {
             if( nbr_tests_to_run != 12 )
@@ -0,0 +1,191 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-timeline.cpp
+ *       A timeline of engine activity, in Chrome trace event format, for
+ *       viewing in chrome://tracing or https://ui.perfetto.dev
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "sargon-timeline.h"
+
+/*
+
+  The file is a JSON array of events. Spans are written as complete ("X")
+  events when they end, with their start time and duration, so a search
+  abandoned with longjmp() never leaves a span open. The engine writes a
+  handful of events per command and per iteration of the search (not per
+  callback), and stdio buffers them, so a timeline costs next to nothing
+  and can be left on in tournament play. The closing ']' is optional in
+  this format, so if the engine is killed the file is still readable up
+  to the last flush.
+
+*/
+
+static FILE *timeline_out;
+static std::atomic<bool> active;
+static std::mutex timeline_mtx;
+static std::chrono::time_point<std::chrono::steady_clock> base;
+static const char *separator;
+static std::map<std::string,int> tracks;
+static int generation;                      // of timeline files, tracks restart with each
+static thread_local int track;              // 0 until the thread names its track
+static thread_local int track_generation;
+
+bool sargon_timeline_start( const std::string &timeline_file )
+{
+    sargon_timeline_stop();
+    std::lock_guard<std::mutex> lck(timeline_mtx);
+    timeline_out = fopen( timeline_file.c_str(), "wt" );
+    if( !timeline_out )
+        return false;
+    fputs( "[", timeline_out );
+    separator = "\n";
+    tracks.clear();
+    generation++;
+    base = std::chrono::steady_clock::now();
+    active = true;
+    return true;
+}
+
+void sargon_timeline_stop()
+{
+    std::lock_guard<std::mutex> lck(timeline_mtx);
+    if( timeline_out )
+    {
+        fputs( "\n]\n", timeline_out );
+        fclose( timeline_out );
+        timeline_out = NULL;
+    }
+    active = false;
+}
+
+bool sargon_timeline_active()
+{
+    return active;
+}
+
+unsigned long long sargon_timeline_now()
+{
+    if( !active )
+        return 0;
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - base).count();
+}
+
+// Track ids for names, and a metadata event naming each new track. Call
+//  with the mutex held
+static int track_id( const std::string &name )
+{
+    auto it = tracks.find(name);
+    if( it != tracks.end() )
+        return it->second;
+    int id = static_cast<int>(tracks.size()) + 1;
+    tracks[name] = id;
+    fprintf( timeline_out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+        separator, id, sargon_timeline_escape(name).c_str() );
+    separator = ",\n";
+    return id;
+}
+
+void sargon_timeline_track( const std::string &name )
+{
+    if( !active )
+        return;
+    std::lock_guard<std::mutex> lck(timeline_mtx);
+    if( timeline_out )
+    {
+        track = track_id(name);
+        track_generation = generation;
+    }
+}
+
+// Write one event, the args formatted from args_fmt and ap
+static void event( char ph, const char *name, unsigned long long ts, unsigned long long dur, const char *args_fmt, va_list ap )
+{
+    std::lock_guard<std::mutex> lck(timeline_mtx);
+    if( !timeline_out )
+        return;
+    if( track==0 || track_generation!=generation )
+    {
+        track = track_id("engine");
+        track_generation = generation;
+    }
+    fprintf( timeline_out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,", separator, sargon_timeline_escape(name).c_str(), ph, ts );
+    if( ph == 'X' )
+        fprintf( timeline_out, "\"dur\":%llu,", dur );
+    else if( ph == 'i' )
+        fputs( "\"s\":\"t\",", timeline_out );
+    fprintf( timeline_out, "\"pid\":1,\"tid\":%d,\"args\":{", track );
+    vfprintf( timeline_out, args_fmt, ap );
+    fputs( "}}", timeline_out );
+    separator = ",\n";
+}
+
+void sargon_timeline_span( const char *name, unsigned long long start, const char *args_fmt, ... )
+{
+    if( !active )
+        return;
+    unsigned long long now = sargon_timeline_now();
+    va_list ap;
+    va_start( ap, args_fmt );
+    event( 'X', name, start, now>start ? now-start : 0, args_fmt, ap );
+    va_end( ap );
+}
+
+void sargon_timeline_instant( const char *name, const char *args_fmt, ... )
+{
+    if( !active )
+        return;
+    va_list ap;
+    va_start( ap, args_fmt );
+    event( 'i', name, sargon_timeline_now(), 0, args_fmt, ap );
+    va_end( ap );
+}
+
+void sargon_timeline_counter( const char *name, const char *args_fmt, ... )
+{
+    if( !active )
+        return;
+    va_list ap;
+    va_start( ap, args_fmt );
+    event( 'C', name, sargon_timeline_now(), 0, args_fmt, ap );
+    va_end( ap );
+}
+
+std::string sargon_timeline_escape( const std::string &s )
+{
+    std::string out;
+    for( char c: s )
+    {
+        if( c=='"' || c=='\\' )
+        {
+            out += '\\';
+            out += c;
+        }
+        else if( static_cast<unsigned char>(c) < ' ' )
+            out += ' ';
+        else
+            out += c;
+    }
+    return out;
+}
+
+void sargon_timeline_flush()
+{
+    if( !active )
+        return;
+    std::lock_guard<std::mutex> lck(timeline_mtx);
+    if( timeline_out )
+        fflush( timeline_out );
+}
@@ -0,0 +1,53 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-timeline.h
+ *       A timeline of engine activity, in Chrome trace event format, for
+ *       viewing in chrome://tracing or https://ui.perfetto.dev
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_TIMELINE_H_INCLUDED
+#define SARGON_TIMELINE_H_INCLUDED
+
+#include <string>
+
+// Start writing a timeline file (any timeline already being written is
+//  finished first), returns false if it can't be created
+bool sargon_timeline_start( const std::string &timeline_file );
+
+// Finish the timeline file
+void sargon_timeline_stop();
+
+// Is a timeline being written? Everything else does nothing if not
+bool sargon_timeline_active();
+
+// Microseconds since the timeline started, the start time of a span
+unsigned long long sargon_timeline_now();
+
+// Events from the calling thread go on this track (eg one per session),
+//  by default a thread's events go on a track named "engine"
+void sargon_timeline_track( const std::string &name );
+
+// A span from start (see sargon_timeline_now()) until now. The optional
+//  args are JSON object members, eg "\"plymax\":%d", formatted only if a
+//  timeline is being written
+void sargon_timeline_span( const char *name, unsigned long long start, const char *args_fmt="", ... );
+
+// A point event, eg an aborted search
+void sargon_timeline_instant( const char *name, const char *args_fmt="", ... );
+
+// Counter values, eg "\"nodes\":%lu", each member is a separate series
+void sargon_timeline_counter( const char *name, const char *args_fmt, ... );
+
+// A string escaped for use in args
+std::string sargon_timeline_escape( const std::string &s );
+
+// Write out buffered events, so a timeline is complete up to this point
+//  even if the engine is killed (the closing ']' is optional)
+void sargon_timeline_flush();
+
+#endif // SARGON_TIMELINE_H_INCLUDED
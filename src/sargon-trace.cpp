@@ -0,0 +1,283 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-trace.cpp
+ *       Binary traces of Sargon's callbacks, to check different builds
+ *       of Sargon search identically
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "util.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-trace.h"
+
+/*
+
+  A trace file is an eight byte signature, followed by eight byte records.
+  An event record is a callback id (1 up), NPLY, the from and to squares
+  and flags of the move MLPTRJ points at, the value in register A, BRDC
+  and MTRL. A search record is id 0, then the length of the label in bytes
+  2 and 3, followed by the label padded with zeros to a multiple of eight
+  bytes. So two builds that search identically write identical files, and
+  comparing them is mostly comparing eight bytes at a time.
+
+*/
+
+static const char signature[8] = { 'S','G','N','T','R','C','0','1' };
+static const int  RECORD = 8;
+static const int  CONTEXT = 8;   // events shown before a difference
+
+// Callback ids, callbacks not listed are traced as "other"
+static const char *event_names[] =
+{
+    "(search)",
+    "Suppress King moves",
+    "end of POINTS()",
+    "after GENMOV()",
+    "Alpha beta cutoff?",
+    "No. Best move?",
+    "Yes! Best move",
+    "LDAR",
+    "After FNDMOV()",
+    "(other)"
+};
+static const unsigned char ID_OTHER = sizeof(event_names)/sizeof(event_names[0]) - 1;
+
+static FILE *trace_out;
+static unsigned char buf[65536];
+static size_t buf_len;
+static unsigned long nbr_events;
+
+static void flush()
+{
+    if( buf_len > 0 )
+        fwrite( buf, 1, buf_len, trace_out );
+    buf_len = 0;
+}
+
+bool sargon_trace_start( const std::string &trace_file )
+{
+    sargon_trace_stop();
+    trace_out = fopen( trace_file.c_str(), "wb" );
+    if( !trace_out )
+        return false;
+    fwrite( signature, 1, sizeof(signature), trace_out );
+    buf_len = 0;
+    nbr_events = 0;
+    return true;
+}
+
+unsigned long sargon_trace_stop()
+{
+    if( trace_out )
+    {
+        flush();
+        fclose( trace_out );
+        trace_out = NULL;
+    }
+    return nbr_events;
+}
+
+void sargon_trace_search( const std::string &label )
+{
+    if( !trace_out )
+        return;
+    size_t len = label.length() > 0xffff ? 0xffff : label.length();
+    size_t padded = (len+RECORD-1) / RECORD * RECORD;
+    if( buf_len + RECORD + padded > sizeof(buf) )
+        flush();
+    unsigned char *p = buf + buf_len;
+    memset( p, 0, RECORD+padded );
+    p[2] = static_cast<unsigned char>(len&0xff);
+    p[3] = static_cast<unsigned char>(len>>8);
+    memcpy( p+RECORD, label.c_str(), len );
+    buf_len += RECORD + padded;
+}
+
+// Callback messages are string constants, so look them up by address first
+static unsigned char event_id( const char *msg )
+{
+    static const char    *cached_msg[16];
+    static unsigned char  cached_id[16];
+    static int            nbr_cached;
+    for( int i=0; i<nbr_cached; i++ )
+    {
+        if( cached_msg[i] == msg )
+            return cached_id[i];
+    }
+    unsigned char id = ID_OTHER;
+    for( unsigned char i=1; i<ID_OTHER; i++ )
+    {
+        if( 0 == strcmp(msg,event_names[i]) )
+            id = i;
+    }
+    if( nbr_cached < 16 )
+    {
+        cached_msg[nbr_cached] = msg;
+        cached_id[nbr_cached++] = id;
+    }
+    return id;
+}
+
+void sargon_trace_callback( const char *msg, const z80_registers &registers )
+{
+    if( !trace_out )
+        return;
+
+    // Native POINTS() replaces the assembly language evaluation, its result
+    //  is traced at "end of POINTS()" like the assembly language result
+    if( 0 == strcmp(msg,"native POINTS()") )
+        return;
+    if( buf_len + RECORD > sizeof(buf) )
+        flush();
+    unsigned char *p = buf + buf_len;
+    p[0] = event_id(msg);
+    p[1] = peekb(NPLY);
+    unsigned int mlptrj = peekw(MLPTRJ);
+    if( mlptrj == 0 )
+        p[2] = p[3] = p[4] = 0;
+    else
+    {
+        p[2] = peekb(mlptrj+2);   // from
+        p[3] = peekb(mlptrj+3);   // to
+        p[4] = peekb(mlptrj+4);   // flags
+    }
+    p[5] = static_cast<unsigned char>(registers.af&0xff);
+    p[6] = peekb(BRDC);
+    p[7] = peekb(MTRL);
+    buf_len += RECORD;
+    nbr_events++;
+}
+
+// Comparison
+
+static bool read_trace( const std::string &trace_file, std::vector<unsigned char> &trace, std::string &error )
+{
+    FILE *f = fopen( trace_file.c_str(), "rb" );
+    if( !f )
+    {
+        error = "Cannot open " + trace_file;
+        return false;
+    }
+    unsigned char block[65536];
+    size_t n;
+    while( (n=fread(block,1,sizeof(block),f)) > 0 )
+        trace.insert( trace.end(), block, block+n );
+    fclose(f);
+    if( trace.size()<sizeof(signature) || 0!=memcmp(trace.data(),signature,sizeof(signature)) || trace.size()%RECORD!=0 )
+    {
+        error = trace_file + " is not a Sargon trace file";
+        return false;
+    }
+    return true;
+}
+
+static size_t label_size( const unsigned char *p )
+{
+    size_t len = p[2] + (p[3]<<8);
+    return RECORD + (len+RECORD-1) / RECORD * RECORD;
+}
+
+static std::string label( const std::vector<unsigned char> &trace, size_t offset )
+{
+    if( offset == 0 )
+        return "(start of trace)";
+    const unsigned char *p = trace.data() + offset;
+    size_t len = p[2] + (p[3]<<8);
+    return std::string( reinterpret_cast<const char *>(p+RECORD), len );
+}
+
+static std::string describe( const std::vector<unsigned char> &trace, size_t offset )
+{
+    if( offset >= trace.size() )
+        return "(end of trace)";
+    const unsigned char *p = trace.data() + offset;
+    if( p[0] == 0 )
+        return "New search: " + label(trace,offset);
+    std::string move = "----";
+    if( p[2]!=0 || p[3]!=0 )
+        move = algebraic(p[2]) + algebraic(p[3]);
+    return util::sprintf( "%-20s NPLY=%d move=%s flags=%02x value=%02x BRDC=%d MTRL=%d",
+        event_names[ p[0]<=ID_OTHER ? p[0] : ID_OTHER ], p[1], move.c_str(), p[4], p[5],
+        static_cast<signed char>(p[6]), static_cast<signed char>(p[7]) );
+}
+
+bool sargon_trace_compare( const std::string &trace_file1, const std::string &trace_file2, std::string &report )
+{
+    std::vector<unsigned char> trace1, trace2;
+    std::string error;
+    if( !read_trace(trace_file1,trace1,error) || !read_trace(trace_file2,trace2,error) )
+    {
+        report = error + "\n";
+        return false;
+    }
+    std::chrono::time_point<std::chrono::steady_clock> base = std::chrono::steady_clock::now();
+    size_t offset = sizeof(signature), search_offset = 0;
+    size_t recent[CONTEXT];     // offsets of the most recent events, a ring
+    unsigned long nbr_searches=0, nbr_events_compared=0, nbr_events_in_search=0;
+    size_t end = trace1.size()<trace2.size() ? trace1.size() : trace2.size();
+    const unsigned char *p1 = trace1.data(), *p2 = trace2.data();
+    bool same = true;
+    while( offset < end )
+    {
+        if( 0 != memcmp(p1+offset,p2+offset,RECORD) )
+        {
+            same = false;
+            break;
+        }
+        if( p1[offset] == 0 )
+        {
+            size_t size = label_size(p1+offset);
+            if( offset+size > end || 0 != memcmp(p1+offset,p2+offset,size) )
+            {
+                same = false;
+                break;
+            }
+            search_offset = offset;
+            nbr_searches++;
+            nbr_events_in_search = 0;
+            offset += size;
+        }
+        else
+        {
+            recent[nbr_events_in_search%CONTEXT] = offset;
+            nbr_events_in_search++;
+            nbr_events_compared++;
+            offset += RECORD;
+        }
+    }
+    if( same && trace1.size()!=trace2.size() )
+        same = false;
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - base);
+    double elapsed = static_cast<double>(ms.count()) / 1000.0;
+    if( same )
+    {
+        report = util::sprintf( "Traces are identical, %lu searches, %lu events compared in %.3f seconds",
+            nbr_searches, nbr_events_compared, elapsed );
+        if( elapsed > 0 )
+            report += util::sprintf( " (%.0f million events/second)", nbr_events_compared/elapsed/1000000.0 );
+        report += "\n";
+        return true;
+    }
+
+    // Describe the first difference, with the events leading up to it
+    report = util::sprintf( "Traces differ at event %lu of search %lu, %s\n",
+        nbr_events_in_search+1, nbr_searches, label(trace1,search_offset).c_str() );
+    unsigned long first = nbr_events_in_search>CONTEXT ? nbr_events_in_search-CONTEXT : 0;
+    for( unsigned long i=first; i<nbr_events_in_search; i++ )
+        report += util::sprintf( "  %8lu  %s\n", i+1, describe(trace1,recent[i%CONTEXT]).c_str() );
+    report += util::sprintf( "%s:\n  %8lu  %s\n", trace_file1.c_str(), nbr_events_in_search+1, describe(trace1,offset).c_str() );
+    report += util::sprintf( "%s:\n  %8lu  %s\n", trace_file2.c_str(), nbr_events_in_search+1, describe(trace2,offset).c_str() );
+    return false;
+}
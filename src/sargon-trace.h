@@ -0,0 +1,40 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-trace.h
+ *       Binary traces of Sargon's callbacks, to check different builds
+ *       of Sargon search identically
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_TRACE_H_INCLUDED
+#define SARGON_TRACE_H_INCLUDED
+
+#include <string>
+#include "sargon-asm-interface.h"
+
+// Start writing a trace file, returns false if it can't be created
+bool sargon_trace_start( const std::string &trace_file );
+
+// Finish the trace file, returns the number of events written
+unsigned long sargon_trace_stop();
+
+// Mark the start of a search, the label (eg a FEN and PLYMAX) identifies
+//  the search in comparisons
+void sargon_trace_search( const std::string &label );
+
+// Call from sargon_callback(); records the callback, NPLY, the move at
+//  MLPTRJ, the value in register A, BRDC and MTRL. Does nothing unless a
+//  trace is being written
+void sargon_trace_callback( const char *msg, const z80_registers &registers );
+
+// Compare two trace files, eg from sargon-tests and sargon-tests-cpp, or
+//  from builds with different converter options. Returns false if they
+//  differ, the report describes the first difference with the events
+//  leading up to it
+bool sargon_trace_compare( const std::string &trace_file1, const std::string &trace_file2, std::string &report );
+
+#endif // SARGON_TRACE_H_INCLUDED
@@ -0,0 +1,2342 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-z80.cpp
+ *       Run the original Z80 Sargon in a Z80 interpreter, as a reference
+ *       for the x86 translation, with T-state (Z80 clock cycle) accounting
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include "util.h"
+#include "thc.h"
+#include "sargon-asm-interface.h"
+#include "sargon-interface.h"
+#include "sargon-z80.h"
+
+/*
+
+  The x86 Sargon is a mechanical translation of the Z80 Sargon. This module
+  runs the Z80 original, as assembled by zmac into stages/sargon-z80.lst,
+  so the translation can be checked against the real thing and so we can
+  count Z80 T-states and predict how long a move takes on a TRS-80.
+
+  The interpreter implements the documented Z80 instruction set, which is
+  all Sargon uses, with documented T-states. The Jove monitor calls (RST 38H
+  followed by parameter bytes) are skipped; console output is discarded and
+  console input always returns a carriage return. Routines the x86 build
+  replaces with stubs (FCDMAT, TBCPMV and MAKEMV) are patched to RET.
+
+  The Z80 source has no CALLBACK macros, they exist only in the x86 build.
+  We find them by reproducing the convert-z80-to-x86 -z80_only rules on the
+  combined source, which tells us the Z80 source line following each
+  CALLBACK. The callback is made when the program counter reaches that
+  line's address. (A jump to that address also makes the callback, unlike
+  in the x86 code, if the label is on the line after the CALLBACK. Sargon's
+  CALLBACKs don't depend on this.)
+
+*/
+
+// T-states are accumulated per routine (an address that's CALLed). As with
+//  the x86 -profile counters, frames abandoned by a routine discarding its
+//  return address are detected using the stack pointer
+struct FRAME
+{
+    uint16_t addr;          // routine
+    uint16_t sp;            // sp immediately after the CALL
+    uint64_t start;         // tstates at entry
+    uint64_t children;      // tstates in callees
+};
+
+struct ROUTINE_STATS
+{
+    uint64_t calls;
+    uint64_t total;
+    uint64_t self;
+};
+
+// Z80 flags
+#define FLAG_C  0x01
+#define FLAG_N  0x02
+#define FLAG_PV 0x04
+#define FLAG_X  0x08
+#define FLAG_H  0x10
+#define FLAG_Y  0x20
+#define FLAG_Z  0x40
+#define FLAG_S  0x80
+
+// Register indexes, in Z80 instruction encoding order (index 6 is (HL) in
+//  instructions, we keep F there)
+#define REG_B 0
+#define REG_C 1
+#define REG_D 2
+#define REG_E 3
+#define REG_H 4
+#define REG_L 5
+#define REG_F 6
+#define REG_A 7
+
+// Return address pushed for the outermost call, reaching it ends the run
+#define SENTINEL 0xffff
+
+// Unused memory, well above the Z80 program and data
+#define SPARE 0xff00
+
+static uint8_t  mem[65536];
+static uint8_t  reg[8];
+static uint8_t  reg_alt[8];
+static uint16_t ix, iy, sp, pc;
+static uint8_t  reg_i, reg_r;
+static bool     iff1, iff2;
+static uint64_t tstates;
+static bool     running;
+static std::string error;
+
+static bool loaded;
+static std::map<std::string,unsigned int> symbols;       // upper case names
+static std::map<unsigned int,std::string> routine_names;
+static std::vector<std::vector<std::string>> callback_msgs;   // by address
+static std::vector<bool> callback_at;
+static SARGON_Z80_CALLBACK callback_fn;
+
+static std::vector<FRAME> frames;
+static std::vector<ROUTINE_STATS> routine_stats;
+
+// Block translation, see below. Pages (256 bytes) of memory that contain
+//  translated code are marked, writing to them invalidates the translations
+static bool translate = true;
+static uint8_t code_page[256];
+static bool cache_dirty;
+
+// Sign, zero, undocumented X and Y, and parity flags for each byte value
+static uint8_t sz53[256];
+static uint8_t sz53p[256];
+
+static void init_tables()
+{
+    for( int i=0; i<256; i++ )
+    {
+        uint8_t f = i & (FLAG_S|FLAG_X|FLAG_Y);
+        if( i == 0 )
+            f |= FLAG_Z;
+        sz53[i] = f;
+        int bits = 0;
+        for( int j=0; j<8; j++ )
+            bits += (i>>j)&1;
+        sz53p[i] = f | ((bits&1) ? 0 : FLAG_PV);
+    }
+}
+
+//
+// Memory and register access
+//
+
+static inline uint16_t rd16( uint16_t addr )
+{
+    return mem[addr] | (mem[static_cast<uint16_t>(addr+1)]<<8);
+}
+
+// All writes come through here, so that writes to translated code are noticed
+static inline void wr8( uint16_t addr, uint8_t b )
+{
+    mem[addr] = b;
+    if( code_page[addr>>8] )
+        cache_dirty = true;
+}
+
+static inline void wr16( uint16_t addr, uint16_t w )
+{
+    wr8( addr, w&0xff );
+    wr8( static_cast<uint16_t>(addr+1), w>>8 );
+}
+
+static inline uint8_t fetch8()
+{
+    return mem[pc++];
+}
+
+static inline uint16_t fetch16()
+{
+    uint16_t w = rd16(pc);
+    pc += 2;
+    return w;
+}
+
+// Opcode fetch, an M1 cycle increments the refresh register
+static inline uint8_t fetch_m1()
+{
+    reg_r = (reg_r&0x80) | ((reg_r+1)&0x7f);
+    return mem[pc++];
+}
+
+static inline uint16_t pair( int hi )
+{
+    return (reg[hi]<<8) | reg[hi+1];
+}
+
+static inline void set_pair( int hi, uint16_t w )
+{
+    reg[hi]   = w>>8;
+    reg[hi+1] = w&0xff;
+}
+
+static inline uint16_t hl_or_index( int idx )
+{
+    return idx==0 ? pair(REG_H) : (idx==1 ? ix : iy);
+}
+
+static inline void set_hl_or_index( int idx, uint16_t w )
+{
+    if( idx == 0 )
+        set_pair(REG_H,w);
+    else if( idx == 1 )
+        ix = w;
+    else
+        iy = w;
+}
+
+// Register pairs BC,DE,HL,SP (rp) and BC,DE,HL,AF (rp2) in encoding order
+static inline uint16_t get_rp( int p, int idx )
+{
+    switch( p )
+    {
+        case 0:  return pair(REG_B);
+        case 1:  return pair(REG_D);
+        case 2:  return hl_or_index(idx);
+        default: return sp;
+    }
+}
+
+static inline void set_rp( int p, int idx, uint16_t w )
+{
+    switch( p )
+    {
+        case 0:  set_pair(REG_B,w);          break;
+        case 1:  set_pair(REG_D,w);          break;
+        case 2:  set_hl_or_index(idx,w);     break;
+        default: sp = w;                     break;
+    }
+}
+
+static inline uint16_t get_rp2( int p, int idx )
+{
+    return p==3 ? ((reg[REG_A]<<8)|reg[REG_F]) : get_rp(p,idx);
+}
+
+static inline void set_rp2( int p, int idx, uint16_t w )
+{
+    if( p == 3 )
+    {
+        reg[REG_A] = w>>8;
+        reg[REG_F] = w&0xff;
+    }
+    else
+        set_rp(p,idx,w);
+}
+
+// 8 bit register operands other than (HL), H and L are IXH/IXL etc if prefixed
+static inline uint8_t get_r8( int r, int idx )
+{
+    if( idx && (r==REG_H || r==REG_L) )
+    {
+        uint16_t w = idx==1 ? ix : iy;
+        return r==REG_H ? (w>>8) : (w&0xff);
+    }
+    return reg[r];
+}
+
+static inline void set_r8( int r, int idx, uint8_t b )
+{
+    if( idx && (r==REG_H || r==REG_L) )
+    {
+        uint16_t &w = idx==1 ? ix : iy;
+        w = r==REG_H ? ((b<<8)|(w&0xff)) : ((w&0xff00)|b);
+    }
+    else
+        reg[r] = b;
+}
+
+// Address of a (HL) operand, (IX+d) or (IY+d) if prefixed
+static inline uint16_t operand_addr( int idx )
+{
+    if( idx == 0 )
+        return pair(REG_H);
+    int8_t d = static_cast<int8_t>(fetch8());
+    return static_cast<uint16_t>( (idx==1?ix:iy) + d );
+}
+
+static inline void push( uint16_t w )
+{
+    sp -= 2;
+    wr16(sp,w);
+}
+
+static inline uint16_t pop()
+{
+    uint16_t w = rd16(sp);
+    sp += 2;
+    return w;
+}
+
+static inline bool condition( int cc )
+{
+    uint8_t f = reg[REG_F];
+    switch( cc )
+    {
+        case 0:  return (f&FLAG_Z)  == 0;   // NZ
+        case 1:  return (f&FLAG_Z)  != 0;   // Z
+        case 2:  return (f&FLAG_C)  == 0;   // NC
+        case 3:  return (f&FLAG_C)  != 0;   // C
+        case 4:  return (f&FLAG_PV) == 0;   // PO
+        case 5:  return (f&FLAG_PV) != 0;   // PE
+        case 6:  return (f&FLAG_S)  == 0;   // P
+        default: return (f&FLAG_S)  != 0;   // M
+    }
+}
+
+//
+// Per routine T-state accounting
+//
+
+static void close_frame()
+{
+    FRAME &fr = frames.back();
+    uint64_t elapsed = tstates - fr.start;
+    ROUTINE_STATS &rs = routine_stats[fr.addr];
+    rs.total += elapsed;
+    rs.self  += elapsed - fr.children;
+    frames.pop_back();
+    if( frames.size() > 0 )
+        frames.back().children += elapsed;
+}
+
+// Called after a CALL has pushed its return address and tstates includes the CALL
+static inline void enter_routine( uint16_t addr )
+{
+    FRAME fr;
+    fr.addr     = addr;
+    fr.sp       = sp;
+    fr.start    = tstates;
+    fr.children = 0;
+    frames.push_back(fr);
+    routine_stats[addr].calls++;
+}
+
+// Called before a RET pops its return address and after tstates includes the RET
+static inline void leave_routine()
+{
+    while( frames.size() > 0 && frames.back().sp < sp )
+        close_frame();      // abandoned frames
+    if( frames.size() > 0 && frames.back().sp == sp )
+        close_frame();
+}
+
+static inline void call( uint16_t addr )
+{
+    push(pc);
+    pc = addr;
+    enter_routine(addr);
+}
+
+static inline void ret()
+{
+    leave_routine();
+    pc = pop();
+    if( pc == SENTINEL )
+        running = false;
+}
+
+//
+// Arithmetic and logic
+//
+
+static inline void add8( uint8_t v, int carry )
+{
+    uint8_t a = reg[REG_A];
+    unsigned int res = a + v + carry;
+    uint8_t r = res&0xff;
+    reg[REG_F] = sz53[r] | ((a^v^r)&FLAG_H) | (((a^~v)&(a^r)&0x80) ? FLAG_PV : 0) | ((res>>8)&FLAG_C);
+    reg[REG_A] = r;
+}
+
+static inline uint8_t sub8_flags( uint8_t v, int carry, uint8_t &r )
+{
+    uint8_t a = reg[REG_A];
+    unsigned int res = a - v - carry;
+    r = res&0xff;
+    return FLAG_N | (r&FLAG_S) | (r==0?FLAG_Z:0) | ((a^v^r)&FLAG_H) | (((a^v)&(a^r)&0x80) ? FLAG_PV : 0) | ((res>>8)&FLAG_C);
+}
+
+static inline void alu( int op, uint8_t v )
+{
+    uint8_t r;
+    switch( op )
+    {
+        case 0: add8( v, 0 );                                        break;  // ADD
+        case 1: add8( v, reg[REG_F]&FLAG_C );                        break;  // ADC
+        case 2: reg[REG_F] = sub8_flags(v,0,r) | (r&(FLAG_X|FLAG_Y));
+                reg[REG_A] = r;                                      break;  // SUB
+        case 3: reg[REG_F] = sub8_flags(v,reg[REG_F]&FLAG_C,r) | (r&(FLAG_X|FLAG_Y));
+                reg[REG_A] = r;                                      break;  // SBC
+        case 4: reg[REG_A] &= v;
+                reg[REG_F] = sz53p[reg[REG_A]] | FLAG_H;             break;  // AND
+        case 5: reg[REG_A] ^= v;
+                reg[REG_F] = sz53p[reg[REG_A]];                      break;  // XOR
+        case 6: reg[REG_A] |= v;
+                reg[REG_F] = sz53p[reg[REG_A]];                      break;  // OR
+        case 7: reg[REG_F] = sub8_flags(v,0,r) | (v&(FLAG_X|FLAG_Y)); break; // CP
+    }
+}
+
+static inline uint8_t inc8( uint8_t v )
+{
+    uint8_t r = v+1;
+    reg[REG_F] = (reg[REG_F]&FLAG_C) | sz53[r] | (r==0x80?FLAG_PV:0) | ((r&0x0f)==0?FLAG_H:0);
+    return r;
+}
+
+static inline uint8_t dec8( uint8_t v )
+{
+    uint8_t r = v-1;
+    reg[REG_F] = (reg[REG_F]&FLAG_C) | FLAG_N | sz53[r] | (v==0x80?FLAG_PV:0) | ((v&0x0f)==0?FLAG_H:0);
+    return r;
+}
+
+static inline uint16_t add16( uint16_t a, uint16_t b )
+{
+    unsigned int res = a + b;
+    reg[REG_F] = (reg[REG_F]&(FLAG_S|FLAG_Z|FLAG_PV)) | ((res>>16)&FLAG_C) |
+                 (((a^b^res)>>8)&FLAG_H) | ((res>>8)&(FLAG_X|FLAG_Y));
+    return res&0xffff;
+}
+
+static inline uint16_t adc16( uint16_t a, uint16_t b )
+{
+    unsigned int res = a + b + (reg[REG_F]&FLAG_C);
+    uint16_t r = res&0xffff;
+    reg[REG_F] = ((res>>16)&FLAG_C) | (((a^b^res)>>8)&FLAG_H) |
+                 (((~(a^b))&(a^r)&0x8000) ? FLAG_PV : 0) |
+                 ((r>>8)&(FLAG_S|FLAG_X|FLAG_Y)) | (r==0?FLAG_Z:0);
+    return r;
+}
+
+static inline uint16_t sbc16( uint16_t a, uint16_t b )
+{
+    unsigned int res = a - b - (reg[REG_F]&FLAG_C);
+    uint16_t r = res&0xffff;
+    reg[REG_F] = FLAG_N | ((res>>16)&FLAG_C) | (((a^b^res)>>8)&FLAG_H) |
+                 (((a^b)&(a^r)&0x8000) ? FLAG_PV : 0) |
+                 ((r>>8)&(FLAG_S|FLAG_X|FLAG_Y)) | (r==0?FLAG_Z:0);
+    return r;
+}
+
+// CB prefix rotates and shifts
+static inline uint8_t rot( int op, uint8_t v )
+{
+    uint8_t r, c;
+    switch( op )
+    {
+        case 0:  c = v>>7; r = (v<<1)|c;                       break;  // RLC
+        case 1:  c = v&1;  r = (v>>1)|(c<<7);                  break;  // RRC
+        case 2:  c = v>>7; r = (v<<1)|(reg[REG_F]&FLAG_C);     break;  // RL
+        case 3:  c = v&1;  r = (v>>1)|((reg[REG_F]&FLAG_C)<<7); break; // RR
+        case 4:  c = v>>7; r = v<<1;                           break;  // SLA
+        case 5:  c = v&1;  r = (v>>1)|(v&0x80);                break;  // SRA
+        case 6:  c = v>>7; r = (v<<1)|1;                       break;  // SLL (undocumented)
+        default: c = v&1;  r = v>>1;                           break;  // SRL
+    }
+    reg[REG_F] = sz53p[r] | c;
+    return r;
+}
+
+static inline void bit( int b, uint8_t v )
+{
+    uint8_t f = (reg[REG_F]&FLAG_C) | FLAG_H | (v&(FLAG_X|FLAG_Y));
+    if( (v & (1<<b)) == 0 )
+        f |= FLAG_Z|FLAG_PV;
+    else if( b == 7 )
+        f |= FLAG_S;
+    reg[REG_F] = f;
+}
+
+static void daa()
+{
+    uint8_t a = reg[REG_A];
+    uint8_t f = reg[REG_F];
+    uint8_t adjust = 0;
+    uint8_t carry = f&FLAG_C;
+    if( (f&FLAG_H) || (a&0x0f)>9 )
+        adjust = 0x06;
+    if( carry || a>0x99 )
+    {
+        adjust |= 0x60;
+        carry = FLAG_C;
+    }
+    uint8_t r = (f&FLAG_N) ? a-adjust : a+adjust;
+    reg[REG_F] = sz53p[r] | carry | (f&FLAG_N) | ((a^r)&FLAG_H);
+    reg[REG_A] = r;
+}
+
+//
+// Instruction execution
+//
+
+static void bad_opcode( const char *prefix, uint8_t op, uint16_t addr )
+{
+    error = util::sprintf( "Unexpected Z80 opcode %s%02X at %04X", prefix, op, addr );
+    running = false;
+}
+
+// Jove monitor calls, RST 38H followed by a function code and parameters
+static void monitor_call( uint16_t addr )
+{
+    uint8_t fn = fetch8();
+    switch( fn )
+    {
+        case 0x1f:  running = false;    break;                      // EXIT
+        case 0x81:  pc += 1;    reg[REG_A] = 0x0d;  break;          // Console input/echo
+        case 0x92:  pc += 3;    break;                              // CARRET
+        case 0xb2:
+        case 0xb3:  pc += 5;    break;                              // PRTLIN, PRTBLK, CLRSCR
+        default:
+            error = util::sprintf( "Unexpected Jove monitor call %02X at %04X", fn, addr );
+            running = false;
+            break;
+    }
+}
+
+static void exec_cb()
+{
+    uint8_t op = fetch_m1();
+    int x = op>>6, y = (op>>3)&7, z = op&7;
+    if( z == REG_F )   // (HL)
+    {
+        uint16_t addr = pair(REG_H);
+        uint8_t v = mem[addr];
+        if( x == 0 )
+            wr8( addr, rot(y,v) );
+        else if( x == 1 )
+            bit(y,v);
+        else if( x == 2 )
+            wr8( addr, v & ~(1<<y) );
+        else
+            wr8( addr, v | (1<<y) );
+        tstates += (x==1 ? 12 : 15);
+    }
+    else
+    {
+        uint8_t v = reg[z];
+        if( x == 0 )
+            reg[z] = rot(y,v);
+        else if( x == 1 )
+            bit(y,v);
+        else if( x == 2 )
+            reg[z] = v & ~(1<<y);
+        else
+            reg[z] = v | (1<<y);
+        tstates += 8;
+    }
+}
+
+// DDCB d op and FDCB d op, the prefix has been counted
+static void exec_index_cb( int idx )
+{
+    uint16_t addr = operand_addr(idx);
+    uint8_t op = fetch8();
+    int x = op>>6, y = (op>>3)&7, z = op&7;
+    uint8_t v = mem[addr];
+    uint8_t r = v;
+    if( x == 0 )
+        r = rot(y,v);
+    else if( x == 1 )
+        bit(y,v);
+    else if( x == 2 )
+        r = v & ~(1<<y);
+    else
+        r = v | (1<<y);
+    if( x != 1 )
+    {
+        wr8( addr, r );
+        if( z != REG_F )
+            reg[z] = r;     // undocumented copy to register
+    }
+    tstates += (x==1 ? 16 : 19);
+}
+
+static void block_ld( int dir )
+{
+    uint16_t hl = pair(REG_H), de = pair(REG_D), bc = pair(REG_B);
+    uint8_t v = mem[hl];
+    wr8( de, v );
+    set_pair(REG_H,hl+dir);
+    set_pair(REG_D,de+dir);
+    set_pair(REG_B,--bc);
+    uint8_t n = v + reg[REG_A];
+    reg[REG_F] = (reg[REG_F]&(FLAG_S|FLAG_Z|FLAG_C)) | (bc?FLAG_PV:0) | (n&FLAG_X) | ((n&0x02)<<4);
+}
+
+static bool block_cp( int dir )
+{
+    uint16_t hl = pair(REG_H), bc = pair(REG_B);
+    uint8_t v = mem[hl];
+    uint8_t a = reg[REG_A];
+    uint8_t r = a - v;
+    set_pair(REG_H,hl+dir);
+    set_pair(REG_B,--bc);
+    uint8_t h = (a^v^r)&FLAG_H;
+    uint8_t n = r - (h?1:0);
+    reg[REG_F] = (reg[REG_F]&FLAG_C) | FLAG_N | (r&FLAG_S) | (r==0?FLAG_Z:0) | h |
+                 (bc?FLAG_PV:0) | (n&FLAG_X) | ((n&0x02)<<4);
+    return r == 0;
+}
+
+static void exec_ed()
+{
+    uint16_t addr = pc-2;
+    uint8_t op = fetch_m1();
+    int x = op>>6, y = (op>>3)&7, z = op&7, p = y>>1, q = y&1;
+    if( x == 1 )
+    {
+        switch( z )
+        {
+            case 2:
+            {
+                uint16_t hl = pair(REG_H);
+                set_pair( REG_H, q==0 ? sbc16(hl,get_rp(p,0)) : adc16(hl,get_rp(p,0)) );
+                tstates += 15;
+                return;
+            }
+            case 3:
+            {
+                uint16_t nn = fetch16();
+                if( q == 0 )
+                    wr16( nn, get_rp(p,0) );
+                else
+                    set_rp( p, 0, rd16(nn) );
+                tstates += 20;
+                return;
+            }
+            case 4:     // NEG
+            {
+                uint8_t v = reg[REG_A];
+                reg[REG_A] = 0;
+                alu( 2, v );
+                tstates += 8;
+                return;
+            }
+            case 5:     // RETN, RETI
+            {
+                iff1 = iff2;
+                tstates += 14;
+                ret();
+                return;
+            }
+            case 6:     // IM
+            {
+                tstates += 8;
+                return;
+            }
+            case 7:
+            {
+                switch( y )
+                {
+                    case 0: reg_i = reg[REG_A];     tstates += 9;   return;
+                    case 1: reg_r = reg[REG_A];     tstates += 9;   return;
+                    case 2:
+                    case 3:
+                    {
+                        reg[REG_A] = (y==2 ? reg_i : reg_r);
+                        reg[REG_F] = (reg[REG_F]&FLAG_C) | sz53[reg[REG_A]] | (iff2?FLAG_PV:0);
+                        tstates += 9;
+                        return;
+                    }
+                    case 4:     // RRD
+                    case 5:     // RLD
+                    {
+                        uint16_t hl = pair(REG_H);
+                        uint8_t t = mem[hl];
+                        uint8_t a = reg[REG_A];
+                        if( y == 4 )
+                        {
+                            wr8( hl, (a<<4) | (t>>4) );
+                            reg[REG_A] = (a&0xf0) | (t&0x0f);
+                        }
+                        else
+                        {
+                            wr8( hl, (t<<4) | (a&0x0f) );
+                            reg[REG_A] = (a&0xf0) | (t>>4);
+                        }
+                        reg[REG_F] = (reg[REG_F]&FLAG_C) | sz53p[reg[REG_A]];
+                        tstates += 18;
+                        return;
+                    }
+                }
+                break;
+            }
+        }
+    }
+    else if( x==2 && y>=4 && z<=1 )
+    {
+        int dir = (y&1) ? -1 : 1;
+        bool repeat = y>=6;
+        if( z == 0 )
+        {
+            block_ld(dir);
+            if( repeat && pair(REG_B)!=0 )
+            {
+                pc -= 2;
+                tstates += 21;
+            }
+            else
+                tstates += 16;
+        }
+        else
+        {
+            bool found = block_cp(dir);
+            if( repeat && pair(REG_B)!=0 && !found )
+            {
+                pc -= 2;
+                tstates += 21;
+            }
+            else
+                tstates += 16;
+        }
+        return;
+    }
+    bad_opcode( "ED", op, addr );
+}
+
+static void exec_main( uint8_t op, int idx )
+{
+    uint16_t addr = pc-1;
+    int x = op>>6, y = (op>>3)&7, z = op&7, p = y>>1, q = y&1;
+    switch( x )
+    {
+        case 0:
+        {
+            switch( z )
+            {
+                case 0:
+                {
+                    if( y == 0 )            // NOP
+                        tstates += 4;
+                    else if( y == 1 )       // EX AF,AF'
+                    {
+                        std::swap( reg[REG_A], reg_alt[REG_A] );
+                        std::swap( reg[REG_F], reg_alt[REG_F] );
+                        tstates += 4;
+                    }
+                    else if( y == 2 )       // DJNZ
+                    {
+                        int8_t d = static_cast<int8_t>(fetch8());
+                        if( --reg[REG_B] != 0 )
+                        {
+                            pc += d;
+                            tstates += 13;
+                        }
+                        else
+                            tstates += 8;
+                    }
+                    else                    // JR, JR cc
+                    {
+                        int8_t d = static_cast<int8_t>(fetch8());
+                        if( y==3 || condition(y-4) )
+                        {
+                            pc += d;
+                            tstates += 12;
+                        }
+                        else
+                            tstates += 7;
+                    }
+                    return;
+                }
+                case 1:
+                {
+                    if( q == 0 )            // LD rp,nn
+                    {
+                        set_rp( p, idx, fetch16() );
+                        tstates += 10;
+                    }
+                    else                    // ADD HL,rp
+                    {
+                        set_hl_or_index( idx, add16(hl_or_index(idx),get_rp(p,idx)) );
+                        tstates += 11;
+                    }
+                    return;
+                }
+                case 2:
+                {
+                    switch( y )
+                    {
+                        case 0: wr8( pair(REG_B), reg[REG_A] );          tstates += 7;    break;
+                        case 1: reg[REG_A] = mem[pair(REG_B)];           tstates += 7;    break;
+                        case 2: wr8( pair(REG_D), reg[REG_A] );          tstates += 7;    break;
+                        case 3: reg[REG_A] = mem[pair(REG_D)];           tstates += 7;    break;
+                        case 4: wr16( fetch16(), hl_or_index(idx) );     tstates += 16;   break;
+                        case 5: set_hl_or_index( idx, rd16(fetch16()) ); tstates += 16;   break;
+                        case 6: wr8( fetch16(), reg[REG_A] );            tstates += 13;   break;
+                        case 7: reg[REG_A] = mem[fetch16()];             tstates += 13;   break;
+                    }
+                    return;
+                }
+                case 3:                     // INC rp, DEC rp
+                {
+                    set_rp( p, idx, get_rp(p,idx) + (q==0 ? 1 : -1) );
+                    tstates += 6;
+                    return;
+                }
+                case 4:                     // INC r
+                case 5:                     // DEC r
+                {
+                    if( y == REG_F )
+                    {
+                        uint16_t ea = operand_addr(idx);
+                        wr8( ea, (z==4 ? inc8(mem[ea]) : dec8(mem[ea])) );
+                        tstates += (idx ? 19 : 11);
+                    }
+                    else
+                    {
+                        set_r8( y, idx, z==4 ? inc8(get_r8(y,idx)) : dec8(get_r8(y,idx)) );
+                        tstates += 4;
+                    }
+                    return;
+                }
+                case 6:                     // LD r,n
+                {
+                    if( y == REG_F )
+                    {
+                        uint16_t ea = operand_addr(idx);
+                        wr8( ea, fetch8() );
+                        tstates += (idx ? 15 : 10);
+                    }
+                    else
+                    {
+                        set_r8( y, idx, fetch8() );
+                        tstates += 7;
+                    }
+                    return;
+                }
+                case 7:
+                {
+                    uint8_t a = reg[REG_A];
+                    uint8_t f = reg[REG_F];
+                    uint8_t keep = f&(FLAG_S|FLAG_Z|FLAG_PV);
+                    switch( y )
+                    {
+                        case 0: a = (a<<1)|(a>>7);
+                                f = keep | (a&FLAG_C);                          break;  // RLCA
+                        case 1: f = keep | (a&FLAG_C);
+                                a = (a>>1)|(a<<7);                              break;  // RRCA
+                        case 2: { uint8_t c = a>>7; a = (a<<1)|(f&FLAG_C);
+                                f = keep | c; }                                 break;  // RLA
+                        case 3: { uint8_t c = a&1; a = (a>>1)|((f&FLAG_C)<<7);
+                                f = keep | c; }                                 break;  // RRA
+                        case 4: daa(); tstates += 4;                            return;
+                        case 5: a = ~a;
+                                f = (f&(FLAG_S|FLAG_Z|FLAG_PV|FLAG_C)) | FLAG_H | FLAG_N; break; // CPL
+                        case 6: f = keep | FLAG_C;                              break;  // SCF
+                        case 7: f = keep | ((f&FLAG_C) ? FLAG_H : FLAG_C);      break;  // CCF
+                    }
+                    reg[REG_A] = a;
+                    reg[REG_F] = f | (a&(FLAG_X|FLAG_Y));
+                    tstates += 4;
+                    return;
+                }
+            }
+            break;
+        }
+        case 1:
+        {
+            if( op == 0x76 )    // HALT
+            {
+                error = util::sprintf( "Unexpected Z80 HALT at %04X", addr );
+                running = false;
+                return;
+            }
+            if( y == REG_F )        // LD (HL),r
+            {
+                uint16_t ea = operand_addr(idx);
+                wr8( ea, reg[z] );
+                tstates += (idx ? 15 : 7);
+            }
+            else if( z == REG_F )   // LD r,(HL)
+            {
+                uint16_t ea = operand_addr(idx);
+                reg[y] = mem[ea];
+                tstates += (idx ? 15 : 7);
+            }
+            else
+            {
+                set_r8( y, idx, get_r8(z,idx) );
+                tstates += 4;
+            }
+            return;
+        }
+        case 2:                     // ALU A,r
+        {
+            if( z == REG_F )
+            {
+                uint16_t ea = operand_addr(idx);
+                alu( y, mem[ea] );
+                tstates += (idx ? 15 : 7);
+            }
+            else
+            {
+                alu( y, get_r8(z,idx) );
+                tstates += 4;
+            }
+            return;
+        }
+        case 3:
+        {
+            switch( z )
+            {
+                case 0:             // RET cc
+                {
+                    if( condition(y) )
+                    {
+                        tstates += 11;
+                        ret();
+                    }
+                    else
+                        tstates += 5;
+                    return;
+                }
+                case 1:
+                {
+                    if( q == 0 )    // POP rp2
+                    {
+                        set_rp2( p, idx, pop() );
+                        tstates += 10;
+                        return;
+                    }
+                    switch( p )
+                    {
+                        case 0:     // RET
+                            tstates += 10;
+                            ret();
+                            return;
+                        case 1:     // EXX
+                            for( int i=REG_B; i<=REG_L; i++ )
+                                std::swap( reg[i], reg_alt[i] );
+                            tstates += 4;
+                            return;
+                        case 2:     // JP (HL)
+                            pc = hl_or_index(idx);
+                            tstates += 4;
+                            return;
+                        case 3:     // LD SP,HL
+                            sp = hl_or_index(idx);
+                            tstates += 6;
+                            return;
+                    }
+                    break;
+                }
+                case 2:             // JP cc,nn
+                {
+                    uint16_t nn = fetch16();
+                    if( condition(y) )
+                        pc = nn;
+                    tstates += 10;
+                    return;
+                }
+                case 3:
+                {
+                    switch( y )
+                    {
+                        case 0:     // JP nn
+                            pc = fetch16();
+                            tstates += 10;
+                            return;
+                        case 2:     // OUT (n),A
+                            fetch8();
+                            tstates += 11;
+                            return;
+                        case 3:     // IN A,(n)
+                            fetch8();
+                            reg[REG_A] = 0xff;
+                            tstates += 11;
+                            return;
+                        case 4:     // EX (SP),HL
+                        {
+                            uint16_t w = rd16(sp);
+                            wr16( sp, hl_or_index(idx) );
+                            set_hl_or_index( idx, w );
+                            tstates += 19;
+                            return;
+                        }
+                        case 5:     // EX DE,HL
+                        {
+                            uint16_t w = pair(REG_D);
+                            set_pair( REG_D, pair(REG_H) );
+                            set_pair( REG_H, w );
+                            tstates += 4;
+                            return;
+                        }
+                        case 6:     // DI
+                            iff1 = iff2 = false;
+                            tstates += 4;
+                            return;
+                        case 7:     // EI
+                            iff1 = iff2 = true;
+                            tstates += 4;
+                            return;
+                    }
+                    break;
+                }
+                case 4:             // CALL cc,nn
+                {
+                    uint16_t nn = fetch16();
+                    if( condition(y) )
+                    {
+                        tstates += 17;
+                        call(nn);
+                    }
+                    else
+                        tstates += 10;
+                    return;
+                }
+                case 5:
+                {
+                    if( q == 0 )    // PUSH rp2
+                    {
+                        push( get_rp2(p,idx) );
+                        tstates += 11;
+                        return;
+                    }
+                    if( p == 0 )    // CALL nn
+                    {
+                        uint16_t nn = fetch16();
+                        tstates += 17;
+                        call(nn);
+                        return;
+                    }
+                    break;
+                }
+                case 6:             // ALU A,n
+                {
+                    alu( y, fetch8() );
+                    tstates += 7;
+                    return;
+                }
+                case 7:             // RST
+                {
+                    tstates += 11;
+                    if( y == 7 )
+                        monitor_call(addr);
+                    else
+                        call( y*8 );
+                    return;
+                }
+            }
+            break;
+        }
+    }
+    bad_opcode( "", op, addr );
+}
+
+static void step()
+{
+    int idx = 0;
+    uint8_t op = fetch_m1();
+    while( op==0xdd || op==0xfd )
+    {
+        idx = (op==0xdd ? 1 : 2);
+        tstates += 4;
+        op = fetch_m1();
+    }
+    if( op == 0xcb )
+    {
+        if( idx )
+            exec_index_cb(idx);
+        else
+            exec_cb();
+    }
+    else if( op == 0xed )
+        exec_ed();
+    else
+        exec_main(op,idx);
+}
+
+static void do_callbacks()
+{
+    z80_registers regs;
+    for( const std::string &msg: callback_msgs[pc] )
+    {
+        regs.af = (reg[REG_F]<<8) | reg[REG_A];
+        regs.hl = pair(REG_H);
+        regs.bc = pair(REG_B);
+        regs.de = pair(REG_D);
+        regs.ix = ix;
+        regs.iy = iy;
+        callback_fn( msg.c_str(), regs );
+        reg[REG_F] = regs.af>>8;
+        reg[REG_A] = regs.af&0xff;
+        set_pair( REG_H, regs.hl );
+        set_pair( REG_B, regs.bc );
+        set_pair( REG_D, regs.de );
+        ix = regs.ix;
+        iy = regs.iy;
+    }
+}
+
+//
+// Block translation
+//
+
+/*
+
+  Interpreting decodes every instruction every time it executes. Instead,
+  by default, each basic block (a straight run of instructions ending with
+  a jump, call or return) is translated the first time it executes, into a
+  list of OPs. An OP is a pointer to a handler specialised for one form of
+  instruction, plus the instruction's decoded operands. Translations are
+  kept in a cache indexed by Z80 address, and each block remembers the
+  blocks that followed it, so most transitions don't need the cache.
+
+  We know which flags each instruction sets and reads, so a backward pass
+  over each block finds instructions whose flags are all overwritten before
+  anything reads them (an AND or DEC followed by a CP say) and selects
+  handlers that don't calculate flags. Flags are live at the end of blocks.
+
+  Blocks stop before CALLBACK points, so callbacks need only be checked
+  between blocks. The T-states and opcode fetches (which advance the
+  refresh register) of a whole block are counted in one go, handlers only
+  add the extra T-states of taken conditional branches. Less common
+  instructions aren't specialised, they end their block and are run by the
+  interpreter. Results, T-states and per routine accounting are identical
+  to the interpreter's. Sargon doesn't modify its own code, but if memory
+  containing translated code is written the cache is emptied.
+
+*/
+
+struct OP;
+typedef void (*OP_FN)( const OP &op );
+
+struct OP
+{
+    OP_FN     fn;
+    uint16_t  addr;         // of the instruction
+    uint16_t  next;         // address of the following instruction
+    uint16_t  nn;           // 16 bit operand or branch target
+    uint16_t *index;        // &ix or &iy for (IX+d) and (IY+d) operands
+    int8_t    d;            // displacement
+    uint8_t   x;            // register, register pair or bit mask
+    uint8_t   y;            // register, 8 bit operand, or 0=HL,1=IX,2=IY
+};
+
+// Information needed while translating a block only
+struct OP_INFO
+{
+    unsigned int tstates;   // not including extra T-states of taken branches
+    unsigned int m1;        // opcode fetches
+    uint8_t flags_read;
+    uint8_t flags_written;
+    OP_FN   no_flags_fn;    // alternative handler if all flags written are dead
+    bool    ends_block;
+};
+
+struct BLOCK
+{
+    uint16_t start;
+    uint16_t end;           // address following the block
+    unsigned int tstates;
+    unsigned int m1;
+    std::vector<OP> ops;
+    BLOCK *successor[2];
+};
+
+#define MAX_BLOCK_OPS 64
+
+static std::vector<BLOCK *> block_cache;    // by address
+
+struct TRANSLATION_STATS
+{
+    uint64_t blocks;
+    uint64_t ops;
+    uint64_t no_flags;
+    uint64_t fallbacks;
+    uint64_t executed;
+    uint64_t chained;
+    uint64_t flushes;
+};
+static TRANSLATION_STATS translation_stats;
+
+static void flush_cache()
+{
+    for( BLOCK *b: block_cache )
+        delete b;
+    block_cache.assign( 65536, NULL );
+    memset( code_page, 0, sizeof(code_page) );
+    cache_dirty = false;
+}
+
+static inline uint16_t index_addr( const OP &op )
+{
+    return static_cast<uint16_t>( *op.index + op.d );
+}
+
+template<int ALU,bool FLAGS> static inline void alu_op( uint8_t v )
+{
+    if( FLAGS )
+    {
+        alu( ALU, v );
+        return;
+    }
+    switch( ALU )
+    {
+        case 0: reg[REG_A] += v;                        break;
+        case 1: reg[REG_A] += v + (reg[REG_F]&FLAG_C);  break;
+        case 2: reg[REG_A] -= v;                        break;
+        case 3: reg[REG_A] -= v + (reg[REG_F]&FLAG_C);  break;
+        case 4: reg[REG_A] &= v;                        break;
+        case 5: reg[REG_A] ^= v;                        break;
+        case 6: reg[REG_A] |= v;                        break;
+        case 7:                                         break;  // CP only sets flags
+    }
+}
+
+template<bool INC,bool FLAGS> static inline uint8_t inc_op( uint8_t v )
+{
+    if( FLAGS )
+        return INC ? inc8(v) : dec8(v);
+    return INC ? v+1 : v-1;
+}
+
+// Loads
+static void op_ld_r_r ( const OP &op ) { reg[op.x] = reg[op.y]; }
+static void op_ld_r_n ( const OP &op ) { reg[op.x] = op.y; }
+static void op_ld_r_hl( const OP &op ) { reg[op.x] = mem[pair(REG_H)]; }
+static void op_ld_r_ix( const OP &op ) { reg[op.x] = mem[index_addr(op)]; }
+static void op_ld_hl_r( const OP &op ) { wr8( pair(REG_H), reg[op.x] ); }
+static void op_ld_ix_r( const OP &op ) { wr8( index_addr(op), reg[op.x] ); }
+static void op_ld_hl_n( const OP &op ) { wr8( pair(REG_H), op.y ); }
+static void op_ld_ix_n( const OP &op ) { wr8( index_addr(op), op.y ); }
+static void op_ld_a_bc( const OP &  )  { reg[REG_A] = mem[pair(REG_B)]; }
+static void op_ld_a_de( const OP &  )  { reg[REG_A] = mem[pair(REG_D)]; }
+static void op_ld_bc_a( const OP &  )  { wr8( pair(REG_B), reg[REG_A] ); }
+static void op_ld_de_a( const OP &  )  { wr8( pair(REG_D), reg[REG_A] ); }
+static void op_ld_a_nn( const OP &op ) { reg[REG_A] = mem[op.nn]; }
+static void op_ld_nn_a( const OP &op ) { wr8( op.nn, reg[REG_A] ); }
+static void op_ld_rp_nn ( const OP &op ) { set_rp( op.x, op.y, op.nn ); }
+static void op_ld_rp_nni( const OP &op ) { set_rp( op.x, op.y, rd16(op.nn) ); }
+static void op_ld_nni_rp( const OP &op ) { wr16( op.nn, get_rp(op.x,op.y) ); }
+static void op_ld_sp_hl ( const OP &op ) { sp = hl_or_index(op.y); }
+
+// Arithmetic and logic
+template<int ALU,bool FLAGS> static void op_alu_r ( const OP &op ) { alu_op<ALU,FLAGS>( reg[op.x] ); }
+template<int ALU,bool FLAGS> static void op_alu_n ( const OP &op ) { alu_op<ALU,FLAGS>( op.y ); }
+template<int ALU,bool FLAGS> static void op_alu_hl( const OP &    ) { alu_op<ALU,FLAGS>( mem[pair(REG_H)] ); }
+template<int ALU,bool FLAGS> static void op_alu_ix( const OP &op ) { alu_op<ALU,FLAGS>( mem[index_addr(op)] ); }
+template<bool INC,bool FLAGS> static void op_inc_r ( const OP &op ) { reg[op.x] = inc_op<INC,FLAGS>( reg[op.x] ); }
+template<bool INC,bool FLAGS> static void op_inc_hl( const OP &   )
+{
+    uint16_t ea = pair(REG_H);
+    wr8( ea, inc_op<INC,FLAGS>(mem[ea]) );
+}
+template<bool INC,bool FLAGS> static void op_inc_ix( const OP &op )
+{
+    uint16_t ea = index_addr(op);
+    wr8( ea, inc_op<INC,FLAGS>(mem[ea]) );
+}
+template<bool INC> static void op_inc_rp( const OP &op ) { set_rp( op.x, op.y, get_rp(op.x,op.y) + (INC?1:-1) ); }
+template<bool FLAGS> static void op_add_hl_rp( const OP &op )
+{
+    uint16_t hl = hl_or_index(op.y);
+    uint16_t rp = get_rp(op.x,op.y);
+    set_hl_or_index( op.y, FLAGS ? add16(hl,rp) : static_cast<uint16_t>(hl+rp) );
+}
+
+// Bit operations, x is the bit mask
+static void op_bit_r ( const OP &op ) { bit( op.y, reg[op.x] ); }
+static void op_bit_hl( const OP &op ) { bit( op.y, mem[pair(REG_H)] ); }
+static void op_bit_ix( const OP &op ) { bit( op.y, mem[index_addr(op)] ); }
+static void op_set_r ( const OP &op ) { reg[op.y] |= op.x; }
+static void op_res_r ( const OP &op ) { reg[op.y] &= ~op.x; }
+static void op_set_hl( const OP &op ) { uint16_t ea=pair(REG_H); wr8( ea, mem[ea] | op.x ); }
+static void op_res_hl( const OP &op ) { uint16_t ea=pair(REG_H); wr8( ea, mem[ea] & ~op.x ); }
+static void op_set_ix( const OP &op ) { uint16_t ea=index_addr(op); wr8( ea, mem[ea] | op.x ); }
+static void op_res_ix( const OP &op ) { uint16_t ea=index_addr(op); wr8( ea, mem[ea] & ~op.x ); }
+
+// Exchanges and stack
+static void op_nop( const OP & ) {}
+static void op_ex_de_hl( const OP & )
+{
+    uint16_t w = pair(REG_D);
+    set_pair( REG_D, pair(REG_H) );
+    set_pair( REG_H, w );
+}
+static void op_exx( const OP & )
+{
+    for( int i=REG_B; i<=REG_L; i++ )
+        std::swap( reg[i], reg_alt[i] );
+}
+static void op_ex_af( const OP & )
+{
+    std::swap( reg[REG_A], reg_alt[REG_A] );
+    std::swap( reg[REG_F], reg_alt[REG_F] );
+}
+static void op_push( const OP &op ) { push( get_rp2(op.x,op.y) ); }
+static void op_pop ( const OP &op ) { set_rp2( op.x, op.y, pop() ); }
+
+// Control flow, pc has been set to the end of the block
+static void op_jp( const OP &op ) { pc = op.nn; }
+template<int CC> static void op_jp_cc( const OP &op )
+{
+    if( condition(CC) )
+        pc = op.nn;
+}
+template<int CC> static void op_jr_cc( const OP &op )
+{
+    if( condition(CC) )
+    {
+        pc = op.nn;
+        tstates += 5;
+    }
+}
+static void op_djnz( const OP &op )
+{
+    if( --reg[REG_B] != 0 )
+    {
+        pc = op.nn;
+        tstates += 5;
+    }
+}
+static void op_jp_hl( const OP &op ) { pc = hl_or_index(op.y); }
+static void op_call( const OP &op ) { call(op.nn); }
+template<int CC> static void op_call_cc( const OP &op )
+{
+    if( condition(CC) )
+    {
+        tstates += 7;
+        call(op.nn);
+    }
+}
+static void op_ret( const OP & ) { ret(); }
+template<int CC> static void op_ret_cc( const OP & )
+{
+    if( condition(CC) )
+    {
+        tstates += 6;
+        ret();
+    }
+}
+
+// Anything else is interpreted
+static void op_fallback( const OP &op )
+{
+    pc = op.addr;
+    step();
+}
+
+#define ALU_TABLE(fn,flags) { fn<0,flags>, fn<1,flags>, fn<2,flags>, fn<3,flags>, fn<4,flags>, fn<5,flags>, fn<6,flags>, fn<7,flags> }
+#define CC_TABLE(fn) { fn<0>, fn<1>, fn<2>, fn<3>, fn<4>, fn<5>, fn<6>, fn<7> }
+static const OP_FN alu_r_fns[2][8]  = { ALU_TABLE(op_alu_r,false),  ALU_TABLE(op_alu_r,true)  };
+static const OP_FN alu_n_fns[2][8]  = { ALU_TABLE(op_alu_n,false),  ALU_TABLE(op_alu_n,true)  };
+static const OP_FN alu_hl_fns[2][8] = { ALU_TABLE(op_alu_hl,false), ALU_TABLE(op_alu_hl,true) };
+static const OP_FN alu_ix_fns[2][8] = { ALU_TABLE(op_alu_ix,false), ALU_TABLE(op_alu_ix,true) };
+static const OP_FN jp_cc_fns[8]   = CC_TABLE(op_jp_cc);
+static const OP_FN jr_cc_fns[8]   = CC_TABLE(op_jr_cc);
+static const OP_FN call_cc_fns[8] = CC_TABLE(op_call_cc);
+static const OP_FN ret_cc_fns[8]  = CC_TABLE(op_ret_cc);
+
+// Flag tested by each condition code
+static const uint8_t condition_flag[8] = { FLAG_Z, FLAG_Z, FLAG_C, FLAG_C, FLAG_PV, FLAG_PV, FLAG_S, FLAG_S };
+
+// Decode the instruction at addr into an OP, see the interpreter for the
+//  instruction encoding and T-states
+static void translate_op( uint16_t addr, OP &op, OP_INFO &info )
+{
+    op.fn    = op_fallback;
+    op.addr  = addr;
+    op.nn    = 0;
+    op.index = &ix;
+    op.d     = 0;
+    op.x     = 0;
+    op.y     = 0;
+    info.tstates       = 0;
+    info.m1            = 0;
+    info.flags_read    = 0;
+    info.flags_written = 0;
+    info.no_flags_fn   = NULL;
+    info.ends_block    = false;
+    uint16_t p = addr;
+    int idx = 0;
+    unsigned int prefixes = 0;
+    uint8_t opc = mem[p++];
+    while( opc==0xdd || opc==0xfd )
+    {
+        idx = (opc==0xdd ? 1 : 2);
+        prefixes++;
+        opc = mem[p++];
+    }
+    unsigned int m1 = prefixes + ((opc==0xcb && !idx) || opc==0xed ? 2 : 1);
+    op.index = (idx==2 ? &iy : &ix);
+    unsigned int t = 0;
+    int x = opc>>6, y = (opc>>3)&7, z = opc&7, q = y&1, pp = y>>1;
+    bool hl_reg = idx && (y==REG_H || y==REG_L || z==REG_H || z==REG_L);   // IXH etc
+    if( opc == 0xcb )
+    {
+        if( idx )
+            op.d = static_cast<int8_t>(mem[p++]);
+        uint8_t cb = mem[p++];
+        int cx = cb>>6, cy = (cb>>3)&7, cz = cb&7;
+        op.x = 1<<cy;
+        if( cx == 1 )
+        {
+            op.y = cy;
+            info.flags_written = 0xff & ~FLAG_C;
+            if( idx )
+            {
+                op.fn = op_bit_ix;
+                t = 16;
+            }
+            else if( cz == REG_F )
+            {
+                op.fn = op_bit_hl;
+                t = 12;
+            }
+            else
+            {
+                op.fn = op_bit_r;
+                op.x = cz;
+                t = 8;
+            }
+            info.no_flags_fn = op_nop;
+        }
+        else if( cx >= 2 )
+        {
+            bool set = (cx == 3);
+            if( idx && cz==REG_F )
+            {
+                op.fn = set ? op_set_ix : op_res_ix;
+                t = 19;
+            }
+            else if( !idx && cz==REG_F )
+            {
+                op.fn = set ? op_set_hl : op_res_hl;
+                t = 15;
+            }
+            else if( !idx )
+            {
+                op.fn = set ? op_set_r : op_res_r;
+                op.y = cz;
+                t = 8;
+            }
+        }
+    }
+    else if( opc == 0xed )
+    {
+        uint8_t e = mem[p++];
+        if( !idx && (e>>6)==1 && (e&7)==3 )     // LD (nn),rp and LD rp,(nn)
+        {
+            op.nn = mem[p] | (mem[p+1]<<8);
+            p += 2;
+            op.x = (e>>4)&3;
+            op.fn = (e&8) ? op_ld_rp_nni : op_ld_nni_rp;
+            t = 20;
+        }
+    }
+    else if( x == 0 )
+    {
+        switch( z )
+        {
+            case 0:
+            {
+                if( y == 0 )
+                {
+                    op.fn = op_nop;
+                    t = 4;
+                }
+                else if( y == 1 )
+                {
+                    op.fn = op_ex_af;
+                    info.flags_read = 0xff;
+                    t = 4;
+                }
+                else
+                {
+                    int8_t d = static_cast<int8_t>(mem[p++]);
+                    op.nn = static_cast<uint16_t>(p+d);
+                    info.ends_block = true;
+                    if( y == 2 )
+                    {
+                        op.fn = op_djnz;
+                        t = 8;
+                    }
+                    else if( y == 3 )
+                    {
+                        op.fn = op_jp;
+                        t = 12;
+                    }
+                    else
+                    {
+                        op.fn = jr_cc_fns[y-4];
+                        info.flags_read = condition_flag[y-4];
+                        t = 7;
+                    }
+                }
+                break;
+            }
+            case 1:
+            {
+                op.x = pp;
+                op.y = idx;
+                if( q == 0 )
+                {
+                    op.nn = mem[p] | (mem[p+1]<<8);
+                    p += 2;
+                    op.fn = op_ld_rp_nn;
+                    t = 10;
+                }
+                else
+                {
+                    op.fn = op_add_hl_rp<true>;
+                    info.no_flags_fn = op_add_hl_rp<false>;
+                    info.flags_written = FLAG_C|FLAG_N|FLAG_X|FLAG_H|FLAG_Y;
+                    t = 11;
+                }
+                break;
+            }
+            case 2:
+            {
+                static const OP_FN fns[4] = { op_ld_bc_a, op_ld_a_bc, op_ld_de_a, op_ld_a_de };
+                if( y < 4 )
+                {
+                    op.fn = fns[y];
+                    t = 7;
+                }
+                else
+                {
+                    op.nn = mem[p] | (mem[p+1]<<8);
+                    p += 2;
+                    op.x = 2;
+                    op.y = idx;
+                    switch( y )
+                    {
+                        case 4: op.fn = op_ld_nni_rp;   t = 16;     break;
+                        case 5: op.fn = op_ld_rp_nni;   t = 16;     break;
+                        case 6: op.fn = op_ld_nn_a;     t = 13;     break;
+                        case 7: op.fn = op_ld_a_nn;     t = 13;     break;
+                    }
+                }
+                break;
+            }
+            case 3:
+            {
+                op.x = pp;
+                op.y = idx;
+                op.fn = (q==0 ? op_inc_rp<true> : op_inc_rp<false>);
+                t = 6;
+                break;
+            }
+            case 4:
+            case 5:
+            {
+                bool inc = (z==4);
+                info.flags_written = 0xff & ~FLAG_C;
+                if( y == REG_F && idx )
+                {
+                    op.d = static_cast<int8_t>(mem[p++]);
+                    op.fn             = inc ? op_inc_ix<true,true>  : op_inc_ix<false,true>;
+                    info.no_flags_fn  = inc ? op_inc_ix<true,false> : op_inc_ix<false,false>;
+                    t = 19;
+                }
+                else if( y == REG_F )
+                {
+                    op.fn             = inc ? op_inc_hl<true,true>  : op_inc_hl<false,true>;
+                    info.no_flags_fn  = inc ? op_inc_hl<true,false> : op_inc_hl<false,false>;
+                    t = 11;
+                }
+                else if( !hl_reg )
+                {
+                    op.x = y;
+                    op.fn             = inc ? op_inc_r<true,true>  : op_inc_r<false,true>;
+                    info.no_flags_fn  = inc ? op_inc_r<true,false> : op_inc_r<false,false>;
+                    t = 4;
+                }
+                else
+                    info.flags_written = 0;
+                break;
+            }
+            case 6:
+            {
+                if( y == REG_F && idx )
+                {
+                    op.d = static_cast<int8_t>(mem[p++]);
+                    op.y = mem[p++];
+                    op.fn = op_ld_ix_n;
+                    t = 15;
+                }
+                else if( y == REG_F )
+                {
+                    op.y = mem[p++];
+                    op.fn = op_ld_hl_n;
+                    t = 10;
+                }
+                else if( !hl_reg )
+                {
+                    op.x = y;
+                    op.y = mem[p++];
+                    op.fn = op_ld_r_n;
+                    t = 7;
+                }
+                break;
+            }
+        }
+    }
+    else if( x == 1 )
+    {
+        if( opc == 0x76 )
+            ;   // HALT
+        else if( y == REG_F )
+        {
+            op.x = z;
+            if( idx )
+            {
+                op.d = static_cast<int8_t>(mem[p++]);
+                op.fn = op_ld_ix_r;
+                t = 15;
+            }
+            else
+            {
+                op.fn = op_ld_hl_r;
+                t = 7;
+            }
+        }
+        else if( z == REG_F )
+        {
+            op.x = y;
+            if( idx )
+            {
+                op.d = static_cast<int8_t>(mem[p++]);
+                op.fn = op_ld_r_ix;
+                t = 15;
+            }
+            else
+            {
+                op.fn = op_ld_r_hl;
+                t = 7;
+            }
+        }
+        else if( !hl_reg )
+        {
+            op.x = y;
+            op.y = z;
+            op.fn = op_ld_r_r;
+            t = 4;
+        }
+    }
+    else if( x == 2 )
+    {
+        info.flags_read    = (y==1 || y==3) ? FLAG_C : 0;
+        info.flags_written = 0xff;
+        if( z == REG_F && idx )
+        {
+            op.d = static_cast<int8_t>(mem[p++]);
+            op.fn            = alu_ix_fns[1][y];
+            info.no_flags_fn = alu_ix_fns[0][y];
+            t = 15;
+        }
+        else if( z == REG_F )
+        {
+            op.fn            = alu_hl_fns[1][y];
+            info.no_flags_fn = alu_hl_fns[0][y];
+            t = 7;
+        }
+        else if( !(idx && (z==REG_H || z==REG_L)) )
+        {
+            op.x = z;
+            op.fn            = alu_r_fns[1][y];
+            info.no_flags_fn = alu_r_fns[0][y];
+            t = 4;
+        }
+        else
+        {
+            info.flags_read    = 0;
+            info.flags_written = 0;
+        }
+    }
+    else
+    {
+        switch( z )
+        {
+            case 0:
+            {
+                op.fn = ret_cc_fns[y];
+                info.flags_read = condition_flag[y];
+                info.ends_block = true;
+                t = 5;
+                break;
+            }
+            case 1:
+            {
+                op.x = pp;
+                op.y = idx;
+                if( q == 0 )
+                {
+                    op.fn = op_pop;
+                    if( pp == 3 )
+                        info.flags_written = 0xff;
+                    t = 10;
+                }
+                else if( pp == 0 )
+                {
+                    op.fn = op_ret;
+                    info.ends_block = true;
+                    t = 10;
+                }
+                else if( pp == 1 )
+                {
+                    op.fn = op_exx;
+                    t = 4;
+                }
+                else if( pp == 2 )
+                {
+                    op.fn = op_jp_hl;
+                    info.ends_block = true;
+                    t = 4;
+                }
+                else
+                {
+                    op.fn = op_ld_sp_hl;
+                    t = 6;
+                }
+                break;
+            }
+            case 2:
+            {
+                op.nn = mem[p] | (mem[p+1]<<8);
+                p += 2;
+                op.fn = jp_cc_fns[y];
+                info.flags_read = condition_flag[y];
+                info.ends_block = true;
+                t = 10;
+                break;
+            }
+            case 3:
+            {
+                if( y == 0 )
+                {
+                    op.nn = mem[p] | (mem[p+1]<<8);
+                    p += 2;
+                    op.fn = op_jp;
+                    info.ends_block = true;
+                    t = 10;
+                }
+                else if( y == 5 )
+                {
+                    op.fn = op_ex_de_hl;
+                    t = 4;
+                }
+                break;
+            }
+            case 4:
+            {
+                op.nn = mem[p] | (mem[p+1]<<8);
+                p += 2;
+                op.fn = call_cc_fns[y];
+                info.flags_read = condition_flag[y];
+                info.ends_block = true;
+                t = 10;
+                break;
+            }
+            case 5:
+            {
+                op.x = pp;
+                op.y = idx;
+                if( q == 0 )
+                {
+                    op.fn = op_push;
+                    if( pp == 3 )
+                        info.flags_read = 0xff;
+                    t = 11;
+                }
+                else if( pp == 0 )
+                {
+                    op.nn = mem[p] | (mem[p+1]<<8);
+                    p += 2;
+                    op.fn = op_call;
+                    info.ends_block = true;
+                    t = 17;
+                }
+                break;
+            }
+            case 6:
+            {
+                op.y = mem[p++];
+                info.flags_read    = (y==1 || y==3) ? FLAG_C : 0;
+                info.flags_written = 0xff;
+                op.fn            = alu_n_fns[1][y];
+                info.no_flags_fn = alu_n_fns[0][y];
+                t = 7;
+                break;
+            }
+        }
+    }
+    op.next = p;
+    if( op.fn == op_fallback )
+    {
+        // The interpreter counts T-states and opcode fetches and sets pc
+        info.flags_read    = 0xff;
+        info.flags_written = 0;
+        info.no_flags_fn   = NULL;
+        info.ends_block    = true;
+        translation_stats.fallbacks++;
+    }
+    else
+    {
+        info.tstates = t + 4*prefixes;
+        info.m1 = m1;
+    }
+}
+
+static BLOCK *translate_block( uint16_t start )
+{
+    BLOCK *b = new BLOCK;
+    b->start   = start;
+    b->tstates = 0;
+    b->m1      = 0;
+    b->successor[0] = b->successor[1] = NULL;
+    std::vector<OP_INFO> infos;
+    uint16_t addr = start;
+    for(;;)
+    {
+        OP op;
+        OP_INFO info;
+        translate_op( addr, op, info );
+        b->ops.push_back(op);
+        infos.push_back(info);
+        b->tstates += info.tstates;
+        b->m1      += info.m1;
+        addr = op.next;
+        if( info.ends_block || b->ops.size()>=MAX_BLOCK_OPS || callback_at[addr] )
+            break;
+    }
+    b->end = addr;
+
+    // Flag liveness, working backwards from the end of the block where all
+    //  flags are assumed live
+    uint8_t live = 0xff;
+    for( int i=static_cast<int>(b->ops.size())-1; i>=0; i-- )
+    {
+        const OP_INFO &info = infos[i];
+        if( info.no_flags_fn && (info.flags_written&live)==0 )
+        {
+            b->ops[i].fn = info.no_flags_fn;
+            translation_stats.no_flags++;
+        }
+        live = (live & ~info.flags_written) | info.flags_read;
+    }
+
+    // Mark the pages holding the code, allowing for a final instruction of up
+    //  to 4 bytes that's interpreted by a fallback
+    for( unsigned int page=start>>8; page<=((b->end+3u)>>8) && page<256; page++ )
+        code_page[page] = 1;
+    translation_stats.blocks++;
+    translation_stats.ops += b->ops.size();
+    block_cache[start] = b;
+    return b;
+}
+
+static void run_translated()
+{
+    BLOCK *b = NULL;
+    while( running )
+    {
+        if( callback_at[pc] && callback_fn )
+            do_callbacks();
+        BLOCK *next = NULL;
+        if( b )
+        {
+            if( b->successor[0] && b->successor[0]->start==pc )
+                next = b->successor[0];
+            else if( b->successor[1] && b->successor[1]->start==pc )
+                next = b->successor[1];
+        }
+        if( next )
+            translation_stats.chained++;
+        else
+        {
+            next = block_cache[pc];
+            if( !next )
+                next = translate_block(pc);
+            if( b )
+                b->successor[ b->successor[0] ? 1 : 0 ] = next;
+        }
+        b = next;
+        translation_stats.executed++;
+        tstates += b->tstates;
+        reg_r = (reg_r&0x80) | ((reg_r+b->m1)&0x7f);
+        pc = b->end;
+        for( const OP &op: b->ops )
+            op.fn(op);
+        if( cache_dirty )
+        {
+            flush_cache();
+            translation_stats.flushes++;
+            b = NULL;
+        }
+    }
+}
+
+void sargon_z80_set_translate( bool on )
+{
+    translate = on;
+}
+
+std::string sargon_z80_report_translation()
+{
+    const TRANSLATION_STATS &ts = translation_stats;
+    return util::sprintf( "Z80 translation: %llu blocks, %.1f instructions per block, %llu instructions"
+                          " don't calculate dead flags, %llu interpreted, %llu blocks executed, %.1f%%"
+                          " chained, cache emptied %llu times\n",
+        static_cast<unsigned long long>(ts.blocks),
+        ts.blocks ? static_cast<double>(ts.ops)/ts.blocks : 0.0,
+        static_cast<unsigned long long>(ts.no_flags),
+        static_cast<unsigned long long>(ts.fallbacks),
+        static_cast<unsigned long long>(ts.executed),
+        ts.executed ? 100.0*ts.chained/ts.executed : 0.0,
+        static_cast<unsigned long long>(ts.flushes) );
+}
+
+//
+// Loading the listing
+//
+
+// Statement fields, enough to reproduce the -z80_only rules
+static void parse_source_line( const std::string &line, std::string &label, std::string &instruction, bool &comment )
+{
+    label.clear();
+    instruction.clear();
+    comment = false;
+    std::string code;
+    bool quoted = false;
+    for( char c: line )
+    {
+        if( c == '"' || c == '\'' )
+            quoted = !quoted;
+        else if( c==';' && !quoted )
+        {
+            comment = true;
+            break;
+        }
+        code += c;
+    }
+    size_t offset = 0;
+    if( code.length()>0 && !isspace(static_cast<unsigned char>(code[0])) )
+    {
+        offset = code.find_first_of( " \t:" );
+        label = code.substr( 0, offset );
+        if( offset != std::string::npos && code[offset] == ':' )
+            offset++;
+    }
+    if( offset == std::string::npos )
+        return;
+    size_t start = code.find_first_not_of( " \t", offset );
+    if( start == std::string::npos )
+        return;
+    size_t end = code.find_first_of( " \t", start );
+    instruction = code.substr( start, end==std::string::npos ? std::string::npos : end-start );
+}
+
+static std::string normalise( const std::string &s )
+{
+    std::vector<std::string> fields;
+    util::split( s, fields );
+    std::string ret;
+    for( const std::string &f: fields )
+    {
+        if( ret != "" )
+            ret += " ";
+        ret += f;
+    }
+    return ret;
+}
+
+struct LISTING_LINE
+{
+    bool     code;      // has an address and bytes
+    unsigned int addr;
+    std::string source;
+};
+
+bool sargon_z80_load( const std::string &listing_file, const std::string &source_file, std::string &error_msg )
+{
+    loaded = false;
+    init_tables();
+    memset( mem, 0, sizeof(mem) );
+    symbols.clear();
+    routine_names.clear();
+    callback_msgs.assign( 65536, std::vector<std::string>() );
+    callback_at.assign( 65536, false );
+    routine_stats.assign( 65536, ROUTINE_STATS() );
+
+    // Listing lines are "  29:\t0B00  0678    \tsource" with extra bytes on
+    //  continuation lines "\t      18F5". The symbol table follows
+    std::ifstream in( listing_file, std::ios::binary );
+    if( !in )
+    {
+        error_msg = "Cannot open " + listing_file;
+        return false;
+    }
+    std::map<int,LISTING_LINE> listing;
+    bool symbol_table = false;
+    unsigned int next_addr = 0;
+    std::string line;
+    while( std::getline(in,line) )
+    {
+        if( line.length()>0 && line[line.length()-1]=='\r' )
+            line.erase( line.length()-1 );
+        if( line == "Symbol Table:" )
+        {
+            symbol_table = true;
+            continue;
+        }
+        if( symbol_table )
+        {
+            std::vector<std::string> fields;
+            util::split( line, fields );
+            if( fields.size() >= 2 )
+            {
+                std::string name  = util::toupper(fields[0]);
+                std::string value = fields[fields.size()-1];
+                if( name.find_first_of("0123456789") != 0 && value.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos )
+                    symbols[name] = strtoul( value.c_str(), NULL, 16 ) & 0xffff;
+            }
+            continue;
+        }
+        std::string bytes;
+        size_t colon = line.find(":\t");
+        bool numbered = colon!=std::string::npos && colon>0 &&
+                        line.substr(0,colon).find_first_not_of(" 0123456789") == std::string::npos;
+        if( numbered )
+        {
+            int line_nbr = atoi( line.c_str() );
+            std::string rest = line.substr(colon+2);
+            LISTING_LINE ll;
+            ll.code = false;
+            ll.addr = 0;
+            size_t tab = rest.find('\t');
+            std::string head = rest.substr( 0, tab );
+            if( head == "" )
+                ll.source = rest.length()>=2 ? rest.substr(2) : "";
+            else
+            {
+                ll.source = tab==std::string::npos ? "" : rest.substr(tab+1);
+                ll.addr = strtoul( head.substr(0,4).c_str(), NULL, 16 );
+                if( head.length() > 6 )
+                    bytes = head.substr(6);
+                next_addr = ll.addr;
+            }
+            util::trim(bytes);
+            ll.code = (bytes != "");
+            listing[line_nbr] = ll;
+        }
+        else if( line.length()>0 && line[0]=='\t' )
+            bytes = line.substr(1);
+        util::trim(bytes);
+        for( size_t i=0; i+1<bytes.length(); i+=2 )
+            mem[ (next_addr++)&0xffff ] = static_cast<uint8_t>( strtoul(bytes.substr(i,2).c_str(),NULL,16) );
+    }
+    if( symbols.size() == 0 )
+    {
+        error_msg = "No symbol table in " + listing_file;
+        return false;
+    }
+    for( auto &sym: symbols )
+        routine_names[sym.second] = sym.first;
+
+    // Reproduce the convert-z80-to-x86 -z80_only rules to find the Z80
+    //  source line following each CALLBACK, and check the listing was
+    //  assembled from the same source
+    std::ifstream src( source_file );
+    if( !src )
+    {
+        error_msg = "Cannot open " + source_file;
+        return false;
+    }
+    enum { mode_normal, mode_x86, mode_z80, mode_not_z80 } mode = mode_normal;
+    int z80_line_nbr = 0;
+    std::vector<std::string> pending;
+    std::vector<std::string> stubs;
+    int mismatches = 0;
+    while( std::getline(src,line) )
+    {
+        util::rtrim(line);
+        std::string label, instruction;
+        bool comment;
+        parse_source_line( line, label, instruction, comment );
+        if( label == "" )
+        {
+            if( instruction==".DATA" || instruction==".CODE" )
+                continue;
+            else if( instruction == ".IF_Z80" )
+            {
+                mode = mode_z80;
+                continue;
+            }
+            else if( instruction == ".IF_X86" )
+            {
+                mode = mode_x86;
+                continue;
+            }
+            else if( instruction == ".ELSE" )
+            {
+                mode = (mode==mode_z80 ? mode_not_z80 : mode_z80);
+                continue;
+            }
+            else if( instruction == ".ENDIF" )
+            {
+                mode = mode_normal;
+                continue;
+            }
+        }
+        if( mode == mode_x86 && label != "" && instruction == "RET" )
+            stubs.push_back(label);
+        if( mode!=mode_z80 && mode!=mode_normal )
+            continue;
+        bool callback = (instruction == "CALLBACK");
+        if( callback )
+        {
+            size_t start = line.find('"');
+            size_t end   = line.find('"',start+1);
+            if( start!=std::string::npos && end!=std::string::npos )
+                pending.push_back( line.substr(start+1,end-start-1) );
+            if( label=="" && !comment )
+                continue;   // not in the Z80 source at all
+        }
+        z80_line_nbr++;
+        auto it = listing.find(z80_line_nbr);
+        if( it == listing.end() )
+        {
+            mismatches++;
+            continue;
+        }
+        if( !callback && normalise(it->second.source) != normalise(line) )
+            mismatches++;
+        if( it->second.code && pending.size() > 0 )
+        {
+            unsigned int addr = it->second.addr;
+            for( const std::string &msg: pending )
+                callback_msgs[addr].push_back(msg);
+            callback_at[addr] = true;
+            pending.clear();
+        }
+    }
+    if( mismatches > 0 )
+    {
+        error_msg = util::sprintf( "%s doesn't match %s (%d lines differ), reassemble the Z80 code", listing_file.c_str(), source_file.c_str(), mismatches );
+        return false;
+    }
+
+    // The x86 build replaces the user interface routines that aren't needed
+    //  when Sargon is driven from C++ (board graphics and mate dialogue) with
+    //  stubs, so do the same here
+    for( const std::string &stub: stubs )
+    {
+        unsigned int addr = sargon_z80_symbol(stub);
+        if( addr != 0 )
+            mem[addr] = 0xc9;   // RET
+    }
+    flush_cache();
+    loaded = true;
+    return true;
+}
+
+bool sargon_z80_loaded()
+{
+    return loaded;
+}
+
+//
+// Running Sargon
+//
+
+void sargon_z80_set_callback( SARGON_Z80_CALLBACK callback )
+{
+    callback_fn = callback;
+}
+
+std::string sargon_z80_error()
+{
+    return error;
+}
+
+bool sargon_z80( int api_command_code, z80_registers *registers )
+{
+    static const char *routines[] = { "", "INITBD", "ROYALT", "CPTRMV", "VALMOV", "ASNTBI", "EXECMV", "XCHNG",
+                                      "GENMOV", "POINTS", "ATTACK", "PINFND" };
+    error = "";
+    if( !loaded )
+    {
+        error = "Z80 code not loaded";
+        return false;
+    }
+    if( api_command_code<1 || api_command_code>=static_cast<int>(sizeof(routines)/sizeof(routines[0])) )
+    {
+        error = util::sprintf( "Unknown api command code %d", api_command_code );
+        return false;
+    }
+    if( registers )
+    {
+        reg[REG_F] = registers->af>>8;
+        reg[REG_A] = registers->af&0xff;
+        set_pair( REG_H, registers->hl );
+        set_pair( REG_B, registers->bc );
+        set_pair( REG_D, registers->de );
+        ix = registers->ix;
+        iy = registers->iy;
+    }
+    sp = static_cast<uint16_t>( sargon_z80_symbol("STACK") );
+    push( SENTINEL );
+    pc = static_cast<uint16_t>( sargon_z80_symbol(routines[api_command_code]) );
+    frames.clear();
+    enter_routine(pc);
+    running = true;
+    if( translate )
+        run_translated();
+    else
+    {
+        while( running )
+        {
+            if( callback_at[pc] && callback_fn )
+                do_callbacks();
+            step();
+        }
+    }
+    while( frames.size() > 0 )
+        close_frame();
+    if( registers )
+    {
+        registers->af = (reg[REG_F]<<8) | reg[REG_A];
+        registers->hl = pair(REG_H);
+        registers->bc = pair(REG_B);
+        registers->de = pair(REG_D);
+        registers->ix = ix;
+        registers->iy = iy;
+    }
+    return error == "";
+}
+
+unsigned int sargon_z80_symbol( const std::string &name )
+{
+    auto it = symbols.find( util::toupper(name) );
+    return it==symbols.end() ? 0 : it->second;
+}
+
+unsigned char sargon_z80_peekb( unsigned int addr )
+{
+    return mem[addr&0xffff];
+}
+
+unsigned int sargon_z80_peekw( unsigned int addr )
+{
+    return rd16( static_cast<uint16_t>(addr) );
+}
+
+void sargon_z80_pokeb( unsigned int addr, unsigned char b )
+{
+    wr8( addr&0xffff, b );
+}
+
+void sargon_z80_pokew( unsigned int addr, unsigned int w )
+{
+    wr16( static_cast<uint16_t>(addr), static_cast<uint16_t>(w) );
+}
+
+void sargon_z80_import_from_x86()
+{
+    unsigned int boarda = sargon_z80_symbol("BOARDA");
+    for( int i=0; i<120; i++ )
+        wr8( boarda+i, peekb(BOARDA+i) );
+    wr8( sargon_z80_symbol("COLOR"),  peekb(COLOR) );
+    wr8( sargon_z80_symbol("KOLOR"),  peekb(KOLOR) );
+    wr8( sargon_z80_symbol("MOVENO"), peekb(MOVENO) );
+    wr8( sargon_z80_symbol("PLYMAX"), peekb(PLYMAX) );
+
+    // The last move (if any) is needed to generate en passant captures. If
+    //  there is no last move, MLPTRJ is zero and Sargon writes into the first
+    //  page of memory (see sargon_import_position()). That's harmless in the
+    //  x86 layout but in the Z80 layout it corrupts the M3 pointer, so point
+    //  at some spare memory instead
+    unsigned int mlptrj = sargon_z80_symbol("MLPTRJ");
+    unsigned int last = peekw(MLPTRJ);
+    unsigned int z80_last = SPARE;
+    if( last >= MLIST )
+        z80_last = sargon_z80_symbol("MLIST") + (last-MLIST);
+    for( int i=0; i<6; i++ )
+        wr8( z80_last+i, (last==0 ? 0 : peekb(last+i)) );
+    sargon_z80_pokew( mlptrj, z80_last );
+    sargon_z80( api_ROYALT );
+}
+
+std::string sargon_z80_export_move()
+{
+    unsigned int p = sargon_z80_peekw( sargon_z80_symbol("BESTM") );
+    thc::Square src, dst;
+    if( !sargon_export_square(sargon_z80_peekb(p+2),src) || !sargon_export_square(sargon_z80_peekb(p+3),dst) )
+        return "";
+    return util::sprintf( "%c%c%c%c", thc::get_file(src), thc::get_rank(src), thc::get_file(dst), thc::get_rank(dst) );
+}
+
+//
+// T-state accounting
+//
+
+void sargon_z80_reset_stats()
+{
+    tstates = 0;
+    routine_stats.assign( 65536, ROUTINE_STATS() );
+}
+
+uint64_t sargon_z80_tstates()
+{
+    return tstates;
+}
+
+uint64_t sargon_z80_routine_tstates( const std::string &name )
+{
+    auto it = symbols.find( util::toupper(name) );
+    return it==symbols.end() ? 0 : routine_stats[it->second].total;
+}
+
+std::string sargon_z80_report_stats()
+{
+    std::vector<unsigned int> order;
+    for( unsigned int addr=0; addr<routine_stats.size(); addr++ )
+    {
+        if( routine_stats[addr].calls > 0 )
+            order.push_back(addr);
+    }
+    std::sort( order.begin(), order.end(), [](unsigned int a, unsigned int b) { return routine_stats[a].self > routine_stats[b].self; } );
+    std::string s = util::sprintf( "Z80 T-states %llu, %.1f seconds on a TRS-80\n",
+            static_cast<unsigned long long>(tstates), tstates/SARGON_Z80_TRS80_HZ );
+    s += util::sprintf( "%-8s %12s %14s %14s %7s %10s\n", "routine", "calls", "total T", "self T", "self %", "self/call" );
+    for( unsigned int addr: order )
+    {
+        const ROUTINE_STATS &rs = routine_stats[addr];
+        auto it = routine_names.find(addr);
+        std::string name = it==routine_names.end() ? util::sprintf("%04X",addr) : it->second;
+        double self = static_cast<double>(rs.self);
+        s += util::sprintf( "%-8s %12llu %14llu %14llu %6.1f%% %10.0f\n",
+                name.c_str(),
+                static_cast<unsigned long long>(rs.calls),
+                static_cast<unsigned long long>(rs.total),
+                static_cast<unsigned long long>(rs.self),
+                tstates ? 100.0*self/tstates : 0.0,
+                self / rs.calls );
+    }
+    return s;
+}
@@ -0,0 +1,70 @@
+/****************************************************************************
+ * This project is a Windows port of the classic program Sargon, as
+ * presented in the book "Sargon a Z80 Computer Chess Program" by Dan
+ * and Kathe Spracklen (Hayden Books 1978).
+ *
+ * File: sargon-z80.h
+ *       Run the original Z80 Sargon in a Z80 interpreter, as a reference
+ *       for the x86 translation, with T-state (Z80 clock cycle) accounting
+ *
+ * Bill Forster, https://github.com/billforsternz/retro-sargon
+ ****************************************************************************/
+
+#ifndef SARGON_Z80_H_INCLUDED
+#define SARGON_Z80_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include "sargon-asm-interface.h"
+
+// Clock of the TRS-80 Model I, the machine the Sargon manual's timings refer to
+const double SARGON_Z80_TRS80_HZ = 1774080.0;
+
+// Load the assembled Z80 code from the zmac listing (stages/sargon-z80.lst).
+//  The CALLBACK points are found in the combined source the listing was
+//  generated from (stages/sargon-z80-and-x86.asm). Returns false and sets
+//  error on failure
+bool sargon_z80_load( const std::string &listing_file, const std::string &source_file, std::string &error );
+bool sargon_z80_loaded();
+
+// Run a Sargon routine, api_command_code and registers as for sargon(). Returns
+//  false (see sargon_z80_error()) if the Z80 code did something unexpected
+bool sargon_z80( int api_command_code, z80_registers *registers=NULL );
+std::string sargon_z80_error();
+
+// The interpreter's equivalent of callback(), called at each CALLBACK point
+//  with the Z80 registers (af = flags in hi byte, A in lo byte, as for x86)
+typedef void (*SARGON_Z80_CALLBACK)( const char *msg, z80_registers &registers );
+void sargon_z80_set_callback( SARGON_Z80_CALLBACK callback );
+
+// Z80 memory access. The Z80 data layout differs from the x86 layout, so
+//  use sargon_z80_symbol() for addresses, not the constants in
+//  sargon-asm-interface.h
+unsigned int  sargon_z80_symbol( const std::string &name );   // 0 if not found
+unsigned char sargon_z80_peekb( unsigned int addr );
+unsigned int  sargon_z80_peekw( unsigned int addr );
+void sargon_z80_pokeb( unsigned int addr, unsigned char b );
+void sargon_z80_pokew( unsigned int addr, unsigned int w );
+
+// Copy the inputs of a move calculation (position, colours, move number,
+//  PLYMAX, last move for en passant) from the x86 Sargon memory, so
+//  sargon_z80(api_CPTRMV) calculates the same move sargon(api_CPTRMV) would
+void sargon_z80_import_from_x86();
+
+// The calculated move in the same form as sargon_export_move(BESTM)
+std::string sargon_z80_export_move();
+
+// T-state accounting; total T-states, and calls, total T-states (including
+//  callees) and self T-states of a routine since the last reset
+void sargon_z80_reset_stats();
+uint64_t sargon_z80_tstates();
+uint64_t sargon_z80_routine_tstates( const std::string &name );
+std::string sargon_z80_report_stats();
+
+// Basic blocks are translated to threaded code on first execution and
+//  cached (the default), or every instruction is interpreted. Results and
+//  T-states are identical either way, translation is just faster
+void sargon_z80_set_translate( bool on );
+std::string sargon_z80_report_translation();
+
+#endif // SARGON_Z80_H_INCLUDED
@@ -4,7 +4,10 @@
 extern "C" {
 
     // First byte of Sargon data
-    extern unsigned char sargon_base_address;
+    extern unsigned char sargon_base_address[];
+
+    // Non zero selects native C++ POINTS(), see sargon-points.cpp
+    extern unsigned char sargon_native_points;
 
     // Calls to sargon() can set and read back registers
     struct z80_registers
@@ -27,6 +30,10 @@ extern "C" {
                    uint32_t ebx, uint32_t edx, uint32_t ecx, uint32_t eax,
                    uint32_t eflags );
 
+    // Portable form of callback(), for the C++ build of Sargon. The x86 build's
+    //  callback() calls it too, see sargon-interface.cpp
+    void sargon_callback( const char *msg, z80_registers &registers );
+
     // Data offsets for peeking and poking
     const int BOARDA = 0x0134;
     const int ATKLST = 0x01ac;
@@ -84,5 +91,10 @@ extern "C" {
     const int api_VALMOV = 4;
     const int api_ASNTBI = 5;
     const int api_EXECMV = 6;
+    const int api_XCHNG = 7;
+    const int api_GENMOV = 8;
+    const int api_POINTS = 9;
+    const int api_ATTACK = 10;
+    const int api_PINFND = 11;
 };
 #endif //SARGON_ASM_INTERFACE_H_INCLUDED